@@ -1,226 +1,323 @@
-// Checkpoint1.cpp : Defines the entry point for the console application.
-// author: Mike DeMauro
-
-#include "stdafx.h"
-
-#include "GL/glut.h"
-
-// Screen size
-#define RES_WIDTH 800.0
-#define RES_HEIGHT 600.0
-
-// Holds values for the View transform
-struct Camera {
-	int ID;
-
-	GLdouble eyeX;
-	GLdouble eyeY;
-	GLdouble eyeZ;
-
-	GLdouble centerX;
-	GLdouble centerY;
-	GLdouble centerZ;
-
-	GLdouble upX;
-	GLdouble upY;
-	GLdouble upZ;
-
-	void CreateLookAt() {
-		gluLookAt ( eyeX, eyeY, eyeZ,
-			 centerX, centerY, centerZ,
-			 upX, upY, upZ);
-	}
-};
-
-// Camera 
-Camera cam;
-
-// Sets up lighting
-void InitLighting() {
-	glEnable(GL_LIGHTING);
-	//glLightModeli( GL_LIGHT_MODEL_TWO_SIDE, GL_TRUE );
-
-	glEnable(GL_LIGHT0);
-    
-	glEnable(GL_NORMALIZE);
-
-	glEnable(GL_DEPTH_TEST);
-}
-
-//Initializes OpenGL
-void Initialize() {
-	// Init GL 
-	glClearColor (0.4, 0.6, 1.0, 0.0);
-	glShadeModel (GL_SMOOTH);
-
-	// Init lighting
-	InitLighting();
-
-	// Init camera
-	cam = *new Camera();
-	
-	cam.eyeX = 3.0;
-	cam.eyeY = 4.0;
-	cam.eyeZ = 15.0;
-
-	cam.centerX = 3.0;
-	cam.centerY = 0.0;
-	cam.centerZ = -70.0;
-
-	cam.upY = 1.0;
-	cam.ID = 0;
-	
-	// clear the matrix
-	glLoadIdentity ();    
-}
-
-// lighting parameters
-GLfloat position[] = { 5.0, 8.0, 15.0, 1.0 };
-GLfloat diffuse[] = { 1.0, 1.0, 1.0, 0.5 };
-
-// Sets the lighting for draw
-void lighting() {
-    glLightfv(GL_LIGHT0, GL_POSITION, position);
-	glLightfv(GL_LIGHT0, GL_DIFFUSE, diffuse);
-	//glLightfv(GL_LIGHT0, GL_AMBIENT, diffuse);
-}
-
-double s1x = 1.5;
-double s1y = 3.0;
-double s1z = 9;
-
-double s2x = 3;
-double s2y = 4;
-double s2z = 11;
-
-// Draws the graphics
-void Draw() {
-	glPushMatrix();
-
-	glClear( GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT ); 
-
-	// view transform
-	cam.CreateLookAt();
-
-	// lighting
-	lighting();
-
-	// world transforms
-	glPushMatrix();
-
-
-	// floor
-	glBegin(GL_QUADS);
-	glColor3f (1.0, 0.0, 0.0);
-	glVertex3i(-8, 0, -10);
-	glVertex3i(8, 0, -10);
-	glVertex3i(8, 0, 8);
-	glVertex3i(-8, 0, 8);
-	glEnd();
-
-	glPopMatrix();
-
-	// spheres
-	glPushMatrix();
-	glColor3f (0.0, 1.0, 0.0);
-	glTranslated(s1x, s1y, s1z);
-	glutSolidSphere(1.0, 32, 32);
-	glPopMatrix();
-
-	glPushMatrix();
-	glColor3f (0.0, 0.0, 1.0);
-	glTranslated(s2x, s2y, s2z);
-	glutSolidSphere(1.0, 32, 32);
-	glPopMatrix();
-
-	glPopMatrix();
-
-	glFlush();
-
-	glPopMatrix();
-}
-
-// Free up allocated memory
-void Unload() {
-}
-
-// Handles window resizing
-void reshape (int w, int h)
-{
-   glViewport (0, 0, (GLsizei) w, (GLsizei) h); 
-   glMatrixMode (GL_PROJECTION);
-   glLoadIdentity ();
-   gluPerspective(54.0, (double) w / h, 0.01, 50.0);
-   glMatrixMode (GL_MODELVIEW);
-}
-
-#define DELTA 0.1
-
-// Handles keyboard input
-void keyboard(unsigned char key, int x, int y) {
-	putchar(key);
-	
-	switch(key) {
-		case 'w':
-			s1z -= DELTA;
-			break;
-		case 'a':
-			s1x -= DELTA;
-			break;
-		case 's':
-			s1z += DELTA;
-			break;
-		case 'd':
-			s1x += DELTA;
-			break;
-		case 'r':
-			s1y += DELTA;
-			break;
-		case 'f':
-			s1y -= DELTA;
-			break;
-
-		case 'i':
-			s2z -= DELTA;
-			break;
-		case 'j':
-			s2x -= DELTA;
-			break;
-		case 'k':
-			s2z += DELTA;
-			break;
-		case 'l':
-			s2x += DELTA;
-			break;
-		case 'y':
-			s2y += DELTA;
-			break;
-		case 'h':
-			s2y -= DELTA;
-			break;
-	}
-
-	glutPostRedisplay();
-}
-
-int _tmain(int argc, char** argv)
-{
-	glutInit(&argc, argv);
-	glutInitDisplayMode(GLUT_RGB | GLUT_DEPTH);
-	glutInitWindowPosition(10, 10);
-	glutInitWindowSize(RES_WIDTH,RES_HEIGHT);
-	glutCreateWindow("Ray Tracer: Checkpoint 1");
-
-	Initialize();
-	
-	glutDisplayFunc(Draw); 
-	glutReshapeFunc(reshape);
-	glutKeyboardFunc(keyboard);
-
-	glutMainLoop();
-
-	Unload();
-
-	return 0;
-}
-
+// Checkpoint1.cpp : Defines the entry point for the console application.
+// author: Mike DeMauro
+
+#include "stdafx.h"
+
+#include "GL/glut.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "RTDemoScene.h"
+#include "RTFramebuffer.h"
+#include "RTPlatform.h"
+#include "RTScene.h"
+#include "RTTileScheduler.h"
+#include "RTTracer.h"
+
+// Holds values for the View transform
+struct Camera {
+	int ID;
+
+	GLdouble eyeX;
+	GLdouble eyeY;
+	GLdouble eyeZ;
+
+	GLdouble centerX;
+	GLdouble centerY;
+	GLdouble centerZ;
+
+	GLdouble upX;
+	GLdouble upY;
+	GLdouble upZ;
+
+	void CreateLookAt() {
+		gluLookAt ( eyeX, eyeY, eyeZ,
+			 centerX, centerY, centerZ,
+			 upX, upY, upZ);
+	}
+};
+
+// Camera 
+Camera cam;
+
+// Ray traced view
+RTScene scene;
+RTTracer tracer;
+RTFramebuffer framebuffer;
+RTTileScheduler* scheduler = NULL;
+bool traced = false;
+
+// Reflectivity of the spheres, to give the tracer uneven work
+float reflectivity = 0.0f;
+
+// Sets up lighting
+void InitLighting() {
+	glEnable(GL_LIGHTING);
+	//glLightModeli( GL_LIGHT_MODEL_TWO_SIDE, GL_TRUE );
+
+	glEnable(GL_LIGHT0);
+    
+	glEnable(GL_NORMALIZE);
+
+	glEnable(GL_DEPTH_TEST);
+}
+
+// Sets up the camera
+void InitCamera() {
+	cam = *new Camera();
+	
+	RTCamera camera = RTGetDemoCamera();
+	cam.eyeX = camera.eye.x;
+	cam.eyeY = camera.eye.y;
+	cam.eyeZ = camera.eye.z;
+
+	cam.centerX = camera.center.x;
+	cam.centerY = camera.center.y;
+	cam.centerZ = camera.center.z;
+
+	cam.upX = camera.up.x;
+	cam.upY = camera.up.y;
+	cam.upZ = camera.up.z;
+	cam.ID = 0;
+}
+
+//Initializes OpenGL
+void Initialize() {
+	// Init GL 
+	glClearColor (RTDemoBackground[0], RTDemoBackground[1], RTDemoBackground[2], RTDemoBackground[3]);
+	glShadeModel (GL_SMOOTH);
+
+	// Init lighting
+	InitLighting();
+
+	// Init camera
+	InitCamera();
+	
+	// clear the matrix
+	glLoadIdentity ();    
+}
+
+// Sets the lighting for draw
+void lighting() {
+    glLightfv(GL_LIGHT0, GL_POSITION, RTDemoLightPosition);
+	glLightfv(GL_LIGHT0, GL_DIFFUSE, RTDemoLightDiffuse);
+	//glLightfv(GL_LIGHT0, GL_AMBIENT, diffuse);
+}
+
+double s1x = RTDemoSpheres[0][0];
+double s1y = RTDemoSpheres[0][1];
+double s1z = RTDemoSpheres[0][2];
+
+double s2x = RTDemoSpheres[1][0];
+double s2y = RTDemoSpheres[1][1];
+double s2z = RTDemoSpheres[1][2];
+
+// Builds the tracer's copy of the scene Draw rasterizes, where the keys
+// have moved the spheres
+void BuildScene() {
+	RTBuildDemoScene(&scene, RTVector3((float)s1x, (float)s1y, (float)s1z), RTVector3((float)s2x, (float)s2y, (float)s2z), reflectivity);
+	tracer.SetScene(&scene);
+}
+
+// Points the tracer's camera as CreateLookAt and reshape point GL's
+void SetTracerCamera() {
+	RTCamera camera;
+	camera.eye = RTVector3((float)cam.eyeX, (float)cam.eyeY, (float)cam.eyeZ);
+	camera.center = RTVector3((float)cam.centerX, (float)cam.centerY, (float)cam.centerZ);
+	camera.up = RTVector3((float)cam.upX, (float)cam.upY, (float)cam.upZ);
+	camera.fovy = (float)RT_DEMO_FOVY;
+	camera.nearPlane = (float)RT_DEMO_NEAR_PLANE;
+	camera.farPlane = (float)RT_DEMO_FAR_PLANE;
+
+	tracer.SetCamera(camera, RT_DEMO_WIDTH, RT_DEMO_HEIGHT);
+}
+
+// Ray traces the scene and draws the image over the window
+void DrawTraced() {
+	BuildScene();
+	SetTracerCamera();
+	scheduler->Render(&tracer, &framebuffer);
+
+	glClear( GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT ); 
+
+	// the framebuffer's rows run from the top
+	glMatrixMode(GL_PROJECTION);
+	glPushMatrix();
+	glLoadIdentity();
+	glMatrixMode(GL_MODELVIEW);
+	glPushMatrix();
+	glLoadIdentity();
+
+	glRasterPos2f(-1, 1);
+	glPixelZoom(1, -1);
+	glDrawPixels(framebuffer.GetWidth(), framebuffer.GetHeight(), GL_RGB, GL_FLOAT, framebuffer.GetData());
+	glPixelZoom(1, 1);
+
+	glPopMatrix();
+	glMatrixMode(GL_PROJECTION);
+	glPopMatrix();
+	glMatrixMode(GL_MODELVIEW);
+
+	glFlush();
+}
+
+// Draws the graphics
+void Draw() {
+	if (traced) {
+		DrawTraced();
+		return;
+	}
+
+	glPushMatrix();
+
+	glClear( GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT ); 
+
+	// view transform
+	cam.CreateLookAt();
+
+	// lighting
+	lighting();
+
+	// world transforms
+	glPushMatrix();
+
+
+	// floor
+	glBegin(GL_QUADS);
+	glColor3f (1.0, 0.0, 0.0);
+	glVertex3i(-8, 0, -10);
+	glVertex3i(8, 0, -10);
+	glVertex3i(8, 0, 8);
+	glVertex3i(-8, 0, 8);
+	glEnd();
+
+	glPopMatrix();
+
+	// spheres
+	glPushMatrix();
+	glColor3f (0.0, 1.0, 0.0);
+	glTranslated(s1x, s1y, s1z);
+	glutSolidSphere(1.0, 32, 32);
+	glPopMatrix();
+
+	glPushMatrix();
+	glColor3f (0.0, 0.0, 1.0);
+	glTranslated(s2x, s2y, s2z);
+	glutSolidSphere(1.0, 32, 32);
+	glPopMatrix();
+
+	glPopMatrix();
+
+	glFlush();
+
+	glPopMatrix();
+}
+
+// Free up allocated memory
+void Unload() {
+	delete scheduler;
+	scheduler = NULL;
+}
+
+// Handles window resizing
+void reshape (int w, int h)
+{
+   glViewport (0, 0, (GLsizei) w, (GLsizei) h); 
+   glMatrixMode (GL_PROJECTION);
+   glLoadIdentity ();
+   gluPerspective(RT_DEMO_FOVY, (double) w / h, RT_DEMO_NEAR_PLANE, RT_DEMO_FAR_PLANE);
+   glMatrixMode (GL_MODELVIEW);
+}
+
+#define DELTA 0.1
+
+// Handles keyboard input
+void keyboard(unsigned char key, int x, int y) {
+	putchar(key);
+	
+	switch(key) {
+		case 'w':
+			s1z -= DELTA;
+			break;
+		case 'a':
+			s1x -= DELTA;
+			break;
+		case 's':
+			s1z += DELTA;
+			break;
+		case 'd':
+			s1x += DELTA;
+			break;
+		case 'r':
+			s1y += DELTA;
+			break;
+		case 'f':
+			s1y -= DELTA;
+			break;
+
+		case 'i':
+			s2z -= DELTA;
+			break;
+		case 'j':
+			s2x -= DELTA;
+			break;
+		case 'k':
+			s2z += DELTA;
+			break;
+		case 'l':
+			s2x += DELTA;
+			break;
+		case 'y':
+			s2y += DELTA;
+			break;
+		case 'h':
+			s2y -= DELTA;
+			break;
+
+		case 't':
+			traced = !traced;
+			break;
+	}
+
+	glutPostRedisplay();
+}
+
+int _tmain(int argc, char** argv)
+{
+	// -threads n traces the 't' view on n threads rather than one per
+	// processor, -reflect makes the spheres reflective and -scalar traces
+	// a ray at a time instead of in packets. RTOffline.cpp renders and
+	// benchmarks the same scene without a window.
+	int threads = 0;
+
+	for (int i = 1; i < argc; ++i) {
+		if (strcmp(argv[i], "-threads") == 0 && i + 1 < argc)
+			threads = atoi(argv[++i]);
+		else if (strcmp(argv[i], "-reflect") == 0)
+			reflectivity = 0.5f;
+		else if (strcmp(argv[i], "-scalar") == 0)
+			tracer.SetPacketTracing(false);
+	}
+
+	// 0 threads renders on every processor
+	scheduler = new RTTileScheduler(threads);
+
+	glutInit(&argc, argv);
+	glutInitDisplayMode(GLUT_RGB | GLUT_DEPTH);
+	glutInitWindowPosition(10, 10);
+	glutInitWindowSize(RT_DEMO_WIDTH,RT_DEMO_HEIGHT);
+	glutCreateWindow("Ray Tracer: Checkpoint 1");
+
+	Initialize();
+	
+	glutDisplayFunc(Draw); 
+	glutReshapeFunc(reshape);
+	glutKeyboardFunc(keyboard);
+
+	glutMainLoop();
+
+	Unload();
+
+	return 0;
+}
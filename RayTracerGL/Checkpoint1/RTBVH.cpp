@@ -0,0 +1,296 @@
+// RTBVH.cpp
+//
+// Summary:
+//	Builds a bounding volume hierarchy over the bounds of a scene's objects
+//	with the surface area heuristic.
+
+#include "RTBVH.h"
+
+#include <algorithm>
+#include <cfloat>
+
+// Bins object centres are sorted into along a node's widest axis. The
+// boundaries between them are the splits the surface area heuristic tries.
+#define RT_BVH_BINS					16
+
+// Cost of testing a ray against a node's bounds, relative to testing it
+// against an object
+#define RT_BVH_TRAVERSAL_COST		1.0f
+
+// Depth from which nodes are split at the median, so that no ray walks
+// down more than RT_BVH_STACK_SIZE nodes
+#define RT_BVH_MEDIAN_DEPTH			40
+
+/// <summary>
+/// Orders objects by their centres along an axis.
+/// </summary>
+struct RTBVHCenterLess
+{
+	const RTVector3 *			centers;
+	int							axis;
+
+	bool operator()( int a, int b ) const { return centers[a][axis] < centers[b][axis]; }
+};
+
+/// <summary>
+/// Makes the bounds empty, so that the first thing grown into them is all
+/// they hold.
+/// </summary>
+void RTBounds::Reset()
+{
+	min = RTVector3( FLT_MAX, FLT_MAX, FLT_MAX );
+	max = RTVector3( -FLT_MAX, -FLT_MAX, -FLT_MAX );
+}
+
+void RTBounds::Grow( const RTVector3 & point )
+{
+	min = RTVector3( point.x < min.x ? point.x : min.x, point.y < min.y ? point.y : min.y, point.z < min.z ? point.z : min.z );
+	max = RTVector3( point.x > max.x ? point.x : max.x, point.y > max.y ? point.y : max.y, point.z > max.z ? point.z : max.z );
+}
+
+void RTBounds::Grow( const RTBounds & bounds )
+{
+	Grow( bounds.min );
+	Grow( bounds.max );
+}
+
+/// <summary>
+/// Returns the surface area of the bounds, to which the chance that a ray
+/// passing through a parent passes through them is proportional.
+/// </summary>
+float RTBounds::GetArea() const
+{
+	RTVector3 size = max - min;
+	return 2 * ( size.x * size.y + size.y * size.z + size.z * size.x );
+}
+
+RTBVH::RTBVH( void )
+{
+	maxLeafSize = 4;
+	bounds = NULL;
+}
+
+RTBVH::~RTBVH( void )
+{
+}
+
+void RTBVH::Clear()
+{
+	nodes.clear();
+	objects.clear();
+}
+
+/// <summary>
+/// Sets how many objects a leaf may hold. Leaves hold fewer where the
+/// surface area heuristic finds a split cheaper.
+/// </summary>
+void RTBVH::SetMaxLeafSize( int maxLeafSize )
+{
+	this->maxLeafSize = maxLeafSize < 1 ? 1 : maxLeafSize > 255 ? 255 : maxLeafSize;
+}
+
+/// <summary>
+/// Builds the hierarchy over objects with the given bounds, numbered in
+/// their order.
+/// </summary>
+void RTBVH::Build( const vector<RTBounds> & bounds )
+{
+	Clear();
+	if( bounds.empty() )
+		return;
+
+	int numObjects = ( int )bounds.size();
+	this->bounds = &bounds[0];
+	centers.resize( numObjects );
+	objects.resize( numObjects );
+	for( int i = 0; i < numObjects; ++i )
+	{
+		centers[i] = bounds[i].GetCenter();
+		objects[i] = i;
+	}
+
+	// A binary tree with a leaf per object at most
+	nodes.reserve( 2 * numObjects - 1 );
+	BuildNode( 0, numObjects, 0 );
+
+	this->bounds = NULL;
+	vector<RTVector3>().swap( centers );
+}
+
+/// <summary>
+/// Builds the node over objects[begin] to objects[end - 1], and the nodes
+/// below it, reordering those entries so each leaf's are together.
+/// </summary>
+/// <returns>The index of the node.</returns>
+int RTBVH::BuildNode( int begin, int end, int depth )
+{
+	RTBounds nodeBounds;
+	RTBounds centerBounds;
+	nodeBounds.Reset();
+	centerBounds.Reset();
+	for( int i = begin; i < end; ++i )
+	{
+		nodeBounds.Grow( bounds[objects[i]] );
+		centerBounds.Grow( centers[objects[i]] );
+	}
+
+	int index = ( int )nodes.size();
+	RTBVHNode node;
+	node.min = nodeBounds.min;
+	node.max = nodeBounds.max;
+	node.first = begin;
+	node.count = ( unsigned short )( end - begin );
+	node.axis = 0;
+	nodes.push_back( node );
+
+	int count = end - begin;
+	if( count == 1 )
+		return index;
+
+	RTVector3 extent = centerBounds.max - centerBounds.min;
+	int axis = extent.y > extent.x ? 1 : 0;
+	if( extent.z > extent[axis] )
+		axis = 2;
+
+	int middle;
+	if( extent[axis] < RT_BVH_BINS * FLT_MIN )
+	{
+		// The centres are all but one point, so no plane parts them
+		if( count <= maxLeafSize )
+			return index;
+
+		middle = begin + count / 2;
+	}
+	else if( depth >= RT_BVH_MEDIAN_DEPTH )
+	{
+		middle = begin + count / 2;
+		RTBVHCenterLess less;
+		less.centers = &centers[0];
+		less.axis = axis;
+		nth_element( objects.begin() + begin, objects.begin() + middle, objects.begin() + end, less );
+	}
+	else
+	{
+		int binCounts[RT_BVH_BINS];
+		RTBounds binBounds[RT_BVH_BINS];
+		for( int bin = 0; bin < RT_BVH_BINS; ++bin )
+		{
+			binCounts[bin] = 0;
+			binBounds[bin].Reset();
+		}
+
+		float low = centerBounds.min[axis];
+		float scale = RT_BVH_BINS / extent[axis];
+		for( int i = begin; i < end; ++i )
+		{
+			int bin = ( int )( ( centers[objects[i]][axis] - low ) * scale );
+			if( bin >= RT_BVH_BINS )
+				bin = RT_BVH_BINS - 1;
+
+			++binCounts[bin];
+			binBounds[bin].Grow( bounds[objects[i]] );
+		}
+
+		// The cost of the objects above each boundary, summed from the top,
+		// then of those below it from the bottom. The lowest and highest
+		// centres fall in the end bins, so some boundary parts the objects.
+		float aboveCosts[RT_BVH_BINS];
+		int aboveCounts[RT_BVH_BINS];
+		RTBounds above;
+		above.Reset();
+		int aboveCount = 0;
+		for( int bin = RT_BVH_BINS - 1; bin > 0; --bin )
+		{
+			aboveCount += binCounts[bin];
+			above.Grow( binBounds[bin] );
+			aboveCounts[bin] = aboveCount;
+			aboveCosts[bin] = aboveCount > 0 ? aboveCount * above.GetArea() : 0;
+		}
+
+		RTBounds below;
+		below.Reset();
+		int belowCount = 0;
+		float bestCost = FLT_MAX;
+		int bestBin = 0;
+		for( int bin = 0; bin < RT_BVH_BINS - 1; ++bin )
+		{
+			belowCount += binCounts[bin];
+			below.Grow( binBounds[bin] );
+			if( belowCount == 0 || aboveCounts[bin + 1] == 0 )
+				continue;
+
+			float cost = belowCount * below.GetArea() + aboveCosts[bin + 1];
+			if( cost < bestCost )
+			{
+				bestCost = cost;
+				bestBin = bin;
+			}
+		}
+
+		// A ray reaching the node reaches each child in proportion to its
+		// area, so the split costs a test of each child's bounds and of the
+		// objects in those it reaches, against a test of every object
+		float area = nodeBounds.GetArea();
+		float splitCost = 2 * RT_BVH_TRAVERSAL_COST + ( area > 0 ? bestCost / area : count );
+		if( count <= maxLeafSize && count <= splitCost )
+			return index;
+
+		// The bins are worked out again rather than compared with a plane,
+		// so every object lands on the side it was counted on
+		int i = begin;
+		int j = end - 1;
+		while( i <= j )
+		{
+			int bin = ( int )( ( centers[objects[i]][axis] - low ) * scale );
+			if( bin <= bestBin )
+				++i;
+			else
+				swap( objects[i], objects[j--] );
+		}
+		middle = i;
+	}
+
+	BuildNode( begin, middle, depth + 1 );
+	int second = BuildNode( middle, end, depth + 1 );
+
+	nodes[index].first = second;
+	nodes[index].count = 0;
+	nodes[index].axis = ( unsigned short )axis;
+	return index;
+}
+
+/// <summary>
+/// Returns the number of nodes on the longest path from the root to a leaf.
+/// </summary>
+int RTBVH::GetDepth() const
+{
+	if( nodes.empty() )
+		return 0;
+
+	vector<int> depths( nodes.size() );
+	depths[0] = 1;
+	int depth = 1;
+
+	// Parents come before their children
+	for( int i = 0; i < ( int )nodes.size(); ++i )
+	{
+		if( depths[i] > depth )
+			depth = depths[i];
+
+		if( nodes[i].count == 0 )
+		{
+			depths[i + 1] = depths[i] + 1;
+			depths[nodes[i].first] = depths[i] + 1;
+		}
+	}
+
+	return depth;
+}
+
+/// <summary>
+/// Returns the bytes the nodes and the object list take.
+/// </summary>
+size_t RTBVH::GetMemorySize() const
+{
+	return nodes.size() * sizeof( RTBVHNode ) + objects.size() * sizeof( int );
+}
@@ -0,0 +1,84 @@
+#pragma once
+
+#include <vector>
+
+#include "RTMath.h"
+
+using namespace std;
+
+// Most nodes a ray walks down from the root to a leaf, and so the most a
+// traversal stack of the nodes it has yet to visit holds. Build keeps to
+// it for up to 2^24 objects.
+#define RT_BVH_STACK_SIZE			64
+
+/// <summary>
+/// An axis aligned bounding box.
+/// </summary>
+struct RTBounds
+{
+	RTVector3					min;
+	RTVector3					max;
+
+	void Reset();
+	void Grow( const RTVector3 & point );
+	void Grow( const RTBounds & bounds );
+	RTVector3 GetCenter() const { return ( min + max ) * 0.5f; }
+	float GetArea() const;
+};
+
+/// <summary>
+/// A node of a bounding volume hierarchy, 32 bytes so two share a cache
+/// line. An interior node's first child follows it in the node array, so
+/// only the second child's index is kept.
+/// </summary>
+struct RTBVHNode
+{
+	RTVector3					min;
+	int							first;			// Leaf: first entry of its objects in the object list. Interior: second child.
+	RTVector3					max;
+	unsigned short				count;			// Objects in a leaf, 0 for an interior node
+	unsigned short				axis;			// Interior: axis the children were split along, the first child on the low side
+};
+
+/// <summary>
+/// A bounding volume hierarchy over the objects of a scene, built with the
+/// surface area heuristic, to find the objects a ray may hit without
+/// testing them all.
+/// </summary>
+/// <remarks>
+/// The hierarchy knows objects only by their bounds and their numbers, in
+/// the order the bounds are given; what an object is, and how a ray is
+/// tested against it, is up to whoever traverses it. Nodes are kept depth
+/// first in one array, so a ray walking down the near side of the tree
+/// reads memory in order.
+///
+/// Each node is split where the surface area heuristic, evaluated at the
+/// boundaries of a few bins of object centres along its widest axis,
+/// estimates rays will test the fewest objects, and becomes a leaf when
+/// testing its objects is cheaper than any split. Deep nodes are split at
+/// the median instead, which bounds the depth of the tree.
+/// </remarks>
+class RTBVH
+{
+protected:
+	vector<RTBVHNode>			nodes;
+	vector<int>					objects;		// Object numbers, a leaf's together
+	int							maxLeafSize;
+	const RTBounds *			bounds;			// Of each object, while building
+	vector<RTVector3>			centers;
+
+	int BuildNode( int begin, int end, int depth );
+public:
+	RTBVH( void );
+	~RTBVH( void );
+	void Clear();
+	void Build( const vector<RTBounds> & bounds );
+	bool IsEmpty() const { return nodes.empty(); }
+	int GetNumNodes() const { return ( int )nodes.size(); }
+	const RTBVHNode & GetNode( int node ) const { return nodes[node]; }
+	int GetObject( int entry ) const { return objects[entry]; }
+	int GetMaxLeafSize() const { return maxLeafSize; }
+	void SetMaxLeafSize( int maxLeafSize );
+	int GetDepth() const;
+	size_t GetMemorySize() const;
+};
@@ -0,0 +1,86 @@
+// RTDemoScene.cpp
+//
+// Summary:
+//	Builds the tracer's copy of the scene Checkpoint1.cpp draws with GL,
+//	and random scenes of many spheres over the same floor.
+
+#include "RTDemoScene.h"
+
+#include <math.h>
+#include <stdlib.h>
+
+/// <summary>
+/// Returns a random number from low to high.
+/// </summary>
+static float RandomFloat( float low, float high )
+{
+	return low + ( high - low ) * rand() / RAND_MAX;
+}
+
+/// <summary>
+/// Adds the light and floor every scene here has, lit as GL lights them.
+/// </summary>
+static void AddFloorAndLight( RTScene * scene )
+{
+	// GL's default global ambient
+	scene->SetAmbient( RTVector3( 0.2f, 0.2f, 0.2f ) );
+	scene->SetBackground( RTVector3( RTDemoBackground[0], RTDemoBackground[1], RTDemoBackground[2] ) );
+
+	scene->AddLight( RTVector3( RTDemoLightPosition[0], RTDemoLightPosition[1], RTDemoLightPosition[2] ),
+		RTVector3( RTDemoLightDiffuse[0], RTDemoLightDiffuse[1], RTDemoLightDiffuse[2] ) );
+
+	scene->AddQuad( RTVector3( -8, 0, -10 ), RTVector3( 8, 0, -10 ), RTVector3( 8, 0, 8 ), RTVector3( -8, 0, 8 ), RTMaterial( RTVector3( 1, 0, 0 ) ) );
+}
+
+/// <summary>
+/// Returns the camera the window looks through, with its projection.
+/// </summary>
+RTCamera RTGetDemoCamera()
+{
+	RTCamera camera;
+	camera.eye = RTVector3( 3.0f, 4.0f, 15.0f );
+	camera.center = RTVector3( 3.0f, 0.0f, -70.0f );
+	camera.up = RTVector3( 0.0f, 1.0f, 0.0f );
+	camera.fovy = ( float )RT_DEMO_FOVY;
+	camera.nearPlane = ( float )RT_DEMO_NEAR_PLANE;
+	camera.farPlane = ( float )RT_DEMO_FAR_PLANE;
+	return camera;
+}
+
+/// <summary>
+/// Builds the scene the window draws: the floor, and a green and a blue
+/// sphere of radius 1, with a hierarchy over them.
+/// </summary>
+/// <param name='reflectivity'>Reflectivity of the spheres, to give the tracer uneven work.</param>
+void RTBuildDemoScene( RTScene * scene, const RTVector3 & sphere1, const RTVector3 & sphere2, float reflectivity )
+{
+	scene->Clear();
+	AddFloorAndLight( scene );
+
+	scene->AddSphere( sphere1, 1.0f, RTMaterial( RTVector3( 0, 1, 0 ), 0, 0, reflectivity ) );
+	scene->AddSphere( sphere2, 1.0f, RTMaterial( RTVector3( 0, 0, 1 ), 0, 0, reflectivity ) );
+
+	scene->BuildHierarchy();
+}
+
+/// <summary>
+/// Builds a scene of the floor and light of RTBuildDemoScene and random
+/// spheres over the floor, sized to fill the same share of the space above
+/// it whatever their number, without a hierarchy.
+/// </summary>
+void RTBuildRandomScene( RTScene * scene, int numSpheres, float reflectivity )
+{
+	scene->Clear();
+	AddFloorAndLight( scene );
+
+	// 16 by 6 by 18 above the floor
+	float radius = 0.25f * powf( 16.0f * 6.0f * 18.0f / numSpheres, 1.0f / 3.0f );
+
+	srand( 1 );
+	for( int i = 0; i < numSpheres; ++i )
+	{
+		RTVector3 center( RandomFloat( -8, 8 ), RandomFloat( radius, 6 ), RandomFloat( -10, 8 ) );
+		RTVector3 color( RandomFloat( 0, 1 ), RandomFloat( 0, 1 ), RandomFloat( 0, 1 ) );
+		scene->AddSphere( center, radius, RTMaterial( color, 0, 0, reflectivity ) );
+	}
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include "RTMath.h"
+#include "RTScene.h"
+#include "RTTracer.h"
+
+// The scene of the checkpoint: a floor, two spheres and a light, seen from
+// one camera. Checkpoint1.cpp draws it with GL and traces it in a window,
+// and RTOffline.cpp traces it without one, so both take it from here.
+
+// Image size
+#define RT_DEMO_WIDTH				800
+#define RT_DEMO_HEIGHT				600
+
+// Projection, shared by GL and the tracer
+#define RT_DEMO_FOVY				54.0
+#define RT_DEMO_NEAR_PLANE			0.01
+#define RT_DEMO_FAR_PLANE			50.0
+
+// GL's clear colour, and the colour where rays miss
+static const float RTDemoBackground[4] = { 0.4f, 0.6f, 1.0f, 0.0f };
+
+// The light, laid out as GL_POSITION and GL_DIFFUSE take it
+static const float RTDemoLightPosition[4] = { 5.0f, 8.0f, 15.0f, 1.0f };
+static const float RTDemoLightDiffuse[4] = { 1.0f, 1.0f, 1.0f, 0.5f };
+
+// Centres of the two spheres before the keys move them
+static const float RTDemoSpheres[2][3] = { { 1.5f, 3.0f, 9.0f }, { 3.0f, 4.0f, 11.0f } };
+
+RTCamera RTGetDemoCamera();
+void RTBuildDemoScene( RTScene * scene, const RTVector3 & sphere1, const RTVector3 & sphere2, float reflectivity );
+void RTBuildRandomScene( RTScene * scene, int numSpheres, float reflectivity );
@@ -0,0 +1,83 @@
+// RTFramebuffer.cpp
+//
+// Summary:
+//	Float framebuffer of a render, written out as a PFM or PPM image.
+
+#include "RTFramebuffer.h"
+
+#include <cstdio>
+#include <cstring>
+
+RTFramebuffer::RTFramebuffer( void )
+{
+	width = 0;
+	height = 0;
+}
+
+RTFramebuffer::RTFramebuffer( int width, int height )
+{
+	this->width = 0;
+	this->height = 0;
+	Resize( width, height );
+}
+
+RTFramebuffer::~RTFramebuffer( void )
+{
+}
+
+/// <summary>
+/// Changes the size of the image. Pixels are black until rendered.
+/// </summary>
+void RTFramebuffer::Resize( int width, int height )
+{
+	this->width = width;
+	this->height = height;
+	pixels.assign( ( size_t )width * height, RTVector3( 0, 0, 0 ) );
+}
+
+/// <summary>
+/// Writes the image to a file. A name ending in .pfm keeps the floats as
+/// they are; any other name gets an 8 bit PPM, clamped to 0 to 1.
+/// </summary>
+HRESULT RTFramebuffer::Write( const char * fileName ) const
+{
+	size_t length = strlen( fileName );
+	bool pfm = length >= 4 && strcmp( fileName + length - 4, ".pfm" ) == 0;
+
+	FILE * file = fopen( fileName, "wb" );
+	if( file == NULL )
+		return E_FAIL;
+
+	bool written = true;
+	if( pfm )
+	{
+		// PFM rows run from the bottom, and a negative scale marks the
+		// floats as little endian
+		fprintf( file, "PF\n%d %d\n-1.0\n", width, height );
+		for( int y = height - 1; y >= 0 && written; --y )
+			written = fwrite( &pixels[y * width], sizeof( RTVector3 ), width, file ) == ( size_t )width;
+	}
+	else
+	{
+		fprintf( file, "P6\n%d %d\n255\n", width, height );
+		vector<unsigned char> row( width * 3 );
+		for( int y = 0; y < height && written; ++y )
+		{
+			for( int x = 0; x < width; ++x )
+			{
+				const RTVector3 & pixel = GetPixel( x, y );
+				for( int c = 0; c < 3; ++c )
+				{
+					float value = pixel[c] < 0 ? 0 : pixel[c] > 1 ? 1 : pixel[c];
+					row[x * 3 + c] = ( unsigned char )( value * 255 + 0.5f );
+				}
+			}
+			written = fwrite( &row[0], 1, row.size(), file ) == row.size();
+		}
+	}
+
+	if( fclose( file ) != 0 )
+		written = false;
+
+	return written ? S_OK : E_FAIL;
+}
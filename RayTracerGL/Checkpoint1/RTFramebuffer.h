@@ -0,0 +1,30 @@
+#pragma once
+
+#include <vector>
+
+#include "RTMath.h"
+#include "RTPlatform.h"
+
+using namespace std;
+
+/// <summary>
+/// An RGB image of floats, kept row by row from the top.
+/// </summary>
+class RTFramebuffer
+{
+protected:
+	int							width;
+	int							height;
+	vector<RTVector3>			pixels;
+public:
+	RTFramebuffer( void );
+	RTFramebuffer( int width, int height );
+	~RTFramebuffer( void );
+	void Resize( int width, int height );
+	int GetWidth() const { return width; }
+	int GetHeight() const { return height; }
+	RTVector3 & GetPixel( int x, int y ) { return pixels[y * width + x]; }
+	const RTVector3 & GetPixel( int x, int y ) const { return pixels[y * width + x]; }
+	const float * GetData() const { return pixels.empty() ? NULL : &pixels[0].x; }
+	HRESULT Write( const char * fileName ) const;
+};
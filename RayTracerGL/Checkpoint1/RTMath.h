@@ -0,0 +1,66 @@
+#pragma once
+
+#include <cmath>
+
+/// <summary>
+/// A point, direction or RGB colour.
+/// </summary>
+struct RTVector3
+{
+	float x;
+	float y;
+	float z;
+
+	RTVector3() {}
+	RTVector3( float x, float y, float z ) { this->x = x; this->y = y; this->z = z; }
+
+	RTVector3 operator-() const { return RTVector3( -x, -y, -z ); }
+	RTVector3 operator+( const RTVector3 & v ) const { return RTVector3( x + v.x, y + v.y, z + v.z ); }
+	RTVector3 operator-( const RTVector3 & v ) const { return RTVector3( x - v.x, y - v.y, z - v.z ); }
+	RTVector3 operator*( const RTVector3 & v ) const { return RTVector3( x * v.x, y * v.y, z * v.z ); }
+	RTVector3 operator*( float s ) const { return RTVector3( x * s, y * s, z * s ); }
+	RTVector3 & operator+=( const RTVector3 & v ) { x += v.x; y += v.y; z += v.z; return *this; }
+	float operator[]( int i ) const { return ( &x )[i]; }
+};
+
+inline float RTDot( const RTVector3 & a, const RTVector3 & b )
+{
+	return a.x * b.x + a.y * b.y + a.z * b.z;
+}
+
+inline RTVector3 RTCross( const RTVector3 & a, const RTVector3 & b )
+{
+	return RTVector3( a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x );
+}
+
+inline float RTLength( const RTVector3 & v )
+{
+	return sqrtf( RTDot( v, v ) );
+}
+
+inline RTVector3 RTNormalize( const RTVector3 & v )
+{
+	return v * ( 1.0f / RTLength( v ) );
+}
+
+/// <summary>
+/// Reflects an incident direction about a surface normal.
+/// </summary>
+inline RTVector3 RTReflect( const RTVector3 & incident, const RTVector3 & normal )
+{
+	return incident - normal * ( 2.0f * RTDot( incident, normal ) );
+}
+
+/// <summary>
+/// A ray from position along a unit direction.
+/// </summary>
+struct RTRay
+{
+	RTVector3 position;
+	RTVector3 direction;
+
+	RTRay() {}
+	RTRay( const RTVector3 & position, const RTVector3 & direction ) { this->position = position; this->direction = direction; }
+
+	RTVector3 GetPoint( float distance ) const { return position + direction * distance; }
+};
@@ -0,0 +1,302 @@
+// RTOffline.cpp : Traces the Checkpoint1 scene without a window.
+//
+// Summary:
+//	Renders and benchmarks the tracer from the command line. It uses
+//	neither GLUT nor the precompiled header, so it builds on POSIX render
+//	boxes with nothing but a compiler:
+//
+//	  g++ -O2 -msse2 -pthread -o RTOffline RTOffline.cpp RTDemoScene.cpp
+//	      RTBVH.cpp RTFramebuffer.cpp RTPlatform.cpp RTScene.cpp
+//	      RTTileScheduler.cpp RTTracer.cpp
+//
+//	Use -mavx for 8 ray packets, or -DRT_NO_SIMD for scalar code alone.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <vector>
+
+#include "RTDemoScene.h"
+#include "RTFramebuffer.h"
+#include "RTPlatform.h"
+#include "RTScene.h"
+#include "RTTileScheduler.h"
+#include "RTTracer.h"
+
+RTScene scene;
+RTTracer tracer;
+RTFramebuffer framebuffer;
+RTTileScheduler* scheduler = NULL;
+
+// Reflectivity of the spheres, to give the tracer uneven work
+float reflectivity = 0.0f;
+
+// Builds the scene as the window first shows it
+void BuildScene() {
+	RTBuildDemoScene(&scene, RTVector3(RTDemoSpheres[0][0], RTDemoSpheres[0][1], RTDemoSpheres[0][2]),
+		RTVector3(RTDemoSpheres[1][0], RTDemoSpheres[1][1], RTDemoSpheres[1][2]), reflectivity);
+	tracer.SetScene(&scene);
+}
+
+// Points the tracer's camera as the window points GL's
+void SetTracerCamera() {
+	tracer.SetCamera(RTGetDemoCamera(), RT_DEMO_WIDTH, RT_DEMO_HEIGHT);
+}
+
+// Ray traces the scene and writes the image
+int RenderOffline(const char* fileName, int frames) {
+	BuildScene();
+	SetTracerCamera();
+
+	scheduler->ResetStatistics();
+	double start = RTGetSeconds();
+	for (int i = 0; i < frames; ++i)
+		scheduler->Render(&tracer, &framebuffer);
+	double renderTime = (RTGetSeconds() - start) / frames;
+
+	printf("%dx%d on %d threads, %d rays per packet: render %.2f ms per frame, %.2f Mrays/s\n",
+		framebuffer.GetWidth(), framebuffer.GetHeight(), scheduler->GetNumThreads(),
+		tracer.GetPacketTracing() ? RT_SIMD_WIDTH : 1, renderTime * 1000,
+		scheduler->GetNumRays() / (renderTime * frames) / 1e6);
+	printf("%.1f tiles, %.1f steals, %.1f splits per frame\n", (double)scheduler->GetNumTiles() / frames,
+		(double)scheduler->GetNumSteals() / frames, (double)scheduler->GetNumSplits() / frames);
+
+	if (fileName != NULL && FAILED(framebuffer.Write(fileName))) {
+		fprintf(stderr, "Cannot write %s\n", fileName);
+		return 1;
+	}
+
+	return 0;
+}
+
+// Renders on 1, 2, 4... threads up to maxThreads, and prints the time and
+// speedup of each over one thread
+void PrintSpeedup(int frames, int maxThreads) {
+	BuildScene();
+	SetTracerCamera();
+
+	printf("threads   ms/frame   speedup   efficiency   tiles   steals   splits\n");
+
+	double oneThreadTime = 0;
+	for (int threads = 1; ; threads *= 2) {
+		if (threads > maxThreads)
+			threads = maxThreads;
+
+		RTTileScheduler curveScheduler(threads);
+
+		// the first frame warms the caches and starts the threads
+		curveScheduler.Render(&tracer, &framebuffer);
+		curveScheduler.ResetStatistics();
+
+		double start = RTGetSeconds();
+		for (int i = 0; i < frames; ++i)
+			curveScheduler.Render(&tracer, &framebuffer);
+		double time = (RTGetSeconds() - start) / frames;
+
+		if (threads == 1)
+			oneThreadTime = time;
+
+		double speedup = oneThreadTime / time;
+		printf("%7d %10.2f %9.2f %11.0f%% %7.1f %8.1f %8.1f\n", curveScheduler.GetNumThreads(), time * 1000,
+			speedup, speedup / threads * 100, (double)curveScheduler.GetNumTiles() / frames,
+			(double)curveScheduler.GetNumSteals() / frames, (double)curveScheduler.GetNumSplits() / frames);
+
+		if (threads == maxThreads)
+			break;
+	}
+}
+
+// Times intersection alone, for a ray at a time and for packets: the
+// primary rays of every pixel, then a shadow ray from each point they hit
+// to the light
+void PrintPacketThroughput(int frames) {
+	BuildScene();
+	SetTracerCamera();
+
+	std::vector<RTRay> primaryRays;
+	std::vector<RTRay> shadowRays;
+	std::vector<float> zeros;
+	std::vector<float> farDistances;
+	std::vector<float> lightDistances;
+	const RTLight& light = scene.GetLight(0);
+
+	for (int y = 0; y < tracer.GetHeight(); ++y) {
+		for (int x = 0; x < tracer.GetWidth(); ++x) {
+			RTRay ray = tracer.GetPrimaryRay(x, y);
+			primaryRays.push_back(ray);
+			zeros.push_back(0);
+			farDistances.push_back((float)RT_DEMO_FAR_PLANE);
+
+			RTHit hit;
+			if (scene.Intersect(ray, 0, (float)RT_DEMO_FAR_PLANE, &hit)) {
+				RTVector3 point = ray.GetPoint(hit.distance);
+				RTVector3 normal = scene.GetNormal(hit, point);
+				if (RTDot(normal, ray.direction) > 0)
+					normal = -normal;
+
+				RTVector3 toLight = light.position - point;
+				shadowRays.push_back(RTRay(point + normal * 1e-4f, RTNormalize(toLight)));
+				lightDistances.push_back(RTLength(toLight));
+			}
+		}
+	}
+
+	const char* names[] = { "primary", "shadow" };
+	std::vector<RTRay>* rays[] = { &primaryRays, &shadowRays };
+	std::vector<float>* maxDistances[] = { &farDistances, &lightDistances };
+
+	printf("rays      single (Mrays/s)   packets of %d (Mrays/s)   gain\n", RT_SIMD_WIDTH);
+
+	for (int r = 0; r < 2; ++r) {
+		// a camera that sees nothing casts no shadow rays
+		int count = (int)rays[r]->size();
+		if (count == 0) {
+			printf("%-9s %16s %25s\n", names[r], "no rays", "no rays");
+			continue;
+		}
+
+		const RTRay* first = &(*rays[r])[0];
+		const float* maxDistance = &(*maxDistances[r])[0];
+		int found = 0;
+
+		double start = RTGetSeconds();
+		for (int f = 0; f < frames; ++f) {
+			for (int i = 0; i < count; ++i) {
+				RTHit hit;
+				if (r == 0 ? scene.Intersect(first[i], 0, maxDistance[i], &hit) : scene.IsOccluded(first[i], 0, maxDistance[i]))
+					++found;
+			}
+		}
+		double singleTime = RTGetSeconds() - start;
+
+		int packetFound = 0;
+		start = RTGetSeconds();
+		for (int f = 0; f < frames; ++f) {
+			for (int i = 0; i < count; i += RT_SIMD_WIDTH) {
+				int lanes = count - i < RT_SIMD_WIDTH ? (1 << (count - i)) - 1 : RT_SIMD_ALL_LANES;
+				RTRayPacket packet;
+				RTSimdLoadRays(&packet, first + i, &zeros[i], maxDistance + i, lanes);
+
+				RTPacketHit hit;
+				int hits = r == 0 ? scene.IntersectPacket(packet, &hit) : scene.IsOccludedPacket(packet);
+				for (; hits != 0; hits &= hits - 1)
+					++packetFound;
+			}
+		}
+		double packetTime = RTGetSeconds() - start;
+
+		if (packetFound != found)
+			printf("%s rays: packets found %d hits, single rays %d\n", names[r], packetFound, found);
+
+		double numRays = (double)count * frames;
+		printf("%-9s %16.2f %25.2f %6.2fx\n", names[r], numRays / singleTime / 1e6, numRays / packetTime / 1e6,
+			singleTime / packetTime);
+	}
+}
+
+// Renders random scenes of 1000, 10000... spheres up to maxSpheres, and
+// prints the time to build each one's hierarchy and the rays traced per
+// second through it, and for the smaller scenes without it
+void PrintHierarchyScaling(int frames, int maxSpheres) {
+	SetTracerCamera();
+
+	printf("spheres   build ms     nodes   depth     MB   Mrays/s   linear Mrays/s   speedup\n");
+
+	for (int numSpheres = 1000; numSpheres <= maxSpheres; numSpheres *= 10) {
+		RTBuildRandomScene(&scene, numSpheres, reflectivity);
+		tracer.SetScene(&scene);
+
+		double start = RTGetSeconds();
+		scene.BuildHierarchy();
+		double buildTime = RTGetSeconds() - start;
+
+		scheduler->ResetStatistics();
+		start = RTGetSeconds();
+		for (int i = 0; i < frames; ++i)
+			scheduler->Render(&tracer, &framebuffer);
+		double rate = scheduler->GetNumRays() / (RTGetSeconds() - start) / 1e6;
+
+		const RTBVH& hierarchy = scene.GetHierarchy();
+		printf("%7d %10.2f %9d %7d %6.1f %9.2f", numSpheres, buildTime * 1000, hierarchy.GetNumNodes(),
+			hierarchy.GetDepth(), hierarchy.GetMemorySize() / 1048576.0, rate);
+
+		// every ray against every sphere takes too long beyond a few
+		// thousand, and says nothing new
+		if (numSpheres <= 1000) {
+			scene.ClearHierarchy();
+			scheduler->ResetStatistics();
+			start = RTGetSeconds();
+			for (int i = 0; i < frames; ++i)
+				scheduler->Render(&tracer, &framebuffer);
+			double linearRate = scheduler->GetNumRays() / (RTGetSeconds() - start) / 1e6;
+			printf(" %16.2f %8.1fx", linearRate, rate / linearRate);
+		}
+
+		printf("\n");
+	}
+}
+
+int main(int argc, char** argv)
+{
+	// -render [file] writes the image, -frames n times n renders, and
+	// -speedup prints how the render time scales with the number of
+	// threads. -scalar traces a ray at a time instead of in packets, and
+	// -packets compares the two. -bvh [spheres] prints how the hierarchy
+	// scales with random scenes of up to a million spheres.
+	bool speedup = false;
+	bool packets = false;
+	int maxSpheres = 0;
+	const char* fileName = NULL;
+	int frames = 1;
+	int threads = 0;
+
+	for (int i = 1; i < argc; ++i) {
+		if (strcmp(argv[i], "-render") == 0) {
+			if (i + 1 < argc && argv[i + 1][0] != '-')
+				fileName = argv[++i];
+		}
+		else if (strcmp(argv[i], "-frames") == 0 && i + 1 < argc) {
+			frames = atoi(argv[++i]);
+			if (frames < 1)
+				frames = 1;
+		}
+		else if (strcmp(argv[i], "-threads") == 0 && i + 1 < argc)
+			threads = atoi(argv[++i]);
+		else if (strcmp(argv[i], "-reflect") == 0)
+			reflectivity = 0.5f;
+		else if (strcmp(argv[i], "-speedup") == 0)
+			speedup = true;
+		else if (strcmp(argv[i], "-scalar") == 0)
+			tracer.SetPacketTracing(false);
+		else if (strcmp(argv[i], "-packets") == 0)
+			packets = true;
+		else if (strcmp(argv[i], "-bvh") == 0) {
+			maxSpheres = 1000000;
+			if (i + 1 < argc && argv[i + 1][0] != '-')
+				maxSpheres = atoi(argv[++i]);
+		}
+	}
+
+	if (packets) {
+		PrintPacketThroughput(frames);
+		return 0;
+	}
+
+	if (speedup) {
+		PrintSpeedup(frames, threads > 0 ? threads : RTGetNumProcessors());
+		return 0;
+	}
+
+	// 0 threads renders on every processor
+	scheduler = new RTTileScheduler(threads);
+
+	int result = 0;
+	if (maxSpheres > 0)
+		PrintHierarchyScaling(frames, maxSpheres);
+	else
+		result = RenderOffline(fileName, frames);
+
+	delete scheduler;
+	return result;
+}
@@ -0,0 +1,132 @@
+// RTPlatform.cpp
+//
+// Summary:
+//	Win32 and POSIX versions of the threading, atomic and timer functions
+//	declared in RTPlatform.h.
+
+#include "RTPlatform.h"
+
+#ifdef _WIN32
+
+void RTMutexInit( RTMutex * mutex ) { InitializeCriticalSection( mutex ); }
+void RTMutexDestroy( RTMutex * mutex ) { DeleteCriticalSection( mutex ); }
+void RTMutexLock( RTMutex * mutex ) { EnterCriticalSection( mutex ); }
+void RTMutexUnlock( RTMutex * mutex ) { LeaveCriticalSection( mutex ); }
+
+void RTConditionInit( RTCondition * condition ) { InitializeConditionVariable( condition ); }
+void RTConditionDestroy( RTCondition * condition ) {}
+void RTConditionWait( RTCondition * condition, RTMutex * mutex ) { SleepConditionVariableCS( condition, mutex, INFINITE ); }
+void RTConditionWakeAll( RTCondition * condition ) { WakeAllConditionVariable( condition ); }
+
+bool RTThreadCreate( RTThread * thread, RTThreadFunction function, void * argument )
+{
+	*thread = CreateThread( NULL, 0, function, argument, 0, NULL );
+	return *thread != NULL;
+}
+
+void RTThreadJoin( RTThread thread )
+{
+	WaitForSingleObject( thread, INFINITE );
+	CloseHandle( thread );
+}
+
+void RTThreadYield()
+{
+	SwitchToThread();
+}
+
+LONG RTAtomicAdd( volatile LONG * value, LONG amount )
+{
+	return InterlockedExchangeAdd( value, amount );
+}
+
+LONG RTAtomicLoad( volatile LONG * value )
+{
+	return InterlockedCompareExchange( value, 0, 0 );
+}
+
+/// <summary>
+/// Returns the number of logical processors.
+/// </summary>
+int RTGetNumProcessors()
+{
+	SYSTEM_INFO info;
+	GetSystemInfo( &info );
+	return info.dwNumberOfProcessors > 0 ? ( int )info.dwNumberOfProcessors : 1;
+}
+
+/// <summary>
+/// Returns a high resolution timestamp in seconds.
+/// </summary>
+double RTGetSeconds()
+{
+	static LARGE_INTEGER frequency = { 0 };
+	if( frequency.QuadPart == 0 )
+		QueryPerformanceFrequency( &frequency );
+
+	LARGE_INTEGER counter;
+	QueryPerformanceCounter( &counter );
+	return ( double )counter.QuadPart / ( double )frequency.QuadPart;
+}
+
+#else
+
+#include <sched.h>
+#include <time.h>
+#include <unistd.h>
+
+void RTMutexInit( RTMutex * mutex ) { pthread_mutex_init( mutex, NULL ); }
+void RTMutexDestroy( RTMutex * mutex ) { pthread_mutex_destroy( mutex ); }
+void RTMutexLock( RTMutex * mutex ) { pthread_mutex_lock( mutex ); }
+void RTMutexUnlock( RTMutex * mutex ) { pthread_mutex_unlock( mutex ); }
+
+void RTConditionInit( RTCondition * condition ) { pthread_cond_init( condition, NULL ); }
+void RTConditionDestroy( RTCondition * condition ) { pthread_cond_destroy( condition ); }
+void RTConditionWait( RTCondition * condition, RTMutex * mutex ) { pthread_cond_wait( condition, mutex ); }
+void RTConditionWakeAll( RTCondition * condition ) { pthread_cond_broadcast( condition ); }
+
+bool RTThreadCreate( RTThread * thread, RTThreadFunction function, void * argument )
+{
+	return pthread_create( thread, NULL, function, argument ) == 0;
+}
+
+void RTThreadJoin( RTThread thread )
+{
+	pthread_join( thread, NULL );
+}
+
+void RTThreadYield()
+{
+	sched_yield();
+}
+
+LONG RTAtomicAdd( volatile LONG * value, LONG amount )
+{
+	return __sync_fetch_and_add( value, amount );
+}
+
+LONG RTAtomicLoad( volatile LONG * value )
+{
+	return __sync_fetch_and_add( value, 0 );
+}
+
+/// <summary>
+/// Returns the number of logical processors.
+/// </summary>
+int RTGetNumProcessors()
+{
+	long count = sysconf( _SC_NPROCESSORS_ONLN );
+	return count > 0 ? ( int )count : 1;
+}
+
+/// <summary>
+/// Returns a high resolution timestamp in seconds.
+/// </summary>
+double RTGetSeconds()
+{
+	timespec now;
+	clock_gettime( CLOCK_MONOTONIC, &now );
+	return ( double )now.tv_sec + ( double )now.tv_nsec * 1e-9;
+}
+
+#endif
@@ -0,0 +1,60 @@
+#pragma once
+
+// The few operating system services the tracer needs, so that RTOffline
+// builds on Windows and on POSIX render boxes alike. Only the interactive
+// view in Checkpoint1.cpp depends on GLUT and the precompiled header.
+
+#ifdef _WIN32
+
+#include <windows.h>
+
+typedef CRITICAL_SECTION			RTMutex;
+typedef CONDITION_VARIABLE			RTCondition;
+typedef HANDLE						RTThread;
+typedef DWORD						RTThreadResult;
+#define RT_THREAD_CALL				WINAPI
+
+#else
+
+#include <pthread.h>
+#include <stdint.h>
+
+typedef int32_t						HRESULT;
+typedef int32_t						LONG;
+
+#define S_OK						( ( HRESULT )0 )
+#define E_FAIL						( ( HRESULT )0x80004005 )
+#define E_OUTOFMEMORY				( ( HRESULT )0x8007000E )
+#define E_INVALIDARG				( ( HRESULT )0x80070057 )
+#define SUCCEEDED( hr )				( ( ( HRESULT )( hr ) ) >= 0 )
+#define FAILED( hr )				( ( ( HRESULT )( hr ) ) < 0 )
+
+typedef pthread_mutex_t				RTMutex;
+typedef pthread_cond_t				RTCondition;
+typedef pthread_t					RTThread;
+typedef void *						RTThreadResult;
+#define RT_THREAD_CALL
+
+#endif
+
+typedef RTThreadResult ( RT_THREAD_CALL * RTThreadFunction )( void * argument );
+
+void RTMutexInit( RTMutex * mutex );
+void RTMutexDestroy( RTMutex * mutex );
+void RTMutexLock( RTMutex * mutex );
+void RTMutexUnlock( RTMutex * mutex );
+
+void RTConditionInit( RTCondition * condition );
+void RTConditionDestroy( RTCondition * condition );
+void RTConditionWait( RTCondition * condition, RTMutex * mutex );
+void RTConditionWakeAll( RTCondition * condition );
+
+bool RTThreadCreate( RTThread * thread, RTThreadFunction function, void * argument );
+void RTThreadJoin( RTThread thread );
+void RTThreadYield();
+
+LONG RTAtomicAdd( volatile LONG * value, LONG amount );
+LONG RTAtomicLoad( volatile LONG * value );
+
+int RTGetNumProcessors();
+double RTGetSeconds();
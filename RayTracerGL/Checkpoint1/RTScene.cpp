@@ -0,0 +1,714 @@
+// RTScene.cpp
+//
+// Summary:
+//	Ray intersection with the spheres and quads of a scene, tested one by
+//	one or found through a bounding volume hierarchy.
+
+#include "RTScene.h"
+
+/// <summary>
+/// Returns whether a ray passes through a node's bounds between minDistance
+/// and maxDistance.
+/// </summary>
+/// <param name='inverse'>1 over each component of the ray's direction.</param>
+static inline bool RTHitsBounds( const RTBVHNode & node, const RTRay & ray, const RTVector3 & inverse, float minDistance, float maxDistance )
+{
+	// Rays parallel to an axis divide by 0, and the infinite distances keep
+	// them inside or outside that slab of the bounds for good
+	for( int axis = 0; axis < 3; ++axis )
+	{
+		float low = ( node.min[axis] - ray.position[axis] ) * inverse[axis];
+		float high = ( node.max[axis] - ray.position[axis] ) * inverse[axis];
+		if( low > high )
+		{
+			float swapped = low;
+			low = high;
+			high = swapped;
+		}
+
+		if( low > minDistance )
+			minDistance = low;
+		if( high < maxDistance )
+			maxDistance = high;
+	}
+
+	return minDistance <= maxDistance;
+}
+
+/// <summary>
+/// Returns which active rays of a packet pass through a node's bounds,
+/// between their minimum distance and maxDistance.
+/// </summary>
+/// <param name='inverse'>1 over each component of the rays' directions.</param>
+static inline RTFloats RTHitsBoundsPacket( const RTBVHNode & node, const RTRayPacket & packet, const RTFloats * inverse, RTFloats maxDistance )
+{
+	const RTFloats * positions = &packet.positionX;
+	RTFloats minDistance = packet.minDistance;
+
+	for( int axis = 0; axis < 3; ++axis )
+	{
+		RTFloats low = RTSimdMul( RTSimdSub( RTSimdSet( node.min[axis] ), positions[axis] ), inverse[axis] );
+		RTFloats high = RTSimdMul( RTSimdSub( RTSimdSet( node.max[axis] ), positions[axis] ), inverse[axis] );
+		minDistance = RTSimdMax( RTSimdMin( low, high ), minDistance );
+		maxDistance = RTSimdMin( RTSimdMax( low, high ), maxDistance );
+	}
+
+	return RTSimdAnd( packet.active, RTSimdLessEqual( minDistance, maxDistance ) );
+}
+
+RTMaterial::RTMaterial( const RTVector3 & color, float specular, float exponent, float reflectivity )
+{
+	this->color = color;
+	this->specular = specular;
+	this->exponent = exponent;
+	this->reflectivity = reflectivity;
+}
+
+/// <summary>
+/// Returns the distance along the ray to the first point where it enters
+/// the sphere, or leaves it if the ray starts inside, or -1 if neither lies
+/// between minDistance and maxDistance.
+/// </summary>
+float RTSphere::Intersects( const RTRay & ray, float minDistance, float maxDistance ) const
+{
+	// The direction is a unit vector, so the quadratic's first coefficient is 1
+	RTVector3 diff = ray.position - center;
+	float b = RTDot( ray.direction, diff );
+	float c = RTDot( diff, diff ) - radius * radius;
+	float square = b * b - c;
+
+	// no real root, no intersection
+	if( square < 0 )
+		return -1;
+
+	float root = sqrtf( square );
+	float distance = -b - root;
+	if( distance <= minDistance )
+		distance = -b + root;
+
+	return distance > minDistance && distance < maxDistance ? distance : -1;
+}
+
+/// <summary>
+/// Returns the distance along the ray to the quad, or -1 if the ray misses
+/// it or hits it outside minDistance to maxDistance.
+/// </summary>
+float RTQuad::Intersects( const RTRay & ray, float minDistance, float maxDistance ) const
+{
+	float dot = RTDot( normal, ray.direction );
+	if( dot == 0 )
+		return -1;
+
+	float distance = ( offset - RTDot( normal, ray.position ) ) / dot;
+	if( !( distance > minDistance && distance < maxDistance ) )
+		return -1;
+
+	RTVector3 point = ray.GetPoint( distance );
+	for( int i = 0; i < 4; ++i )
+	{
+		if( RTDot( edgeNormals[i], point ) < edgeOffsets[i] )
+			return -1;
+	}
+
+	return distance;
+}
+
+/// <summary>
+/// Intersects RT_SIMD_WIDTH rays with the sphere at once, as Intersects
+/// does one.
+/// </summary>
+/// <param name='maxDistance'>Distance of each lane's closest hit so far.</param>
+/// <param name='distance'>Set to the distance of each lane that hits.</param>
+/// <returns>The mask of active lanes that hit the sphere closer than maxDistance.</returns>
+RTFloats RTSphere::IntersectsPacket( const RTRayPacket & packet, RTFloats maxDistance, RTFloats * distance ) const
+{
+	RTFloats diffX = RTSimdSub( packet.positionX, RTSimdSet( center.x ) );
+	RTFloats diffY = RTSimdSub( packet.positionY, RTSimdSet( center.y ) );
+	RTFloats diffZ = RTSimdSub( packet.positionZ, RTSimdSet( center.z ) );
+
+	RTFloats b = RTSimdAdd( RTSimdAdd( RTSimdMul( packet.directionX, diffX ), RTSimdMul( packet.directionY, diffY ) ), RTSimdMul( packet.directionZ, diffZ ) );
+	RTFloats c = RTSimdAdd( RTSimdAdd( RTSimdMul( diffX, diffX ), RTSimdMul( diffY, diffY ) ), RTSimdMul( diffZ, diffZ ) );
+	c = RTSimdSub( c, RTSimdSet( radius * radius ) );
+	RTFloats square = RTSimdSub( RTSimdMul( b, b ), c );
+
+	RTFloats hit = RTSimdAnd( packet.active, RTSimdLessEqual( RTSimdSet( 0 ), square ) );
+	if( RTSimdMask( hit ) == 0 )
+		return hit;
+
+	// Lanes with no real root take the square root of a negative number,
+	// but are masked off already
+	RTFloats root = RTSimdSqrt( square );
+	RTFloats minusB = RTSimdSub( RTSimdSet( 0 ), b );
+	RTFloats nearDistance = RTSimdSub( minusB, root );
+	RTFloats farDistance = RTSimdAdd( minusB, root );
+	*distance = RTSimdSelect( RTSimdLessEqual( nearDistance, packet.minDistance ), farDistance, nearDistance );
+
+	hit = RTSimdAnd( hit, RTSimdLess( packet.minDistance, *distance ) );
+	return RTSimdAnd( hit, RTSimdLess( *distance, maxDistance ) );
+}
+
+/// <summary>
+/// Intersects RT_SIMD_WIDTH rays with the quad at once, as Intersects does
+/// one.
+/// </summary>
+/// <param name='maxDistance'>Distance of each lane's closest hit so far.</param>
+/// <param name='distance'>Set to the distance of each lane that hits.</param>
+/// <returns>The mask of active lanes that hit the quad closer than maxDistance.</returns>
+RTFloats RTQuad::IntersectsPacket( const RTRayPacket & packet, RTFloats maxDistance, RTFloats * distance ) const
+{
+	RTFloats normalX = RTSimdSet( normal.x );
+	RTFloats normalY = RTSimdSet( normal.y );
+	RTFloats normalZ = RTSimdSet( normal.z );
+
+	// Rays parallel to the plane divide by 0, and the infinite or NaN
+	// distance fails the range test
+	RTFloats dot = RTSimdAdd( RTSimdAdd( RTSimdMul( normalX, packet.directionX ), RTSimdMul( normalY, packet.directionY ) ), RTSimdMul( normalZ, packet.directionZ ) );
+	RTFloats height = RTSimdAdd( RTSimdAdd( RTSimdMul( normalX, packet.positionX ), RTSimdMul( normalY, packet.positionY ) ), RTSimdMul( normalZ, packet.positionZ ) );
+	*distance = RTSimdDiv( RTSimdSub( RTSimdSet( offset ), height ), dot );
+
+	RTFloats hit = RTSimdAnd( packet.active, RTSimdLess( packet.minDistance, *distance ) );
+	hit = RTSimdAnd( hit, RTSimdLess( *distance, maxDistance ) );
+	if( RTSimdMask( hit ) == 0 )
+		return hit;
+
+	RTFloats pointX = RTSimdAdd( packet.positionX, RTSimdMul( packet.directionX, *distance ) );
+	RTFloats pointY = RTSimdAdd( packet.positionY, RTSimdMul( packet.directionY, *distance ) );
+	RTFloats pointZ = RTSimdAdd( packet.positionZ, RTSimdMul( packet.directionZ, *distance ) );
+
+	for( int i = 0; i < 4; ++i )
+	{
+		const RTVector3 & edgeNormal = edgeNormals[i];
+		RTFloats side = RTSimdAdd( RTSimdAdd( RTSimdMul( RTSimdSet( edgeNormal.x ), pointX ), RTSimdMul( RTSimdSet( edgeNormal.y ), pointY ) ), RTSimdMul( RTSimdSet( edgeNormal.z ), pointZ ) );
+		hit = RTSimdAnd( hit, RTSimdLessEqual( RTSimdSet( edgeOffsets[i] ), side ) );
+	}
+
+	return hit;
+}
+
+RTScene::RTScene( void )
+{
+	ambient = RTVector3( 0.2f, 0.2f, 0.2f );
+	background = RTVector3( 0, 0, 0 );
+}
+
+RTScene::~RTScene( void )
+{
+}
+
+/// <summary>
+/// Removes every object and light.
+/// </summary>
+void RTScene::Clear()
+{
+	spheres.clear();
+	quads.clear();
+	lights.clear();
+	hierarchy.Clear();
+}
+
+/// <returns>The index of the sphere.</returns>
+int RTScene::AddSphere( const RTVector3 & center, float radius, const RTMaterial & material )
+{
+	RTSphere sphere;
+	sphere.center = center;
+	sphere.radius = radius;
+	sphere.material = material;
+	spheres.push_back( sphere );
+	hierarchy.Clear();
+	return ( int )spheres.size() - 1;
+}
+
+/// <summary>
+/// Adds a flat convex quad, given its corners in order around it.
+/// </summary>
+/// <returns>The index of the quad.</returns>
+int RTScene::AddQuad( const RTVector3 & a, const RTVector3 & b, const RTVector3 & c, const RTVector3 & d, const RTMaterial & material )
+{
+	RTQuad quad;
+	quad.corners[0] = a;
+	quad.corners[1] = b;
+	quad.corners[2] = c;
+	quad.corners[3] = d;
+	quad.normal = RTNormalize( RTCross( b - a, c - a ) );
+	quad.offset = RTDot( quad.normal, a );
+
+	// Edge normals point into the quad whichever way its corners wind,
+	// since the face normal follows the winding
+	for( int i = 0; i < 4; ++i )
+	{
+		const RTVector3 & from = quad.corners[i];
+		const RTVector3 & to = quad.corners[( i + 1 ) % 4];
+		quad.edgeNormals[i] = RTCross( quad.normal, to - from );
+		quad.edgeOffsets[i] = RTDot( quad.edgeNormals[i], from );
+	}
+
+	quad.material = material;
+	quads.push_back( quad );
+	hierarchy.Clear();
+	return ( int )quads.size() - 1;
+}
+
+/// <returns>The index of the light.</returns>
+int RTScene::AddLight( const RTVector3 & position, const RTVector3 & color )
+{
+	RTLight light;
+	light.position = position;
+	light.color = color;
+	lights.push_back( light );
+	return ( int )lights.size() - 1;
+}
+
+/// <summary>
+/// Builds the bounding volume hierarchy over the objects as they are now,
+/// which queries use until objects are added or removed. Scenes too small
+/// to split are left without one.
+/// </summary>
+void RTScene::BuildHierarchy()
+{
+	vector<RTBounds> bounds( spheres.size() + quads.size() );
+
+	for( int i = 0; i < ( int )spheres.size(); ++i )
+	{
+		const RTSphere & sphere = spheres[i];
+		RTVector3 radius( sphere.radius, sphere.radius, sphere.radius );
+		bounds[i].min = sphere.center - radius;
+		bounds[i].max = sphere.center + radius;
+	}
+
+	int numSpheres = ( int )spheres.size();
+	for( int i = 0; i < ( int )quads.size(); ++i )
+	{
+		RTBounds & quadBounds = bounds[numSpheres + i];
+		quadBounds.Reset();
+		for( int corner = 0; corner < 4; ++corner )
+			quadBounds.Grow( quads[i].corners[corner] );
+	}
+
+	hierarchy.Build( bounds );
+
+	// A single leaf would only add a test of the scene's bounds to each
+	// query, so small scenes keep testing every object
+	if( hierarchy.GetNumNodes() == 1 )
+		hierarchy.Clear();
+}
+
+/// <summary>
+/// Intersects the ray with an object, numbered spheres first, as
+/// RTSphere::Intersects and RTQuad::Intersects do.
+/// </summary>
+inline float RTScene::IntersectObject( int object, const RTRay & ray, float minDistance, float maxDistance ) const
+{
+	int numSpheres = ( int )spheres.size();
+	if( object < numSpheres )
+		return spheres[object].Intersects( ray, minDistance, maxDistance );
+
+	return quads[object - numSpheres].Intersects( ray, minDistance, maxDistance );
+}
+
+/// <summary>
+/// Intersects a packet with an object, numbered spheres first, as
+/// RTSphere::IntersectsPacket and RTQuad::IntersectsPacket do.
+/// </summary>
+inline RTFloats RTScene::IntersectObjectPacket( int object, const RTRayPacket & packet, RTFloats maxDistance, RTFloats * distance ) const
+{
+	int numSpheres = ( int )spheres.size();
+	if( object < numSpheres )
+		return spheres[object].IntersectsPacket( packet, maxDistance, distance );
+
+	return quads[object - numSpheres].IntersectsPacket( packet, maxDistance, distance );
+}
+
+/// <summary>
+/// Fills in the hit of an object, numbered spheres first.
+/// </summary>
+void RTScene::SetHit( int object, float distance, RTHit * hit ) const
+{
+	int numSpheres = ( int )spheres.size();
+	hit->distance = distance;
+	hit->type = object < numSpheres ? RTObjectSphere : RTObjectQuad;
+	hit->index = object < numSpheres ? object : object - numSpheres;
+}
+
+/// <summary>
+/// Finds the closest object the ray hits between minDistance and
+/// maxDistance.
+/// </summary>
+/// <returns>Whether the ray hits anything.</returns>
+bool RTScene::Intersect( const RTRay & ray, float minDistance, float maxDistance, RTHit * hit ) const
+{
+	if( !hierarchy.IsEmpty() )
+	{
+		int object = IntersectHierarchy( ray, minDistance, &maxDistance );
+		if( object < 0 )
+			return false;
+
+		SetHit( object, maxDistance, hit );
+		return true;
+	}
+
+	bool found = false;
+
+	for( int i = 0; i < ( int )spheres.size(); ++i )
+	{
+		float distance = spheres[i].Intersects( ray, minDistance, maxDistance );
+		if( distance >= 0 )
+		{
+			maxDistance = distance;
+			hit->distance = distance;
+			hit->type = RTObjectSphere;
+			hit->index = i;
+			found = true;
+		}
+	}
+
+	for( int i = 0; i < ( int )quads.size(); ++i )
+	{
+		float distance = quads[i].Intersects( ray, minDistance, maxDistance );
+		if( distance >= 0 )
+		{
+			maxDistance = distance;
+			hit->distance = distance;
+			hit->type = RTObjectQuad;
+			hit->index = i;
+			found = true;
+		}
+	}
+
+	return found;
+}
+
+/// <summary>
+/// Returns whether the ray hits anything between minDistance and
+/// maxDistance. Shadow rays need no closest hit, so the first one found
+/// ends the search.
+/// </summary>
+bool RTScene::IsOccluded( const RTRay & ray, float minDistance, float maxDistance ) const
+{
+	if( !hierarchy.IsEmpty() )
+		return IsOccludedHierarchy( ray, minDistance, maxDistance );
+
+	for( int i = 0; i < ( int )spheres.size(); ++i )
+	{
+		if( spheres[i].Intersects( ray, minDistance, maxDistance ) >= 0 )
+			return true;
+	}
+
+	for( int i = 0; i < ( int )quads.size(); ++i )
+	{
+		if( quads[i].Intersects( ray, minDistance, maxDistance ) >= 0 )
+			return true;
+	}
+
+	return false;
+}
+
+/// <summary>
+/// Finds the closest object each active ray of a packet hits, as Intersect
+/// does for one ray.
+/// </summary>
+/// <returns>The mask of lanes, as RTSimdMask returns it, whose rays hit anything.</returns>
+int RTScene::IntersectPacket( const RTRayPacket & packet, RTPacketHit * hit ) const
+{
+	RTFloats closest = packet.maxDistance;
+	RTFloats object = RTSimdSet( -1 );
+
+	if( !hierarchy.IsEmpty() )
+		IntersectHierarchyPacket( packet, &closest, &object );
+	else
+	{
+		RTFloats distance = closest;
+
+		for( int i = 0; i < ( int )spheres.size(); ++i )
+		{
+			RTFloats found = spheres[i].IntersectsPacket( packet, closest, &distance );
+			if( RTSimdMask( found ) != 0 )
+			{
+				closest = RTSimdSelect( found, distance, closest );
+				object = RTSimdSelect( found, RTSimdSet( ( float )i ), object );
+			}
+		}
+
+		int numSpheres = ( int )spheres.size();
+		for( int i = 0; i < ( int )quads.size(); ++i )
+		{
+			RTFloats found = quads[i].IntersectsPacket( packet, closest, &distance );
+			if( RTSimdMask( found ) != 0 )
+			{
+				closest = RTSimdSelect( found, distance, closest );
+				object = RTSimdSelect( found, RTSimdSet( ( float )( numSpheres + i ) ), object );
+			}
+		}
+	}
+
+	// Object numbers are small enough to be exact as floats
+	float objects[RT_SIMD_WIDTH];
+	RTSimdStore( hit->distance, closest );
+	RTSimdStore( objects, object );
+
+	int lanes = 0;
+	for( int lane = 0; lane < RT_SIMD_WIDTH; ++lane )
+	{
+		hit->object[lane] = ( int )objects[lane];
+		if( hit->object[lane] >= 0 )
+			lanes |= 1 << lane;
+	}
+
+	return lanes;
+}
+
+/// <summary>
+/// Returns which active rays of a packet hit anything between their
+/// distances, as IsOccluded does for one ray. The search ends once every
+/// active ray has hit something.
+/// </summary>
+/// <returns>The mask of lanes, as RTSimdMask returns it, whose rays are occluded.</returns>
+int RTScene::IsOccludedPacket( const RTRayPacket & packet ) const
+{
+	if( !hierarchy.IsEmpty() )
+		return IsOccludedHierarchyPacket( packet );
+
+	int active = RTSimdMask( packet.active );
+	int occluded = 0;
+	RTFloats distance;
+
+	for( int i = 0; i < ( int )spheres.size(); ++i )
+	{
+		occluded |= RTSimdMask( spheres[i].IntersectsPacket( packet, packet.maxDistance, &distance ) );
+		if( occluded == active )
+			return occluded;
+	}
+
+	for( int i = 0; i < ( int )quads.size(); ++i )
+	{
+		occluded |= RTSimdMask( quads[i].IntersectsPacket( packet, packet.maxDistance, &distance ) );
+		if( occluded == active )
+			return occluded;
+	}
+
+	return occluded;
+}
+
+/// <summary>
+/// Finds the closest object the ray hits through the hierarchy.
+/// </summary>
+/// <param name='maxDistance'>Distance the hit must be closer than, set to that of the hit.</param>
+/// <returns>The object hit, numbered spheres first, or -1 for none.</returns>
+int RTScene::IntersectHierarchy( const RTRay & ray, float minDistance, float * maxDistance ) const
+{
+	RTVector3 inverse( 1.0f / ray.direction.x, 1.0f / ray.direction.y, 1.0f / ray.direction.z );
+	int stack[RT_BVH_STACK_SIZE];
+	int numStacked = 0;
+	int node = 0;
+	int object = -1;
+
+	for( ;; )
+	{
+		const RTBVHNode & bounds = hierarchy.GetNode( node );
+		if( RTHitsBounds( bounds, ray, inverse, minDistance, *maxDistance ) )
+		{
+			if( bounds.count == 0 )
+			{
+				// The child on the side the ray comes from first, so that hits
+				// in it cull the other
+				bool backwards = ray.direction[bounds.axis] < 0;
+				stack[numStacked++] = backwards ? node + 1 : bounds.first;
+				node = backwards ? bounds.first : node + 1;
+				continue;
+			}
+
+			for( int i = bounds.first; i < bounds.first + bounds.count; ++i )
+			{
+				float distance = IntersectObject( hierarchy.GetObject( i ), ray, minDistance, *maxDistance );
+				if( distance >= 0 )
+				{
+					*maxDistance = distance;
+					object = hierarchy.GetObject( i );
+				}
+			}
+		}
+
+		if( numStacked == 0 )
+			return object;
+
+		node = stack[--numStacked];
+	}
+}
+
+/// <summary>
+/// Returns whether the ray hits anything through the hierarchy, stopping at
+/// the first hit found.
+/// </summary>
+bool RTScene::IsOccludedHierarchy( const RTRay & ray, float minDistance, float maxDistance ) const
+{
+	RTVector3 inverse( 1.0f / ray.direction.x, 1.0f / ray.direction.y, 1.0f / ray.direction.z );
+	int stack[RT_BVH_STACK_SIZE];
+	int numStacked = 0;
+	int node = 0;
+
+	for( ;; )
+	{
+		const RTBVHNode & bounds = hierarchy.GetNode( node );
+		if( RTHitsBounds( bounds, ray, inverse, minDistance, maxDistance ) )
+		{
+			if( bounds.count == 0 )
+			{
+				stack[numStacked++] = bounds.first;
+				node = node + 1;
+				continue;
+			}
+
+			for( int i = bounds.first; i < bounds.first + bounds.count; ++i )
+			{
+				if( IntersectObject( hierarchy.GetObject( i ), ray, minDistance, maxDistance ) >= 0 )
+					return true;
+			}
+		}
+
+		if( numStacked == 0 )
+			return false;
+
+		node = stack[--numStacked];
+	}
+}
+
+/// <summary>
+/// Finds the closest object each active ray of a packet hits through the
+/// hierarchy. Children are visited in the order the first active ray
+/// reaches them.
+/// </summary>
+/// <param name='closest'>Distance each lane's hit must be closer than, set to that of its hit.</param>
+/// <param name='object'>Set to the object each lane hits, numbered spheres first, where it hits one.</param>
+void RTScene::IntersectHierarchyPacket( const RTRayPacket & packet, RTFloats * closest, RTFloats * object ) const
+{
+	RTFloats one = RTSimdSet( 1 );
+	RTFloats inverse[3] = { RTSimdDiv( one, packet.directionX ), RTSimdDiv( one, packet.directionY ), RTSimdDiv( one, packet.directionZ ) };
+
+	int lane = 0;
+	int active = RTSimdMask( packet.active );
+	while( lane < RT_SIMD_WIDTH - 1 && ( active & ( 1 << lane ) ) == 0 )
+		++lane;
+
+	RTFloats zero = RTSimdSet( 0 );
+	int backwards[3];
+	backwards[0] = RTSimdMask( RTSimdLess( packet.directionX, zero ) ) >> lane & 1;
+	backwards[1] = RTSimdMask( RTSimdLess( packet.directionY, zero ) ) >> lane & 1;
+	backwards[2] = RTSimdMask( RTSimdLess( packet.directionZ, zero ) ) >> lane & 1;
+
+	int stack[RT_BVH_STACK_SIZE];
+	int numStacked = 0;
+	int node = 0;
+	RTFloats distance = *closest;
+
+	for( ;; )
+	{
+		const RTBVHNode & bounds = hierarchy.GetNode( node );
+		if( RTSimdMask( RTHitsBoundsPacket( bounds, packet, inverse, *closest ) ) != 0 )
+		{
+			if( bounds.count == 0 )
+			{
+				stack[numStacked++] = backwards[bounds.axis] ? node + 1 : bounds.first;
+				node = backwards[bounds.axis] ? bounds.first : node + 1;
+				continue;
+			}
+
+			for( int i = bounds.first; i < bounds.first + bounds.count; ++i )
+			{
+				RTFloats found = IntersectObjectPacket( hierarchy.GetObject( i ), packet, *closest, &distance );
+				if( RTSimdMask( found ) != 0 )
+				{
+					*closest = RTSimdSelect( found, distance, *closest );
+					*object = RTSimdSelect( found, RTSimdSet( ( float )hierarchy.GetObject( i ) ), *object );
+				}
+			}
+		}
+
+		if( numStacked == 0 )
+			return;
+
+		node = stack[--numStacked];
+	}
+}
+
+/// <summary>
+/// Returns which active rays of a packet hit anything through the
+/// hierarchy. Rays drop out of the packet as they hit something, and the
+/// search ends once none is left.
+/// </summary>
+/// <returns>The mask of lanes, as RTSimdMask returns it, whose rays are occluded.</returns>
+int RTScene::IsOccludedHierarchyPacket( const RTRayPacket & packet ) const
+{
+	RTFloats one = RTSimdSet( 1 );
+	RTFloats inverse[3] = { RTSimdDiv( one, packet.directionX ), RTSimdDiv( one, packet.directionY ), RTSimdDiv( one, packet.directionZ ) };
+
+	RTRayPacket unoccluded = packet;
+	RTFloats occluded = RTSimdSet( 0 );
+	RTFloats distance;
+	int stack[RT_BVH_STACK_SIZE];
+	int numStacked = 0;
+	int node = 0;
+
+	for( ;; )
+	{
+		const RTBVHNode & bounds = hierarchy.GetNode( node );
+		if( RTSimdMask( RTHitsBoundsPacket( bounds, unoccluded, inverse, packet.maxDistance ) ) != 0 )
+		{
+			if( bounds.count == 0 )
+			{
+				stack[numStacked++] = bounds.first;
+				node = node + 1;
+				continue;
+			}
+
+			for( int i = bounds.first; i < bounds.first + bounds.count; ++i )
+			{
+				RTFloats found = IntersectObjectPacket( hierarchy.GetObject( i ), unoccluded, packet.maxDistance, &distance );
+				if( RTSimdMask( found ) != 0 )
+				{
+					occluded = RTSimdOr( occluded, found );
+					unoccluded.active = RTSimdAndNot( packet.active, occluded );
+					if( RTSimdMask( unoccluded.active ) == 0 )
+						return RTSimdMask( occluded );
+				}
+			}
+		}
+
+		if( numStacked == 0 )
+			return RTSimdMask( occluded );
+
+		node = stack[--numStacked];
+	}
+}
+
+/// <summary>
+/// Gives the hit of one lane of a packet as Intersect would have.
+/// </summary>
+/// <returns>Whether the lane's ray hit anything.</returns>
+bool RTScene::GetHit( const RTPacketHit & packetHit, int lane, RTHit * hit ) const
+{
+	int object = packetHit.object[lane];
+	if( object < 0 )
+		return false;
+
+	SetHit( object, packetHit.distance[lane], hit );
+	return true;
+}
+
+/// <summary>
+/// Returns the unit normal of the object hit at a point on it, facing out
+/// of spheres and along the winding of quads.
+/// </summary>
+RTVector3 RTScene::GetNormal( const RTHit & hit, const RTVector3 & point ) const
+{
+	if( hit.type == RTObjectSphere )
+	{
+		const RTSphere & sphere = spheres[hit.index];
+		return ( point - sphere.center ) * ( 1.0f / sphere.radius );
+	}
+
+	return quads[hit.index].normal;
+}
+
+const RTMaterial & RTScene::GetMaterial( const RTHit & hit ) const
+{
+	return hit.type == RTObjectSphere ? spheres[hit.index].material : quads[hit.index].material;
+}
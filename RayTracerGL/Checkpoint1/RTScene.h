@@ -0,0 +1,148 @@
+#pragma once
+
+#include <vector>
+
+#include "RTBVH.h"
+#include "RTMath.h"
+#include "RTSimd.h"
+
+using namespace std;
+
+/// <summary>
+/// How a surface is shaded. The colour is used for both the ambient and the
+/// diffuse term, as glColor is under GL_COLOR_MATERIAL.
+/// </summary>
+struct RTMaterial
+{
+	RTVector3					color;
+	float						specular;		// Strength of the Blinn-Phong highlight, 0 for none
+	float						exponent;
+	float						reflectivity;	// Fraction of the reflected ray's light added, 0 for none
+
+	RTMaterial() {}
+	RTMaterial( const RTVector3 & color, float specular = 0, float exponent = 0, float reflectivity = 0 );
+};
+
+struct RTSphere
+{
+	RTVector3					center;
+	float						radius;
+	RTMaterial					material;
+
+	float Intersects( const RTRay & ray, float minDistance, float maxDistance ) const;
+	RTFloats IntersectsPacket( const RTRayPacket & packet, RTFloats maxDistance, RTFloats * distance ) const;
+};
+
+/// <summary>
+/// A flat convex quad. Each edge keeps the normal of its side within the
+/// plane, so a point on the plane is inside when it is inside every edge.
+/// </summary>
+struct RTQuad
+{
+	RTVector3					corners[4];
+	RTVector3					normal;
+	float						offset;			// Of the plane along the normal
+	RTVector3					edgeNormals[4];
+	float						edgeOffsets[4];
+	RTMaterial					material;
+
+	float Intersects( const RTRay & ray, float minDistance, float maxDistance ) const;
+	RTFloats IntersectsPacket( const RTRayPacket & packet, RTFloats maxDistance, RTFloats * distance ) const;
+};
+
+/// <summary>
+/// A point light, as GL_LIGHT0 with its default constant attenuation.
+/// </summary>
+struct RTLight
+{
+	RTVector3					position;
+	RTVector3					color;
+};
+
+enum RTObjectType
+{
+	RTObjectSphere,
+	RTObjectQuad
+};
+
+/// <summary>
+/// The closest object a ray hits.
+/// </summary>
+struct RTHit
+{
+	float						distance;
+	RTObjectType				type;
+	int							index;			// In the scene's spheres or quads
+};
+
+/// <summary>
+/// The closest object each ray of a packet hits.
+/// </summary>
+struct RTPacketHit
+{
+	float						distance[RT_SIMD_WIDTH];
+	int							object[RT_SIMD_WIDTH];	// Sphere index, or the number of spheres plus the quad index, -1 for none
+};
+
+/// <summary>
+/// The objects and lights a tracer renders. Objects are kept in one array
+/// per type rather than behind a common interface, so each type's test is
+/// a tight loop over its own array.
+/// </summary>
+/// <remarks>
+/// Each query has a packet version, which tests RT_SIMD_WIDTH rays against
+/// an object at once and finds the same hits as the single ray version.
+///
+/// Once BuildHierarchy is called, queries walk a bounding volume hierarchy
+/// over the objects, numbered spheres first, rather than testing each of
+/// them, until objects are added or removed. Closest hit queries visit the
+/// nearer child of each node first, so that farther ones are culled by the
+/// hits found, and shadow queries stop at the first hit. A packet visits
+/// every node the bounds of any of its rays pass through.
+/// </remarks>
+class RTScene
+{
+protected:
+	vector<RTSphere>			spheres;
+	vector<RTQuad>				quads;
+	vector<RTLight>				lights;
+	RTVector3					ambient;		// Lights every surface, as GL_LIGHT_MODEL_AMBIENT
+	RTVector3					background;		// Colour of rays that miss, as the clear colour
+	RTBVH						hierarchy;		// Empty until built, and once objects change
+
+	float IntersectObject( int object, const RTRay & ray, float minDistance, float maxDistance ) const;
+	RTFloats IntersectObjectPacket( int object, const RTRayPacket & packet, RTFloats maxDistance, RTFloats * distance ) const;
+	int IntersectHierarchy( const RTRay & ray, float minDistance, float * maxDistance ) const;
+	bool IsOccludedHierarchy( const RTRay & ray, float minDistance, float maxDistance ) const;
+	void IntersectHierarchyPacket( const RTRayPacket & packet, RTFloats * closest, RTFloats * object ) const;
+	int IsOccludedHierarchyPacket( const RTRayPacket & packet ) const;
+	void SetHit( int object, float distance, RTHit * hit ) const;
+public:
+	RTScene( void );
+	~RTScene( void );
+	void Clear();
+	int AddSphere( const RTVector3 & center, float radius, const RTMaterial & material );
+	int AddQuad( const RTVector3 & a, const RTVector3 & b, const RTVector3 & c, const RTVector3 & d, const RTMaterial & material );
+	int AddLight( const RTVector3 & position, const RTVector3 & color );
+	int GetNumSpheres() const { return ( int )spheres.size(); }
+	int GetNumQuads() const { return ( int )quads.size(); }
+	int GetNumLights() const { return ( int )lights.size(); }
+	const RTSphere & GetSphere( int sphere ) const { return spheres[sphere]; }
+	const RTQuad & GetQuad( int quad ) const { return quads[quad]; }
+	const RTLight & GetLight( int light ) const { return lights[light]; }
+	const RTVector3 & GetAmbient() const { return ambient; }
+	void SetAmbient( const RTVector3 & ambient ) { this->ambient = ambient; }
+	const RTVector3 & GetBackground() const { return background; }
+	void SetBackground( const RTVector3 & background ) { this->background = background; }
+	void BuildHierarchy();
+	void ClearHierarchy() { hierarchy.Clear(); }
+	bool HasHierarchy() const { return !hierarchy.IsEmpty(); }
+	const RTBVH & GetHierarchy() const { return hierarchy; }
+	bool Intersect( const RTRay & ray, float minDistance, float maxDistance, RTHit * hit ) const;
+	bool IsOccluded( const RTRay & ray, float minDistance, float maxDistance ) const;
+	int IntersectPacket( const RTRayPacket & packet, RTPacketHit * hit ) const;
+	int IsOccludedPacket( const RTRayPacket & packet ) const;
+	bool GetHit( const RTPacketHit & packetHit, int lane, RTHit * hit ) const;
+	RTVector3 GetNormal( const RTHit & hit, const RTVector3 & point ) const;
+	const RTMaterial & GetMaterial( const RTHit & hit ) const;
+};
@@ -0,0 +1,158 @@
+#pragma once
+
+// Vector float operations over whichever instruction set the compiler
+// targets, so rays can be traced in packets: 8 lanes of AVX, 4 lanes of
+// SSE2, or a single float. VS2008 builds get SSE2; AVX needs a compiler
+// that defines __AVX__. Define RT_NO_SIMD to force the single float version.
+// RTSimdMin and RTSimdMax return b in lanes where either is NaN, as the
+// instructions do.
+
+#include <cmath>
+#include <cstring>
+
+#include "RTMath.h"
+
+#if !defined( RT_NO_SIMD ) && defined( __AVX__ )
+
+#include <immintrin.h>
+
+#define RT_SIMD_WIDTH 8
+
+typedef __m256 RTFloats;
+
+inline RTFloats RTSimdSet( float value ) { return _mm256_set1_ps( value ); }
+inline RTFloats RTSimdLoad( const float * values ) { return _mm256_loadu_ps( values ); }
+inline void RTSimdStore( float * values, RTFloats v ) { _mm256_storeu_ps( values, v ); }
+inline RTFloats RTSimdAdd( RTFloats a, RTFloats b ) { return _mm256_add_ps( a, b ); }
+inline RTFloats RTSimdSub( RTFloats a, RTFloats b ) { return _mm256_sub_ps( a, b ); }
+inline RTFloats RTSimdMul( RTFloats a, RTFloats b ) { return _mm256_mul_ps( a, b ); }
+inline RTFloats RTSimdDiv( RTFloats a, RTFloats b ) { return _mm256_div_ps( a, b ); }
+inline RTFloats RTSimdSqrt( RTFloats a ) { return _mm256_sqrt_ps( a ); }
+inline RTFloats RTSimdMin( RTFloats a, RTFloats b ) { return _mm256_min_ps( a, b ); }
+inline RTFloats RTSimdMax( RTFloats a, RTFloats b ) { return _mm256_max_ps( a, b ); }
+inline RTFloats RTSimdAnd( RTFloats a, RTFloats b ) { return _mm256_and_ps( a, b ); }
+inline RTFloats RTSimdAndNot( RTFloats a, RTFloats b ) { return _mm256_andnot_ps( b, a ); }
+inline RTFloats RTSimdOr( RTFloats a, RTFloats b ) { return _mm256_or_ps( a, b ); }
+inline RTFloats RTSimdLess( RTFloats a, RTFloats b ) { return _mm256_cmp_ps( a, b, _CMP_LT_OQ ); }
+inline RTFloats RTSimdLessEqual( RTFloats a, RTFloats b ) { return _mm256_cmp_ps( a, b, _CMP_LE_OQ ); }
+inline RTFloats RTSimdSelect( RTFloats mask, RTFloats a, RTFloats b ) { return _mm256_blendv_ps( b, a, mask ); }
+inline int RTSimdMask( RTFloats mask ) { return _mm256_movemask_ps( mask ); }
+
+#elif !defined( RT_NO_SIMD ) && ( defined( _M_IX86 ) || defined( _M_X64 ) || defined( __SSE2__ ) )
+
+#include <emmintrin.h>
+
+#define RT_SIMD_WIDTH 4
+
+typedef __m128 RTFloats;
+
+inline RTFloats RTSimdSet( float value ) { return _mm_set1_ps( value ); }
+inline RTFloats RTSimdLoad( const float * values ) { return _mm_loadu_ps( values ); }
+inline void RTSimdStore( float * values, RTFloats v ) { _mm_storeu_ps( values, v ); }
+inline RTFloats RTSimdAdd( RTFloats a, RTFloats b ) { return _mm_add_ps( a, b ); }
+inline RTFloats RTSimdSub( RTFloats a, RTFloats b ) { return _mm_sub_ps( a, b ); }
+inline RTFloats RTSimdMul( RTFloats a, RTFloats b ) { return _mm_mul_ps( a, b ); }
+inline RTFloats RTSimdDiv( RTFloats a, RTFloats b ) { return _mm_div_ps( a, b ); }
+inline RTFloats RTSimdSqrt( RTFloats a ) { return _mm_sqrt_ps( a ); }
+inline RTFloats RTSimdMin( RTFloats a, RTFloats b ) { return _mm_min_ps( a, b ); }
+inline RTFloats RTSimdMax( RTFloats a, RTFloats b ) { return _mm_max_ps( a, b ); }
+inline RTFloats RTSimdAnd( RTFloats a, RTFloats b ) { return _mm_and_ps( a, b ); }
+inline RTFloats RTSimdAndNot( RTFloats a, RTFloats b ) { return _mm_andnot_ps( b, a ); }
+inline RTFloats RTSimdOr( RTFloats a, RTFloats b ) { return _mm_or_ps( a, b ); }
+inline RTFloats RTSimdLess( RTFloats a, RTFloats b ) { return _mm_cmplt_ps( a, b ); }
+inline RTFloats RTSimdLessEqual( RTFloats a, RTFloats b ) { return _mm_cmple_ps( a, b ); }
+inline RTFloats RTSimdSelect( RTFloats mask, RTFloats a, RTFloats b ) { return _mm_or_ps( _mm_and_ps( mask, a ), _mm_andnot_ps( mask, b ) ); }
+inline int RTSimdMask( RTFloats mask ) { return _mm_movemask_ps( mask ); }
+
+#else
+
+#define RT_SIMD_WIDTH 1
+
+typedef float RTFloats;
+
+inline unsigned int RTSimdBits( float a ) { unsigned int bits; memcpy( &bits, &a, sizeof( bits ) ); return bits; }
+inline float RTSimdFromBits( unsigned int bits ) { float a; memcpy( &a, &bits, sizeof( a ) ); return a; }
+
+inline RTFloats RTSimdSet( float value ) { return value; }
+inline RTFloats RTSimdLoad( const float * values ) { return *values; }
+inline void RTSimdStore( float * values, RTFloats v ) { *values = v; }
+inline RTFloats RTSimdAdd( RTFloats a, RTFloats b ) { return a + b; }
+inline RTFloats RTSimdSub( RTFloats a, RTFloats b ) { return a - b; }
+inline RTFloats RTSimdMul( RTFloats a, RTFloats b ) { return a * b; }
+inline RTFloats RTSimdDiv( RTFloats a, RTFloats b ) { return a / b; }
+inline RTFloats RTSimdSqrt( RTFloats a ) { return sqrtf( a ); }
+inline RTFloats RTSimdMin( RTFloats a, RTFloats b ) { return a < b ? a : b; }
+inline RTFloats RTSimdMax( RTFloats a, RTFloats b ) { return a > b ? a : b; }
+inline RTFloats RTSimdAnd( RTFloats a, RTFloats b ) { return RTSimdFromBits( RTSimdBits( a ) & RTSimdBits( b ) ); }
+inline RTFloats RTSimdAndNot( RTFloats a, RTFloats b ) { return RTSimdFromBits( RTSimdBits( a ) & ~RTSimdBits( b ) ); }
+inline RTFloats RTSimdOr( RTFloats a, RTFloats b ) { return RTSimdFromBits( RTSimdBits( a ) | RTSimdBits( b ) ); }
+inline RTFloats RTSimdLess( RTFloats a, RTFloats b ) { return RTSimdFromBits( a < b ? 0xFFFFFFFFU : 0 ); }
+inline RTFloats RTSimdLessEqual( RTFloats a, RTFloats b ) { return RTSimdFromBits( a <= b ? 0xFFFFFFFFU : 0 ); }
+inline RTFloats RTSimdSelect( RTFloats mask, RTFloats a, RTFloats b ) { return RTSimdBits( mask ) ? a : b; }
+inline int RTSimdMask( RTFloats mask ) { return RTSimdBits( mask ) >> 31; }
+
+#endif
+
+// Lanes of a mask, one bit each, as RTSimdMask returns them
+#define RT_SIMD_ALL_LANES			( ( 1 << RT_SIMD_WIDTH ) - 1 )
+
+/// <summary>
+/// RT_SIMD_WIDTH rays, a component of all of them per vector, with the
+/// distances each may hit between. Lanes not in the active mask are
+/// ignored by every test.
+/// </summary>
+struct RTRayPacket
+{
+	RTFloats					positionX;
+	RTFloats					positionY;
+	RTFloats					positionZ;
+	RTFloats					directionX;
+	RTFloats					directionY;
+	RTFloats					directionZ;
+	RTFloats					minDistance;
+	RTFloats					maxDistance;
+	RTFloats					active;			// All bits set in lanes holding a ray
+};
+
+/// <summary>
+/// Fills a packet from the rays of the lanes set in a mask, as RTSimdMask
+/// returns it, at least one of them. The arrays need only hold rays for
+/// those lanes; the others repeat the first active ray, so they hold no
+/// garbage, and are masked off.
+/// </summary>
+inline void RTSimdLoadRays( RTRayPacket * packet, const RTRay * rays, const float * minDistances, const float * maxDistances, int lanes )
+{
+	float values[8][RT_SIMD_WIDTH];
+	float active[RT_SIMD_WIDTH];
+
+	int first = 0;
+	while( first < RT_SIMD_WIDTH - 1 && ( lanes & ( 1 << first ) ) == 0 )
+		++first;
+
+	for( int lane = 0; lane < RT_SIMD_WIDTH; ++lane )
+	{
+		bool used = ( lanes & ( 1 << lane ) ) != 0;
+		int ray = used ? lane : first;
+		values[0][lane] = rays[ray].position.x;
+		values[1][lane] = rays[ray].position.y;
+		values[2][lane] = rays[ray].position.z;
+		values[3][lane] = rays[ray].direction.x;
+		values[4][lane] = rays[ray].direction.y;
+		values[5][lane] = rays[ray].direction.z;
+		values[6][lane] = minDistances[ray];
+		values[7][lane] = maxDistances[ray];
+
+		unsigned int bits = used ? 0xFFFFFFFFU : 0;
+		memcpy( &active[lane], &bits, sizeof( bits ) );
+	}
+
+	packet->positionX = RTSimdLoad( values[0] );
+	packet->positionY = RTSimdLoad( values[1] );
+	packet->positionZ = RTSimdLoad( values[2] );
+	packet->directionX = RTSimdLoad( values[3] );
+	packet->directionY = RTSimdLoad( values[4] );
+	packet->directionZ = RTSimdLoad( values[5] );
+	packet->minDistance = RTSimdLoad( values[6] );
+	packet->maxDistance = RTSimdLoad( values[7] );
+	packet->active = RTSimdLoad( active );
+}
@@ -0,0 +1,358 @@
+// RTTileScheduler.cpp
+//
+// Summary:
+//	Renders the tiles of an image on a pool of threads that steal work from
+//	each other, splitting tiles while any of them is idle.
+
+#include "RTTileScheduler.h"
+
+/// <summary>
+/// Starts the worker threads.
+/// </summary>
+/// <param name='numThreads'>Threads to render on, the calling thread included, or 0 for one per processor.</param>
+RTTileScheduler::RTTileScheduler( int numThreads )
+{
+	if( numThreads <= 0 )
+		numThreads = RTGetNumProcessors();
+
+	tileSize = 64;
+	minTileSize = 8;
+	tracer = NULL;
+	framebuffer = NULL;
+	frame = 0;
+	numBusy = 0;
+	quit = false;
+	numPixelsLeft = 0;
+	numIdle = 0;
+
+	RTMutexInit( &mutex );
+	RTConditionInit( &started );
+	RTConditionInit( &finished );
+
+	for( int i = 0; i < numThreads; ++i )
+	{
+		Worker * worker = new Worker;
+		worker->scheduler = this;
+		RTMutexInit( &worker->mutex );
+		worker->random = 2654435761u * ( i + 1 );
+		worker->numRays = 0;
+		worker->numTiles = 0;
+		worker->numSteals = 0;
+		worker->numSplits = 0;
+		workers.push_back( worker );
+	}
+
+	// The first worker is whichever thread calls Render. If a thread cannot
+	// be started, the scheduler makes do with those that were.
+	for( int i = 1; i < numThreads; ++i )
+	{
+		if( !RTThreadCreate( &workers[i]->thread, WorkerThread, workers[i] ) )
+		{
+			for( int j = i; j < numThreads; ++j )
+			{
+				RTMutexDestroy( &workers[j]->mutex );
+				delete workers[j];
+			}
+			workers.resize( i );
+			break;
+		}
+	}
+}
+
+RTTileScheduler::~RTTileScheduler( void )
+{
+	RTMutexLock( &mutex );
+	quit = true;
+	RTConditionWakeAll( &started );
+	RTMutexUnlock( &mutex );
+
+	for( int i = 0; i < ( int )workers.size(); ++i )
+	{
+		if( i > 0 )
+			RTThreadJoin( workers[i]->thread );
+
+		RTMutexDestroy( &workers[i]->mutex );
+		delete workers[i];
+	}
+
+	RTConditionDestroy( &finished );
+	RTConditionDestroy( &started );
+	RTMutexDestroy( &mutex );
+}
+
+/// <summary>
+/// Sets the size of the tiles an image is first cut into, and the size
+/// below which they are not split.
+/// </summary>
+void RTTileScheduler::SetTileSizes( int tileSize, int minTileSize )
+{
+	this->tileSize = tileSize > 1 ? tileSize : 1;
+	this->minTileSize = minTileSize > 1 ? minTileSize : 1;
+}
+
+/// <summary>
+/// Renders the tracer's image into a framebuffer, and returns once every
+/// tile is rendered.
+/// </summary>
+void RTTileScheduler::Render( const RTTracer * tracer, RTFramebuffer * framebuffer )
+{
+	int width = tracer->GetWidth();
+	int height = tracer->GetHeight();
+	if( framebuffer->GetWidth() != width || framebuffer->GetHeight() != height )
+		framebuffer->Resize( width, height );
+
+	this->tracer = tracer;
+	this->framebuffer = framebuffer;
+
+	// The other workers are waiting for the frame, so the queues can be
+	// filled without their locks
+	DealTiles( width, height );
+	numPixelsLeft = width * height;
+	numIdle = 0;
+
+	RTMutexLock( &mutex );
+	++frame;
+	numBusy = ( int )workers.size() - 1;
+	RTConditionWakeAll( &started );
+	RTMutexUnlock( &mutex );
+
+	RenderTiles( workers[0] );
+
+	RTMutexLock( &mutex );
+	while( numBusy > 0 )
+		RTConditionWait( &finished, &mutex );
+	RTMutexUnlock( &mutex );
+}
+
+/// <summary>
+/// Cuts the image into tiles and gives each worker a run of them, so that
+/// each starts on its own part of the image.
+/// </summary>
+void RTTileScheduler::DealTiles( int width, int height )
+{
+	vector<RTTile> tiles;
+	for( int y = 0; y < height; y += tileSize )
+	{
+		for( int x = 0; x < width; x += tileSize )
+		{
+			RTTile tile;
+			tile.x = x;
+			tile.y = y;
+			tile.width = x + tileSize < width ? tileSize : width - x;
+			tile.height = y + tileSize < height ? tileSize : height - y;
+			tiles.push_back( tile );
+		}
+	}
+
+	int numWorkers = ( int )workers.size();
+	int numTiles = ( int )tiles.size();
+	for( int i = 0; i < numWorkers; ++i )
+	{
+		// Queued in reverse, so each worker takes its run from the top down
+		workers[i]->tiles.clear();
+		int begin = numTiles * i / numWorkers;
+		int end = numTiles * ( i + 1 ) / numWorkers;
+		for( int t = end - 1; t >= begin; --t )
+			workers[i]->tiles.push_back( tiles[t] );
+	}
+}
+
+/// <summary>
+/// Waits for each frame and renders tiles of it, until the scheduler is
+/// destroyed.
+/// </summary>
+RTThreadResult RT_THREAD_CALL RTTileScheduler::WorkerThread( void * argument )
+{
+	Worker * worker = ( Worker * )argument;
+	RTTileScheduler * scheduler = worker->scheduler;
+	int lastFrame = 0;
+
+	for( ;; )
+	{
+		RTMutexLock( &scheduler->mutex );
+		while( !scheduler->quit && scheduler->frame == lastFrame )
+			RTConditionWait( &scheduler->started, &scheduler->mutex );
+
+		lastFrame = scheduler->frame;
+		bool quit = scheduler->quit;
+		RTMutexUnlock( &scheduler->mutex );
+
+		if( quit )
+			break;
+
+		scheduler->RenderTiles( worker );
+
+		RTMutexLock( &scheduler->mutex );
+		if( --scheduler->numBusy == 0 )
+			RTConditionWakeAll( &scheduler->finished );
+		RTMutexUnlock( &scheduler->mutex );
+	}
+
+	return 0;
+}
+
+/// <summary>
+/// Renders tiles from the worker's own queue, then stolen ones, until no
+/// pixel of the frame is left.
+/// </summary>
+void RTTileScheduler::RenderTiles( Worker * worker )
+{
+	RTTile tile;
+
+	while( RTAtomicLoad( &numPixelsLeft ) > 0 )
+	{
+		if( !PopTile( worker, &tile ) )
+		{
+			// Tiles still being rendered may yet be split, so keep looking
+			// until every pixel is done
+			RTAtomicAdd( &numIdle, 1 );
+			bool stolen = false;
+			while( !stolen && RTAtomicLoad( &numPixelsLeft ) > 0 )
+			{
+				stolen = StealTile( worker, &tile );
+				if( !stolen )
+					RTThreadYield();
+			}
+			RTAtomicAdd( &numIdle, -1 );
+
+			if( !stolen )
+				break;
+
+			++worker->numSteals;
+		}
+
+		// Rendered a row at a time, so that half of what is left of a slow
+		// tile can be given away as soon as anyone is waiting for work. A
+		// half already queued has not been taken yet, so no more is split.
+		while( tile.height > 0 )
+		{
+			if( RTAtomicLoad( &numIdle ) > 0 && ( tile.width >= 2 * minTileSize || tile.height >= 2 * minTileSize ) )
+			{
+				RTMutexLock( &worker->mutex );
+				if( worker->tiles.empty() )
+				{
+					RTTile half = tile;
+					if( tile.width >= tile.height )
+					{
+						tile.width /= 2;
+						half.x += tile.width;
+						half.width -= tile.width;
+					}
+					else
+					{
+						tile.height /= 2;
+						half.y += tile.height;
+						half.height -= tile.height;
+					}
+
+					worker->tiles.push_back( half );
+					++worker->numSplits;
+				}
+				RTMutexUnlock( &worker->mutex );
+			}
+
+			worker->numRays += tracer->RenderTile( framebuffer, tile.x, tile.y, tile.width, 1 );
+			RTAtomicAdd( &numPixelsLeft, -tile.width );
+			++tile.y;
+			--tile.height;
+		}
+
+		++worker->numTiles;
+	}
+}
+
+/// <summary>
+/// Takes the tile at the back of the worker's own queue.
+/// </summary>
+bool RTTileScheduler::PopTile( Worker * worker, RTTile * tile )
+{
+	RTMutexLock( &worker->mutex );
+	bool found = !worker->tiles.empty();
+	if( found )
+	{
+		*tile = worker->tiles.back();
+		worker->tiles.pop_back();
+	}
+	RTMutexUnlock( &worker->mutex );
+
+	return found;
+}
+
+/// <summary>
+/// Takes the tile at the front of another worker's queue, trying each in
+/// turn from one picked at random.
+/// </summary>
+bool RTTileScheduler::StealTile( Worker * worker, RTTile * tile )
+{
+	int numWorkers = ( int )workers.size();
+	worker->random = worker->random * 1664525 + 1013904223;
+	int first = ( int )( ( worker->random >> 16 ) % numWorkers );
+
+	for( int i = 0; i < numWorkers; ++i )
+	{
+		Worker * victim = workers[( first + i ) % numWorkers];
+		if( victim == worker )
+			continue;
+
+		RTMutexLock( &victim->mutex );
+		bool found = !victim->tiles.empty();
+		if( found )
+		{
+			*tile = victim->tiles.front();
+			victim->tiles.pop_front();
+		}
+		RTMutexUnlock( &victim->mutex );
+
+		if( found )
+			return true;
+	}
+
+	return false;
+}
+
+long long RTTileScheduler::GetNumRays() const
+{
+	long long numRays = 0;
+	for( int i = 0; i < ( int )workers.size(); ++i )
+		numRays += workers[i]->numRays;
+	return numRays;
+}
+
+int RTTileScheduler::GetNumTiles() const
+{
+	int numTiles = 0;
+	for( int i = 0; i < ( int )workers.size(); ++i )
+		numTiles += workers[i]->numTiles;
+	return numTiles;
+}
+
+int RTTileScheduler::GetNumSteals() const
+{
+	int numSteals = 0;
+	for( int i = 0; i < ( int )workers.size(); ++i )
+		numSteals += workers[i]->numSteals;
+	return numSteals;
+}
+
+int RTTileScheduler::GetNumSplits() const
+{
+	int numSplits = 0;
+	for( int i = 0; i < ( int )workers.size(); ++i )
+		numSplits += workers[i]->numSplits;
+	return numSplits;
+}
+
+/// <summary>
+/// Zeroes the counts of rays, tiles, steals and splits. Call between
+/// frames only.
+/// </summary>
+void RTTileScheduler::ResetStatistics()
+{
+	for( int i = 0; i < ( int )workers.size(); ++i )
+	{
+		workers[i]->numRays = 0;
+		workers[i]->numTiles = 0;
+		workers[i]->numSteals = 0;
+		workers[i]->numSplits = 0;
+	}
+}
@@ -0,0 +1,91 @@
+#pragma once
+
+#include <deque>
+#include <vector>
+
+#include "RTFramebuffer.h"
+#include "RTPlatform.h"
+#include "RTTracer.h"
+
+using namespace std;
+
+/// <summary>
+/// A rectangle of pixels rendered as one piece of work.
+/// </summary>
+struct RTTile
+{
+	int							x;
+	int							y;
+	int							width;
+	int							height;
+};
+
+/// <summary>
+/// Renders an image on several threads, a tile at a time.
+/// </summary>
+/// <remarks>
+/// Each frame the image is cut into tiles of the tile size, and each worker
+/// is dealt a run of neighbouring tiles in its own queue. A worker takes
+/// tiles from the back of its queue, and once it is empty steals from the
+/// front of another's, where the largest tiles wait.
+///
+/// Tile sizes adapt to the load. Tiles are rendered a row at a time, and
+/// while any worker is looking for work, what is left of the tile being
+/// rendered is halved along its longer side, down to the minimum tile
+/// size, and the other half queued where it can be stolen. A frame whose
+/// cost is even is rendered in large tiles, while the expensive parts of
+/// an uneven one, such as reflective spheres against an empty sky, are cut
+/// finer as the cheap parts run out.
+///
+/// The thread calling Render is the first worker, and the others wait on
+/// their own threads between frames.
+/// </remarks>
+class RTTileScheduler
+{
+protected:
+	struct Worker
+	{
+		RTTileScheduler *		scheduler;
+		RTThread				thread;
+		RTMutex					mutex;			// Guards tiles
+		deque<RTTile>			tiles;
+		unsigned int			random;			// Picks the worker to steal from
+		long long				numRays;
+		int						numTiles;
+		int						numSteals;
+		int						numSplits;
+	};
+
+	vector<Worker *>			workers;
+	int							tileSize;
+	int							minTileSize;
+	const RTTracer *			tracer;			// Of the frame being rendered
+	RTFramebuffer *				framebuffer;
+	RTMutex						mutex;			// Guards frame, numBusy and quit
+	RTCondition					started;
+	RTCondition					finished;
+	int							frame;			// Frames started, so a waking worker knows there is a new one
+	int							numBusy;		// Threads still rendering the frame
+	bool						quit;
+	volatile LONG				numPixelsLeft;	// Pixels of the frame not yet rendered
+	volatile LONG				numIdle;		// Workers looking for a tile to steal
+
+	static RTThreadResult RT_THREAD_CALL WorkerThread( void * argument );
+	void RenderTiles( Worker * worker );
+	bool PopTile( Worker * worker, RTTile * tile );
+	bool StealTile( Worker * worker, RTTile * tile );
+	void DealTiles( int width, int height );
+public:
+	RTTileScheduler( int numThreads = 0 );
+	~RTTileScheduler( void );
+	int GetNumThreads() const { return ( int )workers.size(); }
+	int GetTileSize() const { return tileSize; }
+	int GetMinTileSize() const { return minTileSize; }
+	void SetTileSizes( int tileSize, int minTileSize );
+	void Render( const RTTracer * tracer, RTFramebuffer * framebuffer );
+	long long GetNumRays() const;
+	int GetNumTiles() const;
+	int GetNumSteals() const;
+	int GetNumSplits() const;
+	void ResetStatistics();
+};
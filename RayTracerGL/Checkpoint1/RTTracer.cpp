@@ -0,0 +1,365 @@
+// RTTracer.cpp
+//
+// Summary:
+//	Whitted style ray tracing of a scene: primary, shadow and reflection
+//	rays, lit as GL's fixed function pipeline lights the same scene.
+
+#include "RTTracer.h"
+
+#include <cfloat>
+
+// Distance secondary rays start from their surface, so they do not hit it again
+#define RT_EPSILON					1e-4f
+
+#define RT_PI						3.14159265358979f
+
+// Index of each lane of a packet
+static const float RTLaneIndices[8] = { 0, 1, 2, 3, 4, 5, 6, 7 };
+
+RTTracer::RTTracer( void )
+{
+	scene = NULL;
+	camera.eye = RTVector3( 0, 0, 0 );
+	camera.center = RTVector3( 0, 0, -1 );
+	camera.up = RTVector3( 0, 1, 0 );
+	camera.fovy = 45;
+	camera.nearPlane = 0.1f;
+	camera.farPlane = 100;
+	width = 0;
+	height = 0;
+	recursionDepth = 3;
+	packetTracing = RT_SIMD_WIDTH > 1;
+	forward = RTVector3( 0, 0, -1 );
+	side = RTVector3( 1, 0, 0 );
+	up = RTVector3( 0, 1, 0 );
+	halfWidth = 0;
+	halfHeight = 0;
+	numRays = 0;
+}
+
+RTTracer::~RTTracer( void )
+{
+}
+
+/// <summary>
+/// Sets the view and the size of the image, and works out the basis
+/// gluLookAt builds and the view plane gluPerspective's field of view
+/// spans, from which primary rays are made.
+/// </summary>
+void RTTracer::SetCamera( const RTCamera & camera, int width, int height )
+{
+	this->camera = camera;
+	this->width = width;
+	this->height = height;
+
+	forward = RTNormalize( camera.center - camera.eye );
+	side = RTNormalize( RTCross( forward, camera.up ) );
+	up = RTCross( side, forward );
+
+	halfHeight = tanf( camera.fovy * RT_PI / 360.0f );
+	halfWidth = halfHeight * width / height;
+}
+
+/// <summary>
+/// Returns the primary ray through the centre of a pixel.
+/// </summary>
+RTRay RTTracer::GetPrimaryRay( int x, int y ) const
+{
+	float u = halfWidth * ( 2 * ( x + 0.5f ) / width - 1 );
+	float v = halfHeight * ( 1 - 2 * ( y + 0.5f ) / height );
+	return RTRay( camera.eye, RTNormalize( forward + side * u + up * v ) );
+}
+
+/// <summary>
+/// Makes the primary rays of count neighbouring pixels of a row, at most
+/// RT_SIMD_WIDTH, as a packet of rays equal to those GetPrimaryRay makes,
+/// with the distances of the near and far planes along each.
+/// </summary>
+void RTTracer::GetPrimaryPacket( int x, int y, int count, RTRayPacket * packet ) const
+{
+	RTFloats one = RTSimdSet( 1 );
+	RTFloats two = RTSimdSet( 2 );
+	RTFloats lanes = RTSimdLoad( RTLaneIndices );
+
+	// The same operations in the same order as GetPrimaryRay, so each lane
+	// rounds as it does
+	RTFloats column = RTSimdAdd( RTSimdSet( ( float )x ), RTSimdAdd( lanes, RTSimdSet( 0.5f ) ) );
+	RTFloats u = RTSimdMul( RTSimdSet( halfWidth ), RTSimdSub( RTSimdDiv( RTSimdMul( two, column ), RTSimdSet( ( float )width ) ), one ) );
+	float v = halfHeight * ( 1 - 2 * ( y + 0.5f ) / height );
+
+	RTFloats directionX = RTSimdAdd( RTSimdAdd( RTSimdSet( forward.x ), RTSimdMul( RTSimdSet( side.x ), u ) ), RTSimdSet( up.x * v ) );
+	RTFloats directionY = RTSimdAdd( RTSimdAdd( RTSimdSet( forward.y ), RTSimdMul( RTSimdSet( side.y ), u ) ), RTSimdSet( up.y * v ) );
+	RTFloats directionZ = RTSimdAdd( RTSimdAdd( RTSimdSet( forward.z ), RTSimdMul( RTSimdSet( side.z ), u ) ), RTSimdSet( up.z * v ) );
+
+	RTFloats squaredLength = RTSimdAdd( RTSimdAdd( RTSimdMul( directionX, directionX ), RTSimdMul( directionY, directionY ) ), RTSimdMul( directionZ, directionZ ) );
+	RTFloats scale = RTSimdDiv( one, RTSimdSqrt( squaredLength ) );
+	packet->directionX = RTSimdMul( directionX, scale );
+	packet->directionY = RTSimdMul( directionY, scale );
+	packet->directionZ = RTSimdMul( directionZ, scale );
+
+	packet->positionX = RTSimdSet( camera.eye.x );
+	packet->positionY = RTSimdSet( camera.eye.y );
+	packet->positionZ = RTSimdSet( camera.eye.z );
+
+	// The near and far planes are at a fixed depth, so further along rays
+	// away from the centre of the view
+	RTFloats depth = RTSimdAdd( RTSimdAdd( RTSimdMul( packet->directionX, RTSimdSet( forward.x ) ), RTSimdMul( packet->directionY, RTSimdSet( forward.y ) ) ), RTSimdMul( packet->directionZ, RTSimdSet( forward.z ) ) );
+	packet->minDistance = RTSimdDiv( RTSimdSet( camera.nearPlane ), depth );
+	packet->maxDistance = RTSimdDiv( RTSimdSet( camera.farPlane ), depth );
+
+	// Lanes past the end of the row hold rays beside the image, masked off
+	packet->active = RTSimdLess( lanes, RTSimdSet( ( float )count ) );
+}
+
+/// <summary>
+/// Traces the primary ray of one pixel.
+/// </summary>
+/// <param name='numRays'>Incremented for each ray traced.</param>
+RTVector3 RTTracer::TracePixel( int x, int y, long long * numRays ) const
+{
+	RTRay ray = GetPrimaryRay( x, y );
+
+	// The near and far planes are at a fixed depth, so further along rays
+	// away from the centre of the view
+	float depth = RTDot( ray.direction, forward );
+	return Illuminate( ray, camera.nearPlane / depth, camera.farPlane / depth, 0, numRays );
+}
+
+/// <summary>
+/// Renders a rectangle of pixels into a framebuffer already of the
+/// tracer's size.
+/// </summary>
+/// <returns>The number of rays traced.</returns>
+long long RTTracer::RenderTile( RTFramebuffer * framebuffer, int x, int y, int width, int height ) const
+{
+	long long numRays = 0;
+
+	if( !packetTracing )
+	{
+		for( int row = y; row < y + height; ++row )
+		{
+			for( int column = x; column < x + width; ++column )
+				framebuffer->GetPixel( column, row ) = TracePixel( column, row, &numRays );
+		}
+
+		return numRays;
+	}
+
+	RTVector3 colors[RT_SIMD_WIDTH];
+	for( int row = y; row < y + height; ++row )
+	{
+		for( int column = x; column < x + width; column += RT_SIMD_WIDTH )
+		{
+			int count = x + width - column < RT_SIMD_WIDTH ? x + width - column : RT_SIMD_WIDTH;
+			TracePacket( column, row, count, colors, &numRays );
+
+			for( int lane = 0; lane < count; ++lane )
+				framebuffer->GetPixel( column + lane, row ) = colors[lane];
+		}
+	}
+
+	return numRays;
+}
+
+/// <summary>
+/// Traces the primary rays of count neighbouring pixels of a row, at most
+/// RT_SIMD_WIDTH, as one packet, and lights them as Illuminate does. The
+/// shadow rays of the pixels that hit something go towards each light as
+/// another packet, with the lanes that miss or face away from it masked.
+/// </summary>
+/// <param name='colors'>Set to the colour of each pixel.</param>
+/// <param name='numRays'>Incremented for each ray traced.</param>
+void RTTracer::TracePacket( int x, int y, int count, RTVector3 * colors, long long * numRays ) const
+{
+	RTRayPacket packet;
+	GetPrimaryPacket( x, y, count, &packet );
+
+	RTPacketHit packetHit;
+	int hits = scene->IntersectPacket( packet, &packetHit );
+	*numRays += count;
+
+	// Lanes are shaded one by one from here
+	float directions[3][RT_SIMD_WIDTH];
+	RTSimdStore( directions[0], packet.directionX );
+	RTSimdStore( directions[1], packet.directionY );
+	RTSimdStore( directions[2], packet.directionZ );
+
+	RTRay rays[RT_SIMD_WIDTH];
+	for( int lane = 0; lane < RT_SIMD_WIDTH; ++lane )
+		rays[lane] = RTRay( camera.eye, RTVector3( directions[0][lane], directions[1][lane], directions[2][lane] ) );
+
+	RTVector3 points[RT_SIMD_WIDTH];
+	RTVector3 normals[RT_SIMD_WIDTH];
+	const RTMaterial * materials[RT_SIMD_WIDTH] = { NULL };
+
+	for( int lane = 0; lane < count; ++lane )
+	{
+		RTHit hit;
+		if( !scene->GetHit( packetHit, lane, &hit ) )
+		{
+			colors[lane] = scene->GetBackground();
+			continue;
+		}
+
+		points[lane] = rays[lane].GetPoint( hit.distance );
+		normals[lane] = scene->GetNormal( hit, points[lane] );
+		materials[lane] = &scene->GetMaterial( hit );
+
+		if( RTDot( normals[lane], rays[lane].direction ) > 0 )
+			normals[lane] = -normals[lane];
+
+		colors[lane] = scene->GetAmbient() * materials[lane]->color;
+	}
+
+	if( hits == 0 )
+		return;
+
+	RTRay shadowRays[RT_SIMD_WIDTH];
+	float shadowDistances[RT_SIMD_WIDTH];
+	float facings[RT_SIMD_WIDTH];
+	float zeros[RT_SIMD_WIDTH] = { 0 };
+
+	for( int i = 0; i < scene->GetNumLights(); ++i )
+	{
+		const RTLight & light = scene->GetLight( i );
+		int shadowLanes = 0;
+
+		for( int lane = 0; lane < count; ++lane )
+		{
+			if( ( hits & ( 1 << lane ) ) == 0 )
+				continue;
+
+			RTVector3 toLight = light.position - points[lane];
+			shadowDistances[lane] = RTLength( toLight );
+			RTVector3 lightVector = toLight * ( 1.0f / shadowDistances[lane] );
+
+			// Only surfaces facing the light can be lit by it
+			facings[lane] = RTDot( normals[lane], lightVector );
+			if( facings[lane] <= 0 )
+				continue;
+
+			shadowRays[lane] = RTRay( points[lane] + normals[lane] * RT_EPSILON, lightVector );
+			shadowLanes |= 1 << lane;
+			++*numRays;
+		}
+
+		if( shadowLanes == 0 )
+			continue;
+
+		RTRayPacket shadowPacket;
+		RTSimdLoadRays( &shadowPacket, shadowRays, zeros, shadowDistances, shadowLanes );
+		int litLanes = shadowLanes & ~scene->IsOccludedPacket( shadowPacket );
+
+		for( int lane = 0; lane < count; ++lane )
+		{
+			if( litLanes & ( 1 << lane ) )
+				colors[lane] += LightSurface( light, shadowRays[lane].direction, facings[lane], normals[lane], -rays[lane].direction, *materials[lane] );
+		}
+	}
+
+	// Material is reflective
+	for( int lane = 0; lane < count; ++lane )
+	{
+		if( materials[lane] != NULL && recursionDepth > 0 && materials[lane]->reflectivity > 0 )
+		{
+			RTRay reflectionRay( points[lane] + normals[lane] * RT_EPSILON, RTReflect( rays[lane].direction, normals[lane] ) );
+			colors[lane] += Illuminate( reflectionRay, 0, FLT_MAX, 1, numRays ) * materials[lane]->reflectivity;
+		}
+	}
+}
+
+/// <summary>
+/// Renders the scene from the camera set by SetCamera, into a framebuffer
+/// of its size, on the calling thread.
+/// </summary>
+void RTTracer::Render( RTFramebuffer * framebuffer )
+{
+	if( framebuffer->GetWidth() != width || framebuffer->GetHeight() != height )
+		framebuffer->Resize( width, height );
+
+	numRays += RenderTile( framebuffer, 0, 0, width, height );
+}
+
+/// <summary>
+/// Returns the light arriving along a ray, from the closest object it hits
+/// between minDistance and maxDistance, or the background if it hits none.
+/// </summary>
+RTVector3 RTTracer::Illuminate( const RTRay & ray, float minDistance, float maxDistance, int depth, long long * numRays ) const
+{
+	++*numRays;
+
+	RTHit hit;
+	if( !scene->Intersect( ray, minDistance, maxDistance, &hit ) )
+		return scene->GetBackground();
+
+	RTVector3 point = ray.GetPoint( hit.distance );
+	RTVector3 normal = scene->GetNormal( hit, point );
+	const RTMaterial & material = scene->GetMaterial( hit );
+
+	// Surfaces are lit on the side the ray hits, as GL lights both sides of
+	// the floor whichever way its corners wind
+	if( RTDot( normal, ray.direction ) > 0 )
+		normal = -normal;
+
+	RTVector3 totalLight = scene->GetAmbient() * material.color;
+	totalLight += SpawnShadowRays( point, normal, -ray.direction, material, numRays );
+
+	// Material is reflective
+	if( depth < recursionDepth && material.reflectivity > 0 )
+	{
+		RTRay reflectionRay( point + normal * RT_EPSILON, RTReflect( ray.direction, normal ) );
+		totalLight += Illuminate( reflectionRay, 0, FLT_MAX, depth + 1, numRays ) * material.reflectivity;
+	}
+
+	return totalLight;
+}
+
+/// <summary>
+/// Returns the diffuse and specular light a point receives from every
+/// light that a shadow ray from it reaches.
+/// </summary>
+RTVector3 RTTracer::SpawnShadowRays( const RTVector3 & point, const RTVector3 & normal, const RTVector3 & viewVector, const RTMaterial & material, long long * numRays ) const
+{
+	RTVector3 totalLight( 0, 0, 0 );
+	RTVector3 origin = point + normal * RT_EPSILON;
+
+	for( int i = 0; i < scene->GetNumLights(); ++i )
+	{
+		const RTLight & light = scene->GetLight( i );
+		RTVector3 toLight = light.position - point;
+		float distance = RTLength( toLight );
+		RTVector3 lightVector = toLight * ( 1.0f / distance );
+
+		// Only surfaces facing the light can be lit by it
+		float facing = RTDot( normal, lightVector );
+		if( facing <= 0 )
+			continue;
+
+		++*numRays;
+		if( scene->IsOccluded( RTRay( origin, lightVector ), 0, distance ) )
+			continue;
+
+		totalLight += LightSurface( light, lightVector, facing, normal, viewVector, material );
+	}
+
+	return totalLight;
+}
+
+/// <summary>
+/// Returns the diffuse and specular light a point receives from a light it
+/// faces and can see.
+/// </summary>
+/// <param name='facing'>Cosine of the angle between the normal and the light vector.</param>
+RTVector3 RTTracer::LightSurface( const RTLight & light, const RTVector3 & lightVector, float facing, const RTVector3 & normal, const RTVector3 & viewVector, const RTMaterial & material ) const
+{
+	RTVector3 totalLight = light.color * material.color * facing;
+
+	if( material.specular > 0 )
+	{
+		float highlight = RTDot( normal, RTNormalize( lightVector + viewVector ) );
+		if( highlight > 0 )
+			totalLight += light.color * ( material.specular * powf( highlight, material.exponent ) );
+	}
+
+	return totalLight;
+}
@@ -0,0 +1,86 @@
+#pragma once
+
+#include "RTFramebuffer.h"
+#include "RTMath.h"
+#include "RTScene.h"
+#include "RTSimd.h"
+
+using namespace std;
+
+/// <summary>
+/// A view as gluLookAt and gluPerspective set it up. The aspect ratio is
+/// that of the image rendered.
+/// </summary>
+struct RTCamera
+{
+	RTVector3					eye;
+	RTVector3					center;
+	RTVector3					up;
+	float						fovy;			// Vertical field of view in degrees
+	float						nearPlane;
+	float						farPlane;
+};
+
+/// <summary>
+/// Renders a scene into a float framebuffer, as RTManager does: the closest
+/// hit of each primary ray is lit by an ambient term and each light that a
+/// shadow ray reaches, and reflective surfaces add the light of a reflected
+/// ray, up to the recursion depth.
+/// </summary>
+/// <remarks>
+/// Primary rays start at the eye and pass through the centres of the
+/// pixels, and only hits between the near and far planes count, so the
+/// image matches what GL rasterizes for the same camera. SetCamera works
+/// out the camera's basis and the extent of the view plane along it, and
+/// each ray is made from those as its pixel is traced, so the camera can
+/// move every frame at no cost and rays take no memory whatever the size.
+///
+/// Neighbouring pixels of a row are traced as one packet of RT_SIMD_WIDTH
+/// primary rays, and their shadow rays towards each light as another, so
+/// each object is tested against a packet of coherent rays at once.
+/// Reflected rays scatter, and are traced one at a time.
+///
+/// Tracing changes nothing but the framebuffer, so several threads may
+/// render different tiles of one image with RenderTile at once.
+/// </remarks>
+class RTTracer
+{
+protected:
+	const RTScene *				scene;
+	RTCamera					camera;
+	int							width;
+	int							height;
+	int							recursionDepth;
+	bool						packetTracing;	// Whether primary and shadow rays are traced in packets
+	RTVector3					forward;		// Unit view direction, along which the near and far planes are measured
+	RTVector3					side;			// Unit vectors to the right and up of the view plane
+	RTVector3					up;
+	float						halfWidth;		// Of the view plane, a unit along forward from the eye
+	float						halfHeight;
+	long long					numRays;		// Rays Render has traced since ResetStatistics
+
+	RTVector3 Illuminate( const RTRay & ray, float minDistance, float maxDistance, int depth, long long * numRays ) const;
+	RTVector3 SpawnShadowRays( const RTVector3 & point, const RTVector3 & normal, const RTVector3 & viewVector, const RTMaterial & material, long long * numRays ) const;
+	RTVector3 LightSurface( const RTLight & light, const RTVector3 & lightVector, float facing, const RTVector3 & normal, const RTVector3 & viewVector, const RTMaterial & material ) const;
+	void TracePacket( int x, int y, int count, RTVector3 * colors, long long * numRays ) const;
+public:
+	RTTracer( void );
+	~RTTracer( void );
+	const RTScene * GetScene() const { return scene; }
+	void SetScene( const RTScene * scene ) { this->scene = scene; }
+	const RTCamera & GetCamera() const { return camera; }
+	void SetCamera( const RTCamera & camera, int width, int height );
+	RTRay GetPrimaryRay( int x, int y ) const;
+	void GetPrimaryPacket( int x, int y, int count, RTRayPacket * packet ) const;
+	int GetWidth() const { return width; }
+	int GetHeight() const { return height; }
+	int GetRecursionDepth() const { return recursionDepth; }
+	void SetRecursionDepth( int recursionDepth ) { this->recursionDepth = recursionDepth; }
+	bool GetPacketTracing() const { return packetTracing; }
+	void SetPacketTracing( bool packetTracing ) { this->packetTracing = packetTracing; }
+	RTVector3 TracePixel( int x, int y, long long * numRays ) const;
+	long long RenderTile( RTFramebuffer * framebuffer, int x, int y, int width, int height ) const;
+	void Render( RTFramebuffer * framebuffer );
+	long long GetNumRays() const { return numRays; }
+	void ResetStatistics() { numRays = 0; }
+};
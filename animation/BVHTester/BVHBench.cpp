@@ -0,0 +1,1918 @@
+//--------------------------------------------------------------------------------------
+// File: BVHBench.cpp
+//
+// Console benchmark for loading and posing BVH clips. It only uses the
+// headless parts of BVHTester, so it also builds on Linux:
+//
+//   g++ -O2 -pthread BVHBench.cpp BVHBlendTree.cpp BVHCache.cpp BVHClip.cpp
+//       BVHClipCache.cpp BVHClipStream.cpp BVHCompressedClip.cpp BVHCrowd.cpp
+//       BVHFigure.cpp BVHFile.cpp BVHPlatform.cpp BVHPose.cpp BVHPoseBatch.cpp
+//       BVHPoseCache.cpp BVHProfiler.cpp BVHSkeleton.cpp BVHThreadPool.cpp
+//       BVHTimeWarp.cpp
+//
+// Add -mavx for the 8 lane BVHPoseBatch kernel.
+//
+// Usage: BVHBench [-n iterations] [-verify] [-json results.json] [file.bvh | directory ...]
+//
+// Every .bvh file in a directory given is measured. -json also writes the
+// measurements to a file, for scripts that track them between runs. Built
+// with PROFILE defined, -trace results.trace.json writes a Chrome trace of
+// the run, with each crowd update as a frame. An unknown option prints the
+// usage and exits with 1.
+//
+// -verify checks BVHReader::ParseFloat against strtod on every number in
+// the clips, the poses of all six rotation orders against a reference, the
+// frames streamed by BVHClipStream against the loaded clips, and the poses
+// of BVHBlendTree and BVHPoseCache against the figures playing their
+// clips, and BVHCompressedClip decoded at every quarter frame against its
+// clip, instead of timing them.
+//--------------------------------------------------------------------------------------
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include <sys/stat.h>
+
+#ifndef _WIN32
+#include <dirent.h>
+#endif
+
+#include "BVHBlendTree.h"
+#include "BVHClip.h"
+#include "BVHClipStream.h"
+#include "BVHCompressedClip.h"
+#include "BVHCrowd.h"
+#include "BVHFile.h"
+#include "BVHPlatform.h"
+#include "BVHPose.h"
+#include "BVHPoseBatch.h"
+#include "BVHPoseCache.h"
+#include "BVHProfiler.h"
+#include "BVHThreadPool.h"
+
+using namespace std;
+
+// Error bounds of the compression table: degrees of joint rotation, and
+// units of position channels
+static const float g_compressAngle = 0.5f;
+static const float g_compressPosition = 0.05f;
+
+// Clips bundled with BVHTester, used when no files are given
+static const char * g_defaultClips[] =
+{
+	"Example1.bvh", "Jog.bvh", "Legs.bvh", "Stand.bvh", "Turn.bvh", "tiptoe.bvh", "wave.bvh"
+};
+
+// The ways BVHPoseCache is measured playing each clip: at full speed and
+// held on frames at a quarter speed, exactly, then interpolated with a
+// tolerance in degrees and position units
+static const struct
+{
+	const char *				mode;
+	float						rate;
+	float						tolerance;
+	bool						interpolate;
+}
+g_cacheModes[] =
+{
+	{ "1x exact", 1.0f, 0.0f, false },
+	{ "0.25x exact", 0.25f, 0.0f, false },
+	{ "1x lerp 0.05", 1.0f, 0.05f, true }
+};
+
+// Clips of the blend tree checks and timings: a cross-fade from the first
+// to the second, with the third layered over the upper body
+static const char * g_blendClips[] = { "Stand.bvh", "Jog.bvh", "wave.bvh" };
+
+/// <summary>
+/// Stands in for a section parser that takes the line buffer by value.
+/// </summary>
+static size_t CountLines( vector<string> lines )
+{
+	return lines.size();
+}
+
+/// <summary>
+/// The line buffer loading that BVHFigure::ReadBVH used before the file was
+/// memory mapped: every line is read into its own string, then the vector
+/// is copied into the hierarchy and motion parsers.
+/// </summary>
+static size_t LoadLineBuffer( const char * fileName )
+{
+	ifstream bvhFile( fileName );
+	if( !bvhFile.is_open() )
+		return 0;
+
+	string line;
+	vector<string> lines;
+
+	while( !bvhFile.eof() )
+	{
+		getline( bvhFile, line );
+		lines.push_back( line );
+	}
+
+	return CountLines( lines ) + CountLines( lines );
+}
+
+/// <summary>
+/// Maps the file and splits it into lines in place.
+/// </summary>
+static size_t LoadMapped( const char * fileName )
+{
+	BVHFile bvhFile;
+	if( FAILED( bvhFile.Open( fileName ) ) )
+		return 0;
+
+	BVHReader reader( bvhFile.GetData(), bvhFile.GetData() + bvhFile.GetSize() );
+	BVHToken line;
+	size_t numLines = 0;
+
+	while( reader.NextLine( &line ) )
+		++numLines;
+
+	return numLines;
+}
+
+/// <summary>
+/// Parses the clip, ignoring its cache file.
+/// </summary>
+static size_t LoadClip( const char * fileName )
+{
+	BVHClip clip;
+	return SUCCEEDED( clip.ReadBVH( fileName, false ) ) ? 1 : 0;
+}
+
+/// <summary>
+/// Loads the clip from its cache file.
+/// </summary>
+static size_t LoadClipCached( const char * fileName )
+{
+	BVHClip clip;
+	return SUCCEEDED( clip.ReadBVH( fileName ) ) ? 1 : 0;
+}
+
+/// <summary>
+/// Times EvaluatePose on every frame of a clip.
+/// </summary>
+/// <returns>Average microseconds per pose, or -1 if the clip could not be loaded.</returns>
+static double TimeEvaluatePose( const char * fileName, int iterations )
+{
+	BVHClip clip;
+	if( FAILED( clip.ReadBVH( fileName ) ) )
+		return -1.0;
+
+	vector<BVHMatrix> pose( clip.GetSkeleton().GetNumJoints() );
+	int numPoses = iterations * clip.GetNumFrames();
+
+	double start = BVHGetSeconds();
+	for( int i = 0; i < numPoses; ++i )
+	{
+		EvaluatePose( clip, ( i % clip.GetNumFrames() ) * clip.GetFrameTime(), &pose[0] );
+	}
+	return ( BVHGetSeconds() - start ) * 1000000.0 / numPoses;
+}
+
+/// <summary>
+/// Returns the largest difference between matrices and transforms.
+/// </summary>
+static double MaxError( const BVHMatrix * matrices, const BVHAffine * transforms, int count )
+{
+	double maxError = 0;
+	for( int p = 0; p < count; ++p )
+	{
+		BVHMatrix matrix;
+		BVHMatrixFromAffine( &matrix, &transforms[p] );
+		for( int r = 0; r < 4; ++r )
+		{
+			for( int c = 0; c < 4; ++c )
+			{
+				double error = fabs( ( double )matrix.m[r][c] - matrices[p].m[r][c] );
+				if( error > maxError )
+					maxError = error;
+			}
+		}
+	}
+	return maxError;
+}
+
+/// <summary>
+/// Times forward kinematics on every frame of a clip, one pose at a time
+/// with BVHSkeleton::EvaluatePose and a lane of poses at a time with
+/// BVHPoseBatch, and compares their results. Then times BVHPoseBatch on
+/// poses blended part way to the next frame, and compares that with the
+/// blended BVHSkeleton::EvaluatePose.
+/// </summary>
+/// <param name='scalar'>Set to millions of joints per second with BVHSkeleton::EvaluatePose.</param>
+/// <param name='batch'>Set to millions of joints per second with BVHPoseBatch.</param>
+/// <param name='blend'>Set to millions of joints per second with BVHPoseBatch blending frames.</param>
+/// <returns>The largest difference between the two, or -1 if the clip could not be loaded.</returns>
+static double TimeJoints( const char * fileName, int iterations, double * scalar, double * batch, double * blend )
+{
+	*scalar = *batch = *blend = 0;
+
+	BVHClip clip;
+	if( FAILED( clip.ReadBVH( fileName ) ) || clip.GetNumFrames() == 0 )
+		return -1.0;
+
+	const BVHSkeleton & skeleton = clip.GetSkeleton();
+	int numJoints = skeleton.GetNumJoints();
+	int numFrames = clip.GetNumFrames();
+
+	BVHMatrix world;
+	BVHMatrixIdentity( &world );
+
+	// Each frame of the clip stands in for a different figure
+	vector<const float *> frames( numFrames );
+	vector<const float *> nextFrames( numFrames );
+	vector<float> weights( numFrames );
+	vector<const BVHMatrix *> roots( numFrames, &world );
+	for( int f = 0; f < numFrames; ++f )
+	{
+		frames[f] = clip.GetFrame( f );
+		nextFrames[f] = clip.GetFrame( ( f + 1 ) % numFrames );
+		weights[f] = ( f % 7 + 1 ) / 8.0f;
+	}
+
+	vector<BVHMatrix> matrices( numFrames * numJoints );
+	vector<BVHAffine> transforms( numFrames * numJoints );
+	vector<BVHAffine *> poses( numFrames );
+	for( int f = 0; f < numFrames; ++f )
+		poses[f] = &transforms[f * numJoints];
+
+	BVHPoseBatch poseBatch( skeleton );
+	double numJointsTimed = ( double )iterations * numFrames * numJoints;
+
+	double start = BVHGetSeconds();
+	for( int i = 0; i < iterations; ++i )
+	{
+		for( int f = 0; f < numFrames; ++f )
+			skeleton.EvaluatePose( frames[f], world, &matrices[f * numJoints] );
+	}
+	*scalar = numJointsTimed / ( ( BVHGetSeconds() - start ) * 1000000.0 );
+
+	start = BVHGetSeconds();
+	for( int i = 0; i < iterations; ++i )
+		poseBatch.Evaluate( &frames[0], &roots[0], numFrames, &poses[0] );
+	*batch = numJointsTimed / ( ( BVHGetSeconds() - start ) * 1000000.0 );
+
+	double maxError = MaxError( &matrices[0], &transforms[0], numFrames * numJoints );
+
+	start = BVHGetSeconds();
+	for( int i = 0; i < iterations; ++i )
+		poseBatch.Evaluate( &frames[0], &nextFrames[0], &weights[0], &roots[0], numFrames, &poses[0] );
+	*blend = numJointsTimed / ( ( BVHGetSeconds() - start ) * 1000000.0 );
+
+	for( int f = 0; f < numFrames; ++f )
+		skeleton.EvaluatePose( frames[f], nextFrames[f], weights[f], world, &matrices[f * numJoints] );
+
+	double blendError = MaxError( &matrices[0], &transforms[0], numFrames * numJoints );
+	return blendError > maxError ? blendError : maxError;
+}
+
+/// <summary>
+/// Times BVHCrowd::Update on a crowd playing every clip in turn.
+/// </summary>
+/// <returns>Figures posed per millisecond, or -1 if no clip could be played.</returns>
+static double TimeCrowd( const vector<const char *> & clips, int numFigures, BVHThreadPool * pool, int iterations )
+{
+	BVHCrowd crowd( pool );
+	BVHMatrix root;
+
+	for( int i = 0; i < numFigures; ++i )
+	{
+		// Each clip is loaded once, through BVHClipCache
+		BVHFigure figure;
+		if( FAILED( figure.ReadBVH( clips[i % clips.size()] ) ) )
+			continue;
+
+		BVHMatrixTranslation( &root, ( float )( i % 100 ), 0.0f, ( float )( i / 100 ) );
+		figure.SetWorld( root );
+		figure.SetTimeOffset( i * 0.37f );
+		figure.SetRate( 0.8f + 0.1f * ( i % 5 ) );
+		crowd.AddFigure( figure );
+	}
+
+	if( crowd.GetNumFigures() == 0 )
+		return -1.0;
+
+	// The first update also groups the figures by clip
+	crowd.Update( 0 );
+
+	double start = BVHGetSeconds();
+	for( int i = 0; i < iterations; ++i )
+	{
+		crowd.Update( i / 30.0f );
+		BVH_PROFILE_FRAME();
+	}
+	return crowd.GetNumFigures() * iterations / ( ( BVHGetSeconds() - start ) * 1000.0 );
+}
+
+// What compressing a clip costs and saves, see MeasureCompression
+struct CompressionResult
+{
+	size_t						rawSize;		// Bytes of motion data in BVHClip
+	size_t						size;			// Bytes of BVHCompressedClip
+	double						keys;			// Fraction of samples kept as keys
+	double						channelAngle;	// Largest rotation channel error, degrees
+	double						jointAngle;		// Largest joint rotation error, degrees
+	double						channelPosition;	// Largest position channel error
+	double						worldPosition;	// Largest error in a joint's world position
+	double						decode;			// Microseconds to decode the samples at a time
+};
+
+/// <summary>
+/// Compresses a clip, then decodes every frame and measures how far the
+/// joints moved, and how long decoding at a random time takes.
+/// </summary>
+/// <returns>False if the clip could not be loaded or compressed.</returns>
+static bool MeasureCompression( const char * fileName, int iterations, CompressionResult * result )
+{
+	BVHClip clip;
+	BVHCompressedClip compressed;
+	if( FAILED( clip.ReadBVH( fileName ) ) || clip.GetNumFrames() == 0 ||
+		FAILED( compressed.Compress( clip, g_compressAngle, g_compressPosition ) ) )
+		return false;
+
+	const BVHSkeleton & skeleton = clip.GetSkeleton();
+	int numJoints = skeleton.GetNumJoints();
+	int numFrames = clip.GetNumFrames();
+
+	result->rawSize = ( size_t )numFrames * clip.GetNumChannels() * sizeof( float );
+	result->size = compressed.GetSize();
+	result->keys = compressed.GetNumKeys() / ( ( double )numFrames * clip.GetNumChannels() );
+	result->channelAngle = compressed.GetMaxAngleError();
+	result->channelPosition = compressed.GetMaxPositionError();
+	result->jointAngle = 0;
+	result->worldPosition = 0;
+
+	BVHMatrix world;
+	BVHMatrixIdentity( &world );
+
+	vector<float> samples( clip.GetNumChannels() + 1 );
+	vector<BVHMatrix> pose( numJoints ), decodedPose( numJoints );
+
+	for( int f = 0; f < numFrames; ++f )
+	{
+		compressed.DecodeFrame( f, &samples[0] );
+		skeleton.EvaluatePose( clip.GetFrame( f ), world, &pose[0] );
+		skeleton.EvaluatePose( &samples[0], world, &decodedPose[0] );
+
+		for( int j = 0; j < numJoints; ++j )
+		{
+			if( skeleton.GetNumJointChannels( j ) > 0 )
+			{
+				BVHQuaternion a = skeleton.GetRotationQuaternion( j, clip.GetFrame( f ) );
+				BVHQuaternion b = skeleton.GetRotationQuaternion( j, &samples[0] );
+				// The angle of the rotation from a to b, from both parts of the quaternion
+				// since an acos of the dot product loses precision near 1
+				double w = ( double )a.w * b.w + ( double )a.x * b.x + ( double )a.y * b.y + ( double )a.z * b.z;
+				double x = ( double )a.w * b.x - ( double )a.x * b.w - ( double )a.y * b.z + ( double )a.z * b.y;
+				double y = ( double )a.w * b.y + ( double )a.x * b.z - ( double )a.y * b.w - ( double )a.z * b.x;
+				double z = ( double )a.w * b.z - ( double )a.x * b.y + ( double )a.y * b.x - ( double )a.z * b.w;
+				double angle = 2.0 * atan2( sqrt( x * x + y * y + z * z ), fabs( w ) ) * 180.0 / BVH_PI;
+				result->jointAngle = max( result->jointAngle, angle );
+			}
+
+			double dx = pose[j]._41 - decodedPose[j]._41;
+			double dy = pose[j]._42 - decodedPose[j]._42;
+			double dz = pose[j]._43 - decodedPose[j]._43;
+			result->worldPosition = max( result->worldPosition, sqrt( dx * dx + dy * dy + dz * dz ) );
+		}
+	}
+
+	// Quarter frames in a scattered order, so each decode is a random
+	// access, blended between frames as a figure playing the clip does
+	int numDecodes = iterations * numFrames;
+	double start = BVHGetSeconds();
+	for( int i = 0; i < numDecodes; ++i )
+		compressed.DecodeTime( ( ( i * 7919LL ) % ( 4 * numFrames ) ) * 0.25f * clip.GetFrameTime(), &samples[0] );
+	result->decode = ( BVHGetSeconds() - start ) * 1000000.0 / numDecodes;
+
+	return true;
+}
+
+/// <summary>
+/// Plays a clip through a BVHClipStream with blocks so small that the
+/// window is reloaded many times, and compares every pair of frames it
+/// returns with the loaded clip: forwards over several loops, then at
+/// scattered times both sides of zero.
+/// </summary>
+/// <param name='useCache'>True to stream from the cache file, false from the text.</param>
+/// <param name='numChecked'>Set to the number of times compared.</param>
+/// <returns>The number of times whose frames did not match, or -1 if the clip could not be opened.</returns>
+static int VerifyStream( const char * fileName, bool useCache, int * numChecked )
+{
+	*numChecked = 0;
+
+	BVHClip clip;
+	BVHClipStream stream;
+	if( FAILED( clip.ReadBVH( fileName, useCache ) ) || FAILED( stream.Open( fileName, 16, 3, useCache ) ) )
+		return -1;
+
+	if( stream.GetNumFrames() != clip.GetNumFrames() || stream.GetNumChannels() != clip.GetNumChannels() )
+		return -1;
+
+	BVHFigure figure;
+	figure.SetStream( &stream );
+	figure.SetInterpolate( true );
+
+	int numFrames = clip.GetNumFrames();
+	int numSteps = numFrames * 8;
+	int numMismatches = 0;
+	size_t rowSize = clip.GetNumChannels() * sizeof( float );
+
+	for( int i = 0; i < numSteps + 200; ++i )
+	{
+		float frames = i < numSteps ? i * 0.37f : ( ( i * 7919 ) % ( 2 * numFrames ) - numFrames ) + 0.25f;
+		figure.Update( frames * clip.GetFrameTime() );
+
+		const float * frame = NULL;
+		const float * nextFrame = NULL;
+		float weight = figure.GetFrames( &frame, &nextFrame );
+
+		int index = 0, nextIndex = 0;
+		float expected = clip.GetFrameIndices( figure.GetClipTime(), &index, &nextIndex );
+
+		++*numChecked;
+		if( rowSize > 0 && ( frame == NULL || nextFrame == NULL ||
+			memcmp( frame, clip.GetFrame( index ), rowSize ) != 0 ||
+			memcmp( nextFrame, clip.GetFrame( nextIndex ), rowSize ) != 0 || weight != expected ) )
+		{
+			if( numMismatches < 10 )
+				printf( "  %s: frame %d does not match\n", fileName, index );
+			++numMismatches;
+		}
+	}
+
+	return numMismatches;
+}
+
+/// <summary>
+/// Writes a long clip: the hierarchy of a BVH file followed by its frames
+/// repeated a number of times.
+/// </summary>
+/// <returns>The number of frames written, or 0 if the file could not be read or written.</returns>
+static int WriteLongClip( const char * fileName, int repeats, const char * longFileName )
+{
+	BVHFile bvhFile;
+	if( FAILED( bvhFile.Open( fileName ) ) )
+		return 0;
+
+	const char * data = bvhFile.GetData();
+	BVHReader reader( data, data + bvhFile.GetSize() );
+	BVHSkeleton skeleton;
+	int numFrames = 0;
+	float frameTime = 0;
+
+	if( FAILED( BVHClip::ParseHeader( &reader, &skeleton, &numFrames, &frameTime ) ) )
+		return 0;
+
+	static const char motion[] = "MOTION";
+	const char * hierarchyEnd = search( data, reader.GetPosition(), motion, motion + 6 );
+	string frames( reader.GetPosition(), reader.GetEnd() );
+	if( frames.empty() || frames[frames.size() - 1] != '\n' )
+		frames.push_back( '\n' );
+
+	FILE * file = fopen( longFileName, "wb" );
+	if( file == NULL )
+		return 0;
+
+	fwrite( data, 1, hierarchyEnd - data, file );
+	fprintf( file, "MOTION\nFrames: %d\nFrame Time: %.9g\n", numFrames * repeats, frameTime );
+	for( int r = 0; r < repeats; ++r )
+		fwrite( frames.data(), 1, frames.size(), file );
+
+	return fclose( file ) == 0 ? numFrames * repeats : 0;
+}
+
+struct StreamResult
+{
+	bool						binary;			// Read from the cache file
+	int							numFrames;
+	size_t						clipSize;		// Bytes of the loaded clip's frames
+	size_t						residentSize;	// Bytes the stream holds
+	int							numLoads;
+	double						stalls;			// Fraction of updates that waited for the loader
+	double						update;			// Microseconds per update, loading included
+};
+
+/// <summary>
+/// Plays a clip through a BVHClipStream twice over, a frame per update as
+/// fast as the blocks load, and measures what the stream holds and how
+/// long each update takes.
+/// </summary>
+/// <returns>False if the clip could not be opened.</returns>
+static bool MeasureStream( const char * fileName, bool useCache, StreamResult * result )
+{
+	BVHClipStream stream;
+	if( FAILED( stream.Open( fileName, 256, 8, useCache ) ) )
+		return false;
+
+	BVHFigure figure;
+	figure.SetStream( &stream );
+
+	vector<BVHMatrix> pose( stream.GetSkeleton().GetNumJoints() );
+	int numUpdates = 2 * stream.GetNumFrames();
+
+	double start = BVHGetSeconds();
+	for( int i = 0; i < numUpdates; ++i )
+	{
+		figure.Update( ( i + 0.5f ) * stream.GetFrameTime() );
+		figure.EvaluatePose( &pose[0] );
+	}
+	result->update = ( BVHGetSeconds() - start ) * 1000000.0 / numUpdates;
+
+	result->binary = stream.IsBinary();
+	result->numFrames = stream.GetNumFrames();
+	result->clipSize = ( size_t )stream.GetNumFrames() * stream.GetNumChannels() * sizeof( float );
+	result->residentSize = stream.GetResidentSize();
+	result->numLoads = stream.GetNumLoads();
+	result->stalls = stream.GetNumStalls() / ( double )numUpdates;
+
+	return true;
+}
+
+/// <summary>
+/// Returns the size of a file in bytes, 0 if it cannot be opened.
+/// </summary>
+static size_t FileSize( const char * fileName )
+{
+	BVHFile bvhFile;
+	return SUCCEEDED( bvhFile.Open( fileName ) ) ? bvhFile.GetSize() : 0;
+}
+
+/// <summary>
+/// Prints a row of the streaming table.
+/// </summary>
+static void PrintStream( const char * name, const char * fileName, bool useCache )
+{
+	StreamResult result;
+	if( !MeasureStream( fileName, useCache, &result ) )
+	{
+		printf( "%-16s failed\n", name );
+		return;
+	}
+
+	printf( "%-16s %7s %10d %10.1f %10.1f %8d %7.1f%% %10.2f\n", name, result.binary ? "cache" : "text",
+		result.numFrames, result.clipSize / 1024.0, result.residentSize / 1024.0, result.numLoads,
+		result.stalls * 100.0, result.update );
+}
+
+/// <summary>
+/// Compares BVHReader::ParseFloat with strtod on every number in a clip.
+/// </summary>
+/// <param name='numValues'>Set to the number of values compared.</param>
+/// <returns>The number of values that did not match bit for bit.</returns>
+static size_t VerifyParseFloat( const char * fileName, size_t * numValues )
+{
+	*numValues = 0;
+
+	BVHFile bvhFile;
+	if( FAILED( bvhFile.Open( fileName ) ) )
+		return 1;
+
+	BVHReader reader( bvhFile.GetData(), bvhFile.GetData() + bvhFile.GetSize() );
+	BVHToken line, token;
+	size_t numMismatches = 0;
+
+	while( reader.NextLine( &line ) )
+	{
+		while( BVHReader::NextToken( &line, &token ) )
+		{
+			// Only tokens that are numbers to strtod
+			string text( token.begin, token.end );
+			char * textEnd = NULL;
+			float expected = ( float )strtod( text.c_str(), &textEnd );
+			if( textEnd != text.c_str() + text.length() )
+				continue;
+
+			const char * p = token.begin;
+			float actual = 0;
+			bool parsed = BVHReader::ParseFloat( &p, token.end, &actual );
+
+			++*numValues;
+			if( !parsed || p != token.end || memcmp( &expected, &actual, sizeof( float ) ) != 0 )
+			{
+				if( numMismatches < 10 )
+					printf( "  %s: '%s' strtod %.9g ParseFloat %.9g\n", fileName, text.c_str(), expected, actual );
+				++numMismatches;
+			}
+		}
+	}
+
+	return numMismatches;
+}
+
+/// <summary>
+/// Returns the rotation a BVH joint lists as CHANNELS, built one axis at a
+/// time: the channel listed last turns a point first, so each row of the
+/// matrix is its basis vector turned by the last channel, then the one
+/// before it, and so on.
+/// </summary>
+static BVHMatrix ReferenceRotation( const Channel * channels, const float * degrees, int numChannels )
+{
+	BVHMatrix rotation;
+	BVHMatrixIdentity( &rotation );
+
+	for( int i = numChannels - 1; i >= 0; --i )
+	{
+		BVHMatrix axis;
+		float angle = degrees[i] * ( BVH_PI / 180.0f );
+		if( channels[i] == Xrotation )
+			BVHMatrixRotationX( &axis, angle );
+		else if( channels[i] == Yrotation )
+			BVHMatrixRotationY( &axis, angle );
+		else
+			BVHMatrixRotationZ( &axis, angle );
+
+		rotation = rotation * axis;
+	}
+	return rotation;
+}
+
+/// <summary>
+/// Poses a two joint skeleton with each of the six rotation orders and
+/// random angles, and compares BVHSkeleton and BVHPoseBatch, plain and
+/// blended, with poses built by ReferenceRotation.
+/// </summary>
+/// <returns>The number of orders that did not match.</returns>
+static int VerifyRotationOrders()
+{
+	static const char * names[6] = { "XYZ", "XZY", "YXZ", "YZX", "ZXY", "ZYX" };
+	const int numFrames = 64;
+	int numFailed = 0;
+
+	srand( 1 );
+
+	for( int order = 0; order < 6; ++order )
+	{
+		Channel rotations[3];
+		for( int i = 0; i < 3; ++i )
+		{
+			int axis = BVHSkeleton::GetRotationAxes( ( RotationOrder )order )[i];
+			rotations[i] = axis == 0 ? Xrotation : axis == 1 ? Yrotation : Zrotation;
+		}
+
+		// A root with a position and a rotation, and a child with a rotation
+		BVHSkeleton skeleton;
+		skeleton.AddJoint( "Hips", -1 );
+		skeleton.AddJoint( "Chest", 0 );
+		skeleton.SetOffset( 1, BVHVector3( 1.5f, 10.0f, -2.0f ) );
+		skeleton.AddChannel( 0, Xposition );
+		skeleton.AddChannel( 0, Yposition );
+		skeleton.AddChannel( 0, Zposition );
+		for( int j = 0; j < 2; ++j )
+			for( int i = 0; i < 3; ++i )
+				skeleton.AddChannel( j, rotations[i] );
+
+		if( skeleton.GetRotationOrder( 0 ) != order || skeleton.GetRotationOrder( 1 ) != order )
+		{
+			printf( "  %s: parsed as order %d\n", names[order], ( int )skeleton.GetRotationOrder( 0 ) );
+			++numFailed;
+			continue;
+		}
+
+		vector<float> data( numFrames * 9 );
+		for( size_t i = 0; i < data.size(); ++i )
+			data[i] = ( rand() / ( float )RAND_MAX ) * 360.0f - 180.0f;
+
+		BVHMatrix world;
+		BVHMatrixIdentity( &world );
+
+		vector<const float *> frames( numFrames );
+		vector<float> weights( numFrames, 0.0f );
+		vector<BVHMatrix> reference( numFrames * 2 ), matrices( numFrames * 2 ), blended( numFrames * 2 );
+		vector<BVHAffine> transforms( numFrames * 2 ), blendedTransforms( numFrames * 2 );
+		vector<BVHAffine *> poses( numFrames ), blendedPoses( numFrames );
+
+		for( int f = 0; f < numFrames; ++f )
+		{
+			const float * frame = &data[f * 9];
+			frames[f] = frame;
+			poses[f] = &transforms[f * 2];
+			blendedPoses[f] = &blendedTransforms[f * 2];
+
+			BVHMatrix root = ReferenceRotation( rotations, frame + 3, 3 );
+			root._41 = frame[0];
+			root._42 = frame[1];
+			root._43 = frame[2];
+
+			BVHMatrix child = ReferenceRotation( rotations, frame + 6, 3 );
+			child._41 = 1.5f;
+			child._42 = 10.0f;
+			child._43 = -2.0f;
+
+			reference[f * 2] = root;
+			reference[f * 2 + 1] = child * root;
+
+			skeleton.EvaluatePose( frame, world, &matrices[f * 2] );
+			skeleton.EvaluatePose( frame, frame, 0.0f, world, &blended[f * 2] );
+		}
+
+		BVHPoseBatch poseBatch( skeleton );
+		poseBatch.Evaluate( &frames[0], NULL, numFrames, &poses[0] );
+		poseBatch.Evaluate( &frames[0], &frames[0], &weights[0], NULL, numFrames, &blendedPoses[0] );
+
+		double scalarError = 0, blendedError = 0;
+		for( int p = 0; p < numFrames * 2; ++p )
+		{
+			for( int r = 0; r < 4; ++r )
+			{
+				for( int c = 0; c < 4; ++c )
+				{
+					scalarError = max( scalarError, fabs( ( double )matrices[p].m[r][c] - reference[p].m[r][c] ) );
+					blendedError = max( blendedError, fabs( ( double )blended[p].m[r][c] - reference[p].m[r][c] ) );
+				}
+			}
+		}
+		double batchError = MaxError( &reference[0], &transforms[0], numFrames * 2 );
+		double batchBlendedError = MaxError( &reference[0], &blendedTransforms[0], numFrames * 2 );
+
+		bool failed = scalarError > 1e-4 || blendedError > 1e-4 || batchError > 1e-4 || batchBlendedError > 1e-4;
+		printf( "%-16s %10.2g scalar %10.2g blended %10.2g lanes %10.2g lanes blended%s\n", names[order],
+			scalarError, blendedError, batchError, batchBlendedError, failed ? "  FAILED" : "" );
+		if( failed )
+			++numFailed;
+	}
+
+	return numFailed;
+}
+
+/// <summary>
+/// Returns the largest difference between two sets of matrices.
+/// </summary>
+static double MaxMatrixError( const BVHMatrix * a, const BVHMatrix * b, int count )
+{
+	double maxError = 0;
+	for( int p = 0; p < count; ++p )
+	{
+		for( int r = 0; r < 4; ++r )
+		{
+			for( int c = 0; c < 4; ++c )
+				maxError = max( maxError, fabs( ( double )a[p].m[r][c] - b[p].m[r][c] ) );
+		}
+	}
+	return maxError;
+}
+
+/// <summary>
+/// Adds the nodes of the blend tree that is checked and timed: a
+/// cross-fade from g_blendClips[0] to g_blendClips[1], with g_blendClips[2]
+/// layered over the upper body when layered is true. The layer's reference
+/// is its own first frame.
+/// </summary>
+/// <returns>False if a clip could not be loaded.</returns>
+static bool BuildBlendTree( BVHBlendTree * tree, bool layered )
+{
+	int from = tree->AddClip( g_blendClips[0] );
+	int to = tree->AddClip( g_blendClips[1] );
+	if( from < 0 || to < 0 || tree->AddCrossFade( from, to, 0.5f ) < 0 )
+		return false;
+
+	if( !layered )
+		return true;
+
+	int fade = tree->GetNumNodes() - 1;
+	int layer = tree->AddClip( g_blendClips[2] );
+	int reference = tree->AddClip( g_blendClips[2] );
+	if( layer < 0 || reference < 0 )
+		return false;
+
+	tree->SetClipTiming( reference, 0, 0 );
+	int additive = tree->AddAdditive( fade, layer, reference );
+	return additive >= 0 && SUCCEEDED( tree->SetMask( additive, "Chest" ) );
+}
+
+/// <summary>
+/// Prints the result of a blend tree check and counts it if it failed.
+/// </summary>
+static void PrintBlendCheck( const char * name, double error, double tolerance, int * numFailed )
+{
+	bool failed = error > tolerance;
+	printf( "%-28s %10.2g%s\n", name, error, failed ? "  FAILED" : "" );
+	if( failed )
+		++*numFailed;
+}
+
+/// <summary>
+/// Checks BVHBlendTree against figures playing its clips: a tree of one
+/// clip, a cross-fade held at either end, a layer added relative to
+/// itself, an upper body mask, retargeting onto longer bones, and figures
+/// playing trees in a crowd.
+/// </summary>
+/// <returns>The number of checks that failed.</returns>
+static int VerifyBlendTree()
+{
+	BVHFigure from, to, layer;
+	if( FAILED( from.ReadBVH( g_blendClips[0] ) ) || FAILED( to.ReadBVH( g_blendClips[1] ) ) || FAILED( layer.ReadBVH( g_blendClips[2] ) ) )
+	{
+		printf( "Blend tree checks skipped, they need %s, %s and %s\n", g_blendClips[0], g_blendClips[1], g_blendClips[2] );
+		return 0;
+	}
+
+	const BVHSkeleton & skeleton = to.GetClip()->GetSkeleton();
+	int numJoints = skeleton.GetNumJoints();
+	vector<BVHMatrix> expected( numJoints ), actual( numJoints ), scaled( numJoints );
+	int numFailed = 0;
+
+	from.SetInterpolate( true );
+	to.SetInterpolate( true );
+	layer.SetInterpolate( true );
+
+	// Every tree is stepped through two seconds at an uneven rate, so
+	// frames are blended as well as hit exactly
+	double single = 0, ends = 0, identity = 0, masked = 0, retarget = 0;
+	int numMaskedMoved = 0;
+
+	BVHBlendTree one( skeleton );
+	one.AddClip( to.GetClip() );
+
+	BVHBlendTree fade( skeleton );
+	BuildBlendTree( &fade, false );
+
+	BVHBlendTree self( skeleton );
+	int base = self.AddClip( to.GetClip() );
+	int added = self.AddClip( layer.GetClip() );
+	self.AddAdditive( base, added, added );
+
+	BVHBlendTree upper( skeleton );
+	BuildBlendTree( &upper, true );
+	upper.SetWeight( 2, 1 );
+
+	// The same skeleton with every bone a quarter longer
+	BVHSkeleton longer = skeleton;
+	for( int j = 0; j < numJoints; ++j )
+	{
+		BVHVector3 offset = skeleton.GetOffset( j );
+		longer.SetOffset( j, BVHVector3( offset.x * 1.25f, offset.y * 1.25f, offset.z * 1.25f ) );
+	}
+	BVHBlendTree stretched( longer );
+	stretched.AddClip( to.GetClip() );
+
+	for( int i = 0; i < 60; ++i )
+	{
+		float time = i * 0.0337f;
+
+		to.Update( time );
+		to.EvaluatePose( &expected[0] );
+
+		one.Update( time, true );
+		one.EvaluatePose( to.GetWorld(), &actual[0] );
+		single = max( single, MaxMatrixError( &expected[0], &actual[0], numJoints ) );
+
+		stretched.Update( time, true );
+		stretched.EvaluatePose( to.GetWorld(), &scaled[0] );
+		for( int j = 0; j < numJoints; ++j )
+		{
+			for( int c = 0; c < 3; ++c )
+				retarget = max( retarget, fabs( scaled[j].m[3][c] - 1.25 * expected[j].m[3][c] ) );
+		}
+
+		self.Update( time, true );
+		self.EvaluatePose( to.GetWorld(), &actual[0] );
+		identity = max( identity, MaxMatrixError( &expected[0], &actual[0], numJoints ) );
+
+		fade.SetWeight( 2, 1 );
+		fade.Update( time, true );
+		fade.EvaluatePose( to.GetWorld(), &actual[0] );
+		ends = max( ends, MaxMatrixError( &expected[0], &actual[0], numJoints ) );
+
+		// The legs are outside the mask and show the cross-fade alone
+		upper.Update( time, true );
+		upper.EvaluatePose( to.GetWorld(), &actual[0] );
+		int chest = -1;
+		for( int j = 0; j < numJoints; ++j )
+		{
+			if( skeleton.GetName( j ) == "Chest" )
+				chest = j;
+
+			bool inMask = false;
+			for( int k = j; k >= 0; k = skeleton.GetParent( k ) )
+				inMask = inMask || k == chest;
+
+			double error = MaxMatrixError( &expected[j], &actual[j], 1 );
+			if( !inMask )
+				masked = max( masked, error );
+			else if( error > 1e-2 )
+				++numMaskedMoved;
+		}
+
+		from.Update( time );
+		from.EvaluatePose( &expected[0] );
+		fade.SetWeight( 2, 0 );
+		fade.Update( time, true );
+		fade.EvaluatePose( from.GetWorld(), &actual[0] );
+		ends = max( ends, MaxMatrixError( &expected[0], &actual[0], numJoints ) );
+	}
+
+	PrintBlendCheck( "one clip", single, 1e-3, &numFailed );
+	PrintBlendCheck( "cross-fade at 0 and 1", ends, 1e-3, &numFailed );
+	PrintBlendCheck( "layer over itself", identity, 1e-3, &numFailed );
+	PrintBlendCheck( "layer outside mask", masked, 1e-3, &numFailed );
+	PrintBlendCheck( "layer inside mask moved", numMaskedMoved > 0 ? 0.0 : 1.0, 0, &numFailed );
+	PrintBlendCheck( "bones 1.25 times longer", retarget, 1e-2, &numFailed );
+
+	// Fades are linear in tree time
+	fade.SetWeight( 2, 0 );
+	fade.FadeWeight( 2, 1, 1.0f, 2.0f );
+	fade.Update( 2.0f, true );
+	PrintBlendCheck( "fade half way", fabs( fade.GetWeight( 2 ) - 0.5 ), 1e-6, &numFailed );
+
+	// Figures playing copies of a tree in a crowd match the figures alone
+	vector<BVHBlendTree> trees( 5, upper );
+	BVHCrowd crowd;
+	vector<BVHFigure> figures( trees.size() );
+	for( size_t i = 0; i < trees.size(); ++i )
+	{
+		BVHMatrix root;
+		BVHMatrixTranslation( &root, i * 100.0f, 0.0f, 0.0f );
+		figures[i].SetBlendTree( &trees[i] );
+		figures[i].SetWorld( root );
+		figures[i].SetTimeOffset( i * 0.37f );
+		figures[i].SetInterpolate( true );
+		crowd.AddFigure( figures[i] );
+	}
+	crowd.AddFigure( to );
+
+	crowd.Update( 1.3f );
+	double crowdError = 0;
+	for( size_t i = 0; i < figures.size(); ++i )
+	{
+		figures[i].Update( 1.3f );
+		figures[i].EvaluatePose( &actual[0] );
+		crowdError = max( crowdError, MaxError( &actual[0], crowd.GetPose( ( int )i ), numJoints ) );
+	}
+	PrintBlendCheck( "crowd of trees", crowdError, 1e-3, &numFailed );
+
+	return numFailed;
+}
+
+// What a blend tree costs per figure, see TimeBlendTree
+struct BlendResult
+{
+	double						clip;			// Microseconds per figure playing a clip
+	double						tree;			// Microseconds per figure playing a tree of one clip
+	double						fade;			// Microseconds per figure mid cross-fade
+	double						layered;		// Microseconds per figure mid cross-fade with a masked layer
+	double						crowd;			// Figures per millisecond of a crowd playing the layered tree
+};
+
+/// <summary>
+/// Times Update and EvaluatePose of figures playing a clip and blend trees
+/// of growing size, then a crowd of figures each playing a copy of the
+/// layered tree.
+/// </summary>
+/// <returns>False if the clips of the tree could not be loaded.</returns>
+static bool TimeBlendTree( int iterations, BlendResult * result )
+{
+	BVHFigure figure;
+	if( FAILED( figure.ReadBVH( g_blendClips[1] ) ) )
+		return false;
+	figure.SetInterpolate( true );
+
+	const BVHSkeleton & skeleton = figure.GetClip()->GetSkeleton();
+	BVHBlendTree one( skeleton ), fade( skeleton ), layered( skeleton );
+	one.AddClip( figure.GetClip() );
+	if( !BuildBlendTree( &fade, false ) || !BuildBlendTree( &layered, true ) )
+		return false;
+
+	vector<BVHMatrix> pose( skeleton.GetNumJoints() );
+	BVHBlendTree * trees[] = { NULL, &one, &fade, &layered };
+	double * times[] = { &result->clip, &result->tree, &result->fade, &result->layered };
+	int numPoses = iterations * 100;
+
+	for( int t = 0; t < 4; ++t )
+	{
+		BVHFigure player = figure;
+		player.SetBlendTree( trees[t] );
+
+		double start = BVHGetSeconds();
+		for( int i = 0; i < numPoses; ++i )
+		{
+			player.Update( i * 0.0173f );
+			player.EvaluatePose( &pose[0] );
+		}
+		*times[t] = ( BVHGetSeconds() - start ) * 1000000.0 / numPoses;
+	}
+
+	const int numFigures = 1000;
+	vector<BVHBlendTree> copies( numFigures, layered );
+	BVHCrowd crowd;
+	for( int i = 0; i < numFigures; ++i )
+	{
+		BVHMatrix root;
+		BVHMatrixTranslation( &root, ( float )( i % 100 ), 0.0f, ( float )( i / 100 ) );
+		BVHFigure player;
+		player.SetBlendTree( &copies[i] );
+		player.SetWorld( root );
+		player.SetTimeOffset( i * 0.37f );
+		player.SetInterpolate( true );
+		crowd.AddFigure( player );
+	}
+
+	crowd.Update( 0 );
+	double start = BVHGetSeconds();
+	for( int i = 0; i < iterations; ++i )
+		crowd.Update( i / 30.0f );
+	result->crowd = numFigures * iterations / ( ( BVHGetSeconds() - start ) * 1000.0 );
+
+	return true;
+}
+
+/// <summary>
+/// Plays a clip with and without a BVHPoseCache, in step, moving the
+/// figure now and then, and returns the largest difference between their
+/// poses. Then poses figures keeping caches in a crowd and compares them
+/// with the figures alone.
+/// </summary>
+/// <returns>The largest difference, or -1 if the clip could not be loaded.</returns>
+static double VerifyPoseCache( const char * fileName, bool interpolate )
+{
+	BVHFigure plain;
+	if( FAILED( plain.ReadBVH( fileName ) ) || plain.GetClip()->GetNumFrames() == 0 )
+		return -1.0;
+
+	int numJoints = plain.GetClip()->GetSkeleton().GetNumJoints();
+	vector<BVHMatrix> expected( numJoints ), actual( numJoints );
+
+	BVHPoseCache cache;
+	plain.SetInterpolate( interpolate );
+	plain.SetRate( 0.37f );
+	BVHFigure cached = plain;
+	cached.SetPoseCache( &cache );
+
+	double maxError = 0;
+	for( int i = 0; i < 400; ++i )
+	{
+		if( i % 50 == 0 )
+		{
+			BVHMatrix root;
+			BVHMatrixTranslation( &root, i * 1.0f, 0.0f, 0.0f );
+			plain.SetWorld( root );
+			cached.SetWorld( root );
+		}
+
+		plain.Update( i / 60.0f );
+		cached.Update( i / 60.0f );
+		plain.EvaluatePose( &expected[0] );
+		cached.EvaluatePose( &actual[0] );
+		maxError = max( maxError, MaxMatrixError( &expected[0], &actual[0], numJoints ) );
+	}
+
+	vector<BVHPoseCache> caches( 5 );
+	BVHCrowd crowd;
+	for( size_t f = 0; f < caches.size(); ++f )
+	{
+		BVHFigure figure = plain;
+		figure.SetTimeOffset( f * 0.37f );
+		figure.SetPoseCache( &caches[f] );
+		crowd.AddFigure( figure );
+	}
+
+	for( int i = 0; i < 20; ++i )
+	{
+		crowd.Update( i / 60.0f );
+		for( size_t f = 0; f < caches.size(); ++f )
+		{
+			BVHFigure figure = plain;
+			figure.SetTimeOffset( f * 0.37f );
+			figure.Update( i / 60.0f );
+			figure.EvaluatePose( &expected[0] );
+			maxError = max( maxError, MaxError( &expected[0], crowd.GetPose( ( int )f ), numJoints ) );
+		}
+	}
+
+	return maxError;
+}
+
+/// <summary>
+/// Compresses a clip and decodes it at every quarter frame of a loop, and
+/// of a few frames before its start, comparing the samples with those of
+/// the clip blended between the same frames. Then poses figures playing
+/// the compressed clip in a crowd and compares them with the figures alone.
+/// </summary>
+/// <param name='angleError'>Set to the largest rotation channel error, in degrees.</param>
+/// <param name='positionError'>Set to the largest position channel error.</param>
+/// <returns>The largest difference between the crowd and the figures, or -1 if the clip could not be loaded or compressed.</returns>
+static double VerifyCompressedClip( const char * fileName, double * angleError, double * positionError )
+{
+	*angleError = 0;
+	*positionError = 0;
+
+	BVHClip clip;
+	BVHCompressedClip compressed;
+	if( FAILED( clip.ReadBVH( fileName ) ) || clip.GetNumFrames() == 0 ||
+		FAILED( compressed.Compress( clip, g_compressAngle, g_compressPosition ) ) )
+		return -1.0;
+
+	const BVHSkeleton & skeleton = clip.GetSkeleton();
+	int numChannels = clip.GetNumChannels();
+	int numFrames = clip.GetNumFrames();
+	vector<float> samples( numChannels + 1 );
+
+	// Past the last frame the decode blends back to the first
+	for( int i = -32; i < 4 * numFrames + 8; ++i )
+	{
+		float time = i * 0.25f * clip.GetFrameTime();
+		compressed.DecodeTime( time, &samples[0] );
+
+		int frame = 0, nextFrame = 0;
+		float weight = clip.GetFrameIndices( time, &frame, &nextFrame );
+		const float * from = clip.GetFrame( frame );
+		const float * to = clip.GetFrame( nextFrame );
+
+		for( int c = 0; c < numChannels; ++c )
+		{
+			double error = fabs( samples[c] - ( from[c] + ( to[c] - from[c] ) * weight ) );
+			Channel channel = skeleton.GetChannel( c );
+			if( channel == Xrotation || channel == Yrotation || channel == Zrotation )
+				*angleError = max( *angleError, error );
+			else
+				*positionError = max( *positionError, error );
+		}
+	}
+
+	int numJoints = skeleton.GetNumJoints();
+	vector<BVHMatrix> expected( numJoints );
+
+	BVHFigure player;
+	player.SetCompressedClip( &compressed );
+
+	BVHCrowd crowd;
+	for( int f = 0; f < 5; ++f )
+	{
+		BVHMatrix root;
+		BVHMatrixTranslation( &root, f * 100.0f, 0.0f, 0.0f );
+		player.SetWorld( root );
+		player.SetTimeOffset( f * 0.37f );
+		player.SetInterpolate( f % 2 != 0 );
+		crowd.AddFigure( player );
+	}
+
+	double maxError = 0;
+	for( int i = 0; i < 20; ++i )
+	{
+		crowd.Update( i / 60.0f );
+		for( int f = 0; f < crowd.GetNumFigures(); ++f )
+		{
+			BVHFigure alone = crowd.GetFigure( f );
+			alone.Update( i / 60.0f );
+			alone.EvaluatePose( &expected[0] );
+			maxError = max( maxError, MaxError( &expected[0], crowd.GetPose( f ), numJoints ) );
+		}
+	}
+
+	return maxError;
+}
+
+// How a BVHPoseCache does on a clip played one way, see MeasurePoseCache
+struct CacheResult
+{
+	const char *				mode;
+	float						rate;
+	float						tolerance;
+	bool						interpolate;
+	double						localHits;		// Fraction of joints whose local matrix was reused
+	double						worldHits;		// Fraction of joints whose world matrix was reused
+	double						cached;			// Microseconds per figure with the cache
+	double						plain;			// Microseconds per figure without it
+	double						maxError;		// Largest difference in a joint's world position
+};
+
+/// <summary>
+/// Plays a clip at 60 updates a second with and without a BVHPoseCache,
+/// and measures the hit rates, the time per figure of each, and how far
+/// apart their joints end up.
+/// </summary>
+/// <returns>False if the clip could not be loaded.</returns>
+static bool MeasurePoseCache( const char * fileName, int iterations, CacheResult * result )
+{
+	BVHFigure plain;
+	if( FAILED( plain.ReadBVH( fileName ) ) || plain.GetClip()->GetNumFrames() == 0 )
+		return false;
+
+	const BVHClip & clip = *plain.GetClip();
+	int numJoints = clip.GetSkeleton().GetNumJoints();
+	int numUpdates = max( 60, ( int )( clip.GetNumFrames() * clip.GetFrameTime() * 60.0f ) ) * iterations;
+	vector<BVHMatrix> expected( numJoints ), actual( numJoints );
+
+	BVHPoseCache cache( result->tolerance );
+	plain.SetInterpolate( result->interpolate );
+	plain.SetRate( result->rate );
+	BVHFigure cached = plain;
+	cached.SetPoseCache( &cache );
+
+	double start = BVHGetSeconds();
+	for( int i = 0; i < numUpdates; ++i )
+	{
+		plain.Update( i / 60.0f );
+		plain.EvaluatePose( &expected[0] );
+	}
+	result->plain = ( BVHGetSeconds() - start ) * 1000000.0 / numUpdates;
+
+	start = BVHGetSeconds();
+	for( int i = 0; i < numUpdates; ++i )
+	{
+		cached.Update( i / 60.0f );
+		cached.EvaluatePose( &actual[0] );
+	}
+	result->cached = ( BVHGetSeconds() - start ) * 1000000.0 / numUpdates;
+	result->localHits = cache.GetLocalHitRate();
+	result->worldHits = cache.GetWorldHitRate();
+
+	result->maxError = 0;
+	cache.Invalidate();
+	for( int i = 0; i < numUpdates; ++i )
+	{
+		plain.Update( i / 60.0f );
+		cached.Update( i / 60.0f );
+		plain.EvaluatePose( &expected[0] );
+		cached.EvaluatePose( &actual[0] );
+
+		for( int j = 0; j < numJoints; ++j )
+		{
+			for( int c = 0; c < 3; ++c )
+				result->maxError = max( result->maxError, fabs( ( double )expected[j].m[3][c] - actual[j].m[3][c] ) );
+		}
+	}
+
+	return true;
+}
+
+/// <summary>
+/// Times BVHReader::ParseFrames on the MOTION section of a clip.
+/// </summary>
+/// <returns>Average milliseconds per parse, or -1 if the clip could not be parsed.</returns>
+static double TimeParseFrames( const char * fileName, BVHThreadPool * pool, int iterations )
+{
+	BVHFile bvhFile;
+	if( FAILED( bvhFile.Open( fileName ) ) )
+		return -1.0;
+
+	// Find the Frames: count and the line after Frame Time:
+	BVHReader reader( bvhFile.GetData(), bvhFile.GetData() + bvhFile.GetSize() );
+	BVHToken line, token;
+	int numFrames = 0;
+
+	for( ;; )
+	{
+		if( !reader.NextLine( &line ) )
+			return -1.0;
+
+		if( !BVHReader::NextToken( &line, &token ) )
+			continue;
+
+		if( token.Equals( "Frames:" ) && BVHReader::NextToken( &line, &token ) )
+			numFrames = ( int )BVHReader::ParseLong( token );
+		else if( token.Equals( "Frame" ) )
+			break;
+	}
+
+	// The first frame line gives the channel count
+	const char * motion = reader.GetPosition();
+	vector<float> row( 4096 );
+	int numChannels = 0;
+	while( numChannels == 0 && reader.NextLine( &line ) )
+		numChannels = BVHReader::ParseFloats( line, &row[0], ( int )row.size() );
+
+	if( numFrames <= 0 || numChannels <= 0 )
+		return -1.0;
+
+	vector<float> data( numFrames * numChannels );
+
+	double start = BVHGetSeconds();
+	for( int i = 0; i < iterations; ++i )
+	{
+		if( BVHReader::ParseFrames( motion, reader.GetEnd(), &data[0], numFrames, numChannels, pool ) != numFrames )
+			return -1.0;
+	}
+	return ( BVHGetSeconds() - start ) * 1000.0 / iterations;
+}
+
+/// <summary>
+/// Runs a loader a number of times and returns the average milliseconds per load.
+/// </summary>
+static double TimeLoad( size_t ( *load )( const char * ), const char * fileName, int iterations )
+{
+	double start = BVHGetSeconds();
+	for( int i = 0; i < iterations; ++i )
+	{
+		if( load( fileName ) == 0 )
+			return -1.0;
+	}
+	return ( BVHGetSeconds() - start ) * 1000.0 / iterations;
+}
+
+/// <summary>
+/// Times the two stages of parsing a clip's text separately: everything
+/// before the first frame, which is mostly the hierarchy, then the frames,
+/// on the shared thread pool as BVHClip::ReadBVH parses them.
+/// </summary>
+/// <param name='hierarchy'>Set to average milliseconds per BVHClip::ParseHeader.</param>
+/// <param name='motion'>Set to average milliseconds per BVHReader::ParseFrames.</param>
+/// <returns>False if the clip could not be parsed.</returns>
+static bool TimeParseStages( const char * fileName, int iterations, double * hierarchy, double * motion )
+{
+	*hierarchy = *motion = -1.0;
+
+	BVHFile bvhFile;
+	if( FAILED( bvhFile.Open( fileName ) ) )
+		return false;
+
+	const char * end = bvhFile.GetData() + bvhFile.GetSize();
+	const char * frames = NULL;
+	BVHSkeleton skeleton;
+	int numFrames = 0;
+	float frameTime = 0;
+
+	double start = BVHGetSeconds();
+	for( int i = 0; i < iterations; ++i )
+	{
+		BVHReader reader( bvhFile.GetData(), end );
+		skeleton.Clear();
+		if( FAILED( BVHClip::ParseHeader( &reader, &skeleton, &numFrames, &frameTime ) ) )
+			return false;
+		frames = reader.GetPosition();
+	}
+	*hierarchy = ( BVHGetSeconds() - start ) * 1000.0 / iterations;
+
+	int numChannels = skeleton.GetNumChannels();
+	vector<float> data( ( size_t )numFrames * numChannels + 1 );
+
+	start = BVHGetSeconds();
+	for( int i = 0; i < iterations && numChannels > 0; ++i )
+	{
+		if( BVHReader::ParseFrames( frames, end, &data[0], numFrames, numChannels, BVHThreadPool::GetShared() ) < numFrames )
+			return false;
+	}
+	*motion = ( BVHGetSeconds() - start ) * 1000.0 / iterations;
+
+	return true;
+}
+
+/// <summary>
+/// Adds the .bvh files in a directory to a list, sorted by name.
+/// </summary>
+/// <returns>False if the directory could not be read.</returns>
+static bool ListClips( const string & directory, vector<string> * fileNames )
+{
+	vector<string> found;
+
+#ifdef _WIN32
+	WIN32_FIND_DATAA data;
+	HANDLE find = FindFirstFileA( ( directory + "\\*" ).c_str(), &data );
+	if( find == INVALID_HANDLE_VALUE )
+		return false;
+
+	do
+	{
+		if( ( data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY ) == 0 )
+			found.push_back( data.cFileName );
+	} while( FindNextFileA( find, &data ) );
+
+	FindClose( find );
+#else
+	DIR * dir = opendir( directory.c_str() );
+	if( dir == NULL )
+		return false;
+
+	for( struct dirent * entry = readdir( dir ); entry != NULL; entry = readdir( dir ) )
+		found.push_back( entry->d_name );
+
+	closedir( dir );
+#endif
+
+	// Matched here rather than by a wildcard, which on Windows also finds .bvhc files
+	sort( found.begin(), found.end() );
+	for( size_t i = 0; i < found.size(); ++i )
+	{
+		const string & name = found[i];
+		if( name.size() > 4 && name.compare( name.size() - 4, 4, ".bvh" ) == 0 )
+			fileNames->push_back( directory + "/" + name );
+	}
+
+	return true;
+}
+
+/// <summary>
+/// Returns true if a path names a directory.
+/// </summary>
+static bool IsDirectory( const char * path )
+{
+	struct stat attributes;
+	return stat( path, &attributes ) == 0 && ( attributes.st_mode & S_IFMT ) == S_IFDIR;
+}
+
+// Everything measured about one clip, printed in the tables and written by -json
+struct ClipResult
+{
+	const char *				fileName;
+	size_t						fileSize;
+	int							numFrames;
+	int							numJoints;
+	int							numChannels;
+	size_t						memory;			// BVHClip::GetSize
+	double						lineBuffer;		// Milliseconds per load, see the Load functions
+	double						mapped;
+	double						parsed;
+	double						hierarchy;		// Milliseconds per stage, see TimeParseStages
+	double						motion;
+	double						cached;
+	double						pose;			// Microseconds per figure, see TimeEvaluatePose
+	double						scalar;			// Millions of joints per second, see TimeJoints
+	double						batch;
+	double						blend;
+	double						maxError;
+	bool						compressed;
+	CompressionResult			compression;
+	vector<double>				motionThreads;	// Milliseconds per TimeParseFrames with each pool
+	vector<CacheResult>			cache;			// One per g_cacheModes, empty if the clip failed
+};
+
+/// <summary>
+/// Writes a number to a JSON file, or null for a failed measurement.
+/// </summary>
+static void WriteJsonNumber( FILE * file, double value )
+{
+	if( value < 0 || value != value )
+		fprintf( file, "null" );
+	else
+		fprintf( file, "%.6g", value );
+}
+
+/// <summary>
+/// Writes a string to a JSON file, quoted and escaped.
+/// </summary>
+static void WriteJsonString( FILE * file, const char * text )
+{
+	fputc( '"', file );
+	for( const char * p = text; *p != '\0'; ++p )
+	{
+		if( *p == '"' || *p == '\\' )
+			fprintf( file, "\\%c", *p );
+		else if( ( unsigned char )*p < 0x20 )
+			fprintf( file, "\\u%04x", *p );
+		else
+			fputc( *p, file );
+	}
+	fputc( '"', file );
+}
+
+/// <summary>
+/// Writes a list of numbers to a JSON file.
+/// </summary>
+static void WriteJsonArray( FILE * file, const vector<double> & values )
+{
+	fprintf( file, "[" );
+	for( size_t i = 0; i < values.size(); ++i )
+	{
+		fprintf( file, i > 0 ? ", " : "" );
+		WriteJsonNumber( file, values[i] );
+	}
+	fprintf( file, "]" );
+}
+
+/// <summary>
+/// Writes every measurement as JSON, so runs can be compared by a script.
+/// Times are in milliseconds or microseconds as their names say, sizes in
+/// bytes, and failed measurements are null.
+/// </summary>
+/// <returns>False if the file could not be written.</returns>
+static bool WriteJson( const char * jsonFileName, int iterations, const vector<ClipResult> & results, const BlendResult * blend,
+	const vector<int> & threadCounts, const int * crowdSizes, const vector< vector<double> > & crowdRates )
+{
+	FILE * file = fopen( jsonFileName, "w" );
+	if( file == NULL )
+		return false;
+
+	fprintf( file, "{\n\t\"iterations\": %d,\n\t\"processors\": %d,\n\t\"lanes\": %d,\n\t\"threads\": [",
+		iterations, BVHThreadPool::GetNumProcessors(), BVHPoseBatch::GetNumLanes() );
+	for( size_t t = 0; t < threadCounts.size(); ++t )
+		fprintf( file, t > 0 ? ", %d" : "%d", threadCounts[t] );
+	fprintf( file, "],\n\t\"clips\": [\n" );
+
+	for( size_t i = 0; i < results.size(); ++i )
+	{
+		const ClipResult & r = results[i];
+
+		fprintf( file, "\t\t{\n\t\t\t\"file\": " );
+		WriteJsonString( file, r.fileName );
+		fprintf( file, ",\n\t\t\t\"bytes\": %lu,\n\t\t\t\"frames\": %d,\n\t\t\t\"joints\": %d,\n\t\t\t\"channels\": %d,\n\t\t\t\"memory_bytes\": %lu,\n",
+			( unsigned long )r.fileSize, r.numFrames, r.numJoints, r.numChannels, ( unsigned long )r.memory );
+
+		fprintf( file, "\t\t\t\"load_ms\": { \"lines\": " );
+		WriteJsonNumber( file, r.lineBuffer );
+		fprintf( file, ", \"mapped\": " );
+		WriteJsonNumber( file, r.mapped );
+		fprintf( file, ", \"read\": " );
+		WriteJsonNumber( file, r.parsed );
+		fprintf( file, ", \"hierarchy\": " );
+		WriteJsonNumber( file, r.hierarchy );
+		fprintf( file, ", \"motion\": " );
+		WriteJsonNumber( file, r.motion );
+		fprintf( file, ", \"cached\": " );
+		WriteJsonNumber( file, r.cached );
+
+		fprintf( file, " },\n\t\t\t\"pose\": { \"figure_us\": " );
+		WriteJsonNumber( file, r.pose );
+		fprintf( file, ", \"joint_ns\": " );
+		WriteJsonNumber( file, r.pose >= 0 && r.numJoints > 0 ? r.pose * 1000.0 / r.numJoints : -1.0 );
+		fprintf( file, ", \"scalar_mjoints_per_s\": " );
+		WriteJsonNumber( file, r.scalar );
+		fprintf( file, ", \"lanes_mjoints_per_s\": " );
+		WriteJsonNumber( file, r.batch );
+		fprintf( file, ", \"lanes_blend_mjoints_per_s\": " );
+		WriteJsonNumber( file, r.blend );
+		fprintf( file, ", \"lanes_max_error\": " );
+		WriteJsonNumber( file, r.maxError );
+
+		fprintf( file, " },\n\t\t\t\"compression\": " );
+		if( r.compressed )
+		{
+			fprintf( file, "{ \"bytes\": %lu, \"ratio\": ", ( unsigned long )r.compression.size );
+			WriteJsonNumber( file, ( double )r.compression.rawSize / r.compression.size );
+			fprintf( file, ", \"joint_deg\": " );
+			WriteJsonNumber( file, r.compression.jointAngle );
+			fprintf( file, ", \"world_position\": " );
+			WriteJsonNumber( file, r.compression.worldPosition );
+			fprintf( file, ", \"decode_us\": " );
+			WriteJsonNumber( file, r.compression.decode );
+			fprintf( file, " }" );
+		}
+		else
+		{
+			fprintf( file, "null" );
+		}
+
+		fprintf( file, ",\n\t\t\t\"pose_cache\": [" );
+		for( size_t m = 0; m < r.cache.size(); ++m )
+		{
+			const CacheResult & c = r.cache[m];
+			fprintf( file, "%s\n\t\t\t\t{ \"mode\": ", m > 0 ? "," : "" );
+			WriteJsonString( file, c.mode );
+			fprintf( file, ", \"rate\": %g, \"tolerance\": %g, \"interpolate\": %s, \"local_hit_rate\": ", c.rate, c.tolerance, c.interpolate ? "true" : "false" );
+			WriteJsonNumber( file, c.localHits );
+			fprintf( file, ", \"world_hit_rate\": " );
+			WriteJsonNumber( file, c.worldHits );
+			fprintf( file, ", \"cached_us\": " );
+			WriteJsonNumber( file, c.cached );
+			fprintf( file, ", \"plain_us\": " );
+			WriteJsonNumber( file, c.plain );
+			fprintf( file, ", \"max_error\": " );
+			WriteJsonNumber( file, c.maxError );
+			fprintf( file, " }" );
+		}
+		fprintf( file, r.cache.empty() ? "]" : "\n\t\t\t]" );
+
+		fprintf( file, ",\n\t\t\t\"motion_ms_by_threads\": " );
+		WriteJsonArray( file, r.motionThreads );
+		fprintf( file, i + 1 < results.size() ? "\n\t\t},\n" : "\n\t\t}\n" );
+	}
+
+	fprintf( file, "\t],\n\t\"blend_tree\": " );
+	if( blend != NULL )
+	{
+		fprintf( file, "{ \"clip_us\": " );
+		WriteJsonNumber( file, blend->clip );
+		fprintf( file, ", \"tree_us\": " );
+		WriteJsonNumber( file, blend->tree );
+		fprintf( file, ", \"cross_fade_us\": " );
+		WriteJsonNumber( file, blend->fade );
+		fprintf( file, ", \"layered_us\": " );
+		WriteJsonNumber( file, blend->layered );
+		fprintf( file, ", \"crowd_figures_per_ms\": " );
+		WriteJsonNumber( file, blend->crowd );
+		fprintf( file, " }" );
+	}
+	else
+	{
+		fprintf( file, "null" );
+	}
+
+	fprintf( file, ",\n\t\"crowd\": [\n" );
+	for( size_t s = 0; s < crowdRates.size(); ++s )
+	{
+		fprintf( file, "\t\t{ \"figures\": %d, \"figures_per_ms_by_threads\": ", crowdSizes[s] );
+		WriteJsonArray( file, crowdRates[s] );
+		fprintf( file, s + 1 < crowdRates.size() ? " },\n" : " }\n" );
+	}
+	fprintf( file, "\t]\n}\n" );
+
+	return fclose( file ) == 0;
+}
+
+/// <summary>
+/// Prints how to run the benchmark.
+/// </summary>
+static void PrintUsage()
+{
+	fprintf( stderr, "Usage: BVHBench [-n iterations] [-verify] [-json results.json] [-trace results.trace.json] [file.bvh | directory ...]\n" );
+}
+
+int main( int argc, char ** argv )
+{
+	int iterations = 20;
+	bool verify = false;
+	const char * jsonFileName = NULL;
+	const char * traceFileName = NULL;
+	vector<string> fileNames;
+
+	BVH_PROFILE_THREAD( "Main" );
+
+	for( int i = 1; i < argc; ++i )
+	{
+		if( strcmp( argv[i], "-n" ) == 0 && i + 1 < argc )
+			iterations = atoi( argv[++i] );
+		else if( strcmp( argv[i], "-verify" ) == 0 )
+			verify = true;
+		else if( strcmp( argv[i], "-json" ) == 0 && i + 1 < argc )
+			jsonFileName = argv[++i];
+		else if( strcmp( argv[i], "-trace" ) == 0 && i + 1 < argc )
+			traceFileName = argv[++i];
+		else if( argv[i][0] == '-' )
+		{
+			// An unknown option, or one missing its value, is not a clip
+			bool takesValue = strcmp( argv[i], "-n" ) == 0 || strcmp( argv[i], "-json" ) == 0 || strcmp( argv[i], "-trace" ) == 0;
+			fprintf( stderr, takesValue ? "The option %s needs a value\n" : "Unknown option %s\n", argv[i] );
+			PrintUsage();
+			return 1;
+		}
+		else if( IsDirectory( argv[i] ) )
+		{
+			if( !ListClips( argv[i], &fileNames ) )
+				fprintf( stderr, "Cannot read the directory %s\n", argv[i] );
+		}
+		else
+			fileNames.push_back( argv[i] );
+	}
+
+	if( fileNames.empty() )
+		fileNames.assign( g_defaultClips, g_defaultClips + sizeof( g_defaultClips ) / sizeof( g_defaultClips[0] ) );
+
+	vector<const char *> clips;
+	for( size_t i = 0; i < fileNames.size(); ++i )
+		clips.push_back( fileNames[i].c_str() );
+
+	if( iterations < 1 )
+		iterations = 1;
+
+	if( verify )
+	{
+		size_t totalMismatches = 0;
+		for( size_t i = 0; i < clips.size(); ++i )
+		{
+			size_t numValues = 0;
+			size_t numMismatches = VerifyParseFloat( clips[i], &numValues );
+			printf( "%-16s %10u values %10u mismatches\n", clips[i], ( unsigned )numValues, ( unsigned )numMismatches );
+			totalMismatches += numMismatches;
+		}
+		printf( totalMismatches == 0 ? "ParseFloat matches strtod\n" : "ParseFloat DOES NOT match strtod\n" );
+
+		int numFailedOrders = VerifyRotationOrders();
+		printf( numFailedOrders == 0 ? "Rotation orders match the reference\n" : "Rotation orders DO NOT match the reference\n" );
+
+		int numStreamMismatches = 0;
+		for( size_t i = 0; i < clips.size(); ++i )
+		{
+			for( int useCache = 0; useCache < 2; ++useCache )
+			{
+				int numChecked = 0;
+				int numMismatches = VerifyStream( clips[i], useCache != 0, &numChecked );
+				printf( "%-16s %-5s %6d times %6d mismatches\n", clips[i], useCache ? "cache" : "text", numChecked, numMismatches );
+				numStreamMismatches += numMismatches != 0 ? 1 : 0;
+			}
+		}
+		printf( numStreamMismatches == 0 ? "Streamed frames match the clips\n" : "Streamed frames DO NOT match the clips\n" );
+
+		int numFailedBlends = VerifyBlendTree();
+		printf( numFailedBlends == 0 ? "Blend trees match their clips\n" : "Blend trees DO NOT match their clips\n" );
+
+		int numFailedCaches = 0;
+		for( size_t i = 0; i < clips.size(); ++i )
+		{
+			double nearest = VerifyPoseCache( clips[i], false );
+			double blended = VerifyPoseCache( clips[i], true );
+			bool failed = nearest < 0 || nearest > 1e-4 || blended < 0 || blended > 1e-4;
+			printf( "%-16s %10.2g nearest %10.2g blended%s\n", clips[i], nearest, blended, failed ? "  FAILED" : "" );
+			numFailedCaches += failed ? 1 : 0;
+		}
+		printf( numFailedCaches == 0 ? "Cached poses match the figures\n" : "Cached poses DO NOT match the figures\n" );
+
+		// Blending keeps each channel between two frames within its bound,
+		// give or take the rounding of the blend
+		int numFailedCompressions = 0;
+		for( size_t i = 0; i < clips.size(); ++i )
+		{
+			double angleError = 0, positionError = 0;
+			double crowdError = VerifyCompressedClip( clips[i], &angleError, &positionError );
+			bool failed = crowdError < 0 || crowdError > 1e-4 || angleError > g_compressAngle / 3.0 + 1e-3 || positionError > g_compressPosition + 1e-4;
+			printf( "%-16s %10.3g chan deg %10.3g chan pos %10.2g crowd%s\n", clips[i], angleError, positionError, crowdError, failed ? "  FAILED" : "" );
+			numFailedCompressions += failed ? 1 : 0;
+		}
+		printf( numFailedCompressions == 0 ? "Compressed clips decode within their bounds\n" : "Compressed clips DO NOT decode within their bounds\n" );
+
+		return totalMismatches == 0 && numFailedOrders == 0 && numStreamMismatches == 0 && numFailedBlends == 0 && numFailedCaches == 0 &&
+			numFailedCompressions == 0 ? 0 : 1;
+	}
+
+	vector<ClipResult> results( clips.size() );
+
+	printf( "%-16s %11s %11s %11s %11s %11s %11s %11s %11s %11s\n", "clip", "lines (ms)", "mapped (ms)", "ReadBVH (ms)",
+		"hier (ms)", "motion (ms)", "cached (ms)", "memory (KB)", "pose (us)", "joint (ns)" );
+
+	for( size_t i = 0; i < clips.size(); ++i )
+	{
+		ClipResult & r = results[i];
+		r.fileName = clips[i];
+		r.fileSize = FileSize( clips[i] );
+		r.lineBuffer = TimeLoad( LoadLineBuffer, clips[i], iterations );
+		r.mapped = TimeLoad( LoadMapped, clips[i], iterations );
+		r.parsed = TimeLoad( LoadClip, clips[i], iterations );
+		TimeParseStages( clips[i], iterations, &r.hierarchy, &r.motion );
+
+		// The first load writes the cache file, the timed loads read it
+		BVHClip clip;
+		clip.ReadBVH( clips[i] );
+		r.numFrames = clip.GetNumFrames();
+		r.numJoints = clip.GetSkeleton().GetNumJoints();
+		r.numChannels = clip.GetNumChannels();
+		r.memory = clip.GetSize();
+		r.cached = TimeLoad( LoadClipCached, clips[i], iterations );
+		r.pose = TimeEvaluatePose( clips[i], iterations );
+
+		printf( "%-16s %11.3f %11.3f %11.3f %11.3f %11.3f %11.3f %11.1f %11.3f %11.1f\n", clips[i], r.lineBuffer, r.mapped, r.parsed,
+			r.hierarchy, r.motion, r.cached, r.memory / 1024.0, r.pose, r.numJoints > 0 ? r.pose * 1000.0 / r.numJoints : 0.0 );
+	}
+
+	// Forward kinematics, scalar against SIMD lanes
+
+	printf( "\n%-16s %14s %14s %14s %14s\n", "FK (Mjoints/s)", "scalar", "lanes", "lanes blend", "max error" );
+	printf( "%-16s %14d %14d %14d\n", "lanes", 1, BVHPoseBatch::GetNumLanes(), BVHPoseBatch::GetNumLanes() );
+
+	for( size_t i = 0; i < clips.size(); ++i )
+	{
+		ClipResult & r = results[i];
+		r.maxError = TimeJoints( clips[i], iterations, &r.scalar, &r.batch, &r.blend );
+		printf( "%-16s %14.2f %14.2f %14.2f %14.2g\n", clips[i], r.scalar, r.batch, r.blend, r.maxError );
+	}
+
+	// Compression within g_compressAngle and g_compressPosition
+
+	printf( "\n%-16s %10s %10s %7s %7s %10s %10s %10s %10s %10s\n", "compression", "raw (KB)", "keys (KB)", "ratio", "keys",
+		"chan deg", "joint deg", "chan pos", "world pos", "decode us" );
+
+	for( size_t i = 0; i < clips.size(); ++i )
+	{
+		CompressionResult & result = results[i].compression;
+		results[i].compressed = MeasureCompression( clips[i], iterations, &result );
+		if( !results[i].compressed )
+		{
+			printf( "%-16s failed\n", clips[i] );
+			continue;
+		}
+
+		printf( "%-16s %10.1f %10.1f %6.1fx %6.1f%% %10.3f %10.3f %10.4f %10.4f %10.2f\n", clips[i],
+			result.rawSize / 1024.0, result.size / 1024.0, ( double )result.rawSize / result.size, result.keys * 100.0,
+			result.channelAngle, result.jointAngle, result.channelPosition, result.worldPosition, result.decode );
+	}
+
+	// Streaming from the text and the cache file, then from long clips
+	// made by repeating the longest one
+
+	printf( "\n%-16s %7s %10s %10s %10s %8s %8s %10s\n", "streaming", "source", "frames", "clip (KB)", "held (KB)", "loads", "stalls", "update us" );
+
+	size_t longest = 0;
+	for( size_t i = 0; i < clips.size(); ++i )
+	{
+		PrintStream( clips[i], clips[i], false );
+		PrintStream( clips[i], clips[i], true );
+
+		if( FileSize( clips[i] ) > FileSize( clips[longest] ) )
+			longest = i;
+	}
+
+	static const int repeats[] = { 10, 100 };
+	static const char * longFileName = "BVHBench_long.bvh";
+	for( int r = 0; r < sizeof( repeats ) / sizeof( repeats[0] ); ++r )
+	{
+		char name[64];
+		sprintf( name, "%.9s x%d", clips[longest], repeats[r] );
+		if( WriteLongClip( clips[longest], repeats[r], longFileName ) > 0 )
+			PrintStream( name, longFileName, false );
+		remove( longFileName );
+	}
+
+	// Pose caching, hit rates and cost per figure
+
+	printf( "\n%-16s %-13s %10s %10s %10s %10s %10s\n", "pose cache", "playback", "local hit", "world hit", "cached us", "plain us", "max error" );
+
+	int numCacheModes = sizeof( g_cacheModes ) / sizeof( g_cacheModes[0] );
+	for( size_t i = 0; i < clips.size(); ++i )
+	{
+		results[i].cache.resize( numCacheModes );
+		for( int m = 0; m < numCacheModes; ++m )
+		{
+			CacheResult & result = results[i].cache[m];
+			result.mode = g_cacheModes[m].mode;
+			result.rate = g_cacheModes[m].rate;
+			result.tolerance = g_cacheModes[m].tolerance;
+			result.interpolate = g_cacheModes[m].interpolate;
+
+			if( !MeasurePoseCache( clips[i], iterations, &result ) )
+			{
+				printf( "%-16s failed\n", clips[i] );
+				results[i].cache.clear();
+				break;
+			}
+
+			printf( "%-16s %-13s %9.1f%% %9.1f%% %10.3f %10.3f %10.2g\n", m == 0 ? clips[i] : "", result.mode,
+				result.localHits * 100.0, result.worldHits * 100.0, result.cached, result.plain, result.maxError );
+		}
+	}
+
+	// Blend trees against playing one clip
+
+	BlendResult blend;
+	bool blended = TimeBlendTree( iterations, &blend );
+	if( blended )
+	{
+		printf( "\n%-16s %10s %10s %10s %10s %12s\n", "blend (us/fig)", "clip", "tree", "cross-fade", "layered", "crowd fig/ms" );
+		printf( "%-16s %10.3f %10.3f %10.3f %10.3f %12.1f\n", g_blendClips[1], blend.clip, blend.tree, blend.fade, blend.layered, blend.crowd );
+	}
+
+	// Motion parsing across thread counts
+
+	vector<int> threadCounts;
+	for( int t = 1; t < BVHThreadPool::GetNumProcessors(); t *= 2 )
+		threadCounts.push_back( t );
+	threadCounts.push_back( BVHThreadPool::GetNumProcessors() );
+
+	printf( "\n%-16s", "motion (ms)" );
+	for( size_t t = 0; t < threadCounts.size(); ++t )
+		printf( " %7d thr", threadCounts[t] );
+	printf( "\n" );
+
+	vector<BVHThreadPool *> pools;
+	for( size_t t = 0; t < threadCounts.size(); ++t )
+		pools.push_back( new BVHThreadPool( threadCounts[t] ) );
+
+	for( size_t i = 0; i < clips.size(); ++i )
+	{
+		printf( "%-16s", clips[i] );
+		for( size_t t = 0; t < pools.size(); ++t )
+		{
+			results[i].motionThreads.push_back( TimeParseFrames( clips[i], pools[t], iterations ) );
+			printf( " %11.3f", results[i].motionThreads.back() );
+		}
+		printf( "\n" );
+	}
+
+	// Crowd posing across thread counts
+
+	printf( "\n%-16s", "crowd (fig/ms)" );
+	for( size_t t = 0; t < threadCounts.size(); ++t )
+		printf( " %7d thr", threadCounts[t] );
+	printf( "\n" );
+
+	static const int crowdSizes[] = { 100, 1000, 10000 };
+	vector< vector<double> > crowdRates( sizeof( crowdSizes ) / sizeof( crowdSizes[0] ) );
+	for( int s = 0; s < crowdRates.size(); ++s )
+	{
+		printf( "%-16d", crowdSizes[s] );
+		for( size_t t = 0; t < pools.size(); ++t )
+		{
+			crowdRates[s].push_back( TimeCrowd( clips, crowdSizes[s], pools[t], iterations ) );
+			printf( " %11.1f", crowdRates[s].back() );
+		}
+		printf( "\n" );
+	}
+
+	for( size_t t = 0; t < pools.size(); ++t )
+		delete pools[t];
+
+#ifdef PROFILE
+	if( traceFileName != NULL && FAILED( BVHProfiler::WriteChromeTrace( traceFileName ) ) )
+	{
+		fprintf( stderr, "Cannot write %s\n", traceFileName );
+		return 1;
+	}
+#else
+	if( traceFileName != NULL )
+		fprintf( stderr, "Build with PROFILE defined to write a trace\n" );
+#endif
+
+	if( jsonFileName != NULL && !WriteJson( jsonFileName, iterations, results, blended ? &blend : NULL, threadCounts, crowdSizes, crowdRates ) )
+	{
+		fprintf( stderr, "Cannot write %s\n", jsonFileName );
+		return 1;
+	}
+
+	return 0;
+}
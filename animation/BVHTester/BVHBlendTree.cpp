@@ -0,0 +1,550 @@
+// BVHBlendTree.cpp
+//
+// Summary:
+//	Blends clips into one skeleton's pose a joint at a time: cross-fades,
+//	masked additive layers, and retargeting onto different bone lengths.
+
+#include "BVHBlendTree.h"
+#include "BVHProfiler.h"
+
+/// <summary>
+/// Creates a tree with no nodes, which leaves the skeleton in its bind pose.
+/// </summary>
+/// <param name='skeleton'>The skeleton to pose, copied. Its offsets set the bone lengths.</param>
+BVHBlendTree::BVHBlendTree( const BVHSkeleton & skeleton )
+{
+	this->skeleton = skeleton;
+	hipHeight = GetHipHeight( skeleton );
+}
+
+/// <summary>
+/// Creates a tree with the same nodes and state as another, sharing its clips.
+/// </summary>
+BVHBlendTree::BVHBlendTree( const BVHBlendTree & tree )
+{
+	skeleton = tree.skeleton;
+	hipHeight = tree.hipHeight;
+	nodes = tree.nodes;
+	jointMaps = tree.jointMaps;
+	masks = tree.masks;
+	values = tree.values;
+
+	for( int n = 0; n < nodes.size(); ++n )
+		BVHClipCache::GetShared()->AddRef( nodes[n].clip );
+}
+
+BVHBlendTree::~BVHBlendTree( void )
+{
+	Clear();
+}
+
+/// <summary>
+/// Makes this tree a copy of another, sharing its clips.
+/// </summary>
+BVHBlendTree & BVHBlendTree::operator=( const BVHBlendTree & tree )
+{
+	if( this != &tree )
+	{
+		for( int n = 0; n < tree.nodes.size(); ++n )
+			BVHClipCache::GetShared()->AddRef( tree.nodes[n].clip );
+		Clear();
+
+		skeleton = tree.skeleton;
+		hipHeight = tree.hipHeight;
+		nodes = tree.nodes;
+		jointMaps = tree.jointMaps;
+		masks = tree.masks;
+		values = tree.values;
+	}
+	return *this;
+}
+
+/// <summary>
+/// Removes every node and releases the clips.
+/// </summary>
+void BVHBlendTree::Clear()
+{
+	for( int n = 0; n < nodes.size(); ++n )
+		BVHClipCache::GetShared()->Release( nodes[n].clip );
+
+	nodes.clear();
+	jointMaps.clear();
+	masks.clear();
+	values.clear();
+}
+
+/// <summary>
+/// Returns how far the lowest joint of a skeleton's bind pose is below its
+/// first joint, or 0 if none is below it.
+/// </summary>
+float BVHBlendTree::GetHipHeight( const BVHSkeleton & skeleton )
+{
+	vector<float> heights( skeleton.GetNumJoints() );
+	float lowest = 0;
+
+	for( int j = 0; j < skeleton.GetNumJoints(); ++j )
+	{
+		int parent = skeleton.GetParent( j );
+		heights[j] = parent >= 0 ? heights[parent] + skeleton.GetOffset( j ).y : 0;
+
+		if( heights[j] < lowest )
+			lowest = heights[j];
+	}
+
+	return -lowest;
+}
+
+/// <summary>
+/// Returns the index of the joint with a name, or -1. End Sites have no
+/// name and are never found.
+/// </summary>
+int BVHBlendTree::FindJoint( const BVHSkeleton & skeleton, const string & name )
+{
+	if( name.empty() )
+		return -1;
+
+	for( int j = 0; j < skeleton.GetNumJoints(); ++j )
+	{
+		if( skeleton.GetName( j ) == name )
+			return j;
+	}
+	return -1;
+}
+
+/// <summary>
+/// Adds a node after every existing node, making it the tree's output.
+/// </summary>
+int BVHBlendTree::AddNode( const Node & node )
+{
+	nodes.push_back( node );
+	values.resize( nodes.size() );
+	return ( int )nodes.size() - 1;
+}
+
+/// <summary>
+/// Adds a node that plays the clip of a BVH file, loading it only if
+/// nothing else has.
+/// </summary>
+/// <param name='fileName'>Name of the BVH file to play.</param>
+/// <param name='useCache'>False to always parse the text and leave the clip's cache file alone.</param>
+/// <returns>Index of the node, or -1 if the clip cannot be loaded or has no frames.</returns>
+int BVHBlendTree::AddClip( const string & fileName, bool useCache )
+{
+	const BVHClip * clip = NULL;
+	if( FAILED( BVHClipCache::GetShared()->Acquire( fileName, &clip, useCache ) ) )
+		return -1;
+
+	int node = AddClip( clip );
+	BVHClipCache::GetShared()->Release( clip );
+	return node;
+}
+
+/// <summary>
+/// Adds a node that plays a clip. The clip's joints are matched to the
+/// tree's by name; use MapJoint for joints named differently.
+/// </summary>
+/// <param name='clip'>The clip to play, referenced if it came from BVHClipCache::GetShared and otherwise kept by the caller while the tree plays it.</param>
+/// <returns>Index of the node, or -1 if the clip has no frames.</returns>
+int BVHBlendTree::AddClip( const BVHClip * clip )
+{
+	if( clip == NULL || clip->GetNumFrames() == 0 )
+		return -1;
+
+	Node node;
+	node.type = NodeClip;
+	node.inputs[0] = node.inputs[1] = node.inputs[2] = -1;
+	node.active = false;
+	node.clip = clip;
+	node.firstMap = ( int )jointMaps.size();
+	node.timeOffset = 0;
+	node.rate = 1;
+	node.frame = node.nextFrame = NULL;
+	node.frameWeight = 0;
+	node.weight = node.fadeFrom = node.fadeTo = 1;
+	node.fadeStart = node.fadeDuration = 0;
+	node.firstMask = -1;
+
+	float clipHipHeight = GetHipHeight( clip->GetSkeleton() );
+	node.translationScale = clipHipHeight > 0 && hipHeight > 0 ? hipHeight / clipHipHeight : 1.0f;
+
+	for( int j = 0; j < skeleton.GetNumJoints(); ++j )
+		jointMaps.push_back( FindJoint( clip->GetSkeleton(), skeleton.GetName( j ) ) );
+
+	BVHClipCache::GetShared()->AddRef( clip );
+	return AddNode( node );
+}
+
+/// <summary>
+/// Adds a node that blends from one node's pose to another's.
+/// </summary>
+/// <param name='from'>The node shown at weight 0.</param>
+/// <param name='to'>The node shown at weight 1.</param>
+/// <param name='weight'>How far to blend, see SetWeight and FadeWeight.</param>
+/// <returns>Index of the node, or -1 if an input is not an existing node.</returns>
+int BVHBlendTree::AddCrossFade( int from, int to, float weight )
+{
+	if( from < 0 || from >= nodes.size() || to < 0 || to >= nodes.size() )
+		return -1;
+
+	Node node;
+	node.type = NodeCrossFade;
+	node.inputs[0] = from;
+	node.inputs[1] = to;
+	node.inputs[2] = -1;
+	node.active = false;
+	node.clip = NULL;
+	node.firstMap = -1;
+	node.translationScale = 1;
+	node.timeOffset = 0;
+	node.rate = 1;
+	node.frame = node.nextFrame = NULL;
+	node.frameWeight = 0;
+	node.weight = node.fadeFrom = node.fadeTo = weight;
+	node.fadeStart = node.fadeDuration = 0;
+	node.firstMask = -1;
+
+	return AddNode( node );
+}
+
+/// <summary>
+/// Adds a node that layers the difference between two poses onto a third,
+/// for example a wave over a walk. Each joint's rotation is turned by how
+/// far the additive pose turns it from the reference pose, and its
+/// translation moved by the difference in theirs.
+/// </summary>
+/// <param name='base'>The node the layer is added to.</param>
+/// <param name='additive'>The node whose motion is added.</param>
+/// <param name='reference'>The node the additive pose is measured from, often the additive clip held at its first frame.</param>
+/// <param name='weight'>How much of the layer to add, see SetWeight and FadeWeight.</param>
+/// <returns>Index of the node, or -1 if an input is not an existing node.</returns>
+int BVHBlendTree::AddAdditive( int base, int additive, int reference, float weight )
+{
+	if( base < 0 || base >= nodes.size() || additive < 0 || additive >= nodes.size() || reference < 0 || reference >= nodes.size() )
+		return -1;
+
+	Node node;
+	node.type = NodeAdditive;
+	node.inputs[0] = base;
+	node.inputs[1] = additive;
+	node.inputs[2] = reference;
+	node.active = false;
+	node.clip = NULL;
+	node.firstMap = -1;
+	node.translationScale = 1;
+	node.timeOffset = 0;
+	node.rate = 1;
+	node.frame = node.nextFrame = NULL;
+	node.frameWeight = 0;
+	node.weight = node.fadeFrom = node.fadeTo = weight;
+	node.fadeStart = node.fadeDuration = 0;
+	node.firstMask = -1;
+
+	return AddNode( node );
+}
+
+/// <summary>
+/// Drives a joint of the tree's skeleton from a differently named joint of
+/// a clip node's clip.
+/// </summary>
+/// <param name='node'>A clip node.</param>
+/// <param name='joint'>Name of the joint in the tree's skeleton.</param>
+/// <param name='clipJoint'>Name of the joint in the clip's skeleton.</param>
+HRESULT BVHBlendTree::MapJoint( int node, const string & joint, const string & clipJoint )
+{
+	if( node < 0 || node >= nodes.size() || nodes[node].type != NodeClip )
+		return E_INVALIDARG;
+
+	int j = FindJoint( skeleton, joint );
+	int c = FindJoint( nodes[node].clip->GetSkeleton(), clipJoint );
+	if( j < 0 || c < 0 )
+		return E_INVALIDARG;
+
+	jointMaps[nodes[node].firstMap + j] = c;
+	return S_OK;
+}
+
+/// <summary>
+/// Limits a cross-fade or additive node to a joint and its descendants,
+/// for example an upper body layer from the Chest. The other joints show
+/// the node's first input.
+/// </summary>
+/// <param name='node'>A cross-fade or additive node.</param>
+/// <param name='joint'>Name of the first joint of the masked part of the skeleton.</param>
+HRESULT BVHBlendTree::SetMask( int node, const string & joint )
+{
+	if( node < 0 || node >= nodes.size() || nodes[node].type == NodeClip )
+		return E_INVALIDARG;
+
+	int first = FindJoint( skeleton, joint );
+	if( first < 0 )
+		return E_INVALIDARG;
+
+	if( nodes[node].firstMask < 0 )
+	{
+		nodes[node].firstMask = ( int )masks.size();
+		masks.resize( masks.size() + skeleton.GetNumJoints() );
+	}
+
+	// Parents come before their children, so one pass finds the descendants
+	float * mask = &masks[nodes[node].firstMask];
+	for( int j = 0; j < skeleton.GetNumJoints(); ++j )
+	{
+		int parent = skeleton.GetParent( j );
+		mask[j] = j == first || ( j > first && parent >= 0 && mask[parent] > 0 ) ? 1.0f : 0.0f;
+	}
+
+	return S_OK;
+}
+
+/// <summary>
+/// Sets where in its clip a clip node plays: the clip time at tree time t
+/// is timeOffset + rate * t.
+/// </summary>
+void BVHBlendTree::SetClipTiming( int node, float timeOffset, float rate )
+{
+	nodes[node].timeOffset = timeOffset;
+	nodes[node].rate = rate;
+}
+
+/// <summary>
+/// Sets the weight of a cross-fade or additive node at once.
+/// </summary>
+void BVHBlendTree::SetWeight( int node, float weight )
+{
+	nodes[node].weight = nodes[node].fadeFrom = nodes[node].fadeTo = weight;
+	nodes[node].fadeDuration = 0;
+}
+
+/// <summary>
+/// Moves the weight of a cross-fade or additive node from where it is to a
+/// new weight over a span of tree time.
+/// </summary>
+/// <param name='weight'>The weight at the end of the fade.</param>
+/// <param name='time'>Tree time the fade starts at.</param>
+/// <param name='duration'>Seconds the fade takes.</param>
+void BVHBlendTree::FadeWeight( int node, float weight, float time, float duration )
+{
+	nodes[node].fadeFrom = nodes[node].weight;
+	nodes[node].fadeTo = weight;
+	nodes[node].fadeStart = time;
+	nodes[node].fadeDuration = duration;
+}
+
+/// <summary>
+/// Marks a node and the inputs its weight depends on as active.
+/// </summary>
+void BVHBlendTree::Activate( int node )
+{
+	Node & n = nodes[node];
+	n.active = true;
+
+	if( n.type == NodeCrossFade )
+	{
+		if( n.weight < 1 || n.firstMask >= 0 )
+			Activate( n.inputs[0] );
+		if( n.weight > 0 )
+			Activate( n.inputs[1] );
+	}
+	else if( n.type == NodeAdditive )
+	{
+		Activate( n.inputs[0] );
+		if( n.weight > 0 )
+		{
+			Activate( n.inputs[1] );
+			Activate( n.inputs[2] );
+		}
+	}
+}
+
+/// <summary>
+/// Moves the tree to a time: advances the fades, finds the nodes the
+/// output depends on, and finds the frames each of their clips shows.
+/// </summary>
+/// <param name='time'>Seconds of tree time, as given to FadeWeight.</param>
+/// <param name='interpolate'>True to blend between the frames around each clip's time, false to show the frame at it.</param>
+void BVHBlendTree::Update( float time, bool interpolate )
+{
+	if( nodes.empty() )
+		return;
+
+	for( int n = 0; n < nodes.size(); ++n )
+	{
+		Node & node = nodes[n];
+		node.active = false;
+
+		if( node.type != NodeClip )
+		{
+			float t = node.fadeDuration > 0 ? ( time - node.fadeStart ) / node.fadeDuration : 1.0f;
+			t = t < 0 ? 0 : t > 1 ? 1 : t;
+			node.weight = node.fadeFrom + ( node.fadeTo - node.fadeFrom ) * t;
+		}
+	}
+
+	Activate( ( int )nodes.size() - 1 );
+
+	for( int n = 0; n < nodes.size(); ++n )
+	{
+		Node & node = nodes[n];
+		if( !node.active || node.type != NodeClip )
+			continue;
+
+		float clipTime = node.timeOffset + node.rate * time;
+		if( interpolate )
+		{
+			int frame = 0, nextFrame = 0;
+			node.frameWeight = node.clip->GetFrameIndices( clipTime, &frame, &nextFrame );
+			node.frame = node.clip->GetFrame( frame );
+			node.nextFrame = node.clip->GetFrame( nextFrame );
+		}
+		else
+		{
+			node.frame = node.nextFrame = node.clip->GetFrame( node.clip->GetFrameIndex( clipTime ) );
+			node.frameWeight = 0;
+		}
+	}
+}
+
+/// <summary>
+/// Blends one joint's local pose through every active node, inputs first.
+/// </summary>
+/// <param name='joint'>Index of the joint in the tree's skeleton.</param>
+/// <param name='pose'>Receives the output node's pose of the joint.</param>
+void BVHBlendTree::EvaluateJoint( int joint, BVHJointPose * pose )
+{
+	const BVHQuaternion identity( 0, 0, 0, 1 );
+
+	if( nodes.empty() )
+	{
+		pose->rotation = identity;
+		pose->translation = BVHVector3( 0, 0, 0 );
+		return;
+	}
+
+	for( int n = 0; n < nodes.size(); ++n )
+	{
+		const Node & node = nodes[n];
+		if( !node.active )
+			continue;
+
+		BVHJointPose & value = values[n];
+
+		if( node.type == NodeClip )
+		{
+			const BVHSkeleton & clipSkeleton = node.clip->GetSkeleton();
+			int c = jointMaps[node.firstMap + joint];
+
+			if( c < 0 || clipSkeleton.GetNumJointChannels( c ) == 0 )
+			{
+				value.rotation = identity;
+				value.translation = BVHVector3( 0, 0, 0 );
+				continue;
+			}
+
+			value.rotation = clipSkeleton.GetRotationQuaternion( c, node.frame );
+			value.translation = clipSkeleton.GetTranslation( c, node.frame );
+
+			if( node.frameWeight != 0 )
+			{
+				BVHQuaternion next = clipSkeleton.GetRotationQuaternion( c, node.nextFrame );
+				BVHQuaternionNlerp( &value.rotation, &value.rotation, &next, node.frameWeight );
+
+				BVHVector3 to = clipSkeleton.GetTranslation( c, node.nextFrame );
+				value.translation.x += ( to.x - value.translation.x ) * node.frameWeight;
+				value.translation.y += ( to.y - value.translation.y ) * node.frameWeight;
+				value.translation.z += ( to.z - value.translation.z ) * node.frameWeight;
+			}
+
+			value.translation.x *= node.translationScale;
+			value.translation.y *= node.translationScale;
+			value.translation.z *= node.translationScale;
+			continue;
+		}
+
+		float weight = node.weight * ( node.firstMask >= 0 ? masks[node.firstMask + joint] : 1.0f );
+		const BVHJointPose & base = values[node.inputs[0]];
+
+		if( weight <= 0 )
+		{
+			value = base;
+		}
+		else if( node.type == NodeCrossFade )
+		{
+			const BVHJointPose & to = values[node.inputs[1]];
+
+			if( weight >= 1 )
+			{
+				value = to;
+			}
+			else
+			{
+				BVHQuaternionNlerp( &value.rotation, &base.rotation, &to.rotation, weight );
+				value.translation.x = base.translation.x + ( to.translation.x - base.translation.x ) * weight;
+				value.translation.y = base.translation.y + ( to.translation.y - base.translation.y ) * weight;
+				value.translation.z = base.translation.z + ( to.translation.z - base.translation.z ) * weight;
+			}
+		}
+		else
+		{
+			const BVHJointPose & additive = values[node.inputs[1]];
+			const BVHJointPose & reference = values[node.inputs[2]];
+
+			// The turn from the reference to the additive rotation, applied
+			// in the joint's own space before the base rotation
+			BVHQuaternion inverse( -reference.rotation.x, -reference.rotation.y, -reference.rotation.z, reference.rotation.w );
+			BVHQuaternion delta;
+			BVHQuaternionMultiply( &delta, &additive.rotation, &inverse );
+			if( weight < 1 )
+				BVHQuaternionNlerp( &delta, &identity, &delta, weight );
+
+			BVHQuaternion rotation;
+			BVHQuaternionMultiply( &rotation, &delta, &base.rotation );
+			value.rotation = rotation;
+			value.translation.x = base.translation.x + ( additive.translation.x - reference.translation.x ) * weight;
+			value.translation.y = base.translation.y + ( additive.translation.y - reference.translation.y ) * weight;
+			value.translation.z = base.translation.z + ( additive.translation.z - reference.translation.z ) * weight;
+		}
+	}
+
+	*pose = values[nodes.size() - 1];
+}
+
+/// <summary>
+/// Returns the translation of the first root joint as of the last Update,
+/// in the space of the world matrix, without posing the other joints.
+/// </summary>
+BVHVector3 BVHBlendTree::GetRootPosition()
+{
+	if( skeleton.GetNumJoints() == 0 )
+		return BVHVector3( 0, 0, 0 );
+
+	BVHJointPose pose;
+	EvaluateJoint( 0, &pose );
+	return pose.translation;
+}
+
+/// <summary>
+/// Computes the world matrix of every joint as of the last Update.
+/// </summary>
+/// <param name='world'>World matrix of the roots' parent space.</param>
+/// <param name='worldMatrices'>Receives GetSkeleton().GetNumJoints() matrices.</param>
+void BVHBlendTree::EvaluatePose( const BVHMatrix & world, BVHMatrix * worldMatrices )
+{
+	for( int j = 0; j < skeleton.GetNumJoints(); ++j )
+	{
+		BVHJointPose pose;
+		EvaluateJoint( j, &pose );
+
+		BVHMatrix local;
+		BVHMatrixRotationQuaternion( &local, &pose.rotation );
+
+		const BVHVector3 & offset = skeleton.GetOffset( j );
+		local._41 = pose.translation.x + offset.x;
+		local._42 = pose.translation.y + offset.y;
+		local._43 = pose.translation.z + offset.z;
+
+		int parent = skeleton.GetParent( j );
+		worldMatrices[j] = local * ( parent >= 0 ? worldMatrices[parent] : world );
+	}
+
+	BVH_PROFILE_COUNT( BVHCounterMatricesComposed, skeleton.GetNumJoints() );
+}
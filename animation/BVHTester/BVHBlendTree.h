@@ -0,0 +1,114 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "BVHClip.h"
+#include "BVHClipCache.h"
+#include "BVHMath.h"
+#include "BVHSkeleton.h"
+
+using namespace std;
+
+/// <summary>
+/// The local transform of one joint: its rotation, and the translation its
+/// position channels add to its offset.
+/// </summary>
+struct BVHJointPose
+{
+	BVHQuaternion				rotation;
+	BVHVector3					translation;
+};
+
+/// <summary>
+/// Blends several clips into the pose of one skeleton: cross-fades between
+/// clips, additive layers over part of the body, and clips captured on
+/// skeletons whose OFFSET lengths differ from it.
+/// </summary>
+/// <remarks>
+/// Nodes are added inputs first, so they are kept in the order they are
+/// evaluated in, and the last node added is the tree's output. The tree is
+/// evaluated a joint at a time: each node blends that joint's BVHJointPose
+/// from its inputs, and the output is composed into the joint's world
+/// matrix before the next joint is started. A node therefore holds a
+/// single joint's pose, and nothing is allocated once the nodes are added.
+///
+/// A clip node's joints are matched to the tree's skeleton by name, or by
+/// MapJoint. Its rotations are used as they are, while the bones take the
+/// OFFSET lengths of the tree's skeleton and the root's translation is
+/// scaled by the ratio of the two skeletons' hip heights, so the feet stay
+/// on the ground.
+///
+/// A tree holds the playback state of one figure, so figures must not
+/// share one. Copies share the clips, so a tree built once can be copied
+/// for each figure of a crowd.
+/// </remarks>
+class BVHBlendTree
+{
+protected:
+	enum NodeType
+	{
+		NodeClip,
+		NodeCrossFade,					// Blends from inputs[0] to inputs[1] by weight
+		NodeAdditive					// Adds inputs[1] relative to inputs[2] onto inputs[0]
+	};
+
+	struct Node
+	{
+		NodeType				type;
+		int						inputs[3];
+		bool					active;			// Set by Update, false if the output does not depend on the node
+
+		// Clip nodes
+		const BVHClip *			clip;			// Referenced in BVHClipCache::GetShared
+		int						firstMap;		// Index in jointMaps of the clip joint of the tree's first joint
+		float					translationScale;	// Tree hip height over clip hip height
+		float					timeOffset;
+		float					rate;
+		const float *			frame;			// Set by Update
+		const float *			nextFrame;
+		float					frameWeight;
+
+		// Cross-fade and additive nodes
+		float					weight;			// Set by Update from the fade
+		float					fadeFrom;
+		float					fadeTo;
+		float					fadeStart;
+		float					fadeDuration;
+		int						firstMask;		// Index in masks of the weight of the tree's first joint, or -1 for all joints at full weight
+	};
+
+	BVHSkeleton					skeleton;		// The skeleton posed
+	float						hipHeight;
+	vector<Node>				nodes;
+	vector<int>					jointMaps;		// Clip joint of each tree joint, -1 for none, per clip node
+	vector<float>				masks;			// Weight of each tree joint, per masked node
+	vector<BVHJointPose>		values;			// Each node's pose of the joint being evaluated
+
+	int AddNode( const Node & node );
+	void Activate( int node );
+	void EvaluateJoint( int joint, BVHJointPose * pose );
+	static float GetHipHeight( const BVHSkeleton & skeleton );
+	static int FindJoint( const BVHSkeleton & skeleton, const string & name );
+public:
+	BVHBlendTree( const BVHSkeleton & skeleton );
+	BVHBlendTree( const BVHBlendTree & tree );
+	~BVHBlendTree( void );
+	BVHBlendTree & operator=( const BVHBlendTree & tree );
+	void Clear();
+	const BVHSkeleton & GetSkeleton() const { return skeleton; }
+	int GetNumNodes() const { return ( int )nodes.size(); }
+	int AddClip( const string & fileName, bool useCache = true );
+	int AddClip( const BVHClip * clip );
+	int AddCrossFade( int from, int to, float weight = 0 );
+	int AddAdditive( int base, int additive, int reference, float weight = 1 );
+	HRESULT MapJoint( int node, const string & joint, const string & clipJoint );
+	HRESULT SetMask( int node, const string & joint );
+	void SetClipTiming( int node, float timeOffset, float rate );
+	void SetWeight( int node, float weight );
+	void FadeWeight( int node, float weight, float time, float duration );
+	float GetWeight( int node ) const { return nodes[node].weight; }
+	void Update( float time, bool interpolate );
+	BVHVector3 GetRootPosition();
+	void EvaluatePose( const BVHMatrix & world, BVHMatrix * worldMatrices );
+};
@@ -0,0 +1,89 @@
+// BVHCache.cpp
+//
+// Summary:
+//	Helpers for the binary cache files BVHClip writes next to parsed
+//	BVH clips.
+
+#include "BVHCache.h"
+
+#include <cstdio>
+
+#ifndef _WIN32
+#include <sys/stat.h>
+#endif
+
+/// <summary>
+/// FNV-1a hash of a block of bytes.
+/// </summary>
+unsigned int BVHCacheChecksum( const void * data, size_t size )
+{
+	const unsigned char * bytes = ( const unsigned char * )data;
+	unsigned int hash = 2166136261U;
+
+	for( size_t i = 0; i < size; ++i )
+	{
+		hash ^= bytes[i];
+		hash *= 16777619U;
+	}
+
+	return hash;
+}
+
+/// <summary>
+/// Gets the last write time of a file, in units that only need to compare
+/// with other times from this function.
+/// </summary>
+/// <returns>False if the file does not exist.</returns>
+bool GetBVHFileTime( const char * fileName, unsigned long long * time )
+{
+#ifdef _WIN32
+	WIN32_FILE_ATTRIBUTE_DATA attributes;
+
+	if( !GetFileAttributesExA( fileName, GetFileExInfoStandard, &attributes ) )
+		return false;
+
+	*time = ( ( unsigned long long )attributes.ftLastWriteTime.dwHighDateTime << 32 ) | attributes.ftLastWriteTime.dwLowDateTime;
+#else
+	struct stat attributes;
+
+	if( stat( fileName, &attributes ) != 0 )
+		return false;
+
+	*time = ( unsigned long long )attributes.st_mtim.tv_sec * 1000000000ULL + attributes.st_mtim.tv_nsec;
+#endif
+	return true;
+}
+
+/// <summary>
+/// Returns true if the cache file exists and was written after the BVH file.
+/// </summary>
+/// <param name='fileName'>Name of the BVH text file.</param>
+/// <param name='cacheFileName'>Name of its cache file.</param>
+bool IsBVHCacheCurrent( const char * fileName, const char * cacheFileName )
+{
+	unsigned long long text, cache;
+
+	if( !GetBVHFileTime( fileName, &text ) || !GetBVHFileTime( cacheFileName, &cache ) )
+		return false;
+
+	return cache > text;
+}
+
+/// <summary>
+/// Moves a newly written cache file over the old one, or deletes it if it cannot be moved.
+/// </summary>
+bool ReplaceBVHCacheFile( const char * tempFileName, const char * cacheFileName )
+{
+#ifdef _WIN32
+	if( MoveFileExA( tempFileName, cacheFileName, MOVEFILE_REPLACE_EXISTING ) )
+		return true;
+
+	DeleteFileA( tempFileName );
+#else
+	if( rename( tempFileName, cacheFileName ) == 0 )
+		return true;
+
+	remove( tempFileName );
+#endif
+	return false;
+}
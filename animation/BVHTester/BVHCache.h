@@ -0,0 +1,53 @@
+#pragma once
+
+#include <cstddef>
+
+#include "BVHPlatform.h"
+
+// Bump when the layout of the cache file changes
+#define BVH_CACHE_VERSION 1
+
+/// <summary>
+/// Header at the start of a binary BVH cache file.
+/// </summary>
+/// <remarks>
+/// Every section is stored at a 16 byte aligned offset from the start of the
+/// file, so a mapped cache can be read in place. The checksum covers every
+/// byte after the header.
+/// </remarks>
+struct BVHCacheHeader
+{
+	char						magic[4];		// "BVHC"
+	unsigned int				version;		// BVH_CACHE_VERSION
+	unsigned int				fileSize;
+	unsigned int				checksum;
+	unsigned int				numJoints;
+	unsigned int				numChannels;
+	unsigned int				numFrames;
+	unsigned int				numEdges;
+	float						frameTime;
+	unsigned int				jointsOffset;	// BVHCacheJoint[numJoints]
+	unsigned int				channelsOffset;	// unsigned char[numChannels] of Channel values
+	unsigned int				namesOffset;	// null terminated joint names
+	unsigned int				motionOffset;	// float[numFrames * numChannels]
+	unsigned int				reserved[3];
+};
+
+/// <summary>
+/// A joint of the skeleton in a cache file. Joints are stored parents first,
+/// in the order the hierarchy lists them.
+/// </summary>
+struct BVHCacheJoint
+{
+	int							parent;			// index of the parent joint, -1 for a root
+	float						offset[3];
+	unsigned int				firstChannel;	// index of the joint's first channel in a frame
+	unsigned int				numChannels;
+	unsigned int				nameOffset;		// from namesOffset
+	unsigned int				isEndSite;
+};
+
+unsigned int BVHCacheChecksum( const void * data, size_t size );
+bool GetBVHFileTime( const char * fileName, unsigned long long * time );
+bool IsBVHCacheCurrent( const char * fileName, const char * cacheFileName );
+bool ReplaceBVHCacheFile( const char * tempFileName, const char * cacheFileName );
@@ -0,0 +1,555 @@
+// BVHClip.cpp
+//
+// Summary:
+//	Loads the skeleton and motion data of a Biovision Hierarchy (BVH) file,
+//	from the text or from its binary cache file. Nothing here depends on 
+//	Direct3D, so clips can be loaded and posed without a device.
+
+#include "BVHClip.h"
+#include "BVHProfiler.h"
+
+#include <cmath>
+#include <cstdio>
+
+/// <summary>
+/// Creates an empty clip. Use BVHClip::ReadBVH to load one.
+/// </summary>
+BVHClip::BVHClip(void)
+{
+	numChannels = 0;
+	numFrames = 0;
+	frameTime = 0;
+}
+
+BVHClip::~BVHClip(void)
+{
+}
+
+/// <summary>
+/// Removes the skeleton and motion data.
+/// </summary>
+void BVHClip::Clear()
+{
+	skeleton.Clear();
+	motionData.clear();
+	numChannels = 0;
+	numFrames = 0;
+	frameTime = 0;
+}
+
+/// <summary>
+/// Read and process the BVH file.
+/// </summary>
+/// <remarks>
+/// A parsed clip is saved to a binary cache file next to the BVH file
+/// ( Jog.bvh is cached as Jog.bvhc ). While the cache is newer than the BVH
+/// file it is loaded instead of parsing the text.
+/// </remarks>
+/// <param name='fileName'>Name of BVH file to process.</param>
+/// <param name='useCache'>False to always parse the text and leave the cache alone.</param>
+HRESULT BVHClip::ReadBVH( const string & fileName, bool useCache )
+{
+	Clear();
+
+	string cacheFileName = fileName + "c";
+
+	if( useCache && IsBVHCacheCurrent( fileName.c_str(), cacheFileName.c_str() ) &&
+		SUCCEEDED( ReadBVHCache( cacheFileName ) ) )
+	{
+		return S_OK;
+	}
+
+	if( FAILED( ParseBVH( fileName ) ) )
+	{
+		Clear();
+		return E_FAIL;
+	}
+
+	// A cache that cannot be written only costs the next load a parse
+	if( useCache )
+		WriteBVHCache( cacheFileName );
+
+	return S_OK;
+}
+
+/// <summary>
+/// Parse the text of a BVH file.
+/// </summary>
+/// <param name='fileName'>Name of BVH file to process.</param>
+HRESULT BVHClip::ParseBVH( const string & fileName )
+{
+	BVH_PROFILE_SCOPE( "ParseBVH" );
+
+	// Map the file 
+
+	BVHFile bvhFile;
+	
+	if( FAILED( bvhFile.Open( fileName.c_str() ) ) )
+	{
+#if DEBUG
+		cerr << "BVHClip::ReadBVH: BVH File not opened.";
+#endif
+		return E_FAIL;
+	}
+
+	// Process the lines in place
+
+	BVHReader reader( bvhFile.GetData(), bvhFile.GetData() + bvhFile.GetSize() );
+
+	if( FAILED( ParseHeader( &reader, &skeleton, &numFrames, &frameTime ) ) )
+		return E_FAIL;
+
+	numChannels = skeleton.GetNumChannels();
+
+	if( FAILED( ProcessMotionData( &reader ) ) )
+		return E_FAIL;
+
+	return S_OK;
+}
+
+/// <summary>
+/// Rounds a cache file offset up to the 16 byte section alignment.
+/// </summary>
+static unsigned int AlignBVHCacheOffset( size_t offset )
+{
+	return ( unsigned int )( ( offset + 15 ) & ~( size_t )15 );
+}
+
+/// <summary>
+/// Writes the skeleton and motion data to a binary cache file.
+/// </summary>
+/// <param name='cacheFileName'>Name of the cache file to write.</param>
+HRESULT BVHClip::WriteBVHCache( const string & cacheFileName )
+{
+	vector<BVHCacheJoint> joints( skeleton.GetNumJoints() );
+	string names;
+
+	for( int j = 0; j < joints.size(); ++j )
+	{
+		BVHCacheJoint & joint = joints[j];
+		const BVHVector3 & offset = skeleton.GetOffset( j );
+
+		joint.parent = skeleton.GetParent( j );
+		joint.offset[0] = offset.x;
+		joint.offset[1] = offset.y;
+		joint.offset[2] = offset.z;
+		joint.firstChannel = skeleton.GetFirstChannel( j );
+		joint.numChannels = skeleton.GetNumJointChannels( j );
+		joint.nameOffset = ( unsigned int )names.size();
+		joint.isEndSite = skeleton.GetName( j ).empty() ? 1 : 0;
+
+		names.append( skeleton.GetName( j ) );
+		names.push_back( '\0' );
+	}
+
+	if( skeleton.GetNumChannels() != numChannels || motionData.size() != ( size_t )numFrames * numChannels )
+		return E_FAIL;
+
+	// Lay out the sections
+
+	BVHCacheHeader header;
+	memset( &header, 0, sizeof( header ) );
+	memcpy( header.magic, "BVHC", 4 );
+	header.version = BVH_CACHE_VERSION;
+	header.numJoints = ( unsigned int )joints.size();
+	header.numChannels = numChannels;
+	header.numFrames = numFrames;
+	header.numEdges = skeleton.GetNumEdges();
+	header.frameTime = frameTime;
+	header.jointsOffset = AlignBVHCacheOffset( sizeof( header ) );
+	header.channelsOffset = AlignBVHCacheOffset( header.jointsOffset + joints.size() * sizeof( BVHCacheJoint ) );
+	header.namesOffset = AlignBVHCacheOffset( header.channelsOffset + numChannels );
+	header.motionOffset = AlignBVHCacheOffset( header.namesOffset + names.size() );
+	header.fileSize = ( unsigned int )( header.motionOffset + motionData.size() * sizeof( float ) );
+
+	vector<char> file( header.fileSize, 0 );
+
+	if( !joints.empty() )
+		memcpy( &file[header.jointsOffset], &joints[0], joints.size() * sizeof( BVHCacheJoint ) );
+
+	for( int c = 0; c < numChannels; ++c )
+		file[header.channelsOffset + c] = ( char )skeleton.GetChannel( c );
+
+	if( !names.empty() )
+		memcpy( &file[header.namesOffset], names.data(), names.size() );
+
+	if( !motionData.empty() )
+		memcpy( &file[header.motionOffset], &motionData[0], motionData.size() * sizeof( float ) );
+
+	header.checksum = BVHCacheChecksum( &file[sizeof( header )], file.size() - sizeof( header ) );
+	memcpy( &file[0], &header, sizeof( header ) );
+
+	// Write to a temporary file first so a reader never sees half a cache.
+	// The name is this writer's own, the process id and a count of the
+	// caches the process has written, so processes and threads warming the
+	// same cache never write into one file.
+
+	static volatile LONG numWritten = 0;
+	char suffix[32];
+	sprintf( suffix, ".%d.%d.tmp", BVHGetProcessId(), ( int )BVHAtomicAdd( &numWritten, 1 ) );
+	string tempFileName = cacheFileName + suffix;
+	ofstream cacheFile( tempFileName.c_str(), ios::out | ios::binary | ios::trunc );
+	if( !cacheFile.is_open() )
+		return E_FAIL;
+
+	cacheFile.write( &file[0], file.size() );
+	cacheFile.close();
+
+	if( cacheFile.fail() )
+	{
+		remove( tempFileName.c_str() );
+		return E_FAIL;
+	}
+
+	if( !ReplaceBVHCacheFile( tempFileName.c_str(), cacheFileName.c_str() ) )
+		return E_FAIL;
+
+	return S_OK;
+}
+
+/// <summary>
+/// Reads the skeleton and motion data from a binary cache file.
+/// </summary>
+/// <remarks>The whole file is validated before any node is created.</remarks>
+/// <param name='cacheFileName'>Name of the cache file to read.</param>
+HRESULT BVHClip::ReadBVHCache( const string & cacheFileName )
+{
+	BVH_PROFILE_SCOPE( "ReadBVHCache" );
+
+	BVHFile cacheFile;
+	
+	if( FAILED( cacheFile.Open( cacheFileName.c_str() ) ) )
+		return E_FAIL;
+
+	const char * data = cacheFile.GetData();
+	size_t size = cacheFile.GetSize();
+
+	// Validate the header and the section bounds
+
+	if( size < sizeof( BVHCacheHeader ) )
+		return E_FAIL;
+
+	BVHCacheHeader header;
+	memcpy( &header, data, sizeof( header ) );
+
+	if( memcmp( header.magic, "BVHC", 4 ) != 0 || header.version != BVH_CACHE_VERSION || header.fileSize != size )
+		return E_FAIL;
+
+	if( header.numFrames == 0 || header.numJoints == 0 || header.frameTime <= 0 )
+		return E_FAIL;
+
+	size_t motionSize = ( size_t )header.numFrames * header.numChannels * sizeof( float );
+	if( header.jointsOffset < sizeof( header ) ||
+		header.jointsOffset + ( size_t )header.numJoints * sizeof( BVHCacheJoint ) > header.channelsOffset ||
+		header.channelsOffset + ( size_t )header.numChannels > header.namesOffset ||
+		header.namesOffset > header.motionOffset ||
+		header.motionOffset + motionSize != size ||
+		header.motionOffset % sizeof( float ) != 0 )
+		return E_FAIL;
+
+	if( BVHCacheChecksum( data + sizeof( header ), size - sizeof( header ) ) != header.checksum )
+		return E_FAIL;
+
+	if( FAILED( ReadCacheSkeleton( header, data, &skeleton ) ) )
+		return E_FAIL;
+
+	numChannels = header.numChannels;
+	numFrames = header.numFrames;
+	frameTime = header.frameTime;
+
+	const float * motion = ( const float * )( data + header.motionOffset );
+	motionData.assign( motion, motion + ( size_t )header.numFrames * header.numChannels );
+
+	return S_OK;
+}
+
+/// <summary>
+/// Validates the joints of a cache file and rebuilds its skeleton from them.
+/// </summary>
+/// <param name='header'>Header of the cache file, its section bounds already checked.</param>
+/// <param name='data'>The cache file from its start up to at least header.motionOffset.</param>
+/// <param name='skeleton'>An empty skeleton that receives the joints and channels.</param>
+HRESULT BVHClip::ReadCacheSkeleton( const BVHCacheHeader & header, const char * data, BVHSkeleton * skeleton )
+{
+	const BVHCacheJoint * joints = ( const BVHCacheJoint * )( data + header.jointsOffset );
+	const unsigned char * channels = ( const unsigned char * )( data + header.channelsOffset );
+	const char * names = data + header.namesOffset;
+	size_t namesSize = header.motionOffset - header.namesOffset;
+
+	unsigned int firstChannel = 0;
+	for( unsigned int j = 0; j < header.numJoints; ++j )
+	{
+		if( joints[j].parent >= ( int )j || joints[j].parent < -1 ||
+			joints[j].firstChannel != firstChannel ||
+			joints[j].nameOffset >= namesSize ||
+			memchr( names + joints[j].nameOffset, '\0', namesSize - joints[j].nameOffset ) == NULL )
+			return E_FAIL;
+
+		firstChannel += joints[j].numChannels;
+	}
+
+	if( firstChannel != header.numChannels )
+		return E_FAIL;
+
+	// Rebuild the skeleton
+
+	for( unsigned int j = 0; j < header.numJoints; ++j )
+	{
+		const BVHCacheJoint & joint = joints[j];
+
+		skeleton->AddJoint( names + joint.nameOffset, joint.parent );
+		skeleton->SetOffset( j, BVHVector3( joint.offset[0], joint.offset[1], joint.offset[2] ) );
+		for( unsigned int c = 0; c < joint.numChannels; ++c )
+			skeleton->AddChannel( j, ( Channel )channels[joint.firstChannel + c] );
+	}
+
+	return S_OK;
+}
+
+/// <summary>
+/// Reads everything in a BVH file before the first frame: the hierarchy,
+/// and the frame count and time of the motion section.
+/// </summary>
+/// <param name='reader'>Reader positioned at the start of the file, left at the first frame.</param>
+/// <param name='skeleton'>An empty skeleton that receives the joints and channels.</param>
+/// <param name='numFrames'>Receives the number of frames.</param>
+/// <param name='frameTime'>Receives the seconds per frame.</param>
+HRESULT BVHClip::ParseHeader( BVHReader * reader, BVHSkeleton * skeleton, int * numFrames, float * frameTime )
+{
+	BVHToken line, token;
+
+	if ( !reader->NextLine( &line ) || !BVHReader::NextToken( &line, &token ) || !token.Equals( "HIERARCHY" ) )
+		return E_FAIL;
+
+	if ( FAILED( ParseHierarchy( reader, skeleton ) ) )
+		return E_FAIL;
+
+	// Skip blank lines between the hierarchy and the motion section
+
+	do
+	{
+		if ( !reader->NextLine( &line ) )
+			return E_FAIL;
+	} while ( !BVHReader::NextToken( &line, &token ) );
+
+	if ( !token.Equals( "MOTION" ) )
+		return E_FAIL;
+
+	return ParseMotionHeader( reader, numFrames, frameTime );
+}
+
+/// <summary>Read and process the Hierarchy section of the BVH file.</summary>
+/// <param name='reader'>Reader positioned at the line after HIERARCHY.</param>
+/// <param name='skeleton'>An empty skeleton that receives the joints and channels.</param>
+HRESULT BVHClip::ParseHierarchy( BVHReader * reader, BVHSkeleton * skeleton )
+{
+    int depth = 0;
+	
+    int curJoint = -1;
+
+	BVHToken line, token;
+
+    do
+    {
+		if( !reader->NextLine( &line ) )
+			return E_FAIL;
+
+		// Process each line, the first token of each line determines which process
+
+		if( !BVHReader::NextToken( &line, &token ) )
+			continue;
+
+		if ( token.Equals( "{" ) ) {} // do nothing
+		else if ( token.Equals( "}" ) )
+		{
+			if( curJoint < 0 )
+				return E_FAIL;
+
+			int parent = skeleton->GetParent( curJoint );
+			if ( parent >= 0 )
+				curJoint = parent;
+			--depth;
+		} 
+		else if ( token.Equals( "ROOT" ) )
+		{
+			if( !BVHReader::NextToken( &line, &token ) )
+				return E_FAIL;
+
+			curJoint = skeleton->AddJoint( string( token.begin, token.end ), -1 );
+
+			++depth;
+		}
+		else if ( token.Equals( "JOINT" ) )
+		{
+			if( curJoint < 0 || !BVHReader::NextToken( &line, &token ) )
+				return E_FAIL;
+
+			curJoint = skeleton->AddJoint( string( token.begin, token.end ), curJoint );
+
+			++depth;
+		}
+		else if ( token.Equals( "End" ) )
+		{
+			if( curJoint < 0 )
+				return E_FAIL;
+
+			curJoint = skeleton->AddJoint( "", curJoint );
+
+			++depth;
+		}
+		else if ( token.Equals( "OFFSET" ) )
+		{
+			if( curJoint < 0 )
+				return E_FAIL;
+
+			BVHVector3 offset( 0, 0, 0 );
+
+			if( BVHReader::NextToken( &line, &token ) )
+				offset.x = ( float )BVHReader::ParseDouble( token );
+			if( BVHReader::NextToken( &line, &token ) )
+				offset.y = ( float )BVHReader::ParseDouble( token );
+			if( BVHReader::NextToken( &line, &token ) )
+				offset.z = ( float )BVHReader::ParseDouble( token );
+
+			skeleton->SetOffset( curJoint, offset );
+		}
+		else if ( token.Equals( "CHANNELS" ) )
+		{
+			if( curJoint < 0 || !BVHReader::NextToken( &line, &token ) )
+				return E_FAIL;
+
+			int nodeChannels = ( int )BVHReader::ParseLong( token );
+
+			for ( int c = 0; c < nodeChannels && BVHReader::NextToken( &line, &token ); ++c )
+			{
+				if( FAILED( skeleton->AddChannel( curJoint, parseChannel( token ) ) ) )
+					return E_FAIL;
+			}
+		}
+    } while ( depth > 0 );
+
+	return S_OK;
+}
+
+/// <summary>Read the Frames: and Frame Time: headers of the Motion data section.</summary>
+/// <param name='reader'>Reader positioned at the line after MOTION, left at the first frame.</param>
+/// <param name='numFrames'>Receives the number of frames.</param>
+/// <param name='frameTime'>Receives the seconds per frame.</param>
+HRESULT BVHClip::ParseMotionHeader( BVHReader * reader, int * numFrames, float * frameTime )
+{
+	BVHToken line, token;
+
+	*numFrames = 0;
+	*frameTime = 0;
+
+	while( *numFrames == 0 || *frameTime == 0 )
+	{
+		if( !reader->NextLine( &line ) )
+			return E_FAIL;
+
+		if( !BVHReader::NextToken( &line, &token ) )
+			continue;
+
+		if ( token.Equals( "Frames:" ) )
+        {
+			if( BVHReader::NextToken( &line, &token ) )
+				*numFrames = ( int )BVHReader::ParseLong( token );
+        }
+		else if ( token.Equals( "Frame" ) )
+        {
+			// Frame Time:
+			if( BVHReader::NextToken( &line, &token ) && BVHReader::NextToken( &line, &token ) )
+				*frameTime = ( float )BVHReader::ParseDouble( token );
+        }
+		else
+		{
+			return E_FAIL;
+		}
+	}
+
+	if( *numFrames <= 0 || *frameTime <= 0 )
+		return E_FAIL;
+
+	return S_OK;
+}
+
+/// <summary>Read and process the frames of the Motion data section of the BVH file.</summary>
+/// <param name='reader'>Reader positioned at the first frame.</param>
+HRESULT BVHClip::ProcessMotionData( BVHReader * reader )
+{
+	// Parse the frame data.
+	//
+	// Each line is one sample of motion data. 
+    // The numbers appear in the order of the channel specifications 
+	// as the skeleton hierarchy was parsed. The lines are independent,
+	// so they are parsed in parallel straight into their rows of motionData.
+	// The samples are kept as they are; matrices are built from them 
+	// when a pose is needed.
+
+	if( numChannels > 0 )
+	{
+		motionData.resize( numFrames * numChannels );
+
+		int numParsed = BVHReader::ParseFrames( reader->GetPosition(), reader->GetEnd(), 
+			&motionData[0], numFrames, numChannels, BVHThreadPool::GetShared() );
+
+		if( numParsed < numFrames )
+			return E_FAIL;
+	}
+
+	return S_OK;
+}
+
+/// <summary>
+/// Returns the index of the frame shown at a time, looping the clip.
+/// </summary>
+/// <param name='time'>Seconds from the start of the clip.</param>
+int BVHClip::GetFrameIndex( float time ) const
+{
+	if( numFrames == 0 )
+		return 0;
+
+	// Rounded down, so a time just before the start shows the last frame
+	int frame = ( int )floorf( time / frameTime ) % numFrames;
+	return frame < 0 ? frame + numFrames : frame;
+}
+
+/// <summary>
+/// Finds the two frames a time falls between, looping the clip, so a pose
+/// can be interpolated between them.
+/// </summary>
+/// <param name='time'>Seconds from the start of the clip.</param>
+/// <param name='frame'>Receives the index of the frame at or before the time.</param>
+/// <param name='nextFrame'>Receives the index of the frame after it, the first frame after the last.</param>
+/// <returns>How far the time is from frame to nextFrame, from 0 up to 1.</returns>
+float BVHClip::GetFrameIndices( float time, int * frame, int * nextFrame ) const
+{
+	*frame = *nextFrame = 0;
+	if( numFrames == 0 )
+		return 0;
+
+	float position = time / frameTime;
+	float whole = floorf( position );
+
+	int index = ( int )whole % numFrames;
+	*frame = index < 0 ? index + numFrames : index;
+	*nextFrame = *frame + 1 < numFrames ? *frame + 1 : 0;
+
+	return position - whole;
+}
+
+/// <summary>
+/// Returns the samples of a frame, or NULL if the clip has no channels.
+/// </summary>
+const float * BVHClip::GetFrame( int frame ) const
+{
+	return numChannels > 0 ? &motionData[( size_t )frame * numChannels] : NULL;
+}
+
+/// <summary>
+/// Returns the bytes the clip takes up in memory, its skeleton and motion data.
+/// </summary>
+size_t BVHClip::GetSize() const
+{
+	return sizeof( *this ) + skeleton.GetSize() + motionData.capacity() * sizeof( float );
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "BVHCache.h"
+#include "BVHFile.h"
+#include "BVHSkeleton.h"
+
+using namespace std;
+
+/// <summary>
+/// The skeleton and motion data of a BVH file.
+/// </summary>
+class BVHClip
+{
+protected:
+	BVHSkeleton					skeleton;
+	vector<float>				motionData;		// numFrames rows of numChannels samples
+	int							numChannels;
+	int							numFrames;
+	float						frameTime;
+	HRESULT ParseBVH( const string & fileName );
+	HRESULT ReadBVHCache( const string & cacheFileName );
+	HRESULT WriteBVHCache( const string & cacheFileName );
+	HRESULT ProcessMotionData( BVHReader * reader );
+	static HRESULT ParseHierarchy( BVHReader * reader, BVHSkeleton * skeleton );
+	static HRESULT ParseMotionHeader( BVHReader * reader, int * numFrames, float * frameTime );
+public:
+	BVHClip(void);
+	~BVHClip(void);
+	HRESULT ReadBVH( const string & fileName, bool useCache = true );
+	static HRESULT ParseHeader( BVHReader * reader, BVHSkeleton * skeleton, int * numFrames, float * frameTime );
+	static HRESULT ReadCacheSkeleton( const BVHCacheHeader & header, const char * data, BVHSkeleton * skeleton );
+	void Clear();
+	const BVHSkeleton & GetSkeleton() const { return skeleton; }
+	int GetNumChannels() const { return numChannels; }
+	int GetNumFrames() const { return numFrames; }
+	float GetFrameTime() const { return frameTime; }
+	int GetFrameIndex( float time ) const;
+	float GetFrameIndices( float time, int * frame, int * nextFrame ) const;
+	const float * GetFrame( int frame ) const;
+	size_t GetSize() const;
+};
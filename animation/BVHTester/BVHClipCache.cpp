@@ -0,0 +1,221 @@
+// BVHClipCache.cpp
+//
+// Summary:
+//	Hands out shared, reference counted clips, loading each BVH file only
+//	once until it changes on disk.
+
+#include "BVHClipCache.h"
+#include "BVHCache.h"
+
+#include <cstdlib>
+
+/// <summary>
+/// Gets the absolute path of a file with any ., .. and links resolved, so
+/// every name of the same file gives the same path.
+/// </summary>
+static bool GetFullPath( const string & fileName, string * fullPath )
+{
+#ifdef _WIN32
+	char path[MAX_PATH];
+	DWORD length = GetFullPathNameA( fileName.c_str(), MAX_PATH, path, NULL );
+	if( length == 0 || length >= MAX_PATH )
+		return false;
+
+	// Windows file names are case insensitive
+	CharLowerBuffA( path, length );
+	*fullPath = path;
+#else
+	char * path = realpath( fileName.c_str(), NULL );
+	if( path == NULL )
+		return false;
+
+	*fullPath = path;
+	free( path );
+#endif
+	return true;
+}
+
+BVHClipCache::BVHClipCache( void )
+{
+	BVHMutexInit( &lock );
+	BVHConditionInit( &loaded );
+}
+
+/// <summary>
+/// Frees every clip, including any still referenced.
+/// </summary>
+BVHClipCache::~BVHClipCache( void )
+{
+	for( map<Key, Entry *>::iterator e = entries.begin(); e != entries.end(); ++e )
+	{
+		delete e->second->clip;
+		delete e->second;
+	}
+
+	BVHConditionDestroy( &loaded );
+	BVHMutexDestroy( &lock );
+}
+
+/// <summary>
+/// Removes an entry from the maps, so later Acquires load its file again.
+/// Call with the lock held.
+/// </summary>
+void BVHClipCache::Remove( Entry * entry )
+{
+	map<Key, Entry *>::iterator found = entries.find( Key( entry->path, entry->fileTime ) );
+	if( found != entries.end() && found->second == entry )
+		entries.erase( found );
+
+	if( entry->clip != NULL )
+		clips.erase( entry->clip );
+}
+
+/// <summary>
+/// Gets a reference to the clip of a BVH file, loading it if it is not
+/// loaded or has been written since. Pass the clip to Release when done.
+/// </summary>
+/// <param name='fileName'>Name of the BVH file. Any name of the same file gets the same clip.</param>
+/// <param name='clip'>Receives the clip.</param>
+/// <param name='useCache'>Passed to BVHClip::ReadBVH if the clip is loaded.</param>
+HRESULT BVHClipCache::Acquire( const string & fileName, const BVHClip ** clip, bool useCache )
+{
+	*clip = NULL;
+
+	string path;
+	unsigned long long fileTime;
+	if( !GetFullPath( fileName, &path ) || !GetBVHFileTime( path.c_str(), &fileTime ) )
+		return E_FAIL;
+
+	Key key( path, fileTime );
+
+	BVHMutexLock( &lock );
+
+	map<Key, Entry *>::iterator found = entries.find( key );
+	if( found != entries.end() )
+	{
+		// The reference keeps the entry alive while another thread loads it
+		Entry * entry = found->second;
+		++entry->refCount;
+		while( entry->loading )
+			BVHConditionWait( &loaded, &lock );
+
+		*clip = entry->clip;
+
+		Entry * failed = NULL;
+		if( entry->clip == NULL && --entry->refCount == 0 )
+			failed = entry;
+
+		BVHMutexUnlock( &lock );
+		delete failed;
+		return *clip != NULL ? S_OK : E_FAIL;
+	}
+
+	// Other Acquires of the file find this entry and wait for the load. An
+	// older version of the file stays loaded until its last reference goes.
+	Entry * entry = new Entry();
+	entry->path = path;
+	entry->fileTime = fileTime;
+	entry->clip = NULL;
+	entry->refCount = 1;
+	entry->loading = true;
+	entries[key] = entry;
+
+	BVHMutexUnlock( &lock );
+
+	BVHClip * newClip = new BVHClip();
+	if( FAILED( newClip->ReadBVH( path, useCache ) ) )
+	{
+		delete newClip;
+		newClip = NULL;
+	}
+
+	BVHMutexLock( &lock );
+
+	entry->loading = false;
+	entry->clip = newClip;
+
+	// A failed entry is removed at once, so the next Acquire tries again
+	Entry * failed = NULL;
+	if( newClip != NULL )
+	{
+		clips[newClip] = entry;
+	}
+	else
+	{
+		Remove( entry );
+		if( --entry->refCount == 0 )
+			failed = entry;
+	}
+
+	BVHConditionWakeAll( &loaded );
+	BVHMutexUnlock( &lock );
+
+	delete failed;
+	*clip = newClip;
+	return newClip != NULL ? S_OK : E_FAIL;
+}
+
+/// <summary>
+/// Adds a reference to a clip from Acquire.
+/// </summary>
+void BVHClipCache::AddRef( const BVHClip * clip )
+{
+	if( clip == NULL )
+		return;
+
+	BVHMutexLock( &lock );
+	map<const BVHClip *, Entry *>::iterator found = clips.find( clip );
+	if( found != clips.end() )
+		++found->second->refCount;
+	BVHMutexUnlock( &lock );
+}
+
+/// <summary>
+/// Releases a reference to a clip, freeing the clip with its last reference.
+/// </summary>
+void BVHClipCache::Release( const BVHClip * clip )
+{
+	if( clip == NULL )
+		return;
+
+	Entry * unused = NULL;
+
+	BVHMutexLock( &lock );
+	map<const BVHClip *, Entry *>::iterator found = clips.find( clip );
+	if( found != clips.end() && --found->second->refCount == 0 )
+	{
+		unused = found->second;
+		Remove( unused );
+	}
+	BVHMutexUnlock( &lock );
+
+	if( unused != NULL )
+	{
+		delete unused->clip;
+		delete unused;
+	}
+}
+
+/// <summary>
+/// Returns the number of clips loaded.
+/// </summary>
+int BVHClipCache::GetNumClips()
+{
+	BVHMutexLock( &lock );
+	int numClips = ( int )clips.size();
+	BVHMutexUnlock( &lock );
+	return numClips;
+}
+
+// The shared cache is created while globals are initialized, before main
+// can start a thread, so no first use races another. It is never
+// destroyed, so a figure released as the program exits still finds it.
+static BVHClipCache * g_sharedClipCache = new BVHClipCache();
+
+/// <summary>
+/// Returns the cache used by BVHFigure and BVHBlendTree.
+/// </summary>
+BVHClipCache * BVHClipCache::GetShared()
+{
+	return g_sharedClipCache;
+}
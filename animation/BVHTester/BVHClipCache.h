@@ -0,0 +1,53 @@
+#pragma once
+
+#include <map>
+#include <string>
+
+#include "BVHClip.h"
+#include "BVHPlatform.h"
+
+using namespace std;
+
+/// <summary>
+/// Loaded clips shared by everything that plays them, so a BVH file is
+/// parsed and stored once however many figures use it. Clips are keyed by
+/// the file's absolute path and last write time, so every name of a file
+/// shares one clip, and are counted by reference; a clip is freed when its
+/// last reference is released.
+/// </summary>
+/// <remarks>
+/// Not to be confused with the cache files on disk, see BVHCache.h, which
+/// BVHClip uses to load a clip quickly in the first place. Clips handed
+/// out are immutable and may be read from any thread. Files are loaded
+/// without holding the lock, so loads of different files run in parallel
+/// and AddRef and Release never wait for one.
+/// </remarks>
+class BVHClipCache
+{
+protected:
+	struct Entry
+	{
+		string					path;			// Absolute, see GetFullPath
+		unsigned long long		fileTime;
+		BVHClip *				clip;			// NULL while loading, and if loading failed
+		int						refCount;		// Includes Acquires waiting for the load
+		bool					loading;
+	};
+
+	typedef pair<string, unsigned long long>	Key;	// Path and write time
+
+	BVHMutex					lock;
+	BVHCondition				loaded;			// Woken as each load finishes
+	map<Key, Entry *>			entries;
+	map<const BVHClip *, Entry *>	clips;		// The entry of each loaded clip
+
+	void Remove( Entry * entry );
+public:
+	BVHClipCache( void );
+	~BVHClipCache( void );
+	HRESULT Acquire( const string & fileName, const BVHClip ** clip, bool useCache = true );
+	void AddRef( const BVHClip * clip );
+	void Release( const BVHClip * clip );
+	int GetNumClips();
+	static BVHClipCache * GetShared();
+};
@@ -0,0 +1,594 @@
+// BVHClipStream.cpp
+//
+// Summary:
+//	Plays a clip from its file without loading it. The frames are read a
+//	block at a time into a small window, and a loader thread keeps the
+//	blocks ahead of the playback cursor resident, so only a seek away from
+//	the window waits for the disk.
+
+#include "BVHClipStream.h"
+#include "BVHProfiler.h"
+
+#include <cmath>
+
+// Bytes of the file first read for the header, doubled until it fits
+static const size_t g_headerBytes = 64 * 1024;
+
+// Largest header tried before the file is taken to be malformed
+static const size_t g_maxHeaderBytes = 16 * 1024 * 1024;
+
+// Bytes of motion data read at once while indexing the text
+static const size_t g_indexChunkBytes = 1024 * 1024;
+
+/// <summary>
+/// Moves to a byte offset of a file, which may be past 2GB.
+/// </summary>
+static bool SeekFile( FILE * file, long long offset )
+{
+#ifdef _WIN32
+	return _fseeki64( file, offset, SEEK_SET ) == 0;
+#else
+	return fseeko( file, ( off_t )offset, SEEK_SET ) == 0;
+#endif
+}
+
+/// <summary>
+/// Returns the size of a file in bytes, or -1 if it cannot be found.
+/// </summary>
+static long long GetFileSize( FILE * file )
+{
+#ifdef _WIN32
+	if( _fseeki64( file, 0, SEEK_END ) != 0 )
+		return -1;
+	return _ftelli64( file );
+#else
+	if( fseeko( file, 0, SEEK_END ) != 0 )
+		return -1;
+	return ftello( file );
+#endif
+}
+
+/// <summary>
+/// Creates a stream with no clip. Use BVHClipStream::Open to play one.
+/// </summary>
+BVHClipStream::BVHClipStream( void )
+{
+	BVHMutexInit( &lock );
+	BVHConditionInit( &cursorMoved );
+	BVHConditionInit( &blockLoaded );
+
+	file = NULL;
+	loaderRunning = false;
+	Close();
+}
+
+BVHClipStream::~BVHClipStream( void )
+{
+	Close();
+
+	BVHConditionDestroy( &cursorMoved );
+	BVHConditionDestroy( &blockLoaded );
+	BVHMutexDestroy( &lock );
+}
+
+/// <summary>
+/// Opens a BVH file for streaming and starts loading its first frames.
+/// </summary>
+/// <remarks>
+/// A text file is read through once to index where its blocks start;
+/// after that only the window is read. The cache file is used when it is
+/// current, but a stream never writes one.
+/// </remarks>
+/// <param name='fileName'>Name of BVH file to play.</param>
+/// <param name='blockFrames'>Frames read at once.</param>
+/// <param name='windowBlocks'>Blocks resident at once, at least 2.</param>
+/// <param name='useCache'>False to always read the text.</param>
+HRESULT BVHClipStream::Open( const string & fileName, int blockFrames, int windowBlocks, bool useCache )
+{
+	Close();
+
+	if( blockFrames < 1 || windowBlocks < 2 )
+		return E_INVALIDARG;
+
+	this->blockFrames = blockFrames;
+
+	string cacheFileName = fileName + "c";
+	HRESULT hr = E_FAIL;
+
+	if( useCache && IsBVHCacheCurrent( fileName.c_str(), cacheFileName.c_str() ) )
+		hr = OpenBinary( cacheFileName );
+
+	if( FAILED( hr ) )
+	{
+		Close();
+		this->blockFrames = blockFrames;
+		hr = OpenText( fileName );
+	}
+
+	if( FAILED( hr ) )
+	{
+		Close();
+		return E_FAIL;
+	}
+
+	numBlocks = ( numFrames + blockFrames - 1 ) / blockFrames;
+
+	// A skeleton without channels has no frames to read
+	if( numChannels == 0 )
+		return S_OK;
+
+	Slot empty;
+	empty.block = -1;
+	empty.ready = false;
+	slots.assign( windowBlocks < numBlocks ? windowBlocks : numBlocks, empty );
+	window.resize( slots.size() * blockFrames * numChannels );
+
+	loaderRunning = BVHThreadCreate( &loader, LoaderMain, this );
+	if( !loaderRunning )
+	{
+		Close();
+		return E_FAIL;
+	}
+
+	return S_OK;
+}
+
+/// <summary>
+/// Stops the loader and frees the window.
+/// </summary>
+void BVHClipStream::Close()
+{
+	if( loaderRunning )
+	{
+		BVHMutexLock( &lock );
+		shutdown = true;
+		BVHConditionWakeAll( &cursorMoved );
+		BVHMutexUnlock( &lock );
+
+		BVHThreadJoin( loader );
+		loaderRunning = false;
+	}
+
+	if( file != NULL )
+	{
+		fclose( file );
+		file = NULL;
+	}
+
+	skeleton.Clear();
+	vector<long long>().swap( blockOffsets );
+	vector<float>().swap( window );
+	vector<Slot>().swap( slots );
+	vector<char>().swap( text );
+
+	binary = false;
+	motionOffset = 0;
+	numChannels = 0;
+	numFrames = 0;
+	frameTime = 0;
+	blockFrames = 0;
+	numBlocks = 0;
+	cursorBlock = 0;
+	frame = NULL;
+	nextFrame = NULL;
+	weight = 0;
+	numSeeks = 0;
+	numStalls = 0;
+	shutdown = false;
+	failed = false;
+	numLoads = 0;
+}
+
+/// <summary>
+/// Reads the skeleton from a binary cache file. Frames are read later as
+/// whole rows straight from the motion section.
+/// </summary>
+/// <remarks>
+/// The header and the joints are validated as BVHClip does, except for the
+/// checksum, which covers the motion section and would mean reading it all.
+/// </remarks>
+HRESULT BVHClipStream::OpenBinary( const string & cacheFileName )
+{
+	file = fopen( cacheFileName.c_str(), "rb" );
+	if( file == NULL )
+		return E_FAIL;
+
+	long long size = GetFileSize( file );
+
+	BVHCacheHeader header;
+	if( size < ( long long )sizeof( header ) || !SeekFile( file, 0 ) || fread( &header, sizeof( header ), 1, file ) != 1 )
+		return E_FAIL;
+
+	if( memcmp( header.magic, "BVHC", 4 ) != 0 || header.version != BVH_CACHE_VERSION || header.fileSize != size )
+		return E_FAIL;
+
+	if( header.numFrames == 0 || header.numJoints == 0 || header.frameTime <= 0 )
+		return E_FAIL;
+
+	long long motionSize = ( long long )header.numFrames * header.numChannels * sizeof( float );
+	if( header.jointsOffset < sizeof( header ) ||
+		header.jointsOffset + ( size_t )header.numJoints * sizeof( BVHCacheJoint ) > header.channelsOffset ||
+		header.channelsOffset + ( size_t )header.numChannels > header.namesOffset ||
+		header.namesOffset > header.motionOffset ||
+		header.motionOffset + motionSize != size ||
+		header.motionOffset % sizeof( float ) != 0 )
+		return E_FAIL;
+
+	// Everything before the motion section: the joints, channels and names
+	vector<char> data( header.motionOffset );
+	if( !SeekFile( file, 0 ) || fread( &data[0], 1, data.size(), file ) != data.size() )
+		return E_FAIL;
+
+	if( FAILED( BVHClip::ReadCacheSkeleton( header, &data[0], &skeleton ) ) )
+		return E_FAIL;
+
+	binary = true;
+	motionOffset = header.motionOffset;
+	numChannels = header.numChannels;
+	numFrames = header.numFrames;
+	frameTime = header.frameTime;
+
+	return S_OK;
+}
+
+/// <summary>
+/// Reads the skeleton from the text of a BVH file and indexes its frames.
+/// </summary>
+HRESULT BVHClipStream::OpenText( const string & fileName )
+{
+	file = fopen( fileName.c_str(), "rb" );
+	if( file == NULL )
+		return E_FAIL;
+
+	// Read the start of the file until the whole header is in it
+
+	vector<char> header;
+	for( size_t size = g_headerBytes; ; size *= 2 )
+	{
+		header.resize( size );
+		if( !SeekFile( file, 0 ) )
+			return E_FAIL;
+
+		size_t numRead = fread( &header[0], 1, size, file );
+		bool whole = numRead < size;
+
+		skeleton.Clear();
+		BVHReader reader( &header[0], &header[0] + numRead );
+
+		// The line after Frame Time: must have started, or its number may be cut short
+		if( SUCCEEDED( BVHClip::ParseHeader( &reader, &skeleton, &numFrames, &frameTime ) ) &&
+			( whole || reader.GetPosition() < reader.GetEnd() ) )
+		{
+			motionOffset = reader.GetPosition() - &header[0];
+			break;
+		}
+
+		if( whole || size >= g_maxHeaderBytes )
+			return E_FAIL;
+	}
+
+	numChannels = skeleton.GetNumChannels();
+
+	return IndexText();
+}
+
+/// <summary>
+/// Reads through the motion section once and records where every block's
+/// first frame line starts, and where the last frame line ends. Lines
+/// that hold only whitespace are not frames, as in BVHReader::ParseFrames.
+/// </summary>
+HRESULT BVHClipStream::IndexText()
+{
+	if( !SeekFile( file, motionOffset ) )
+		return E_FAIL;
+
+	vector<char> chunk( g_indexChunkBytes );
+	long long offset = motionOffset;		// Of chunk[0]
+	long long lineStart = motionOffset;
+	long long end = -1;
+	bool blank = true;
+	int count = 0;
+
+	while( count < numFrames )
+	{
+		size_t numRead = fread( &chunk[0], 1, chunk.size(), file );
+		if( numRead == 0 )
+			break;
+
+		for( size_t i = 0; i < numRead && count < numFrames; ++i )
+		{
+			char c = chunk[i];
+
+			if( c == '\n' )
+			{
+				if( !blank )
+				{
+					if( count % blockFrames == 0 )
+						blockOffsets.push_back( lineStart );
+					if( ++count == numFrames )
+						end = offset + i + 1;
+				}
+
+				lineStart = offset + i + 1;
+				blank = true;
+			}
+			else if( c != ' ' && c != '\t' && c != '\r' )
+			{
+				blank = false;
+			}
+		}
+
+		offset += numRead;
+	}
+
+	// The last frame line need not end in a newline
+	if( count < numFrames && !blank )
+	{
+		if( count % blockFrames == 0 )
+			blockOffsets.push_back( lineStart );
+		++count;
+		end = offset;
+	}
+
+	if( count < numFrames )
+		return E_FAIL;
+
+	blockOffsets.push_back( end );
+
+	return S_OK;
+}
+
+/// <summary>
+/// Returns the number of frames in a block, fewer in the last.
+/// </summary>
+int BVHClipStream::GetBlockFrames( int block ) const
+{
+	int count = numFrames - block * blockFrames;
+	return count < blockFrames ? count : blockFrames;
+}
+
+/// <summary>
+/// Reads and parses the frames of a block. Only the loader thread reads
+/// the file once the stream is open.
+/// </summary>
+/// <param name='data'>Receives GetBlockFrames( block ) rows of samples.</param>
+HRESULT BVHClipStream::LoadBlock( int block, float * data )
+{
+	BVH_PROFILE_SCOPE( "LoadBlock" );
+
+	int count = GetBlockFrames( block );
+
+	if( binary )
+	{
+		size_t rowSize = numChannels * sizeof( float );
+		if( !SeekFile( file, motionOffset + ( long long )block * blockFrames * rowSize ) ||
+			fread( data, rowSize, count, file ) != ( size_t )count )
+			return E_FAIL;
+
+		return S_OK;
+	}
+
+	size_t size = ( size_t )( blockOffsets[block + 1] - blockOffsets[block] );
+	text.resize( size );
+
+	if( !SeekFile( file, blockOffsets[block] ) || fread( &text[0], 1, size, file ) != size )
+		return E_FAIL;
+
+	// The loader is already off the playback thread, so one block is parsed serially
+	if( BVHReader::ParseFrames( &text[0], &text[0] + size, data, count, numChannels, NULL ) < count )
+		return E_FAIL;
+
+	return S_OK;
+}
+
+/// <summary>
+/// Returns the slot a block is in or being loaded into, or -1.
+/// </summary>
+int BVHClipStream::FindSlot( int block ) const
+{
+	for( int s = 0; s < slots.size(); ++s )
+	{
+		if( slots[s].block == block )
+			return s;
+	}
+	return -1;
+}
+
+/// <summary>
+/// Returns the samples of a frame if its block is loaded, or NULL.
+/// </summary>
+const float * BVHClipStream::GetResidentFrame( int frame ) const
+{
+	int block = frame / blockFrames;
+	int slot = FindSlot( block );
+	if( slot < 0 || !slots[slot].ready )
+		return NULL;
+
+	return &window[( ( size_t )slot * blockFrames + frame - block * blockFrames ) * numChannels];
+}
+
+/// <summary>
+/// Returns the first block of the window that is in no slot, or -1 if the
+/// window is full. The window is the blocks from the cursor's onwards,
+/// looping past the end of the clip, as many as there are slots.
+/// </summary>
+int BVHClipStream::NextMissingBlock() const
+{
+	for( int i = 0; i < slots.size(); ++i )
+	{
+		int block = ( cursorBlock + i ) % numBlocks;
+		if( FindSlot( block ) < 0 )
+			return block;
+	}
+	return -1;
+}
+
+/// <summary>
+/// Returns a slot that holds no block of the window. There is always one
+/// while a block of the window is missing.
+/// </summary>
+int BVHClipStream::FindFreeSlot() const
+{
+	for( int s = 0; s < slots.size(); ++s )
+	{
+		if( slots[s].block < 0 || ( slots[s].block - cursorBlock + numBlocks ) % numBlocks >= slots.size() )
+			return s;
+	}
+	return -1;
+}
+
+/// <summary>
+/// Loads the blocks of the window nearest the cursor first, then sleeps
+/// until the cursor moves.
+/// </summary>
+/// <remarks>
+/// A slot is only reused while its block is outside the window. The window
+/// only moves in Seek, and the frames Seek returns are inside it, so the
+/// frames being played are never overwritten.
+/// </remarks>
+BVHThreadResult BVH_THREAD_CALL BVHClipStream::LoaderMain( void * stream )
+{
+	BVHClipStream * self = ( BVHClipStream * )stream;
+
+	BVH_PROFILE_THREAD( "BVHClipStream loader" );
+
+	BVHMutexLock( &self->lock );
+
+	while( !self->shutdown )
+	{
+		int block = self->failed ? -1 : self->NextMissingBlock();
+		if( block < 0 )
+		{
+			BVHConditionWait( &self->cursorMoved, &self->lock );
+			continue;
+		}
+
+		int s = self->FindFreeSlot();
+		Slot & slot = self->slots[s];
+		slot.block = block;
+		slot.ready = false;
+		float * data = &self->window[( size_t )s * self->blockFrames * self->numChannels];
+
+		BVHMutexUnlock( &self->lock );
+		HRESULT hr = self->LoadBlock( block, data );
+		BVHMutexLock( &self->lock );
+
+		if( FAILED( hr ) )
+		{
+			slot.block = -1;
+			self->failed = true;
+		}
+		else
+		{
+			slot.ready = true;
+			++self->numLoads;
+		}
+
+		BVHConditionWakeAll( &self->blockLoaded );
+	}
+
+	BVHMutexUnlock( &self->lock );
+
+	return 0;
+}
+
+/// <summary>
+/// Moves the playback cursor to a time, looping the clip, and finds the
+/// two frames it falls between. Waits only if their blocks are not loaded
+/// yet; the loader then moves on to the blocks after them.
+/// </summary>
+/// <param name='time'>Seconds from the start of the clip.</param>
+/// <returns>E_FAIL if the stream is not open or its file could not be read.</returns>
+HRESULT BVHClipStream::Seek( float time )
+{
+	if( numFrames == 0 )
+		return E_FAIL;
+
+	++numSeeks;
+
+	float position = time / frameTime;
+	float whole = floorf( position );
+
+	int index = ( int )whole % numFrames;
+	if( index < 0 )
+		index += numFrames;
+	int nextIndex = index + 1 < numFrames ? index + 1 : 0;
+
+	weight = position - whole;
+
+	if( numChannels == 0 )
+	{
+		frame = nextFrame = NULL;
+		return S_OK;
+	}
+
+	BVHMutexLock( &lock );
+
+	if( index / blockFrames != cursorBlock )
+	{
+		cursorBlock = index / blockFrames;
+		BVHConditionWakeAll( &cursorMoved );
+	}
+
+	frame = GetResidentFrame( index );
+	nextFrame = GetResidentFrame( nextIndex );
+
+	if( frame == NULL || nextFrame == NULL )
+	{
+		BVH_PROFILE_SCOPE( "Stall" );
+
+		++numStalls;
+
+		while( ( frame == NULL || nextFrame == NULL ) && !failed )
+		{
+			BVHConditionWait( &blockLoaded, &lock );
+			frame = GetResidentFrame( index );
+			nextFrame = GetResidentFrame( nextIndex );
+		}
+	}
+
+	BVHMutexUnlock( &lock );
+
+	if( frame == NULL || nextFrame == NULL )
+	{
+		frame = nextFrame = NULL;
+		return E_FAIL;
+	}
+
+	return S_OK;
+}
+
+/// <summary>
+/// Gets the two frames the last Seek fell between.
+/// </summary>
+/// <param name='frame'>Receives the samples of the frame at or before the time, or NULL if there are none.</param>
+/// <param name='nextFrame'>Receives the samples of the frame after it, the first frame after the last.</param>
+/// <returns>How far the time is from frame to nextFrame, from 0 up to 1.</returns>
+float BVHClipStream::GetFrames( const float ** frame, const float ** nextFrame ) const
+{
+	*frame = this->frame;
+	*nextFrame = this->nextFrame;
+	return weight;
+}
+
+/// <summary>
+/// Returns the bytes the stream holds: the window, the loader's text
+/// buffer and the block index. Only the index grows with the clip, by
+/// one offset per block.
+/// </summary>
+size_t BVHClipStream::GetResidentSize() const
+{
+	return window.capacity() * sizeof( float ) + text.capacity() +
+		blockOffsets.capacity() * sizeof( long long ) + slots.capacity() * sizeof( Slot );
+}
+
+/// <summary>
+/// Returns the number of blocks the loader has read.
+/// </summary>
+int BVHClipStream::GetNumLoads()
+{
+	BVHMutexLock( &lock );
+	int count = numLoads;
+	BVHMutexUnlock( &lock );
+	return count;
+}
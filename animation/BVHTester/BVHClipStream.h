@@ -0,0 +1,97 @@
+#pragma once
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "BVHCache.h"
+#include "BVHClip.h"
+#include "BVHPlatform.h"
+#include "BVHSkeleton.h"
+
+using namespace std;
+
+/// <summary>
+/// A clip played straight from its file, for captures too long to load.
+/// Only a window of frames is resident: the frames are read in blocks, and
+/// a loader thread fills the window with the blocks ahead of the playback
+/// cursor while the current ones play. Memory use depends on the window,
+/// not on the length of the clip.
+/// </summary>
+/// <remarks>
+/// Frames are read from the binary cache file while it is current, as
+/// whole rows at computed offsets, and otherwise from the text, through an
+/// index of where each block's lines start. A stream has one cursor, so it
+/// plays for one figure, and Seek and the frames it returns must be used
+/// from one thread at a time.
+/// </remarks>
+class BVHClipStream
+{
+protected:
+	// A block of frames in the window
+	struct Slot
+	{
+		int						block;			// Block held, or -1
+		bool					ready;			// False while the loader fills it
+	};
+
+	BVHSkeleton					skeleton;
+	FILE *						file;
+	bool						binary;			// Reading the cache file rather than the text
+	long long					motionOffset;	// File offset of the first frame
+	vector<long long>			blockOffsets;	// Text offset of each block's first line, then of the end of the last
+	int							numChannels;
+	int							numFrames;
+	float						frameTime;
+	int							blockFrames;	// Frames per block
+	int							numBlocks;
+	vector<float>				window;			// One block of rows per slot
+	vector<Slot>				slots;
+
+	// Playback, set by Seek
+	int							cursorBlock;	// First of the blocks the loader keeps resident
+	const float *				frame;
+	const float *				nextFrame;
+	float						weight;
+	int							numSeeks;
+	int							numStalls;		// Seeks that waited for the loader
+
+	// The loader thread, and the state it shares with Seek under lock
+	BVHThread					loader;
+	bool						loaderRunning;
+	BVHMutex					lock;
+	BVHCondition				cursorMoved;
+	BVHCondition				blockLoaded;
+	bool						shutdown;
+	bool						failed;
+	int							numLoads;
+	vector<char>				text;			// The lines of the block being loaded
+
+	HRESULT OpenBinary( const string & cacheFileName );
+	HRESULT OpenText( const string & fileName );
+	HRESULT IndexText();
+	HRESULT LoadBlock( int block, float * data );
+	int GetBlockFrames( int block ) const;
+	int FindSlot( int block ) const;
+	const float * GetResidentFrame( int frame ) const;
+	int NextMissingBlock() const;
+	int FindFreeSlot() const;
+	static BVHThreadResult BVH_THREAD_CALL LoaderMain( void * stream );
+public:
+	BVHClipStream( void );
+	~BVHClipStream( void );
+	HRESULT Open( const string & fileName, int blockFrames = 256, int windowBlocks = 8, bool useCache = true );
+	void Close();
+	const BVHSkeleton & GetSkeleton() const { return skeleton; }
+	int GetNumChannels() const { return numChannels; }
+	int GetNumFrames() const { return numFrames; }
+	float GetFrameTime() const { return frameTime; }
+	bool IsBinary() const { return binary; }
+	HRESULT Seek( float time );
+	const float * GetFrame() const { return frame; }
+	float GetFrames( const float ** frame, const float ** nextFrame ) const;
+	size_t GetResidentSize() const;
+	int GetNumSeeks() const { return numSeeks; }
+	int GetNumStalls() const { return numStalls; }
+	int GetNumLoads();
+};
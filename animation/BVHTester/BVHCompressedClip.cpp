@@ -0,0 +1,257 @@
+// BVHCompressedClip.cpp
+//
+// Summary:
+//	Lossy compression of a clip's motion data. Keys a linear interpolation
+//	can rebuild within the error bound are dropped from each channel, and
+//	the rest are quantized to 16 bits over the channel's range.
+
+#include "BVHCompressedClip.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+/// <summary>
+/// Returns whether a channel holds an angle rather than a position.
+/// </summary>
+static inline bool IsRotation( Channel channel )
+{
+	return channel == Xrotation || channel == Yrotation || channel == Zrotation;
+}
+
+/// <summary>
+/// Creates an empty clip. Use BVHCompressedClip::Compress to fill it.
+/// </summary>
+BVHCompressedClip::BVHCompressedClip( void )
+{
+	numFrames = 0;
+	frameTime = 0;
+	maxAngleError = 0;
+	maxPositionError = 0;
+}
+
+BVHCompressedClip::~BVHCompressedClip( void )
+{
+}
+
+/// <summary>
+/// Removes the skeleton and keys.
+/// </summary>
+void BVHCompressedClip::Clear()
+{
+	skeleton.Clear();
+	curves.clear();
+	keyFrames.clear();
+	keyValues.clear();
+	numFrames = 0;
+	frameTime = 0;
+	maxAngleError = 0;
+	maxPositionError = 0;
+}
+
+/// <summary>
+/// Compresses the motion data of a clip.
+/// </summary>
+/// <param name='clip'>The clip to compress, which is left as it is.</param>
+/// <param name='maxAngleError'>Largest error allowed in a joint's rotation, in degrees.</param>
+/// <param name='maxPositionError'>Largest error allowed in a position channel.</param>
+HRESULT BVHCompressedClip::Compress( const BVHClip & clip, float maxAngleError, float maxPositionError )
+{
+	Clear();
+
+	if( clip.GetNumFrames() > 65536 || clip.GetNumChannels() != clip.GetSkeleton().GetNumChannels() )
+		return E_INVALIDARG;
+
+	skeleton = clip.GetSkeleton();
+	numFrames = clip.GetNumFrames();
+	frameTime = clip.GetFrameTime();
+	curves.resize( clip.GetNumChannels() );
+
+	for( int c = 0; c < curves.size(); ++c )
+		CompressCurve( clip, c, IsRotation( skeleton.GetChannel( c ) ) ? maxAngleError / 3.0f : maxPositionError );
+
+	// Measure what the bounds allowed
+	vector<float> samples( curves.size() );
+	for( int f = 0; f < numFrames; ++f )
+	{
+		DecodeFrame( f, samples.empty() ? NULL : &samples[0] );
+
+		const float * frame = clip.GetFrame( f );
+		for( int c = 0; c < curves.size(); ++c )
+		{
+			float error = fabsf( samples[c] - frame[c] );
+			if( IsRotation( skeleton.GetChannel( c ) ) )
+				this->maxAngleError = max( this->maxAngleError, error );
+			else
+				this->maxPositionError = max( this->maxPositionError, error );
+		}
+	}
+
+	return S_OK;
+}
+
+/// <summary>
+/// Quantizes a channel and keeps the fewest keys, greedily, that rebuild
+/// every frame within an error.
+/// </summary>
+/// <remarks>
+/// Each key reaches as many frames forward as a straight line from it can
+/// cover. The line runs between the quantized values the keys will hold,
+/// so quantization is part of the error that is checked.
+///
+/// Every frame passed bounds the slopes a line from the key may take to
+/// keep that frame within the error. The bounds only narrow, so keeping
+/// the narrowest pair tests each frame once and the curve takes linear
+/// time, rather than testing every frame passed again for each new end.
+/// </remarks>
+void BVHCompressedClip::CompressCurve( const BVHClip & clip, int channel, float maxError )
+{
+	Curve & curve = curves[channel];
+	curve.firstKey = ( int )keyFrames.size();
+	curve.numKeys = 0;
+
+	if( numFrames == 0 )
+	{
+		curve.minimum = 0;
+		curve.step = 0;
+		return;
+	}
+
+	vector<float> values( numFrames );
+	for( int f = 0; f < numFrames; ++f )
+		values[f] = clip.GetFrame( f )[channel];
+
+	float minimum = *min_element( values.begin(), values.end() );
+	float maximum = *max_element( values.begin(), values.end() );
+	curve.minimum = minimum;
+	curve.step = ( maximum - minimum ) / 65535.0f;
+
+	vector<unsigned short> quantized( numFrames );
+	for( int f = 0; f < numFrames; ++f )
+	{
+		float units = curve.step > 0 ? ( values[f] - minimum ) / curve.step + 0.5f : 0.0f;
+		quantized[f] = ( unsigned short )min( max( units, 0.0f ), 65535.0f );
+	}
+
+	int key = 0;
+	keyFrames.push_back( 0 );
+	keyValues.push_back( quantized[0] );
+
+	while( key < numFrames - 1 )
+	{
+		float from = minimum + quantized[key] * curve.step;
+		float lowSlope = -FLT_MAX;
+		float highSlope = FLT_MAX;
+
+		// The next frame always rebuilds exactly, so start past it
+		int reach = key + 1;
+		for( int end = key + 2; end < numFrames; ++end )
+		{
+			// The frame before the end is the one the line now also passes
+			int f = end - 1;
+			lowSlope = max( lowSlope, ( values[f] - maxError - from ) / ( f - key ) );
+			highSlope = min( highSlope, ( values[f] + maxError - from ) / ( f - key ) );
+
+			float to = minimum + quantized[end] * curve.step;
+			float slope = ( to - from ) / ( end - key );
+			if( slope < lowSlope || slope > highSlope )
+				break;
+			reach = end;
+		}
+
+		keyFrames.push_back( ( unsigned short )reach );
+		keyValues.push_back( quantized[reach] );
+		key = reach;
+	}
+
+	curve.numKeys = ( int )keyFrames.size() - curve.firstKey;
+}
+
+/// <summary>
+/// Returns the value of a curve at a frame position from 0 to the last frame.
+/// </summary>
+float BVHCompressedClip::SampleCurve( const Curve & curve, float frame ) const
+{
+	const unsigned short * frames = &keyFrames[curve.firstKey];
+	const unsigned short * values = &keyValues[curve.firstKey];
+
+	// The last key at or before the frame
+	int k = ( int )( upper_bound( frames, frames + curve.numKeys, ( unsigned short )frame ) - frames ) - 1;
+	if( k < 0 )
+		k = 0;
+
+	float value = curve.minimum + values[k] * curve.step;
+	if( k + 1 >= curve.numKeys )
+		return value;
+
+	float next = curve.minimum + values[k + 1] * curve.step;
+	return value + ( next - value ) * ( frame - frames[k] ) / ( frames[k + 1] - frames[k] );
+}
+
+/// <summary>
+/// Returns the total size of the keys and curves in bytes.
+/// </summary>
+size_t BVHCompressedClip::GetSize() const
+{
+	return curves.size() * sizeof( Curve ) + keyFrames.size() * sizeof( unsigned short ) + keyValues.size() * sizeof( unsigned short );
+}
+
+/// <summary>
+/// Returns the index of the frame shown at a time, looping the clip, as
+/// BVHClip::GetFrameIndex does.
+/// </summary>
+/// <param name='time'>Seconds from the start of the clip.</param>
+int BVHCompressedClip::GetFrameIndex( float time ) const
+{
+	if( numFrames == 0 )
+		return 0;
+
+	int frame = ( int )floorf( time / frameTime ) % numFrames;
+	return frame < 0 ? frame + numFrames : frame;
+}
+
+/// <summary>
+/// Decodes the samples of a frame.
+/// </summary>
+/// <param name='frame'>Index of the frame, from 0 to GetNumFrames() - 1.</param>
+/// <param name='samples'>Receives GetNumChannels() samples, laid out like a frame of BVHClip.</param>
+void BVHCompressedClip::DecodeFrame( int frame, float * samples ) const
+{
+	for( int c = 0; c < curves.size(); ++c )
+		samples[c] = SampleCurve( curves[c], ( float )frame );
+}
+
+/// <summary>
+/// Decodes the samples at a time, looping the clip. Between frames the
+/// samples are interpolated, as BVHFigure::SetInterpolate does.
+/// </summary>
+/// <param name='time'>Seconds from the start of the clip.</param>
+/// <param name='samples'>Receives GetNumChannels() samples, laid out like a frame of BVHClip.</param>
+void BVHCompressedClip::DecodeTime( float time, float * samples ) const
+{
+	if( numFrames == 0 )
+		return;
+
+	float position = time / frameTime;
+	float whole = floorf( position );
+	float weight = position - whole;
+
+	int frame = ( int )whole % numFrames;
+	if( frame < 0 )
+		frame += numFrames;
+
+	// The curves end at the last frame, so the wrap to the first is blended here
+	if( frame == numFrames - 1 && weight > 0 )
+	{
+		for( int c = 0; c < curves.size(); ++c )
+		{
+			float from = SampleCurve( curves[c], ( float )frame );
+			float to = SampleCurve( curves[c], 0.0f );
+			samples[c] = from + ( to - from ) * weight;
+		}
+		return;
+	}
+
+	for( int c = 0; c < curves.size(); ++c )
+		samples[c] = SampleCurve( curves[c], frame + weight );
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <vector>
+
+#include "BVHClip.h"
+#include "BVHSkeleton.h"
+
+using namespace std;
+
+/// <summary>
+/// A clip stored as one piecewise linear curve per channel, with only the
+/// keys needed to stay within an error bound, each quantized to 16 bits.
+/// Any frame decodes on its own, so playback can start or jump anywhere.
+/// BVHFigure::SetCompressedClip plays one.
+/// </summary>
+/// <remarks>
+/// A rotation channel is kept within a third of the angle bound, so the
+/// joint rotation composed of three of them stays within the whole bound.
+/// Clips are limited to 65536 frames, the range of a key's frame index.
+/// </remarks>
+class BVHCompressedClip
+{
+protected:
+	// The keys of one channel
+	struct Curve
+	{
+		float					minimum;		// Value of a quantized 0
+		float					step;			// Value of one quantized unit
+		int						firstKey;		// Index into keyFrames and keyValues
+		int						numKeys;
+	};
+
+	BVHSkeleton					skeleton;
+	vector<Curve>				curves;			// One per channel
+	vector<unsigned short>		keyFrames;		// Frame index of each key, increasing per curve
+	vector<unsigned short>		keyValues;		// Quantized value of each key
+	int							numFrames;
+	float						frameTime;
+	float						maxAngleError;	// Largest rotation channel error, in degrees
+	float						maxPositionError;	// Largest position channel error
+
+	void CompressCurve( const BVHClip & clip, int channel, float maxError );
+	float SampleCurve( const Curve & curve, float frame ) const;
+public:
+	BVHCompressedClip( void );
+	~BVHCompressedClip( void );
+	HRESULT Compress( const BVHClip & clip, float maxAngleError, float maxPositionError );
+	void Clear();
+	const BVHSkeleton & GetSkeleton() const { return skeleton; }
+	int GetNumChannels() const { return ( int )curves.size(); }
+	int GetNumFrames() const { return numFrames; }
+	float GetFrameTime() const { return frameTime; }
+	int GetNumKeys() const { return ( int )keyFrames.size(); }
+	size_t GetSize() const;
+	int GetFrameIndex( float time ) const;
+	float GetMaxAngleError() const { return maxAngleError; }
+	float GetMaxPositionError() const { return maxPositionError; }
+	void DecodeFrame( int frame, float * samples ) const;
+	void DecodeTime( float time, float * samples ) const;
+};
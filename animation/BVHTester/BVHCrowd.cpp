@@ -0,0 +1,315 @@
+// BVHCrowd.cpp
+//
+// Summary:
+//	Poses a crowd of figures that share clips. Each figure has its own time
+//	offset, playback rate and root transform. Figures of the same clip are
+//	posed in SIMD lanes, and the lanes are spread across a thread pool.
+
+#include "BVHCrowd.h"
+#include "BVHProfiler.h"
+
+// Blocks claimed at once by a thread, enough to keep the pool's counters cool
+#define BVH_CROWD_GRAIN 4
+
+/// <summary>
+/// Creates an empty crowd.
+/// </summary>
+/// <param name='pool'>Threads to pose the crowd on, NULL for the shared pool.</param>
+BVHCrowd::BVHCrowd( BVHThreadPool * pool )
+{
+	this->pool = pool != NULL ? pool : BVHThreadPool::GetShared();
+	blocksDirty = false;
+	time = 0;
+	updateSeconds = 0;
+}
+
+BVHCrowd::~BVHCrowd( void )
+{
+	Clear();
+}
+
+/// <summary>
+/// Removes every figure.
+/// </summary>
+void BVHCrowd::Clear()
+{
+	ClearClips();
+	figures.clear();
+	firstTransforms.clear();
+	transforms.clear();
+	blocksDirty = false;
+}
+
+/// <summary>
+/// Frees the pose batches and blocks, which BuildBlocks makes again.
+/// </summary>
+void BVHCrowd::ClearClips()
+{
+	for( int c = 0; c < clips.size(); ++c )
+	{
+		for( int b = 0; b < clips[c].batches.size(); ++b )
+			delete clips[c].batches[b];
+	}
+
+	clips.clear();
+	order.clear();
+	blocks.clear();
+}
+
+/// <summary>
+/// Adds a copy of a figure. The copy shares the figure's clip.
+/// </summary>
+/// <remarks>
+/// Figures playing a BVHClipStream are not added; a stream has one cursor,
+/// so it cannot be shared by the copies in a crowd. For the same reason a
+/// figure playing a BVHBlendTree or keeping a BVHPoseCache must be the
+/// only one using that tree or cache.
+/// </remarks>
+/// <returns>The index of the figure in the crowd, or -1 if it has no clip frames or blend tree to play, or plays a blend tree or keeps a pose cache another figure of the crowd does.</returns>
+int BVHCrowd::AddFigure( const BVHFigure & figure )
+{
+	if( !IsPlayable( figure ) || IsShared( figure, -1 ) )
+		return -1;
+
+	figures.push_back( figure );
+	blocksDirty = true;
+
+	return ( int )figures.size() - 1;
+}
+
+/// <summary>
+/// Replaces a figure, for example to move it or change its clip. A figure
+/// AddFigure would not add leaves the old one in place.
+/// </summary>
+void BVHCrowd::SetFigure( int figure, const BVHFigure & value )
+{
+	if( !IsPlayable( value ) || IsShared( value, figure ) )
+		return;
+
+	if( value.GetClip() != figures[figure].GetClip() || IsPosedAlone( value ) != IsPosedAlone( figures[figure] ) ||
+		value.GetBlendTree() != figures[figure].GetBlendTree() || value.GetCompressedClip() != figures[figure].GetCompressedClip() )
+		blocksDirty = true;
+
+	figures[figure] = value;
+}
+
+/// <summary>
+/// Returns whether a figure can be added: it plays a blend tree, or a clip
+/// or compressed clip with frames, and no stream.
+/// </summary>
+bool BVHCrowd::IsPlayable( const BVHFigure & figure )
+{
+	if( figure.GetStream() != NULL )
+		return false;
+
+	if( figure.GetBlendTree() != NULL )
+		return true;
+
+	if( figure.GetCompressedClip() != NULL )
+		return figure.GetCompressedClip()->GetNumFrames() > 0;
+
+	return figure.GetClip() != NULL && figure.GetClip()->GetNumFrames() > 0;
+}
+
+/// <summary>
+/// Returns whether a figure plays a blend tree, or keeps a pose cache,
+/// that a figure of the crowd other than the one at except does too.
+/// Figures posed alone are posed on different threads at once, and a tree
+/// or cache holds the state of one.
+/// </summary>
+bool BVHCrowd::IsShared( const BVHFigure & figure, int except ) const
+{
+	const BVHBlendTree * blendTree = figure.GetBlendTree();
+	const BVHPoseCache * poseCache = figure.GetPoseCache();
+	if( blendTree == NULL && poseCache == NULL )
+		return false;
+
+	for( int i = 0; i < figures.size(); ++i )
+	{
+		if( i == except )
+			continue;
+
+		if( ( blendTree != NULL && figures[i].GetBlendTree() == blendTree ) ||
+			( poseCache != NULL && figures[i].GetPoseCache() == poseCache ) )
+			return true;
+	}
+
+	return false;
+}
+
+/// <summary>
+/// Returns whether a figure is posed on its own rather than in the lanes
+/// of a BVHPoseBatch: it plays a blend tree or a compressed clip, whose
+/// frames each figure decodes for itself, or keeps a pose cache.
+/// </summary>
+bool BVHCrowd::IsPosedAlone( const BVHFigure & figure )
+{
+	return figure.GetBlendTree() != NULL || figure.GetCompressedClip() != NULL || figure.GetPoseCache() != NULL;
+}
+
+/// <summary>
+/// Groups the figures by clip, cuts each group into blocks of one figure
+/// per SIMD lane, and lays out the figures' transforms. Each figure posed
+/// alone gets a block of its own.
+/// </summary>
+void BVHCrowd::BuildBlocks()
+{
+	ClearClips();
+
+	firstTransforms.resize( figures.size() );
+	int numTransforms = 0;
+	int maxAloneJoints = 0;
+
+	vector<bool> grouped( figures.size(), false );
+	for( int i = 0; i < figures.size(); ++i )
+	{
+		if( grouped[i] )
+			continue;
+
+		if( IsPosedAlone( figures[i] ) )
+		{
+			int numJoints = figures[i].GetSkeleton()->GetNumJoints();
+			if( numJoints > maxAloneJoints )
+				maxAloneJoints = numJoints;
+
+			grouped[i] = true;
+			order.push_back( i );
+			firstTransforms[i] = numTransforms;
+			numTransforms += numJoints;
+
+			Block block;
+			block.clip = -1;
+			block.first = ( int )order.size() - 1;
+			block.count = 1;
+			blocks.push_back( block );
+			continue;
+		}
+
+		Clip entry;
+		entry.clip = figures[i].GetClip();
+		for( int t = 0; t < pool->GetNumThreads(); ++t )
+			entry.batches.push_back( new BVHPoseBatch( entry.clip->GetSkeleton() ) );
+		clips.push_back( entry );
+
+		// This figure and every later one playing the same clip
+		int first = ( int )order.size();
+		for( int k = i; k < figures.size(); ++k )
+		{
+			if( !grouped[k] && !IsPosedAlone( figures[k] ) && figures[k].GetClip() == entry.clip )
+			{
+				grouped[k] = true;
+				order.push_back( k );
+				firstTransforms[k] = numTransforms;
+				numTransforms += entry.clip->GetSkeleton().GetNumJoints();
+			}
+		}
+
+		for( int b = first; b < order.size(); b += BVHPoseBatch::GetNumLanes() )
+		{
+			Block block;
+			block.clip = ( int )clips.size() - 1;
+			block.first = b;
+			block.count = ( int )order.size() - b < BVHPoseBatch::GetNumLanes() ? ( int )order.size() - b : BVHPoseBatch::GetNumLanes();
+			blocks.push_back( block );
+		}
+	}
+
+	figurePoses.resize( pool->GetNumThreads() );
+	for( int t = 0; t < figurePoses.size(); ++t )
+		figurePoses[t].resize( maxAloneJoints );
+
+	transforms.resize( numTransforms );
+	blocksDirty = false;
+}
+
+/// <summary>
+/// Poses the figures of a range of blocks.
+/// </summary>
+void BVHCrowd::EvaluateBlocks( void * crowd, int thread, int begin, int end )
+{
+	BVH_PROFILE_SCOPE( "EvaluateBlocks" );
+
+	BVHCrowd * self = ( BVHCrowd * )crowd;
+
+	const float * frames[BVH_SIMD_WIDTH];
+	const float * nextFrames[BVH_SIMD_WIDTH];
+	float weights[BVH_SIMD_WIDTH];
+	const BVHMatrix * roots[BVH_SIMD_WIDTH];
+	BVHAffine * poses[BVH_SIMD_WIDTH];
+
+	for( int b = begin; b < end; ++b )
+	{
+		const Block & block = self->blocks[b];
+		bool blend = false;
+
+		if( block.clip < 0 )
+		{
+			int i = self->order[block.first];
+			BVHFigure & figure = self->figures[i];
+			BVHMatrix * matrices = &self->figurePoses[thread][0];
+
+			figure.Update( self->time );
+			figure.EvaluatePose( matrices );
+
+			BVHAffine * pose = &self->transforms[self->firstTransforms[i]];
+			int numJoints = figure.GetSkeleton()->GetNumJoints();
+			for( int j = 0; j < numJoints; ++j )
+				BVHAffineFromMatrix( &pose[j], &matrices[j] );
+			continue;
+		}
+
+		for( int l = 0; l < block.count; ++l )
+		{
+			int i = self->order[block.first + l];
+			BVHFigure & figure = self->figures[i];
+
+			figure.Update( self->time );
+			weights[l] = figure.GetFrames( &frames[l], &nextFrames[l] );
+			roots[l] = &figure.GetWorld();
+			poses[l] = &self->transforms[self->firstTransforms[i]];
+
+			if( weights[l] != 0 )
+				blend = true;
+		}
+
+		// Blocks that all sit on whole frames skip the quaternion blend
+		self->clips[block.clip].batches[thread]->Evaluate( frames, blend ? nextFrames : NULL, weights, roots, block.count, poses );
+	}
+}
+
+/// <summary>
+/// Poses every figure at a time.
+/// </summary>
+/// <param name='time'>Seconds since the crowd started playing, passed to each figure's Update.</param>
+void BVHCrowd::Update( float time )
+{
+	double start = BVHGetSeconds();
+
+	if( blocksDirty )
+		BuildBlocks();
+
+	this->time = time;
+	pool->ParallelFor( ( int )blocks.size(), BVH_CROWD_GRAIN, EvaluateBlocks, this );
+
+	updateSeconds = BVHGetSeconds() - start;
+}
+
+/// <summary>
+/// Returns the world transform of every joint of a figure, as of the last
+/// Update, or NULL if the crowd has changed since and is not posed.
+/// </summary>
+const BVHAffine * BVHCrowd::GetPose( int figure ) const
+{
+	if( blocksDirty )
+		return NULL;
+
+	return &transforms[firstTransforms[figure]];
+}
+
+/// <summary>
+/// Returns how many figures the last Update posed per millisecond.
+/// </summary>
+double BVHCrowd::GetFiguresPerMillisecond() const
+{
+	return updateSeconds > 0 ? figures.size() / ( updateSeconds * 1000.0 ) : 0;
+}
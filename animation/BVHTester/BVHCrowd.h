@@ -0,0 +1,75 @@
+#pragma once
+
+#include <vector>
+
+#include "BVHClip.h"
+#include "BVHFigure.h"
+#include "BVHMath.h"
+#include "BVHPoseBatch.h"
+#include "BVHThreadPool.h"
+
+using namespace std;
+
+/// <summary>
+/// Many figures playing a few shared clips. Update poses every figure,
+/// spread across a thread pool, with figures of the same clip evaluated
+/// together in the SIMD lanes of BVHPoseBatch. Figures playing a
+/// BVHBlendTree or BVHCompressedClip, or keeping a BVHPoseCache, are posed
+/// one at a time, each through its own tree, decoded frame or cache.
+/// </summary>
+/// <remarks>
+/// Poses are only valid after Update. Once figures are added, or a
+/// figure is set to play another clip, the crowd has no poses until the
+/// next Update lays them out again.
+/// </remarks>
+class BVHCrowd
+{
+protected:
+	struct Clip
+	{
+		const BVHClip *			clip;
+		vector<BVHPoseBatch *>	batches;		// One per pool thread
+	};
+
+	// Figures of one clip that are posed together, one per lane
+	struct Block
+	{
+		int						clip;			// -1 for a figure posed alone, see IsPosedAlone
+		int						first;			// Index into order
+		int						count;
+	};
+
+	BVHThreadPool *				pool;
+	vector<BVHFigure>			figures;
+	vector<Clip>				clips;				// The clips the figures play
+	vector<int>					firstTransforms;	// Index in transforms of each figure's first joint
+	vector<BVHAffine>			transforms;			// World transform of every joint of every figure, see GetTransforms
+	vector<int>					order;				// Figures grouped by clip
+	vector<Block>				blocks;
+	vector< vector<BVHMatrix> >	figurePoses;		// Matrices of a figure posed alone, one per pool thread
+	bool						blocksDirty;
+	float						time;
+	double						updateSeconds;
+
+	void ClearClips();
+	void BuildBlocks();
+	static bool IsPlayable( const BVHFigure & figure );
+	static bool IsPosedAlone( const BVHFigure & figure );
+	bool IsShared( const BVHFigure & figure, int except ) const;
+	static void EvaluateBlocks( void * crowd, int thread, int begin, int end );
+public:
+	BVHCrowd( BVHThreadPool * pool = NULL );
+	~BVHCrowd( void );
+	int AddFigure( const BVHFigure & figure );
+	void SetFigure( int figure, const BVHFigure & value );
+	void Clear();
+	int GetNumFigures() const { return ( int )figures.size(); }
+	const BVHFigure & GetFigure( int figure ) const { return figures[figure]; }
+	void Update( float time );
+	bool IsPosed() const { return !blocksDirty; }
+	const BVHAffine * GetPose( int figure ) const;
+	int GetNumTransforms() const { return blocksDirty ? 0 : ( int )transforms.size(); }
+	const BVHAffine * GetTransforms() const { return blocksDirty || transforms.empty() ? NULL : &transforms[0]; }
+	double GetUpdateSeconds() const { return updateSeconds; }
+	double GetFiguresPerMillisecond() const;
+};
@@ -0,0 +1,101 @@
+#pragma once
+
+#include "BVHSimd.h"
+#include "BVHSkeleton.h"
+
+// Closed forms for the rotation of a joint's Euler angles, one per
+// RotationOrder. They are templated on the type of their values, so
+// BVHPoseBatch composes a pose in each SIMD lane with BVHFloats and
+// BVHSkeleton composes a single pose with floats from the same formulas.
+// A rotation matrix is written as rows 0 to 2 of a local array, the term
+// in row r, column c at local[r * 3 + c].
+
+/// <summary>
+/// Composes the rotation matrix of the Euler angles listed in the order I,
+/// J, K, with axes 0 to 2 for X to Z, from the sine and cosine of each
+/// axis's angle.
+/// </summary>
+/// <remarks>
+/// With column vectors the rotation is RI * RJ * RK, which for the cyclic
+/// orders XYZ, YZX and ZXY has a closed form in terms of I, J and K. The
+/// other three orders mirror those, which flips the sign of every sine.
+/// The D3DX matrix is the transpose.
+/// </remarks>
+template< int I, int J, int K, class T >
+inline void BVHComposeMatrix( const T * s, const T * c, T * local )
+{
+	const bool odd = J != ( I + 1 ) % 3;
+
+	T sasb = BVHSimdMul( s[I], s[J] );
+	T casb = BVHSimdMul( c[I], s[J] );
+	T cbsc = BVHSimdMul( c[J], s[K] );
+	T sacb = BVHSimdMul( s[I], c[J] );
+
+	local[I * 3 + I] = BVHSimdMul( c[J], c[K] );
+	local[J * 3 + I] = odd ? cbsc : BVHSimdNegate( cbsc );
+	local[K * 3 + I] = odd ? BVHSimdNegate( s[J] ) : s[J];
+	local[I * 3 + J] = odd ? BVHSimdSub( BVHSimdMul( sasb, c[K] ), BVHSimdMul( c[I], s[K] ) ) : BVHSimdAdd( BVHSimdMul( c[I], s[K] ), BVHSimdMul( sasb, c[K] ) );
+	local[J * 3 + J] = odd ? BVHSimdAdd( BVHSimdMul( c[I], c[K] ), BVHSimdMul( sasb, s[K] ) ) : BVHSimdSub( BVHSimdMul( c[I], c[K] ), BVHSimdMul( sasb, s[K] ) );
+	local[K * 3 + J] = odd ? sacb : BVHSimdNegate( sacb );
+	local[I * 3 + K] = odd ? BVHSimdAdd( BVHSimdMul( s[I], s[K] ), BVHSimdMul( casb, c[K] ) ) : BVHSimdSub( BVHSimdMul( s[I], s[K] ), BVHSimdMul( casb, c[K] ) );
+	local[J * 3 + K] = odd ? BVHSimdSub( BVHSimdMul( casb, s[K] ), BVHSimdMul( s[I], c[K] ) ) : BVHSimdAdd( BVHSimdMul( s[I], c[K] ), BVHSimdMul( casb, s[K] ) );
+	local[K * 3 + K] = BVHSimdMul( c[I], c[J] );
+}
+
+/// <summary>
+/// Composes the rotation of the Euler angles listed in the order I, J, K
+/// as a quaternion ( x, y, z, w ), from the sine and cosine of each axis's
+/// half angle.
+/// </summary>
+template< int I, int J, int K, class T >
+inline void BVHComposeQuaternion( const T * s, const T * c, T * q )
+{
+	const bool odd = J != ( I + 1 ) % 3;
+
+	// qI times qJ, then times qK, as Hamilton products
+	T tw = BVHSimdMul( c[I], c[J] );
+	T ti = BVHSimdMul( s[I], c[J] );
+	T tj = BVHSimdMul( c[I], s[J] );
+	T tk = BVHSimdMul( s[I], s[J] );
+	if( odd )
+		tk = BVHSimdNegate( tk );
+
+	q[I] = odd ? BVHSimdSub( BVHSimdMul( ti, c[K] ), BVHSimdMul( tj, s[K] ) ) : BVHSimdAdd( BVHSimdMul( ti, c[K] ), BVHSimdMul( tj, s[K] ) );
+	q[J] = odd ? BVHSimdAdd( BVHSimdMul( tj, c[K] ), BVHSimdMul( ti, s[K] ) ) : BVHSimdSub( BVHSimdMul( tj, c[K] ), BVHSimdMul( ti, s[K] ) );
+	q[K] = BVHSimdAdd( BVHSimdMul( tw, s[K] ), BVHSimdMul( tk, c[K] ) );
+	q[3] = BVHSimdSub( BVHSimdMul( tw, c[K] ), BVHSimdMul( tk, s[K] ) );
+}
+
+/// <summary>
+/// Composes the rotation matrix of a joint's Euler angles in its order.
+/// </summary>
+template< class T >
+inline void BVHComposeMatrix( RotationOrder order, const T * s, const T * c, T * local )
+{
+	switch( order )
+	{
+	case RotationXYZ: BVHComposeMatrix<0, 1, 2>( s, c, local ); break;
+	case RotationXZY: BVHComposeMatrix<0, 2, 1>( s, c, local ); break;
+	case RotationYXZ: BVHComposeMatrix<1, 0, 2>( s, c, local ); break;
+	case RotationYZX: BVHComposeMatrix<1, 2, 0>( s, c, local ); break;
+	case RotationZXY: BVHComposeMatrix<2, 0, 1>( s, c, local ); break;
+	case RotationZYX: default: BVHComposeMatrix<2, 1, 0>( s, c, local ); break;
+	}
+}
+
+/// <summary>
+/// Composes the rotation of a joint's Euler angles in its order as a quaternion.
+/// </summary>
+template< class T >
+inline void BVHComposeQuaternion( RotationOrder order, const T * s, const T * c, T * q )
+{
+	switch( order )
+	{
+	case RotationXYZ: BVHComposeQuaternion<0, 1, 2>( s, c, q ); break;
+	case RotationXZY: BVHComposeQuaternion<0, 2, 1>( s, c, q ); break;
+	case RotationYXZ: BVHComposeQuaternion<1, 0, 2>( s, c, q ); break;
+	case RotationYZX: BVHComposeQuaternion<1, 2, 0>( s, c, q ); break;
+	case RotationZXY: BVHComposeQuaternion<2, 0, 1>( s, c, q ); break;
+	case RotationZYX: default: BVHComposeQuaternion<2, 1, 0>( s, c, q ); break;
+	}
+}
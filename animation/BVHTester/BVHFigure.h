@@ -1,55 +1,73 @@
-#pragma once
-
-#include <iostream>
-#include <fstream>
-#include <string>
-
-#include "BVHNode.h"
-
-#include <d3dx10.h>
-
-using namespace std;
-
-struct SimpleVertex
-{
-    D3DXVECTOR3 Pos;
-    D3DXVECTOR4 Color;
-};
-
-class BVHFigure
-{
-protected:
-	ID3D10Device*				d3dDevice;
-	ID3D10EffectTechnique*		techniqueRender;
-	ID3D10Buffer*               edgeVertexBuffer;
-	ID3D10Buffer*               edgeIndexBuffer;
-	ID3D10Buffer*               cubeVertexBuffer;
-	ID3D10Buffer*               cubeIndexBuffer;
-	ID3D10EffectMatrixVariable* worldVariable;
-	D3DXMATRIX                  world;
-	vector<BVHNode*>				nodes;
-	vector<SimpleVertex>		edgeVertices;
-	int							numEdges;
-	int							curFrame;
-	int							numFrames;
-	float						frameTime;
-	HRESULT ProcessHierarchy( vector<string> lines, int * lineNum, int * numEdges );
-	HRESULT ProcessMotionData( vector<string> lines, int * lineNum );
-	HRESULT InitBVHNodeFrames( BVHNode * node, vector<float> data , int * dataIndex);
-	D3DXMATRIX GetBVHNodeRotation( vector<Channel> channels, vector<float> data, int * dataIndex );
-	D3DXMATRIX GetBVHNodeTranslation( vector<Channel> channels, vector<float> data, int * dataIndex );
-	HRESULT CreateVertexBuffer();
-public:
-	BVHFigure(void);
-	~BVHFigure(void);
-	HRESULT ReadBVH( string fileName );
-	HRESULT Initialize( ID3D10Device * d3dDevice, 
-		ID3D10EffectTechnique * techniqueRender, 
-		ID3D10EffectMatrixVariable * worldVariable );
-	void Update( float time );
-	void LookAt( D3DXVECTOR3 * Eye, D3DXVECTOR3 * Up, ID3D10EffectMatrixVariable * viewVariable );
-	void Render();
-	void RenderBVHNode( BVHNode * node, D3DXMATRIX parentWorld );
-	void RenderEdges();
-	void Cleanup();
-};
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "BVHBlendTree.h"
+#include "BVHClip.h"
+#include "BVHClipCache.h"
+#include "BVHClipStream.h"
+#include "BVHCompressedClip.h"
+#include "BVHMath.h"
+#include "BVHPose.h"
+#include "BVHPoseCache.h"
+#include "BVHTimeWarp.h"
+
+using namespace std;
+
+/// <summary>
+/// A figure playing a clip. The clip is shared through BVHClipCache, so a
+/// figure holds nothing but its playback state, and any number of figures
+/// can play one clip for the memory of one. A figure can instead play a
+/// BVHClipStream, for clips too long to load, a BVHCompressedClip, to keep
+/// only the keys of a clip, or a BVHBlendTree, to blend several clips.
+/// </summary>
+class BVHFigure
+{
+protected:
+	const BVHClip *				clip;			// Referenced in BVHClipCache::GetShared
+	BVHClipStream *				stream;			// Not owned, played instead of clip when not NULL
+	const BVHCompressedClip *	compressed;		// Not owned, played instead of clip when not NULL
+	vector<float>				samples;		// Frame of compressed decoded by Update
+	BVHBlendTree *				blendTree;		// Not owned, played instead of clip when not NULL
+	BVHPoseCache *				poseCache;		// Not owned, NULL to compute every joint of every pose
+	BVHMatrix                   world;			// World matrix of the roots' parent space
+	float						timeOffset;		// Seconds added to the time given to Update
+	float						rate;			// Playback speed, 1 for the clip's own
+	const BVHTimeWarp *			timeWarp;		// Not owned, NULL to play the clip evenly
+	bool						interpolate;	// Blend between frames rather than show the nearest
+	float						curTime;
+public:
+	BVHFigure(void);
+	BVHFigure( const BVHFigure & figure );
+	~BVHFigure(void);
+	BVHFigure & operator=( const BVHFigure & figure );
+	HRESULT ReadBVH( const string & fileName, bool useCache = true );
+	void Cleanup();
+	const BVHClip * GetClip() const { return clip; }
+	BVHClipStream * GetStream() const { return stream; }
+	void SetStream( BVHClipStream * stream );
+	const BVHCompressedClip * GetCompressedClip() const { return compressed; }
+	void SetCompressedClip( const BVHCompressedClip * compressed );
+	BVHBlendTree * GetBlendTree() const { return blendTree; }
+	void SetBlendTree( BVHBlendTree * blendTree ) { this->blendTree = blendTree; }
+	BVHPoseCache * GetPoseCache() const { return poseCache; }
+	void SetPoseCache( BVHPoseCache * poseCache ) { this->poseCache = poseCache; }
+	const BVHSkeleton * GetSkeleton() const;
+	const BVHMatrix & GetWorld() const { return world; }
+	void SetWorld( const BVHMatrix & world ) { this->world = world; }
+	float GetTimeOffset() const { return timeOffset; }
+	void SetTimeOffset( float timeOffset ) { this->timeOffset = timeOffset; }
+	float GetRate() const { return rate; }
+	void SetRate( float rate ) { this->rate = rate; }
+	const BVHTimeWarp * GetTimeWarp() const { return timeWarp; }
+	void SetTimeWarp( const BVHTimeWarp * timeWarp ) { this->timeWarp = timeWarp; }
+	bool GetInterpolate() const { return interpolate; }
+	void SetInterpolate( bool interpolate ) { this->interpolate = interpolate; }
+	void Update( float time );
+	float GetClipTime() const;
+	const float * GetFrame() const;
+	float GetFrames( const float ** frame, const float ** nextFrame ) const;
+	BVHVector3 GetRootPosition() const;
+	void EvaluatePose( BVHMatrix * worldMatrices ) const;
+};
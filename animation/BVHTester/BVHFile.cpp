@@ -0,0 +1,526 @@
+// BVHFile.cpp
+//
+// Summary:
+//	Memory maps a BVH file and tokenizes it in place, so that loading a
+//	clip does not copy each line into its own string.
+
+#include "BVHFile.h"
+
+#include <cstdlib>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// Powers of ten that are exactly representable as doubles
+static const double g_powersOf10[] =
+{
+	1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+	1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+// Mantissas below 2^53 convert to double exactly
+static const unsigned long long g_maxExactMantissa = 1ULL << 53;
+
+// Smallest run of motion data worth handing to another thread
+static const size_t g_minChunkBytes = 16 * 1024;
+
+/// <summary>
+/// State shared by the tasks of BVHReader::ParseFrames.
+/// </summary>
+struct BVHFrameChunks
+{
+	vector<const char *>		starts;			// numChunks + 1 line aligned chunk boundaries
+	vector<int>					firstFrames;	// frame lines per chunk, then the index of each chunk's first frame
+	float *						data;
+	int							numFrames;
+	int							numChannels;
+	volatile LONG				failed;
+};
+
+/// <summary>
+/// Returns true if a line holds anything other than whitespace.
+/// </summary>
+static bool IsFrameLine( const char * begin, const char * end )
+{
+	for( const char * p = begin; p < end; ++p )
+	{
+		if( *p != ' ' && *p != '\t' && *p != '\r' )
+			return true;
+	}
+	return false;
+}
+
+/// <summary>
+/// Counts the frame lines in a range of chunks.
+/// </summary>
+static void CountFrameLines( void * context, int /* thread */, int begin, int end )
+{
+	BVHFrameChunks * chunks = ( BVHFrameChunks * )context;
+
+	for( int c = begin; c < end; ++c )
+	{
+		BVHReader reader( chunks->starts[c], chunks->starts[c + 1] );
+		BVHToken line;
+		int count = 0;
+
+		while( reader.NextLine( &line ) )
+		{
+			if( IsFrameLine( line.begin, line.end ) )
+				++count;
+		}
+
+		chunks->firstFrames[c] = count;
+	}
+}
+
+/// <summary>
+/// Parses the frame lines in a range of chunks into their rows.
+/// </summary>
+static void ParseFrameLines( void * context, int /* thread */, int begin, int end )
+{
+	BVHFrameChunks * chunks = ( BVHFrameChunks * )context;
+
+	for( int c = begin; c < end; ++c )
+	{
+		BVHReader reader( chunks->starts[c], chunks->starts[c + 1] );
+		BVHToken line;
+		int frame = chunks->firstFrames[c];
+
+		while( frame < chunks->numFrames && reader.NextLine( &line ) )
+		{
+			if( !IsFrameLine( line.begin, line.end ) )
+				continue;
+
+			float * row = chunks->data + ( size_t )frame * chunks->numChannels;
+			if( BVHReader::ParseFloats( line, row, chunks->numChannels ) != chunks->numChannels )
+			{
+				BVHAtomicStore( &chunks->failed, 1 );
+				return;
+			}
+
+			++frame;
+		}
+	}
+}
+
+/// <summary>
+/// Compares the token with a null terminated string.
+/// </summary>
+bool BVHToken::Equals( const char * text ) const
+{
+	size_t length = strlen( text );
+	return Length() == length && memcmp( begin, text, length ) == 0;
+}
+
+/// <summary>
+/// Creates a BVHFile with nothing mapped. Use BVHFile::Open to map a file.
+/// </summary>
+BVHFile::BVHFile(void)
+{
+#ifdef _WIN32
+	file = INVALID_HANDLE_VALUE;
+	mapping = NULL;
+#else
+	file = -1;
+#endif
+	data = NULL;
+	size = 0;
+}
+
+/// <summary>
+/// Deconstructor for BVHFile, unmaps the file.
+/// </summary>
+BVHFile::~BVHFile(void)
+{
+	Close();
+}
+
+/// <summary>
+/// Maps a file into memory for reading.
+/// </summary>
+/// <param name='fileName'>Name of the file to map.</param>
+HRESULT BVHFile::Open( const char * fileName )
+{
+	Close();
+
+#ifdef _WIN32
+	file = CreateFileA( fileName, GENERIC_READ, FILE_SHARE_READ, NULL,
+		OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL );
+
+	if( file == INVALID_HANDLE_VALUE )
+		return E_FAIL;
+
+	LARGE_INTEGER fileSize;
+	if( !GetFileSizeEx( file, &fileSize ) || fileSize.QuadPart == 0 )
+	{
+		Close();
+		return E_FAIL;
+	}
+
+	mapping = CreateFileMappingA( file, NULL, PAGE_READONLY, 0, 0, NULL );
+	if( mapping == NULL )
+	{
+		Close();
+		return E_FAIL;
+	}
+
+	data = ( const char * )MapViewOfFile( mapping, FILE_MAP_READ, 0, 0, 0 );
+	if( data == NULL )
+	{
+		Close();
+		return E_FAIL;
+	}
+
+	size = ( size_t )fileSize.QuadPart;
+#else
+	file = open( fileName, O_RDONLY );
+	if( file < 0 )
+		return E_FAIL;
+
+	struct stat fileStat;
+	if( fstat( file, &fileStat ) != 0 || fileStat.st_size == 0 )
+	{
+		Close();
+		return E_FAIL;
+	}
+
+	void * view = mmap( NULL, ( size_t )fileStat.st_size, PROT_READ, MAP_PRIVATE, file, 0 );
+	if( view == MAP_FAILED )
+	{
+		Close();
+		return E_FAIL;
+	}
+
+	data = ( const char * )view;
+	size = ( size_t )fileStat.st_size;
+#endif
+
+	return S_OK;
+}
+
+/// <summary>
+/// Unmaps the file and releases its handles.
+/// </summary>
+void BVHFile::Close()
+{
+#ifdef _WIN32
+	if( data ) UnmapViewOfFile( data );
+	if( mapping ) CloseHandle( mapping );
+	if( file != INVALID_HANDLE_VALUE ) CloseHandle( file );
+
+	file = INVALID_HANDLE_VALUE;
+	mapping = NULL;
+#else
+	if( data ) munmap( ( void * )data, size );
+	if( file >= 0 ) close( file );
+
+	file = -1;
+#endif
+	data = NULL;
+	size = 0;
+}
+
+/// <summary>
+/// Creates a reader over a range of characters.
+/// </summary>
+BVHReader::BVHReader( const char * begin, const char * end )
+{
+	// Skip a UTF-8 byte order mark
+	if( end - begin >= 3 && memcmp( begin, "\xEF\xBB\xBF", 3 ) == 0 )
+		begin += 3;
+
+	this->cur = begin;
+	this->end = end;
+}
+
+/// <summary>
+/// Reads the next line, without its line terminator.
+/// </summary>
+/// <param name='line'>Set to the characters of the line.</param>
+/// <returns>False if there are no lines left.</returns>
+bool BVHReader::NextLine( BVHToken * line )
+{
+	if( cur >= end )
+		return false;
+
+	const char * lineEnd = ( const char * )memchr( cur, '\n', end - cur );
+	if( lineEnd == NULL )
+		lineEnd = end;
+
+	line->begin = cur;
+	line->end = lineEnd;
+	if( line->end > line->begin && line->end[-1] == '\r' )
+		--line->end;
+
+	cur = lineEnd < end ? lineEnd + 1 : end;
+
+	return true;
+}
+
+/// <summary>
+/// Reads the next whitespace separated token from a line.
+/// </summary>
+/// <param name='line'>The remainder of a line, advanced past the token.</param>
+/// <param name='token'>Set to the characters of the token.</param>
+/// <returns>False if the line has no tokens left.</returns>
+bool BVHReader::NextToken( BVHToken * line, BVHToken * token )
+{
+	const char * p = line->begin;
+
+	while( p < line->end && ( *p == ' ' || *p == '\t' ) )
+		++p;
+
+	if( p == line->end )
+	{
+		line->begin = p;
+		return false;
+	}
+
+	token->begin = p;
+	while( p < line->end && *p != ' ' && *p != '\t' )
+		++p;
+	token->end = p;
+
+	line->begin = p;
+
+	return true;
+}
+
+/// <summary>
+/// Converts a token to a double. The mapped file is not null terminated,
+/// so the token is copied to the stack first.
+/// </summary>
+double BVHReader::ParseDouble( const BVHToken & token )
+{
+	char buffer[64];
+	size_t length = token.Length() < sizeof( buffer ) - 1 ? token.Length() : sizeof( buffer ) - 1;
+	memcpy( buffer, token.begin, length );
+	buffer[length] = '\0';
+
+	return strtod( buffer, NULL );
+}
+
+/// <summary>
+/// Converts a token to a long. The mapped file is not null terminated,
+/// so the token is copied to the stack first.
+/// </summary>
+long BVHReader::ParseLong( const BVHToken & token )
+{
+	char buffer[32];
+	size_t length = token.Length() < sizeof( buffer ) - 1 ? token.Length() : sizeof( buffer ) - 1;
+	memcpy( buffer, token.begin, length );
+	buffer[length] = '\0';
+
+	return strtol( buffer, NULL, 10 );
+}
+
+/// <summary>
+/// Parses a BVH number ( optional sign, digits, optional fraction and
+/// optional exponent ) without the locale handling of strtod.
+/// </summary>
+/// <remarks>
+/// The digits are gathered into an integer mantissa and scaled by one exact
+/// power of ten, which gives the same correctly rounded double as strtod.
+/// Numbers with too many digits or too large an exponent for that fall
+/// back to strtod.
+/// </remarks>
+/// <param name='p'>Pointer to the first character, advanced past the number.</param>
+/// <param name='end'>End of the characters that may be read.</param>
+/// <param name='value'>Set to the parsed value.</param>
+/// <returns>False if no number starts at p.</returns>
+bool BVHReader::ParseFloat( const char ** p, const char * end, float * value )
+{
+	const char * start = *p;
+	const char * c = start;
+
+	bool negative = false;
+	if( c < end && ( *c == '-' || *c == '+' ) )
+	{
+		negative = ( *c == '-' );
+		++c;
+	}
+
+	unsigned long long mantissa = 0;
+	int numDigits = 0;
+	int exponent = 0;
+
+	const char * digits = c;
+	while( c < end && ( unsigned )( *c - '0' ) < 10 )
+	{
+		mantissa = mantissa * 10 + ( *c - '0' );
+		++numDigits;
+		++c;
+	}
+
+	if( c < end && *c == '.' )
+	{
+		++c;
+		while( c < end && ( unsigned )( *c - '0' ) < 10 )
+		{
+			mantissa = mantissa * 10 + ( *c - '0' );
+			++numDigits;
+			--exponent;
+			++c;
+		}
+	}
+
+	if( numDigits == 0 )
+		return false;
+
+	if( c < end && ( *c == 'e' || *c == 'E' ) )
+	{
+		const char * e = c + 1;
+		bool negativeExponent = false;
+		if( e < end && ( *e == '-' || *e == '+' ) )
+		{
+			negativeExponent = ( *e == '-' );
+			++e;
+		}
+
+		if( e < end && ( unsigned )( *e - '0' ) < 10 )
+		{
+			int explicitExponent = 0;
+			while( e < end && ( unsigned )( *e - '0' ) < 10 )
+			{
+				if( explicitExponent < 10000 )
+					explicitExponent = explicitExponent * 10 + ( *e - '0' );
+				++e;
+			}
+			exponent += negativeExponent ? -explicitExponent : explicitExponent;
+			c = e;
+		}
+	}
+
+	*p = c;
+
+	// Leading zeros do not count against the exact mantissa range
+	while( digits < c && ( *digits == '0' || *digits == '.' ) && numDigits > 0 )
+	{
+		if( *digits == '0' )
+			--numDigits;
+		++digits;
+	}
+
+	if( numDigits <= 19 && mantissa < g_maxExactMantissa && exponent >= -22 && exponent <= 22 )
+	{
+		double result = ( double )mantissa;
+		if( exponent < 0 )
+			result /= g_powersOf10[-exponent];
+		else
+			result *= g_powersOf10[exponent];
+
+		*value = ( float )( negative ? -result : result );
+		return true;
+	}
+
+	// Out of the exact range, let strtod round it
+	BVHToken token = { start, c };
+	*value = ( float )ParseDouble( token );
+	return true;
+}
+
+/// <summary>
+/// Parses the whitespace separated numbers of a line.
+/// </summary>
+/// <param name='line'>The characters of the line.</param>
+/// <param name='values'>Array to write the numbers to.</param>
+/// <param name='maxValues'>Size of the values array.</param>
+/// <returns>The number of values on the line, or -1 if the line holds something that is not a number or too many numbers.</returns>
+int BVHReader::ParseFloats( const BVHToken & line, float * values, int maxValues )
+{
+	const char * p = line.begin;
+	int count = 0;
+
+	for( ;; )
+	{
+		while( p < line.end && ( *p == ' ' || *p == '\t' ) )
+			++p;
+
+		if( p == line.end )
+			return count;
+
+		if( count == maxValues || !ParseFloat( &p, line.end, &values[count] ) )
+			return -1;
+
+		if( p < line.end && *p != ' ' && *p != '\t' )
+			return -1;
+
+		++count;
+	}
+}
+
+/// <summary>
+/// Parses the frame lines of a MOTION section into a frames x channels array.
+/// </summary>
+/// <remarks>
+/// The section is cut into chunks on line boundaries. The pool first counts
+/// the frame lines in every chunk, which gives the row each chunk starts at,
+/// then parses the chunks into their rows in parallel. Lines past numFrames
+/// are ignored.
+/// </remarks>
+/// <param name='begin'>First character after the Frame Time: line.</param>
+/// <param name='end'>End of the file.</param>
+/// <param name='data'>Array of numFrames * numChannels values to fill.</param>
+/// <param name='pool'>Threads to parse on, or NULL to parse on the calling thread.</param>
+/// <returns>The number of frames parsed, or -1 if a frame line is malformed.</returns>
+int BVHReader::ParseFrames( const char * begin, const char * end, float * data,
+	int numFrames, int numChannels, BVHThreadPool * pool )
+{
+	size_t size = end - begin;
+	int numChunks = 1;
+	if( pool != NULL )
+	{
+		numChunks = pool->GetNumThreads() * 4;
+		if( ( size_t )numChunks > size / g_minChunkBytes )
+			numChunks = size / g_minChunkBytes > 0 ? ( int )( size / g_minChunkBytes ) : 1;
+	}
+
+	BVHFrameChunks chunks;
+	chunks.data = data;
+	chunks.numFrames = numFrames;
+	chunks.numChannels = numChannels;
+	chunks.failed = 0;
+	chunks.firstFrames.resize( numChunks );
+	chunks.starts.resize( numChunks + 1 );
+
+	// Move each evenly spaced split to the start of the next line
+	chunks.starts[0] = begin;
+	for( int c = 1; c < numChunks; ++c )
+	{
+		const char * split = begin + size * c / numChunks;
+		if( split < chunks.starts[c - 1] )
+			split = chunks.starts[c - 1];
+
+		const char * lineEnd = ( const char * )memchr( split, '\n', end - split );
+		chunks.starts[c] = lineEnd != NULL ? lineEnd + 1 : end;
+	}
+	chunks.starts[numChunks] = end;
+
+	if( pool != NULL )
+		pool->ParallelFor( numChunks, 1, CountFrameLines, &chunks );
+	else
+		CountFrameLines( &chunks, 0, 0, numChunks );
+
+	// Turn the counts into the first frame of each chunk
+	int numFrameLines = 0;
+	for( int c = 0; c < numChunks; ++c )
+	{
+		int count = chunks.firstFrames[c];
+		chunks.firstFrames[c] = numFrameLines;
+		numFrameLines += count;
+	}
+
+	if( pool != NULL )
+		pool->ParallelFor( numChunks, 1, ParseFrameLines, &chunks );
+	else
+		ParseFrameLines( &chunks, 0, 0, numChunks );
+
+	if( chunks.failed )
+		return -1;
+
+	return numFrameLines < numFrames ? numFrameLines : numFrames;
+}
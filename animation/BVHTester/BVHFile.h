@@ -0,0 +1,67 @@
+#pragma once
+
+#include <cstddef>
+#include <cstring>
+
+#include "BVHPlatform.h"
+#include "BVHThreadPool.h"
+
+/// <summary>
+/// A view of a run of characters inside a mapped BVH file. Does not own
+/// or copy the characters.
+/// </summary>
+struct BVHToken
+{
+	const char * begin;
+	const char * end;
+
+	size_t Length() const { return end - begin; }
+	bool IsEmpty() const { return begin == end; }
+	bool Equals( const char * text ) const;
+};
+
+/// <summary>
+/// A read-only memory mapping of a BVH file.
+/// </summary>
+class BVHFile
+{
+protected:
+#ifdef _WIN32
+	HANDLE						file;
+	HANDLE						mapping;
+#else
+	int							file;
+#endif
+	const char *				data;
+	size_t						size;
+public:
+	BVHFile(void);
+	~BVHFile(void);
+	HRESULT Open( const char * fileName );
+	void Close();
+	const char * GetData() const { return data; }
+	size_t GetSize() const { return size; }
+};
+
+/// <summary>
+/// Splits the characters of a BVH file into lines, and lines into
+/// whitespace separated tokens, without copying them.
+/// </summary>
+class BVHReader
+{
+protected:
+	const char *				cur;
+	const char *				end;
+public:
+	BVHReader( const char * begin, const char * end );
+	bool NextLine( BVHToken * line );
+	const char * GetPosition() const { return cur; }
+	const char * GetEnd() const { return end; }
+	static bool NextToken( BVHToken * line, BVHToken * token );
+	static double ParseDouble( const BVHToken & token );
+	static long ParseLong( const BVHToken & token );
+	static bool ParseFloat( const char ** p, const char * end, float * value );
+	static int ParseFloats( const BVHToken & line, float * values, int maxValues );
+	static int ParseFrames( const char * begin, const char * end, float * data,
+		int numFrames, int numChannels, BVHThreadPool * pool );
+};
@@ -0,0 +1,208 @@
+#pragma once
+
+#include <cmath>
+
+// Vector and matrix types for pose evaluation that do not need the DirectX
+// SDK. They use the D3DX conventions: row vectors, left handed rotations,
+// and translation in the bottom row. A BVHMatrix has the memory layout of
+// a D3DXMATRIX, so it can be handed to an effect variable as it is.
+
+#define BVH_PI 3.141592654f
+
+struct BVHVector3
+{
+	float x, y, z;
+
+	BVHVector3() {}
+	BVHVector3( float x, float y, float z ) : x( x ), y( y ), z( z ) {}
+};
+
+/// <summary>
+/// A rotation as a unit quaternion, with the D3DX convention for products:
+/// the matrix of a * b is the matrix of a times the matrix of b.
+/// </summary>
+struct BVHQuaternion
+{
+	float x, y, z, w;
+
+	BVHQuaternion() {}
+	BVHQuaternion( float x, float y, float z, float w ) : x( x ), y( y ), z( z ), w( w ) {}
+};
+
+struct BVHMatrix
+{
+	union
+	{
+		struct
+		{
+			float _11, _12, _13, _14;
+			float _21, _22, _23, _24;
+			float _31, _32, _33, _34;
+			float _41, _42, _43, _44;
+		};
+		float m[4][4];
+	};
+
+	BVHMatrix operator * ( const BVHMatrix & other ) const;
+};
+
+/// <summary>
+/// An affine transform in 12 floats: the first three columns of a
+/// BVHMatrix, each stored as a row of four. The fourth column of the matrix
+/// is always ( 0, 0, 0, 1 ) and is left out. Row c holds the column's
+/// rotation terms and then its translation, so a point p transforms to
+/// ( dot( m[0], p1 ), dot( m[1], p1 ), dot( m[2], p1 ) ) with p1 = ( p, 1 ).
+/// This is the float3x4 layout a shader reads.
+/// </summary>
+struct BVHAffine
+{
+	float m[3][4];
+};
+
+inline BVHMatrix * BVHMatrixIdentity( BVHMatrix * out )
+{
+	for( int r = 0; r < 4; ++r )
+		for( int c = 0; c < 4; ++c )
+			out->m[r][c] = r == c ? 1.0f : 0.0f;
+	return out;
+}
+
+inline BVHMatrix * BVHMatrixTranslation( BVHMatrix * out, float x, float y, float z )
+{
+	BVHMatrixIdentity( out );
+	out->_41 = x;
+	out->_42 = y;
+	out->_43 = z;
+	return out;
+}
+
+inline BVHMatrix * BVHMatrixRotationX( BVHMatrix * out, float angle )
+{
+	float s = sinf( angle ), c = cosf( angle );
+	BVHMatrixIdentity( out );
+	out->_22 = c;	out->_23 = s;
+	out->_32 = -s;	out->_33 = c;
+	return out;
+}
+
+inline BVHMatrix * BVHMatrixRotationY( BVHMatrix * out, float angle )
+{
+	float s = sinf( angle ), c = cosf( angle );
+	BVHMatrixIdentity( out );
+	out->_11 = c;	out->_13 = -s;
+	out->_31 = s;	out->_33 = c;
+	return out;
+}
+
+inline BVHMatrix * BVHMatrixRotationZ( BVHMatrix * out, float angle )
+{
+	float s = sinf( angle ), c = cosf( angle );
+	BVHMatrixIdentity( out );
+	out->_11 = c;	out->_12 = s;
+	out->_21 = -s;	out->_22 = c;
+	return out;
+}
+
+/// <summary>
+/// out = a * b. out may be a or b.
+/// </summary>
+inline BVHMatrix * BVHMatrixMultiply( BVHMatrix * out, const BVHMatrix * a, const BVHMatrix * b )
+{
+	BVHMatrix result;
+	for( int r = 0; r < 4; ++r )
+	{
+		for( int c = 0; c < 4; ++c )
+		{
+			result.m[r][c] = a->m[r][0] * b->m[0][c] + a->m[r][1] * b->m[1][c] +
+				a->m[r][2] * b->m[2][c] + a->m[r][3] * b->m[3][c];
+		}
+	}
+	*out = result;
+	return out;
+}
+
+inline BVHMatrix BVHMatrix::operator * ( const BVHMatrix & other ) const
+{
+	BVHMatrix result;
+	BVHMatrixMultiply( &result, this, &other );
+	return result;
+}
+
+inline BVHMatrix * BVHMatrixFromAffine( BVHMatrix * out, const BVHAffine * affine )
+{
+	for( int r = 0; r < 4; ++r )
+	{
+		for( int c = 0; c < 3; ++c )
+			out->m[r][c] = affine->m[c][r];
+		out->m[r][3] = r == 3 ? 1.0f : 0.0f;
+	}
+	return out;
+}
+
+inline BVHAffine * BVHAffineFromMatrix( BVHAffine * out, const BVHMatrix * matrix )
+{
+	for( int c = 0; c < 3; ++c )
+	{
+		for( int r = 0; r < 4; ++r )
+			out->m[c][r] = matrix->m[r][c];
+	}
+	return out;
+}
+
+inline BVHQuaternion * BVHQuaternionRotationAxis( BVHQuaternion * out, const BVHVector3 * axis, float angle )
+{
+	float s = sinf( angle * 0.5f );
+	out->x = axis->x * s;
+	out->y = axis->y * s;
+	out->z = axis->z * s;
+	out->w = cosf( angle * 0.5f );
+	return out;
+}
+
+/// <summary>
+/// out = a * b, the rotation a followed by the rotation b. out may be a or b.
+/// </summary>
+inline BVHQuaternion * BVHQuaternionMultiply( BVHQuaternion * out, const BVHQuaternion * a, const BVHQuaternion * b )
+{
+	BVHQuaternion result(
+		b->w * a->x + b->x * a->w + b->y * a->z - b->z * a->y,
+		b->w * a->y - b->x * a->z + b->y * a->w + b->z * a->x,
+		b->w * a->z + b->x * a->y - b->y * a->x + b->z * a->w,
+		b->w * a->w - b->x * a->x - b->y * a->y - b->z * a->z );
+	*out = result;
+	return out;
+}
+
+/// <summary>
+/// Normalized linear interpolation from a to b along the shorter arc. For
+/// the small steps between frames it is indistinguishable from a slerp.
+/// </summary>
+inline BVHQuaternion * BVHQuaternionNlerp( BVHQuaternion * out, const BVHQuaternion * a, const BVHQuaternion * b, float t )
+{
+	float dot = a->x * b->x + a->y * b->y + a->z * b->z + a->w * b->w;
+	float tb = dot < 0 ? -t : t;
+	float ta = 1.0f - t;
+
+	BVHQuaternion result( ta * a->x + tb * b->x, ta * a->y + tb * b->y, ta * a->z + tb * b->z, ta * a->w + tb * b->w );
+	float length = sqrtf( result.x * result.x + result.y * result.y + result.z * result.z + result.w * result.w );
+	float scale = length > 0 ? 1.0f / length : 0.0f;
+
+	out->x = result.x * scale;
+	out->y = result.y * scale;
+	out->z = result.z * scale;
+	out->w = result.w * scale;
+	return out;
+}
+
+inline BVHMatrix * BVHMatrixRotationQuaternion( BVHMatrix * out, const BVHQuaternion * q )
+{
+	float xx = q->x * q->x, yy = q->y * q->y, zz = q->z * q->z;
+	float xy = q->x * q->y, xz = q->x * q->z, yz = q->y * q->z;
+	float wx = q->w * q->x, wy = q->w * q->y, wz = q->w * q->z;
+
+	BVHMatrixIdentity( out );
+	out->_11 = 1.0f - 2.0f * ( yy + zz );	out->_12 = 2.0f * ( xy + wz );			out->_13 = 2.0f * ( xz - wy );
+	out->_21 = 2.0f * ( xy - wz );			out->_22 = 1.0f - 2.0f * ( xx + zz );	out->_23 = 2.0f * ( yz + wx );
+	out->_31 = 2.0f * ( xz + wy );			out->_32 = 2.0f * ( yz - wx );			out->_33 = 1.0f - 2.0f * ( xx + yy );
+	return out;
+}
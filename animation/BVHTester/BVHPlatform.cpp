@@ -0,0 +1,137 @@
+// BVHPlatform.cpp
+//
+// Summary:
+//	Win32 and POSIX versions of the threading, atomic and timer functions
+//	declared in BVHPlatform.h.
+
+#include "BVHPlatform.h"
+
+#ifdef _WIN32
+
+void BVHMutexInit( BVHMutex * mutex ) { InitializeCriticalSection( mutex ); }
+void BVHMutexDestroy( BVHMutex * mutex ) { DeleteCriticalSection( mutex ); }
+void BVHMutexLock( BVHMutex * mutex ) { EnterCriticalSection( mutex ); }
+void BVHMutexUnlock( BVHMutex * mutex ) { LeaveCriticalSection( mutex ); }
+
+void BVHConditionInit( BVHCondition * condition ) { InitializeConditionVariable( condition ); }
+void BVHConditionDestroy( BVHCondition * condition ) {}
+void BVHConditionWait( BVHCondition * condition, BVHMutex * mutex ) { SleepConditionVariableCS( condition, mutex, INFINITE ); }
+void BVHConditionWakeAll( BVHCondition * condition ) { WakeAllConditionVariable( condition ); }
+
+bool BVHThreadCreate( BVHThread * thread, BVHThreadFunction function, void * argument )
+{
+	*thread = CreateThread( NULL, 0, function, argument, 0, NULL );
+	return *thread != NULL;
+}
+
+void BVHThreadJoin( BVHThread thread )
+{
+	WaitForSingleObject( thread, INFINITE );
+	CloseHandle( thread );
+}
+
+LONG BVHAtomicAdd( volatile LONG * value, LONG amount )
+{
+	return InterlockedExchangeAdd( value, amount );
+}
+
+void BVHAtomicStore( volatile LONG * value, LONG newValue )
+{
+	InterlockedExchange( value, newValue );
+}
+
+/// <summary>
+/// Returns the number of logical processors.
+/// </summary>
+int BVHGetNumProcessors()
+{
+	SYSTEM_INFO info;
+	GetSystemInfo( &info );
+	return info.dwNumberOfProcessors > 0 ? ( int )info.dwNumberOfProcessors : 1;
+}
+
+/// <summary>
+/// Returns the id of this process.
+/// </summary>
+int BVHGetProcessId()
+{
+	return ( int )GetCurrentProcessId();
+}
+
+/// <summary>
+/// Returns a high resolution timestamp in seconds.
+/// </summary>
+double BVHGetSeconds()
+{
+	static LARGE_INTEGER frequency = { 0 };
+	if( frequency.QuadPart == 0 )
+		QueryPerformanceFrequency( &frequency );
+
+	LARGE_INTEGER counter;
+	QueryPerformanceCounter( &counter );
+	return ( double )counter.QuadPart / ( double )frequency.QuadPart;
+}
+
+#else
+
+#include <time.h>
+#include <unistd.h>
+
+void BVHMutexInit( BVHMutex * mutex ) { pthread_mutex_init( mutex, NULL ); }
+void BVHMutexDestroy( BVHMutex * mutex ) { pthread_mutex_destroy( mutex ); }
+void BVHMutexLock( BVHMutex * mutex ) { pthread_mutex_lock( mutex ); }
+void BVHMutexUnlock( BVHMutex * mutex ) { pthread_mutex_unlock( mutex ); }
+
+void BVHConditionInit( BVHCondition * condition ) { pthread_cond_init( condition, NULL ); }
+void BVHConditionDestroy( BVHCondition * condition ) { pthread_cond_destroy( condition ); }
+void BVHConditionWait( BVHCondition * condition, BVHMutex * mutex ) { pthread_cond_wait( condition, mutex ); }
+void BVHConditionWakeAll( BVHCondition * condition ) { pthread_cond_broadcast( condition ); }
+
+bool BVHThreadCreate( BVHThread * thread, BVHThreadFunction function, void * argument )
+{
+	return pthread_create( thread, NULL, function, argument ) == 0;
+}
+
+void BVHThreadJoin( BVHThread thread )
+{
+	pthread_join( thread, NULL );
+}
+
+LONG BVHAtomicAdd( volatile LONG * value, LONG amount )
+{
+	return __sync_fetch_and_add( value, amount );
+}
+
+void BVHAtomicStore( volatile LONG * value, LONG newValue )
+{
+	__sync_lock_test_and_set( value, newValue );
+}
+
+/// <summary>
+/// Returns the number of logical processors.
+/// </summary>
+int BVHGetNumProcessors()
+{
+	long count = sysconf( _SC_NPROCESSORS_ONLN );
+	return count > 0 ? ( int )count : 1;
+}
+
+/// <summary>
+/// Returns the id of this process.
+/// </summary>
+int BVHGetProcessId()
+{
+	return ( int )getpid();
+}
+
+/// <summary>
+/// Returns a high resolution timestamp in seconds.
+/// </summary>
+double BVHGetSeconds()
+{
+	timespec now;
+	clock_gettime( CLOCK_MONOTONIC, &now );
+	return ( double )now.tv_sec + ( double )now.tv_nsec * 1e-9;
+}
+
+#endif
@@ -0,0 +1,62 @@
+#pragma once
+
+// The few operating system services the clip loader and pose evaluation
+// need, so that they build on Windows and on POSIX systems alike. Only
+// the rendering code depends on Direct3D.
+
+#ifdef _WIN32
+
+#include <windows.h>
+
+typedef CRITICAL_SECTION			BVHMutex;
+typedef CONDITION_VARIABLE			BVHCondition;
+typedef HANDLE						BVHThread;
+typedef DWORD						BVHThreadResult;
+#define BVH_THREAD_CALL				WINAPI
+#define BVH_THREAD_LOCAL			__declspec( thread )
+
+#else
+
+#include <pthread.h>
+#include <stdint.h>
+
+typedef int32_t						HRESULT;
+typedef int32_t						LONG;
+
+#define S_OK						( ( HRESULT )0 )
+#define E_FAIL						( ( HRESULT )0x80004005 )
+#define E_OUTOFMEMORY				( ( HRESULT )0x8007000E )
+#define E_INVALIDARG				( ( HRESULT )0x80070057 )
+#define SUCCEEDED( hr )				( ( ( HRESULT )( hr ) ) >= 0 )
+#define FAILED( hr )				( ( ( HRESULT )( hr ) ) < 0 )
+
+typedef pthread_mutex_t				BVHMutex;
+typedef pthread_cond_t				BVHCondition;
+typedef pthread_t					BVHThread;
+typedef void *						BVHThreadResult;
+#define BVH_THREAD_CALL
+#define BVH_THREAD_LOCAL			__thread
+
+#endif
+
+typedef BVHThreadResult ( BVH_THREAD_CALL * BVHThreadFunction )( void * argument );
+
+void BVHMutexInit( BVHMutex * mutex );
+void BVHMutexDestroy( BVHMutex * mutex );
+void BVHMutexLock( BVHMutex * mutex );
+void BVHMutexUnlock( BVHMutex * mutex );
+
+void BVHConditionInit( BVHCondition * condition );
+void BVHConditionDestroy( BVHCondition * condition );
+void BVHConditionWait( BVHCondition * condition, BVHMutex * mutex );
+void BVHConditionWakeAll( BVHCondition * condition );
+
+bool BVHThreadCreate( BVHThread * thread, BVHThreadFunction function, void * argument );
+void BVHThreadJoin( BVHThread thread );
+
+LONG BVHAtomicAdd( volatile LONG * value, LONG amount );
+void BVHAtomicStore( volatile LONG * value, LONG newValue );
+
+int BVHGetNumProcessors();
+int BVHGetProcessId();
+double BVHGetSeconds();
@@ -0,0 +1,46 @@
+// BVHPose.cpp
+//
+// Summary:
+//	Computes the world matrices of a clip's joints at a point in time.
+
+#include "BVHPose.h"
+
+/// <summary>
+/// Computes the world matrix of every joint of a clip at a time, with the
+/// roots placed at the origin.
+/// </summary>
+/// <param name='clip'>The clip to pose.</param>
+/// <param name='time'>Seconds from the start of the clip, which loops.</param>
+/// <param name='worldMatrices'>Receives one matrix per joint of the clip's skeleton.</param>
+void EvaluatePose( const BVHClip & clip, float time, BVHMatrix * worldMatrices )
+{
+	BVHMatrix world;
+	BVHMatrixIdentity( &world );
+
+	EvaluatePose( clip, time, world, worldMatrices );
+}
+
+/// <summary>
+/// Computes the world matrix of every joint of a clip at a time.
+/// </summary>
+/// <param name='clip'>The clip to pose.</param>
+/// <param name='time'>Seconds from the start of the clip, which loops.</param>
+/// <param name='world'>World matrix of the roots' parent space.</param>
+/// <param name='worldMatrices'>Receives one matrix per joint of the clip's skeleton.</param>
+/// <param name='interpolate'>True to blend between the frames around the time, false to show the frame at it.</param>
+void EvaluatePose( const BVHClip & clip, float time, const BVHMatrix & world, BVHMatrix * worldMatrices, bool interpolate )
+{
+	if( clip.GetNumFrames() == 0 )
+		return;
+
+	if( !interpolate )
+	{
+		const float * frame = clip.GetFrame( clip.GetFrameIndex( time ) );
+		clip.GetSkeleton().EvaluatePose( frame, world, worldMatrices );
+		return;
+	}
+
+	int frame = 0, nextFrame = 0;
+	float weight = clip.GetFrameIndices( time, &frame, &nextFrame );
+	clip.GetSkeleton().EvaluatePose( clip.GetFrame( frame ), clip.GetFrame( nextFrame ), weight, world, worldMatrices );
+}
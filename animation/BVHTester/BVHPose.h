@@ -0,0 +1,10 @@
+#pragma once
+
+#include "BVHClip.h"
+#include "BVHMath.h"
+
+// Pose evaluation. These need neither a window nor a Direct3D device, so
+// they can run in tools and batch jobs as well as in BVHTester.
+
+void EvaluatePose( const BVHClip & clip, float time, BVHMatrix * worldMatrices );
+void EvaluatePose( const BVHClip & clip, float time, const BVHMatrix & world, BVHMatrix * worldMatrices, bool interpolate = false );
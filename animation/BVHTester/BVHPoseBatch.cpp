@@ -0,0 +1,303 @@
+// BVHPoseBatch.cpp
+//
+// Summary:
+//	SIMD forward kinematics. Composes each joint's Euler rotation,
+//	translation and offset straight into an affine transform and chains it
+//	to the parent's, for as many poses at once as there are SIMD lanes.
+//	Poses between two frames blend the rotations as quaternions.
+
+#include "BVHPoseBatch.h"
+#include "BVHEuler.h"
+#include "BVHProfiler.h"
+
+// Index of the term in row r, column c of a world matrix in the world
+// scratch array. Only the first three columns are kept.
+#define TERM( r, c ) ( ( r ) * 3 + ( c ) )
+
+/// <summary>
+/// Gathers one sample from the frame of each lane.
+/// </summary>
+static inline BVHFloats GatherSample( const float * const * frames, int sample )
+{
+	float values[BVH_SIMD_WIDTH];
+	for( int l = 0; l < BVH_SIMD_WIDTH; ++l )
+		values[l] = frames[l][sample];
+	return BVHSimdLoad( values );
+}
+
+/// <summary>
+/// Computes the rotation of a joint in each lane as a quaternion.
+/// </summary>
+static inline void GatherQuaternion( const float * const * frames, const int rotation[3], RotationOrder order, BVHFloats q[4] )
+{
+	const BVHFloats halfDegreesToRadians = BVHSimdSet( BVH_PI / 360.0f );
+
+	BVHFloats s[3], c[3];
+	for( int i = 0; i < 3; ++i )
+	{
+		if( rotation[i] >= 0 )
+		{
+			BVHSimdSinCos( BVHSimdMul( GatherSample( frames, rotation[i] ), halfDegreesToRadians ), &s[i], &c[i] );
+		}
+		else
+		{
+			s[i] = BVHSimdSet( 0.0f );
+			c[i] = BVHSimdSet( 1.0f );
+		}
+	}
+
+	BVHComposeQuaternion( order, s, c, q );
+}
+
+/// <summary>
+/// Precomputes where each joint's samples are in a frame.
+/// </summary>
+BVHPoseBatch::BVHPoseBatch( const BVHSkeleton & skeleton )
+{
+	joints.resize( skeleton.GetNumJoints() );
+
+	for( int j = 0; j < joints.size(); ++j )
+	{
+		Joint & joint = joints[j];
+		const BVHVector3 & offset = skeleton.GetOffset( j );
+
+		joint.parent = skeleton.GetParent( j );
+		joint.order = skeleton.GetRotationOrder( j );
+		joint.offset[0] = offset.x;
+		joint.offset[1] = offset.y;
+		joint.offset[2] = offset.z;
+
+		const int * rotation = skeleton.GetRotationChannels( j );
+		const int * position = skeleton.GetPositionChannels( j );
+		for( int i = 0; i < 3; ++i )
+		{
+			joint.rotation[i] = rotation[i];
+			joint.position[i] = position[i];
+		}
+	}
+
+	world.resize( joints.size() * 12 * BVH_SIMD_WIDTH );
+}
+
+BVHPoseBatch::~BVHPoseBatch( void )
+{
+}
+
+/// <summary>
+/// Computes the world transform of every joint for a number of poses.
+/// </summary>
+/// <param name='frames'>The frame of motion data of each pose.</param>
+/// <param name='roots'>World matrix of each pose's root space, or NULL for identity matrices.</param>
+/// <param name='numPoses'>Number of poses.</param>
+/// <param name='worldTransforms'>Receives GetNumJoints() transforms for each pose.</param>
+void BVHPoseBatch::Evaluate( const float * const * frames, const BVHMatrix * const * roots, int numPoses, BVHAffine * const * worldTransforms )
+{
+	Evaluate( frames, NULL, NULL, roots, numPoses, worldTransforms );
+}
+
+/// <summary>
+/// Computes the world transform of every joint for a number of poses, each
+/// blended between two frames.
+/// </summary>
+/// <param name='frames'>The frame of motion data of each pose.</param>
+/// <param name='nextFrames'>The frame each pose blends towards, or NULL to show frames as they are.</param>
+/// <param name='weights'>The weight of each pose's next frame, from 0 to 1.</param>
+/// <param name='roots'>World matrix of each pose's root space, or NULL for identity matrices.</param>
+/// <param name='numPoses'>Number of poses.</param>
+/// <param name='worldTransforms'>Receives GetNumJoints() transforms for each pose.</param>
+void BVHPoseBatch::Evaluate( const float * const * frames, const float * const * nextFrames, const float * weights,
+							const BVHMatrix * const * roots, int numPoses, BVHAffine * const * worldTransforms )
+{
+	for( int first = 0; first < numPoses; first += BVH_SIMD_WIDTH )
+	{
+		int numLanes = numPoses - first < BVH_SIMD_WIDTH ? numPoses - first : BVH_SIMD_WIDTH;
+		EvaluateLanes( frames + first, nextFrames != NULL ? nextFrames + first : NULL, weights != NULL ? weights + first : NULL,
+			roots != NULL ? roots + first : NULL, numLanes, worldTransforms + first );
+	}
+
+	BVH_PROFILE_COUNT( BVHCounterMatricesComposed, ( long long )numPoses * GetNumJoints() );
+}
+
+/// <summary>
+/// Computes the world transform of every joint for up to one pose per lane.
+/// </summary>
+/// <remarks>
+/// With D3DX conventions a joint's local matrix is its Euler rotations,
+/// composed in the order the joint lists them, with the translation plus
+/// offset in the bottom row, and its world matrix is the
+/// local matrix times the parent's. Both are affine, so only the first
+/// three columns are computed. The world matrices are kept in the scratch
+/// array as world[( joint * 12 + term ) * lanes + lane], so a term of a
+/// parent is one vector load.
+///
+/// When blending, the rotation of each frame is made a quaternion, the two
+/// are blended with an nlerp and the result turned into a matrix. The
+/// matrix formula divides by the squared length of the blend rather than
+/// normalizing it first, which saves a square root.
+/// </remarks>
+void BVHPoseBatch::EvaluateLanes( const float * const * frames, const float * const * nextFrames, const float * weights,
+								 const BVHMatrix * const * roots, int numLanes, BVHAffine * const * worldTransforms )
+{
+	static const float zero = 0;
+
+	// Fill unused lanes with copies of the first pose
+	const float * laneFrames[BVH_SIMD_WIDTH];
+	const float * laneNextFrames[BVH_SIMD_WIDTH];
+	float laneWeights[BVH_SIMD_WIDTH];
+	for( int l = 0; l < BVH_SIMD_WIDTH; ++l )
+	{
+		int lane = l < numLanes ? l : 0;
+		laneFrames[l] = frames[lane] != NULL ? frames[lane] : &zero;
+		laneNextFrames[l] = nextFrames != NULL && nextFrames[lane] != NULL ? nextFrames[lane] : laneFrames[l];
+		laneWeights[l] = nextFrames != NULL ? weights[lane] : 0.0f;
+	}
+
+	const BVHFloats weight = BVHSimdLoad( laneWeights );
+
+	// Root space
+	BVHFloats rootWorld[12];
+	for( int r = 0; r < 4; ++r )
+	{
+		for( int c = 0; c < 3; ++c )
+		{
+			float values[BVH_SIMD_WIDTH];
+			for( int l = 0; l < BVH_SIMD_WIDTH; ++l )
+			{
+				const BVHMatrix * root = roots != NULL ? roots[l < numLanes ? l : 0] : NULL;
+				values[l] = root != NULL ? root->m[r][c] : ( r == c ? 1.0f : 0.0f );
+			}
+			rootWorld[TERM( r, c )] = BVHSimdLoad( values );
+		}
+	}
+
+	const BVHFloats degreesToRadians = BVHSimdSet( BVH_PI / 180.0f );
+	const BVHFloats zeros = BVHSimdSet( 0.0f );
+	const BVHFloats ones = BVHSimdSet( 1.0f );
+	const BVHFloats signBit = BVHSimdSet( -0.0f );
+
+	for( int j = 0; j < joints.size(); ++j )
+	{
+		const Joint & joint = joints[j];
+
+		// Local rotation, rows 0 to 2
+
+		BVHFloats local[12];
+		if( joint.rotation[0] < 0 && joint.rotation[1] < 0 && joint.rotation[2] < 0 )
+		{
+			for( int r = 0; r < 3; ++r )
+				for( int c = 0; c < 3; ++c )
+					local[TERM( r, c )] = BVHSimdSet( r == c ? 1.0f : 0.0f );
+		}
+		else if( nextFrames != NULL )
+		{
+			BVHFloats a[4], b[4];
+			GatherQuaternion( laneFrames, joint.rotation, joint.order, a );
+			GatherQuaternion( laneNextFrames, joint.rotation, joint.order, b );
+
+			// Blend along the shorter arc
+			BVHFloats dot = BVHSimdAdd( BVHSimdAdd( BVHSimdMul( a[0], b[0] ), BVHSimdMul( a[1], b[1] ) ),
+				BVHSimdAdd( BVHSimdMul( a[2], b[2] ), BVHSimdMul( a[3], b[3] ) ) );
+			BVHFloats wb = BVHSimdXor( weight, BVHSimdAnd( BVHSimdLess( dot, zeros ), signBit ) );
+			BVHFloats wa = BVHSimdSub( ones, weight );
+
+			BVHFloats q[4];
+			for( int i = 0; i < 4; ++i )
+				q[i] = BVHSimdAdd( BVHSimdMul( a[i], wa ), BVHSimdMul( b[i], wb ) );
+
+			BVHFloats scale = BVHSimdDiv( BVHSimdSet( 2.0f ), BVHSimdAdd( BVHSimdAdd( BVHSimdMul( q[0], q[0] ), BVHSimdMul( q[1], q[1] ) ),
+				BVHSimdAdd( BVHSimdMul( q[2], q[2] ), BVHSimdMul( q[3], q[3] ) ) ) );
+
+			BVHFloats x = BVHSimdMul( q[0], scale ), y = BVHSimdMul( q[1], scale ), z = BVHSimdMul( q[2], scale );
+			BVHFloats xx = BVHSimdMul( q[0], x ), yy = BVHSimdMul( q[1], y ), zz = BVHSimdMul( q[2], z );
+			BVHFloats xy = BVHSimdMul( q[0], y ), xz = BVHSimdMul( q[0], z ), yz = BVHSimdMul( q[1], z );
+			BVHFloats wx = BVHSimdMul( q[3], x ), wy = BVHSimdMul( q[3], y ), wz = BVHSimdMul( q[3], z );
+
+			local[TERM( 0, 0 )] = BVHSimdSub( ones, BVHSimdAdd( yy, zz ) );
+			local[TERM( 0, 1 )] = BVHSimdAdd( xy, wz );
+			local[TERM( 0, 2 )] = BVHSimdSub( xz, wy );
+			local[TERM( 1, 0 )] = BVHSimdSub( xy, wz );
+			local[TERM( 1, 1 )] = BVHSimdSub( ones, BVHSimdAdd( xx, zz ) );
+			local[TERM( 1, 2 )] = BVHSimdAdd( yz, wx );
+			local[TERM( 2, 0 )] = BVHSimdAdd( xz, wy );
+			local[TERM( 2, 1 )] = BVHSimdSub( yz, wx );
+			local[TERM( 2, 2 )] = BVHSimdSub( ones, BVHSimdAdd( xx, yy ) );
+		}
+		else
+		{
+			BVHFloats s[3], c[3];
+			for( int i = 0; i < 3; ++i )
+			{
+				if( joint.rotation[i] >= 0 )
+				{
+					BVHSimdSinCos( BVHSimdMul( GatherSample( laneFrames, joint.rotation[i] ), degreesToRadians ), &s[i], &c[i] );
+				}
+				else
+				{
+					s[i] = zeros;
+					c[i] = ones;
+				}
+			}
+
+			BVHComposeMatrix( joint.order, s, c, local );
+		}
+
+		// Local translation plus offset, row 3
+
+		for( int i = 0; i < 3; ++i )
+		{
+			BVHFloats offset = BVHSimdSet( joint.offset[i] );
+			if( joint.position[i] < 0 )
+			{
+				local[TERM( 3, i )] = offset;
+				continue;
+			}
+
+			BVHFloats position = GatherSample( laneFrames, joint.position[i] );
+			if( nextFrames != NULL )
+				position = BVHSimdAdd( position, BVHSimdMul( BVHSimdSub( GatherSample( laneNextFrames, joint.position[i] ), position ), weight ) );
+			local[TERM( 3, i )] = BVHSimdAdd( position, offset );
+		}
+
+		// Chain to the parent: world = local * parentWorld
+
+		BVHFloats parentWorld[12];
+		if( joint.parent >= 0 )
+		{
+			const float * parentTerms = &world[joint.parent * 12 * BVH_SIMD_WIDTH];
+			for( int t = 0; t < 12; ++t )
+				parentWorld[t] = BVHSimdLoad( parentTerms + t * BVH_SIMD_WIDTH );
+		}
+		else
+		{
+			for( int t = 0; t < 12; ++t )
+				parentWorld[t] = rootWorld[t];
+		}
+
+		float * terms = &world[j * 12 * BVH_SIMD_WIDTH];
+		for( int r = 0; r < 4; ++r )
+		{
+			for( int c = 0; c < 3; ++c )
+			{
+				BVHFloats term = BVHSimdAdd( BVHSimdAdd(
+					BVHSimdMul( local[TERM( r, 0 )], parentWorld[TERM( 0, c )] ),
+					BVHSimdMul( local[TERM( r, 1 )], parentWorld[TERM( 1, c )] ) ),
+					BVHSimdMul( local[TERM( r, 2 )], parentWorld[TERM( 2, c )] ) );
+
+				if( r == 3 )
+					term = BVHSimdAdd( term, parentWorld[TERM( 3, c )] );
+
+				BVHSimdStore( terms + TERM( r, c ) * BVH_SIMD_WIDTH, term );
+			}
+		}
+
+		// Scatter the lanes to their poses
+
+		for( int l = 0; l < numLanes; ++l )
+		{
+			BVHAffine & transform = worldTransforms[l][j];
+			for( int r = 0; r < 4; ++r )
+				for( int c = 0; c < 3; ++c )
+					transform.m[c][r] = terms[TERM( r, c ) * BVH_SIMD_WIDTH + l];
+		}
+	}
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <vector>
+
+#include "BVHMath.h"
+#include "BVHSimd.h"
+#include "BVHSkeleton.h"
+
+using namespace std;
+
+/// <summary>
+/// Forward kinematics for several poses of one skeleton at once. Each SIMD
+/// lane holds a different pose, for example a different figure or frame,
+/// so every joint is composed and chained to its parent for all of them
+/// with the same instructions. Each pose can also blend between two frames.
+/// </summary>
+/// <remarks>
+/// Not thread safe; give each thread its own BVHPoseBatch.
+/// </remarks>
+class BVHPoseBatch
+{
+protected:
+	struct Joint
+	{
+		int						parent;
+		RotationOrder			order;
+		float					offset[3];
+		int						rotation[3];	// Sample index of the X, Y and Z rotation, -1 if none
+		int						position[3];	// Sample index of the X, Y and Z position, -1 if none
+	};
+
+	vector<Joint>				joints;
+	vector<float>				world;			// 12 terms x lanes per joint, see Evaluate
+
+	void EvaluateLanes( const float * const * frames, const float * const * nextFrames, const float * weights,
+		const BVHMatrix * const * roots, int numLanes, BVHAffine * const * worldTransforms );
+public:
+	BVHPoseBatch( const BVHSkeleton & skeleton );
+	~BVHPoseBatch( void );
+	int GetNumJoints() const { return ( int )joints.size(); }
+	static int GetNumLanes() { return BVH_SIMD_WIDTH; }
+	void Evaluate( const float * const * frames, const BVHMatrix * const * roots, int numPoses, BVHAffine * const * worldTransforms );
+	void Evaluate( const float * const * frames, const float * const * nextFrames, const float * weights,
+		const BVHMatrix * const * roots, int numPoses, BVHAffine * const * worldTransforms );
+};
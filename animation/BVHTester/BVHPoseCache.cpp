@@ -0,0 +1,219 @@
+// BVHPoseCache.cpp
+//
+// Summary:
+//	Poses a figure incrementally, recomputing only the joints whose samples
+//	or ancestors changed since the last pose.
+
+#include "BVHPoseCache.h"
+#include "BVHProfiler.h"
+
+#include <cmath>
+#include <cstring>
+
+/// <summary>
+/// Creates an empty cache.
+/// </summary>
+/// <param name='tolerance'>How far a sample may move before its joint is recomputed, 0 for not at all.</param>
+BVHPoseCache::BVHPoseCache( float tolerance )
+{
+	skeleton = NULL;
+	generation = 0;
+	numJoints = 0;
+	numChannels = 0;
+	this->tolerance = tolerance;
+	BVHMatrixIdentity( &world );
+	numLookups = 0;
+	numLocalHits = 0;
+	numWorldHits = 0;
+}
+
+BVHPoseCache::~BVHPoseCache( void )
+{
+}
+
+/// <summary>
+/// Forgets the cached pose, so the next Evaluate computes every joint.
+/// </summary>
+void BVHPoseCache::Invalidate()
+{
+	skeleton = NULL;
+}
+
+/// <summary>
+/// Changes the tolerance. The cached pose is forgotten, since it may be
+/// further from its samples than the new tolerance allows.
+/// </summary>
+void BVHPoseCache::SetTolerance( float tolerance )
+{
+	this->tolerance = tolerance;
+	Invalidate();
+}
+
+/// <summary>
+/// Zeroes the hit counts.
+/// </summary>
+void BVHPoseCache::ResetStatistics()
+{
+	numLookups = 0;
+	numLocalHits = 0;
+	numWorldHits = 0;
+}
+
+/// <summary>
+/// Returns whether a joint's samples differ from those its local matrix
+/// was computed from. With no tolerance both frames must match exactly,
+/// and the blend weight too unless the joint is the same in both frames.
+/// Otherwise each sample, blended between the frames, may move as far as
+/// the tolerance.
+/// </summary>
+bool BVHPoseCache::HasChanged( int joint, const float * frame, const float * nextFrame, float weight ) const
+{
+	int first = skeleton->GetFirstChannel( joint );
+	int count = skeleton->GetNumJointChannels( joint );
+
+	if( tolerance > 0 )
+	{
+		float cachedWeight = weights[joint];
+		for( int c = first; c < first + count; ++c )
+		{
+			float now = frame[c] + ( nextFrame[c] - frame[c] ) * weight;
+			float then = samples[c] + ( nextSamples[c] - samples[c] ) * cachedWeight;
+			if( fabsf( now - then ) > tolerance )
+				return true;
+		}
+		return false;
+	}
+
+	bool still = true;
+	for( int c = first; c < first + count; ++c )
+	{
+		if( frame[c] != samples[c] || nextFrame[c] != nextSamples[c] )
+			return true;
+
+		still = still && frame[c] == nextFrame[c];
+	}
+
+	return !still && weight != weights[joint];
+}
+
+/// <summary>
+/// Computes a joint's local matrix as BVHSkeleton::EvaluatePose does, and
+/// keeps the samples it was computed from.
+/// </summary>
+void BVHPoseCache::ComputeLocal( int joint, const float * frame, const float * nextFrame, float weight )
+{
+	const BVHVector3 & offset = skeleton->GetOffset( joint );
+	BVHMatrix & local = locals[joint];
+
+	if( skeleton->GetNumJointChannels( joint ) == 0 )
+	{
+		BVHMatrixTranslation( &local, offset.x, offset.y, offset.z );
+		return;
+	}
+
+	// As in BVHSkeleton, one frame is shown as it is and two are blended
+	// as quaternions, whatever the weight
+	if( frame == nextFrame )
+	{
+		BVHVector3 translation = skeleton->GetTranslation( joint, frame );
+		local = skeleton->GetRotation( joint, frame );
+		local._41 = translation.x + offset.x;
+		local._42 = translation.y + offset.y;
+		local._43 = translation.z + offset.z;
+	}
+	else
+	{
+		BVHQuaternion a = skeleton->GetRotationQuaternion( joint, frame );
+		BVHQuaternion b = skeleton->GetRotationQuaternion( joint, nextFrame );
+		BVHQuaternion rotation;
+		BVHMatrixRotationQuaternion( &local, BVHQuaternionNlerp( &rotation, &a, &b, weight ) );
+
+		BVHVector3 from = skeleton->GetTranslation( joint, frame );
+		BVHVector3 to = skeleton->GetTranslation( joint, nextFrame );
+		local._41 = from.x + ( to.x - from.x ) * weight + offset.x;
+		local._42 = from.y + ( to.y - from.y ) * weight + offset.y;
+		local._43 = from.z + ( to.z - from.z ) * weight + offset.z;
+	}
+
+	int first = skeleton->GetFirstChannel( joint );
+	int count = skeleton->GetNumJointChannels( joint );
+	for( int c = first; c < first + count; ++c )
+	{
+		samples[c] = frame[c];
+		nextSamples[c] = nextFrame[c];
+	}
+	weights[joint] = weight;
+}
+
+/// <summary>
+/// Poses the figure, reusing every joint that has not changed since the
+/// last pose.
+/// </summary>
+/// <remarks>
+/// Parents come before their children, so one pass decides each joint from
+/// its own samples and whether its parent was recomputed: a joint whose
+/// samples and ancestors are unchanged keeps its world matrix.
+/// </remarks>
+/// <param name='skeleton'>The skeleton to pose. A different skeleton from the last one, or the same one rebuilt since, starts the cache afresh.</param>
+/// <param name='frame'>A frame of motion data, or NULL if the skeleton has no channels.</param>
+/// <param name='nextFrame'>The frame to interpolate towards, frame itself to show it alone.</param>
+/// <param name='weight'>0 for frame, 1 for nextFrame.</param>
+/// <param name='world'>World matrix of the roots' parent space.</param>
+/// <returns>GetNumJoints() world matrices, kept until the next Evaluate.</returns>
+const BVHMatrix * BVHPoseCache::Evaluate( const BVHSkeleton & skeleton, const float * frame, const float * nextFrame, float weight, const BVHMatrix & world )
+{
+	int numJoints = skeleton.GetNumJoints();
+
+	// A stream reopened on another clip rebuilds its skeleton in place, so
+	// the address alone does not show the arrays still fit
+	bool valid = this->skeleton == &skeleton && generation == skeleton.GetGeneration() &&
+		this->numJoints == numJoints && numChannels == skeleton.GetNumChannels();
+
+	if( !valid )
+	{
+		this->skeleton = &skeleton;
+		generation = skeleton.GetGeneration();
+		this->numJoints = numJoints;
+		numChannels = skeleton.GetNumChannels();
+		samples.resize( numChannels );
+		nextSamples.resize( numChannels );
+		weights.resize( numJoints );
+		locals.resize( numJoints );
+		worlds.resize( numJoints );
+		dirty.resize( numJoints );
+	}
+
+	if( nextFrame == NULL )
+		nextFrame = frame;
+
+	bool rootMoved = !valid || memcmp( &this->world, &world, sizeof( BVHMatrix ) ) != 0;
+	this->world = world;
+
+	int numComposed = 0;
+	for( int j = 0; j < numJoints; ++j )
+	{
+		bool localChanged = !valid || HasChanged( j, frame, nextFrame, weight );
+		if( localChanged )
+			ComputeLocal( j, frame, nextFrame, weight );
+		else
+			++numLocalHits;
+
+		int parent = skeleton.GetParent( j );
+		dirty[j] = localChanged || ( parent >= 0 ? dirty[parent] != 0 : rootMoved );
+
+		if( dirty[j] )
+		{
+			worlds[j] = locals[j] * ( parent >= 0 ? worlds[parent] : world );
+			++numComposed;
+		}
+		else
+		{
+			++numWorldHits;
+		}
+	}
+
+	numLookups += numJoints;
+	BVH_PROFILE_COUNT( BVHCounterMatricesComposed, numComposed );
+
+	return GetWorldMatrices();
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <vector>
+
+#include "BVHMath.h"
+#include "BVHSkeleton.h"
+
+using namespace std;
+
+/// <summary>
+/// Keeps the local and world matrix of every joint of one figure between
+/// poses, and recomputes only what changed. A joint's local matrix is
+/// rebuilt when its samples change, and its world matrix when its local
+/// matrix or its parent's world matrix does, so a still part of the body
+/// costs a comparison of its samples rather than a matrix product.
+/// </summary>
+/// <remarks>
+/// With a tolerance of 0 a joint is reused only when its samples are
+/// exactly those it was last computed from, and poses match
+/// BVHSkeleton::EvaluatePose to rounding. A larger tolerance also reuses joints whose
+/// samples, blended between the frames shown, have moved less than it
+/// since they were last computed, so capture noise and interpolation do
+/// not defeat the cache; the error in each sample is then at most the
+/// tolerance, and does not build up.
+///
+/// A cache holds the pose of one figure, so figures must not share one.
+/// </remarks>
+class BVHPoseCache
+{
+protected:
+	const BVHSkeleton *			skeleton;		// Skeleton of the cached pose, NULL if there is none
+	unsigned int				generation;		// The skeleton's generation when the arrays were sized
+	int							numJoints;		// The skeleton's joints and channels then, which the arrays hold
+	int							numChannels;
+	float						tolerance;
+	vector<float>				samples;		// Samples each joint was last computed from
+	vector<float>				nextSamples;	// Samples blended towards
+	vector<float>				weights;		// Blend weight of each joint
+	vector<BVHMatrix>			locals;
+	vector<BVHMatrix>			worlds;
+	vector<char>				dirty;			// Joints whose world matrix the last Evaluate recomputed
+	BVHMatrix					world;			// World matrix of the roots' parent space
+	long long					numLookups;		// Joints evaluated since ResetStatistics
+	long long					numLocalHits;	// Of those, joints whose local matrix was reused
+	long long					numWorldHits;	// Of those, joints whose world matrix was reused
+
+	bool HasChanged( int joint, const float * frame, const float * nextFrame, float weight ) const;
+	void ComputeLocal( int joint, const float * frame, const float * nextFrame, float weight );
+public:
+	BVHPoseCache( float tolerance = 0 );
+	~BVHPoseCache( void );
+	void Invalidate();
+	float GetTolerance() const { return tolerance; }
+	void SetTolerance( float tolerance );
+	const BVHMatrix * Evaluate( const BVHSkeleton & skeleton, const float * frame, const float * nextFrame, float weight, const BVHMatrix & world );
+	const BVHMatrix * GetWorldMatrices() const { return worlds.empty() ? NULL : &worlds[0]; }
+	long long GetNumLookups() const { return numLookups; }
+	long long GetNumLocalHits() const { return numLocalHits; }
+	long long GetNumWorldHits() const { return numWorldHits; }
+	double GetLocalHitRate() const { return numLookups > 0 ? ( double )numLocalHits / numLookups : 0; }
+	double GetWorldHitRate() const { return numLookups > 0 ? ( double )numWorldHits / numLookups : 0; }
+	void ResetStatistics();
+};
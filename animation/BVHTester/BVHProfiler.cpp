@@ -0,0 +1,226 @@
+// BVHProfiler.cpp
+//
+// Summary:
+//	Records timed scopes and counters into a ring buffer per thread, and
+//	writes them out as a Chrome trace. Compiled only when PROFILE is
+//	defined; see BVHProfiler.h.
+
+#include "BVHProfiler.h"
+
+#ifdef PROFILE
+
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+using namespace std;
+
+// Events each thread's ring holds before the oldest are overwritten
+static const unsigned int g_ringEvents = 64 * 1024;
+
+// Names of the BVHCounter values in traces
+static const char * g_counterNames[BVHNumCounters] =
+{
+	"Draw calls", "Matrices composed", "Bytes uploaded"
+};
+
+/// <summary>
+/// A timed scope, or a counter's total for a frame.
+/// </summary>
+struct BVHProfileEvent
+{
+	const char *				name;
+	double						begin;			// Seconds from BVHGetSeconds
+	double						value;			// Seconds at the end of a scope, or a counter's total
+	int							counter;		// BVHCounter of a counter total, or -1 for a scope
+};
+
+/// <summary>
+/// The events and counters of one thread. Only that thread writes them.
+/// </summary>
+struct BVHProfileThread
+{
+	vector<BVHProfileEvent>		events;			// Ring of g_ringEvents
+	unsigned long long			numEvents;		// Recorded since Reset, of which the ring holds the last
+	long long					counters[BVHNumCounters];
+	int							id;
+	char						name[32];
+};
+
+/// <summary>
+/// Every thread that has recorded. Threads are never removed, so a trace
+/// still holds the events of threads that have exited; the rings are
+/// freed with the process.
+/// </summary>
+struct BVHProfileRegistry
+{
+	BVHMutex					lock;
+	vector<BVHProfileThread *>	threads;
+	long long					frameTotals[BVHNumCounters];	// Counter sums at the last EndFrame
+	double						origin;			// Time zero of the trace
+
+	BVHProfileRegistry( void )
+	{
+		BVHMutexInit( &lock );
+		memset( frameTotals, 0, sizeof( frameTotals ) );
+		origin = BVHGetSeconds();
+	}
+};
+
+static BVHProfileRegistry g_registry;
+static BVH_THREAD_LOCAL BVHProfileThread * g_thread = NULL;
+
+/// <summary>
+/// Returns the calling thread's ring, creating it on its first event.
+/// </summary>
+static BVHProfileThread * GetProfileThread()
+{
+	if( g_thread == NULL )
+	{
+		BVHProfileThread * thread = new BVHProfileThread;
+		thread->events.resize( g_ringEvents );
+		thread->numEvents = 0;
+		memset( thread->counters, 0, sizeof( thread->counters ) );
+
+		BVHMutexLock( &g_registry.lock );
+		thread->id = ( int )g_registry.threads.size() + 1;
+		g_registry.threads.push_back( thread );
+		BVHMutexUnlock( &g_registry.lock );
+
+		sprintf( thread->name, "Thread %d", thread->id );
+		g_thread = thread;
+	}
+
+	return g_thread;
+}
+
+/// <summary>
+/// Records a timed scope on the calling thread.
+/// </summary>
+void BVHProfiler::Record( const char * name, double begin, double end )
+{
+	BVHProfileThread * thread = GetProfileThread();
+	BVHProfileEvent & event = thread->events[( size_t )( thread->numEvents++ % g_ringEvents )];
+	event.name = name;
+	event.begin = begin;
+	event.value = end;
+	event.counter = -1;
+}
+
+/// <summary>
+/// Adds to one of the calling thread's counters.
+/// </summary>
+void BVHProfiler::Count( BVHCounter counter, long long amount )
+{
+	GetProfileThread()->counters[counter] += amount;
+}
+
+/// <summary>
+/// Names the calling thread in traces.
+/// </summary>
+void BVHProfiler::SetThreadName( const char * name )
+{
+	BVHProfileThread * thread = GetProfileThread();
+	strncpy( thread->name, name, sizeof( thread->name ) - 1 );
+	thread->name[sizeof( thread->name ) - 1] = '\0';
+}
+
+/// <summary>
+/// Records how much each counter grew, summed over every thread, since
+/// the last EndFrame. Call once a frame, after the frame's work is done.
+/// </summary>
+void BVHProfiler::EndFrame()
+{
+	BVHProfileThread * thread = GetProfileThread();
+	double now = BVHGetSeconds();
+
+	BVHMutexLock( &g_registry.lock );
+
+	for( int c = 0; c < BVHNumCounters; ++c )
+	{
+		long long total = 0;
+		for( size_t t = 0; t < g_registry.threads.size(); ++t )
+			total += g_registry.threads[t]->counters[c];
+
+		BVHProfileEvent & event = thread->events[( size_t )( thread->numEvents++ % g_ringEvents )];
+		event.name = g_counterNames[c];
+		event.begin = now;
+		event.value = ( double )( total - g_registry.frameTotals[c] );
+		event.counter = c;
+
+		g_registry.frameTotals[c] = total;
+	}
+
+	BVHMutexUnlock( &g_registry.lock );
+}
+
+/// <summary>
+/// Discards every recorded event and zeroes the counters.
+/// </summary>
+void BVHProfiler::Reset()
+{
+	BVHMutexLock( &g_registry.lock );
+
+	for( size_t t = 0; t < g_registry.threads.size(); ++t )
+	{
+		g_registry.threads[t]->numEvents = 0;
+		memset( g_registry.threads[t]->counters, 0, sizeof( g_registry.threads[t]->counters ) );
+	}
+
+	memset( g_registry.frameTotals, 0, sizeof( g_registry.frameTotals ) );
+	g_registry.origin = BVHGetSeconds();
+
+	BVHMutexUnlock( &g_registry.lock );
+}
+
+/// <summary>
+/// Writes the events the rings hold as a Chrome trace: a complete event
+/// for each scope and a counter event for each counter's frame total.
+/// </summary>
+/// <param name='fileName'>Name of the JSON file to write.</param>
+HRESULT BVHProfiler::WriteChromeTrace( const char * fileName )
+{
+	FILE * file = fopen( fileName, "w" );
+	if( file == NULL )
+		return E_FAIL;
+
+	BVHMutexLock( &g_registry.lock );
+
+	fprintf( file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n" );
+
+	const char * separator = "";
+	for( size_t t = 0; t < g_registry.threads.size(); ++t )
+	{
+		const BVHProfileThread & thread = *g_registry.threads[t];
+
+		fprintf( file, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"%s\"}}",
+			separator, thread.id, thread.name );
+		separator = ",\n";
+
+		unsigned long long first = thread.numEvents > g_ringEvents ? thread.numEvents - g_ringEvents : 0;
+		for( unsigned long long e = first; e < thread.numEvents; ++e )
+		{
+			const BVHProfileEvent & event = thread.events[( size_t )( e % g_ringEvents )];
+			double ts = ( event.begin - g_registry.origin ) * 1000000.0;
+
+			if( event.counter < 0 )
+			{
+				fprintf( file, ",\n{\"name\":\"%s\",\"cat\":\"BVH\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f}",
+					event.name, thread.id, ts, ( event.value - event.begin ) * 1000000.0 );
+			}
+			else
+			{
+				fprintf( file, ",\n{\"name\":\"%s\",\"cat\":\"BVH\",\"ph\":\"C\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"args\":{\"value\":%.0f}}",
+					event.name, thread.id, ts, event.value );
+			}
+		}
+	}
+
+	fprintf( file, "\n]}\n" );
+
+	BVHMutexUnlock( &g_registry.lock );
+
+	return fclose( file ) == 0 ? S_OK : E_FAIL;
+}
+
+#endif
@@ -0,0 +1,77 @@
+#pragma once
+
+#include "BVHPlatform.h"
+
+// Scoped timers and counters for the hot paths of loading, posing and
+// drawing. They are built only when PROFILE is defined, as it is in the
+// Debug configurations; otherwise every macro below expands to nothing
+// and none of BVHProfiler is compiled.
+//
+//   BVH_PROFILE_SCOPE( "Update" );						times the enclosing block
+//   BVH_PROFILE_COUNT( BVHCounterDrawCalls, 1 );		adds to a counter
+//   BVH_PROFILE_THREAD( "Worker" );					names the calling thread in traces
+//   BVH_PROFILE_FRAME();								records the counters for the frame
+
+/// <summary>
+/// Things counted per frame by BVH_PROFILE_COUNT.
+/// </summary>
+enum BVHCounter
+{
+	BVHCounterDrawCalls,
+	BVHCounterMatricesComposed,	// Joint world transforms computed
+	BVHCounterBytesUploaded,	// Bytes written to mapped GPU buffers
+	BVHNumCounters
+};
+
+#ifdef PROFILE
+
+/// <summary>
+/// Collects timed scopes and counters. Each thread records into its own
+/// ring buffer, so recording takes no lock and never allocates after the
+/// thread's first event; when a ring is full the oldest events are
+/// overwritten. WriteChromeTrace saves what the rings hold in the trace
+/// event format that chrome://tracing and Perfetto open.
+/// </summary>
+/// <remarks>
+/// EndFrame, Reset and WriteChromeTrace read every thread's ring, so call
+/// them between frames, when no other thread is recording.
+/// </remarks>
+class BVHProfiler
+{
+public:
+	static void Record( const char * name, double begin, double end );
+	static void Count( BVHCounter counter, long long amount );
+	static void SetThreadName( const char * name );
+	static void EndFrame();
+	static void Reset();
+	static HRESULT WriteChromeTrace( const char * fileName );
+};
+
+/// <summary>
+/// Times the block it is declared in, see BVH_PROFILE_SCOPE.
+/// </summary>
+class BVHProfileScope
+{
+protected:
+	const char *				name;
+	double						begin;
+public:
+	BVHProfileScope( const char * name ) { this->name = name; begin = BVHGetSeconds(); }
+	~BVHProfileScope( void ) { BVHProfiler::Record( name, begin, BVHGetSeconds() ); }
+};
+
+#define BVH_PROFILE_JOIN2( a, b )				a##b
+#define BVH_PROFILE_JOIN( a, b )				BVH_PROFILE_JOIN2( a, b )
+#define BVH_PROFILE_SCOPE( name )				BVHProfileScope BVH_PROFILE_JOIN( profileScope, __LINE__ )( name )
+#define BVH_PROFILE_COUNT( counter, amount )	BVHProfiler::Count( counter, amount )
+#define BVH_PROFILE_THREAD( name )				BVHProfiler::SetThreadName( name )
+#define BVH_PROFILE_FRAME()						BVHProfiler::EndFrame()
+
+#else
+
+#define BVH_PROFILE_SCOPE( name )
+#define BVH_PROFILE_COUNT( counter, amount )
+#define BVH_PROFILE_THREAD( name )
+#define BVH_PROFILE_FRAME()
+
+#endif
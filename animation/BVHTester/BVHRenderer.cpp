@@ -0,0 +1,454 @@
+// BVHRenderer.cpp
+//
+// Authors:
+//	Mike DeMauro
+//
+// Summary:
+//	Renders posed BVH skeletons using DirectX 10. Moved out of BVHFigure so
+//	that figures only hold playback state and share one set of buffers.
+//	Joints are drawn as instanced cubes and edges as one line list, one
+//	draw each for a whole crowd.
+
+#include "BVHRenderer.h"
+#include "BVHProfiler.h"
+
+/// <summary>
+/// Creates a BVHRenderer. Use BVHRenderer::Initialize before rendering.
+/// </summary>
+BVHRenderer::BVHRenderer(void)
+{
+	edgeVertexBuffer = NULL;
+	cubeVertexBuffer = NULL;
+	cubeIndexBuffer = NULL;
+	instanceBuffer = NULL;
+	vertexLayout = NULL;
+	instanceLayout = NULL;
+	techniqueRender = NULL;
+	techniqueInstanced = NULL;
+	d3dDevice = NULL;
+	worldVariable = NULL;
+	maxEdges = 0;
+	maxInstances = 0;
+}
+
+/// <summary>
+/// Deconstructor for BVHRenderer
+/// </summary>
+BVHRenderer::~BVHRenderer(void)
+{
+}
+
+/// <summary>
+/// Releases buffers and input layouts.
+/// </summary>
+void BVHRenderer::Cleanup()
+{
+    if( edgeVertexBuffer ) edgeVertexBuffer->Release();
+    if( cubeVertexBuffer ) cubeVertexBuffer->Release();
+    if( cubeIndexBuffer ) cubeIndexBuffer->Release();
+    if( instanceBuffer ) instanceBuffer->Release();
+    if( vertexLayout ) vertexLayout->Release();
+    if( instanceLayout ) instanceLayout->Release();
+	edgeVertexBuffer = NULL;
+	cubeVertexBuffer = NULL;
+	cubeIndexBuffer = NULL;
+	instanceBuffer = NULL;
+	vertexLayout = NULL;
+	instanceLayout = NULL;
+	maxEdges = 0;
+	maxInstances = 0;
+	pose.clear();
+}
+
+/// <summary>
+///	Initialize the graphics properties of the BVHRenderer.
+/// </summary>
+/// <param name='d3dDevice'></param>
+/// <param name='techniqueRender'>Draws vertices transformed by worldVariable, used for the edges.</param>
+/// <param name='techniqueInstanced'>Draws vertices transformed by per instance WORLD0 to WORLD2 rows, used for the joints.</param>
+/// <param name='worldVariable'></param>
+HRESULT BVHRenderer::Initialize( ID3D10Device * d3dDevice,
+							  ID3D10EffectTechnique * techniqueRender,
+							  ID3D10EffectTechnique * techniqueInstanced,
+							  ID3D10EffectMatrixVariable * worldVariable )
+{
+	this->d3dDevice = d3dDevice;
+	this->techniqueRender = techniqueRender;
+	this->techniqueInstanced = techniqueInstanced;
+	this->worldVariable = worldVariable;
+
+	HRESULT hr = CreateInputLayouts();
+	if( FAILED( hr ) )
+		return hr;
+
+	return CreateVertexBuffer();
+}
+
+/// <summary>
+///	Creates the input layouts of the two techniques.
+/// </summary>
+HRESULT BVHRenderer::CreateInputLayouts()
+{
+    // Vertices, and joint transforms in a second stream
+    D3D10_INPUT_ELEMENT_DESC layout[] =
+    {
+        { "POSITION", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 0, D3D10_INPUT_PER_VERTEX_DATA, 0 },
+        { "COLOR", 0, DXGI_FORMAT_R32G32B32A32_FLOAT, 0, 12, D3D10_INPUT_PER_VERTEX_DATA, 0 },
+        { "WORLD", 0, DXGI_FORMAT_R32G32B32A32_FLOAT, 1, 0, D3D10_INPUT_PER_INSTANCE_DATA, 1 },
+        { "WORLD", 1, DXGI_FORMAT_R32G32B32A32_FLOAT, 1, 16, D3D10_INPUT_PER_INSTANCE_DATA, 1 },
+        { "WORLD", 2, DXGI_FORMAT_R32G32B32A32_FLOAT, 1, 32, D3D10_INPUT_PER_INSTANCE_DATA, 1 },
+    };
+
+    D3D10_PASS_DESC PassDesc;
+    techniqueRender->GetPassByIndex( 0 )->GetDesc( &PassDesc );
+    HRESULT hr = d3dDevice->CreateInputLayout( layout, 2, PassDesc.pIAInputSignature,
+                                          PassDesc.IAInputSignatureSize, &vertexLayout );
+    if( FAILED( hr ) )
+        return hr;
+
+    techniqueInstanced->GetPassByIndex( 0 )->GetDesc( &PassDesc );
+    hr = d3dDevice->CreateInputLayout( layout, sizeof( layout ) / sizeof( layout[0] ), PassDesc.pIAInputSignature,
+                                          PassDesc.IAInputSignatureSize, &instanceLayout );
+    return hr;
+}
+
+/// <summary>
+///	Creates the cube vertex and index buffers.
+/// </summary>
+HRESULT BVHRenderer::CreateVertexBuffer()
+{
+    // Create cube vertex buffer
+    SimpleVertex vertices[] =
+    {
+        { D3DXVECTOR3( -1.0f, 1.0f, -1.0f ), D3DXVECTOR4( 0.0f, 0.0f, 1.0f, 1.0f ) },
+        { D3DXVECTOR3( 1.0f, 1.0f, -1.0f ), D3DXVECTOR4( 0.0f, 1.0f, 0.0f, 1.0f ) },
+        { D3DXVECTOR3( 1.0f, 1.0f, 1.0f ), D3DXVECTOR4( 0.0f, 1.0f, 1.0f, 1.0f ) },
+        { D3DXVECTOR3( -1.0f, 1.0f, 1.0f ), D3DXVECTOR4( 1.0f, 0.0f, 0.0f, 1.0f ) },
+        { D3DXVECTOR3( -1.0f, -1.0f, -1.0f ), D3DXVECTOR4( 1.0f, 0.0f, 1.0f, 1.0f ) },
+        { D3DXVECTOR3( 1.0f, -1.0f, -1.0f ), D3DXVECTOR4( 1.0f, 1.0f, 0.0f, 1.0f ) },
+        { D3DXVECTOR3( 1.0f, -1.0f, 1.0f ), D3DXVECTOR4( 1.0f, 1.0f, 1.0f, 1.0f ) },
+        { D3DXVECTOR3( -1.0f, -1.0f, 1.0f ), D3DXVECTOR4( 0.0f, 0.0f, 0.0f, 1.0f ) },
+    };
+
+    D3D10_BUFFER_DESC bd;
+	bd.ByteWidth = sizeof( SimpleVertex ) * 8;
+	bd.Usage = D3D10_USAGE_IMMUTABLE;
+	bd.BindFlags = D3D10_BIND_VERTEX_BUFFER;
+	bd.CPUAccessFlags = 0;
+	bd.MiscFlags = 0;
+
+	D3D10_SUBRESOURCE_DATA initData;
+	initData.pSysMem = &vertices;
+
+	HRESULT hr = d3dDevice->CreateBuffer( &bd, &initData, &cubeVertexBuffer );
+
+    if( FAILED( hr ) )
+        return hr;
+
+    // Create cube index buffer
+    DWORD indices[] =
+    {
+        3,1,0,
+        2,1,3,
+
+        0,5,4,
+        1,5,0,
+
+        3,4,7,
+        0,4,3,
+
+        1,6,5,
+        2,6,1,
+
+        2,7,6,
+        3,7,2,
+
+        6,4,5,
+        7,4,6,
+    };
+
+	bd.ByteWidth = sizeof( DWORD ) * 36;
+	bd.Usage = D3D10_USAGE_IMMUTABLE;
+	bd.BindFlags = D3D10_BIND_INDEX_BUFFER;
+	bd.CPUAccessFlags = 0;
+	bd.MiscFlags = 0;
+
+	initData.pSysMem = &indices;
+
+	hr = d3dDevice->CreateBuffer( &bd, &initData, &cubeIndexBuffer );
+
+	if( FAILED( hr ) )
+        return hr;
+
+	return hr;
+}
+
+/// <summary>
+///	Creates the edge vertex buffer, or replaces it with a larger one.
+/// </summary>
+/// <param name='numEdges'>Edges the buffer must hold.</param>
+HRESULT BVHRenderer::CreateEdgeBuffer( int numEdges )
+{
+	if( numEdges <= maxEdges )
+		return S_OK;
+
+    if( edgeVertexBuffer ) edgeVertexBuffer->Release();
+	edgeVertexBuffer = NULL;
+
+	// Grow by half again so a slowly growing crowd does not recreate it every frame
+	int capacity = maxEdges + maxEdges / 2;
+	if( capacity < numEdges )
+		capacity = numEdges;
+	maxEdges = 0;
+
+    D3D10_BUFFER_DESC bd;
+    bd.Usage = D3D10_USAGE_DYNAMIC;
+	bd.ByteWidth = sizeof( SimpleVertex ) * capacity * 2;
+    bd.BindFlags = D3D10_BIND_VERTEX_BUFFER;
+    bd.CPUAccessFlags = D3D10_CPU_ACCESS_WRITE;
+    bd.MiscFlags = 0;
+
+	HRESULT hr = d3dDevice->CreateBuffer( &bd, NULL, &edgeVertexBuffer );
+
+    if( FAILED( hr ) )
+        return hr;
+
+	maxEdges = capacity;
+	return hr;
+}
+
+/// <summary>
+///	Creates the joint instance buffer, or replaces it with a larger one.
+/// </summary>
+/// <param name='numInstances'>Joint transforms the buffer must hold.</param>
+HRESULT BVHRenderer::CreateInstanceBuffer( int numInstances )
+{
+	if( numInstances <= maxInstances )
+		return S_OK;
+
+    if( instanceBuffer ) instanceBuffer->Release();
+	instanceBuffer = NULL;
+
+	// Grow by half again so a slowly growing crowd does not recreate it every frame
+	int capacity = maxInstances + maxInstances / 2;
+	if( capacity < numInstances )
+		capacity = numInstances;
+	maxInstances = 0;
+
+    D3D10_BUFFER_DESC bd;
+    bd.Usage = D3D10_USAGE_DYNAMIC;
+	bd.ByteWidth = sizeof( BVHAffine ) * capacity;
+    bd.BindFlags = D3D10_BIND_VERTEX_BUFFER;
+    bd.CPUAccessFlags = D3D10_CPU_ACCESS_WRITE;
+    bd.MiscFlags = 0;
+
+	HRESULT hr = d3dDevice->CreateBuffer( &bd, NULL, &instanceBuffer );
+
+    if( FAILED( hr ) )
+        return hr;
+
+	maxInstances = capacity;
+	return hr;
+}
+
+/// <summary>
+/// Renders every figure of a crowd as posed by its last Update. All of
+/// the crowd's joints are drawn at once. A crowd changed since its last
+/// Update has no poses, and is not drawn.
+/// </summary>
+void BVHRenderer::Render( const BVHCrowd & crowd )
+{
+	RenderJoints( crowd.GetTransforms(), crowd.GetNumTransforms() );
+	RenderEdges( crowd );
+}
+
+/// <summary>
+/// Renders a posed skeleton.
+/// </summary>
+/// <param name='skeleton'>The skeleton.</param>
+/// <param name='transforms'>World transform of each joint.</param>
+void BVHRenderer::Render( const BVHSkeleton & skeleton, const BVHAffine * transforms )
+{
+	RenderJoints( transforms, skeleton.GetNumJoints() );
+	RenderEdges( skeleton, transforms );
+}
+
+/// <summary>
+/// Renders a posed skeleton.
+/// </summary>
+/// <param name='skeleton'>The skeleton.</param>
+/// <param name='worldMatrices'>World matrix of each joint, such as from BVHFigure::EvaluatePose.</param>
+void BVHRenderer::Render( const BVHSkeleton & skeleton, const BVHMatrix * worldMatrices )
+{
+	pose.resize( skeleton.GetNumJoints() );
+	for( int j = 0; j < pose.size(); ++j )
+	{
+		BVHAffineFromMatrix( &pose[j], &worldMatrices[j] );
+	}
+
+	if( !pose.empty() )
+		Render( skeleton, &pose[0] );
+}
+
+/// <summary>
+/// Renders a cube at each of a number of joints with one instanced draw.
+/// </summary>
+/// <param name='transforms'>World transform of each joint.</param>
+/// <param name='numJoints'>Number of joints.</param>
+void BVHRenderer::RenderJoints( const BVHAffine * transforms, int numJoints )
+{
+	BVH_PROFILE_SCOPE( "RenderJoints" );
+
+	if( numJoints <= 0 || FAILED( CreateInstanceBuffer( numJoints ) ) )
+		return;
+
+	// Set instance data
+	BVHAffine *pData = NULL;
+	if( FAILED( instanceBuffer->Map( D3D10_MAP_WRITE_DISCARD, 0, reinterpret_cast< void** >( &pData ) ) ) )
+		return;
+
+	memcpy( pData, transforms, sizeof( BVHAffine ) * numJoints );
+	instanceBuffer->Unmap();
+	BVH_PROFILE_COUNT( BVHCounterBytesUploaded, sizeof( BVHAffine ) * numJoints );
+
+	// Set cube and instance buffers
+	ID3D10Buffer* buffers[2] = { cubeVertexBuffer, instanceBuffer };
+	UINT strides[2] = { sizeof( SimpleVertex ), sizeof( BVHAffine ) };
+	UINT offsets[2] = { 0, 0 };
+	d3dDevice->IASetInputLayout( instanceLayout );
+    d3dDevice->IASetVertexBuffers( 0, 2, buffers, strides, offsets );
+    d3dDevice->IASetIndexBuffer( cubeIndexBuffer, DXGI_FORMAT_R32_UINT, 0 );
+
+	// Set topology
+	d3dDevice->IASetPrimitiveTopology( D3D10_PRIMITIVE_TOPOLOGY_TRIANGLELIST );
+
+    //
+    // Render the cubes
+    //
+    D3D10_TECHNIQUE_DESC techDesc;
+    techniqueInstanced->GetDesc( &techDesc );
+    for( UINT p = 0; p < techDesc.Passes; ++p )
+    {
+        techniqueInstanced->GetPassByIndex( p )->Apply( 0 );
+		d3dDevice->DrawIndexedInstanced( 36, numJoints, 0, 0, 0 );
+		BVH_PROFILE_COUNT( BVHCounterDrawCalls, 1 );
+    }
+}
+
+/// <summary>
+/// Writes the two end points of each edge of a posed skeleton.
+/// </summary>
+/// <param name='skeleton'>The skeleton.</param>
+/// <param name='transforms'>World transform of each joint.</param>
+/// <param name='vertices'>Receives two vertices per edge, usually mapped buffer memory, so it is only written in order and never read.</param>
+/// <returns>The vertex after the last one written.</returns>
+SimpleVertex * BVHRenderer::WriteEdges( const BVHSkeleton & skeleton, const BVHAffine * transforms, SimpleVertex * vertices )
+{
+	const D3DXVECTOR4 color( 1, 1, 1, 1 );
+
+	// Each edge runs from the parent's position to the joint's
+	for( int j = 0; j < skeleton.GetNumJoints(); ++j )
+	{
+		int parent = skeleton.GetParent( j );
+		if( parent < 0 )
+			continue;
+
+		vertices->Pos = D3DXVECTOR3( transforms[parent].m[0][3], transforms[parent].m[1][3], transforms[parent].m[2][3] );
+		vertices->Color = color;
+		++vertices;
+
+		vertices->Pos = D3DXVECTOR3( transforms[j].m[0][3], transforms[j].m[1][3], transforms[j].m[2][3] );
+		vertices->Color = color;
+		++vertices;
+	}
+
+	return vertices;
+}
+
+/// <summary>
+/// Draws the first edges of the edge vertex buffer as lines.
+/// </summary>
+/// <param name='numEdges'>Number of edges written to the buffer.</param>
+void BVHRenderer::DrawEdges( int numEdges )
+{
+	// Set vertex buffer
+	UINT stride = sizeof( SimpleVertex );
+	UINT offset = 0;
+	d3dDevice->IASetInputLayout( vertexLayout );
+    d3dDevice->IASetVertexBuffers( 0, 1, &edgeVertexBuffer, &stride, &offset );
+
+    // Update variables for the edges, which are already in world space
+	BVHMatrix world;
+	BVHMatrixIdentity( &world );
+    worldVariable->SetMatrix( ( float* )&world );
+
+	// Set topology
+	d3dDevice->IASetPrimitiveTopology( D3D10_PRIMITIVE_TOPOLOGY_LINELIST );
+
+    // Render the edges
+    D3D10_TECHNIQUE_DESC techDesc;
+    techniqueRender->GetDesc( &techDesc );
+    for( UINT p = 0; p < techDesc.Passes; ++p )
+    {
+        techniqueRender->GetPassByIndex( p )->Apply( 0 );
+		d3dDevice->Draw( numEdges * 2, 0 );
+		BVH_PROFILE_COUNT( BVHCounterDrawCalls, 1 );
+    }
+}
+
+/// <summary>
+/// Renders the edges of every figure of a crowd with one map and one draw.
+/// </summary>
+void BVHRenderer::RenderEdges( const BVHCrowd & crowd )
+{
+	BVH_PROFILE_SCOPE( "RenderEdges" );
+
+	if( !crowd.IsPosed() )
+		return;
+
+	int numEdges = 0;
+	for( int i = 0; i < crowd.GetNumFigures(); ++i )
+	{
+		numEdges += crowd.GetFigure( i ).GetSkeleton()->GetNumEdges();
+	}
+
+	if( numEdges == 0 || FAILED( CreateEdgeBuffer( numEdges ) ) )
+		return;
+
+	SimpleVertex *pData = NULL;
+	if( FAILED( edgeVertexBuffer->Map( D3D10_MAP_WRITE_DISCARD, 0, reinterpret_cast< void** >( &pData ) ) ) )
+		return;
+
+	for( int i = 0; i < crowd.GetNumFigures(); ++i )
+	{
+		pData = WriteEdges( *crowd.GetFigure( i ).GetSkeleton(), crowd.GetPose( i ), pData );
+	}
+
+	edgeVertexBuffer->Unmap();
+	BVH_PROFILE_COUNT( BVHCounterBytesUploaded, sizeof( SimpleVertex ) * 2 * numEdges );
+
+	DrawEdges( numEdges );
+}
+
+/// <summary>
+/// Renders the edges of a posed skeleton.
+/// </summary>
+/// <param name='skeleton'>The skeleton.</param>
+/// <param name='transforms'>World transform of each joint.</param>
+void BVHRenderer::RenderEdges( const BVHSkeleton & skeleton, const BVHAffine * transforms )
+{
+	BVH_PROFILE_SCOPE( "RenderEdges" );
+
+	if( skeleton.GetNumEdges() == 0 || FAILED( CreateEdgeBuffer( skeleton.GetNumEdges() ) ) )
+		return;
+
+	SimpleVertex *pData = NULL;
+	if( FAILED( edgeVertexBuffer->Map( D3D10_MAP_WRITE_DISCARD, 0, reinterpret_cast< void** >( &pData ) ) ) )
+		return;
+
+	WriteEdges( skeleton, transforms, pData );
+	edgeVertexBuffer->Unmap();
+	BVH_PROFILE_COUNT( BVHCounterBytesUploaded, sizeof( SimpleVertex ) * 2 * skeleton.GetNumEdges() );
+
+	DrawEdges( skeleton.GetNumEdges() );
+}
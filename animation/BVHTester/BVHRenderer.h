@@ -0,0 +1,65 @@
+#pragma once
+
+#include <vector>
+
+#include "BVHCrowd.h"
+#include "BVHMath.h"
+#include "BVHSkeleton.h"
+
+#include <d3dx10.h>
+
+using namespace std;
+
+struct SimpleVertex
+{
+    D3DXVECTOR3 Pos;
+    D3DXVECTOR4 Color;
+};
+
+/// <summary>
+/// Draws posed skeletons with DirectX 10, a cube at each joint and a line
+/// from each joint to its parent. One renderer draws any number of figures.
+/// </summary>
+/// <remarks>
+/// The cubes are instanced: the world transforms of the joints go into one
+/// instance buffer, and a single draw places a cube at every one of them.
+/// The edges of every figure are written straight into one mapped vertex
+/// buffer and drawn with a single draw as well.
+/// </remarks>
+class BVHRenderer
+{
+protected:
+	ID3D10Device*				d3dDevice;
+	ID3D10EffectTechnique*		techniqueRender;
+	ID3D10EffectTechnique*		techniqueInstanced;
+	ID3D10InputLayout*			vertexLayout;
+	ID3D10InputLayout*			instanceLayout;
+	ID3D10Buffer*               edgeVertexBuffer;
+	ID3D10Buffer*               cubeVertexBuffer;
+	ID3D10Buffer*               cubeIndexBuffer;
+	ID3D10Buffer*               instanceBuffer;
+	ID3D10EffectMatrixVariable* worldVariable;
+	vector<BVHAffine>			pose;			// Joint transforms converted from matrices
+	int							maxEdges;		// Edges edgeVertexBuffer holds
+	int							maxInstances;	// Joints instanceBuffer holds
+	HRESULT CreateInputLayouts();
+	HRESULT CreateVertexBuffer();
+	HRESULT CreateEdgeBuffer( int numEdges );
+	HRESULT CreateInstanceBuffer( int numInstances );
+	static SimpleVertex * WriteEdges( const BVHSkeleton & skeleton, const BVHAffine * transforms, SimpleVertex * vertices );
+	void DrawEdges( int numEdges );
+public:
+	BVHRenderer(void);
+	~BVHRenderer(void);
+	HRESULT Initialize( ID3D10Device * d3dDevice,
+		ID3D10EffectTechnique * techniqueRender,
+		ID3D10EffectTechnique * techniqueInstanced,
+		ID3D10EffectMatrixVariable * worldVariable );
+	void Render( const BVHCrowd & crowd );
+	void Render( const BVHSkeleton & skeleton, const BVHAffine * transforms );
+	void Render( const BVHSkeleton & skeleton, const BVHMatrix * worldMatrices );
+	void RenderJoints( const BVHAffine * transforms, int numJoints );
+	void RenderEdges( const BVHCrowd & crowd );
+	void RenderEdges( const BVHSkeleton & skeleton, const BVHAffine * transforms );
+	void Cleanup();
+};
@@ -0,0 +1,145 @@
+#pragma once
+
+// A few vector float operations over whichever instruction set the
+// compiler targets: 8 lanes of AVX, 4 lanes of SSE2, or a single float.
+// VS2008 builds get SSE2; AVX needs a compiler that defines __AVX__.
+// Define BVH_NO_SIMD to force the single float version.
+
+#include <cmath>
+#include <cstring>
+
+#if !defined( BVH_NO_SIMD ) && defined( __AVX__ )
+
+#include <immintrin.h>
+
+#define BVH_SIMD_WIDTH 8
+
+typedef __m256 BVHFloats;
+
+inline BVHFloats BVHSimdSet( float value ) { return _mm256_set1_ps( value ); }
+inline BVHFloats BVHSimdLoad( const float * values ) { return _mm256_loadu_ps( values ); }
+inline void BVHSimdStore( float * values, BVHFloats v ) { _mm256_storeu_ps( values, v ); }
+inline BVHFloats BVHSimdAdd( BVHFloats a, BVHFloats b ) { return _mm256_add_ps( a, b ); }
+inline BVHFloats BVHSimdSub( BVHFloats a, BVHFloats b ) { return _mm256_sub_ps( a, b ); }
+inline BVHFloats BVHSimdMul( BVHFloats a, BVHFloats b ) { return _mm256_mul_ps( a, b ); }
+inline BVHFloats BVHSimdNegate( BVHFloats a ) { return _mm256_sub_ps( _mm256_setzero_ps(), a ); }
+inline BVHFloats BVHSimdDiv( BVHFloats a, BVHFloats b ) { return _mm256_div_ps( a, b ); }
+inline BVHFloats BVHSimdAnd( BVHFloats a, BVHFloats b ) { return _mm256_and_ps( a, b ); }
+inline BVHFloats BVHSimdOr( BVHFloats a, BVHFloats b ) { return _mm256_or_ps( a, b ); }
+inline BVHFloats BVHSimdXor( BVHFloats a, BVHFloats b ) { return _mm256_xor_ps( a, b ); }
+inline BVHFloats BVHSimdEqual( BVHFloats a, BVHFloats b ) { return _mm256_cmp_ps( a, b, _CMP_EQ_OQ ); }
+inline BVHFloats BVHSimdLess( BVHFloats a, BVHFloats b ) { return _mm256_cmp_ps( a, b, _CMP_LT_OQ ); }
+inline BVHFloats BVHSimdSelect( BVHFloats mask, BVHFloats a, BVHFloats b ) { return _mm256_blendv_ps( b, a, mask ); }
+inline BVHFloats BVHSimdRound( BVHFloats a ) { return _mm256_round_ps( a, _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC ); }
+inline BVHFloats BVHSimdFloor( BVHFloats a ) { return _mm256_floor_ps( a ); }
+
+#elif !defined( BVH_NO_SIMD ) && ( defined( _M_IX86 ) || defined( _M_X64 ) || defined( __SSE2__ ) )
+
+#include <emmintrin.h>
+
+#define BVH_SIMD_WIDTH 4
+
+typedef __m128 BVHFloats;
+
+inline BVHFloats BVHSimdSet( float value ) { return _mm_set1_ps( value ); }
+inline BVHFloats BVHSimdLoad( const float * values ) { return _mm_loadu_ps( values ); }
+inline void BVHSimdStore( float * values, BVHFloats v ) { _mm_storeu_ps( values, v ); }
+inline BVHFloats BVHSimdAdd( BVHFloats a, BVHFloats b ) { return _mm_add_ps( a, b ); }
+inline BVHFloats BVHSimdSub( BVHFloats a, BVHFloats b ) { return _mm_sub_ps( a, b ); }
+inline BVHFloats BVHSimdMul( BVHFloats a, BVHFloats b ) { return _mm_mul_ps( a, b ); }
+inline BVHFloats BVHSimdNegate( BVHFloats a ) { return _mm_sub_ps( _mm_setzero_ps(), a ); }
+inline BVHFloats BVHSimdDiv( BVHFloats a, BVHFloats b ) { return _mm_div_ps( a, b ); }
+inline BVHFloats BVHSimdAnd( BVHFloats a, BVHFloats b ) { return _mm_and_ps( a, b ); }
+inline BVHFloats BVHSimdOr( BVHFloats a, BVHFloats b ) { return _mm_or_ps( a, b ); }
+inline BVHFloats BVHSimdXor( BVHFloats a, BVHFloats b ) { return _mm_xor_ps( a, b ); }
+inline BVHFloats BVHSimdEqual( BVHFloats a, BVHFloats b ) { return _mm_cmpeq_ps( a, b ); }
+inline BVHFloats BVHSimdLess( BVHFloats a, BVHFloats b ) { return _mm_cmplt_ps( a, b ); }
+inline BVHFloats BVHSimdSelect( BVHFloats mask, BVHFloats a, BVHFloats b ) { return _mm_or_ps( _mm_and_ps( mask, a ), _mm_andnot_ps( mask, b ) ); }
+inline BVHFloats BVHSimdRound( BVHFloats a ) { return _mm_cvtepi32_ps( _mm_cvtps_epi32( a ) ); }
+
+inline BVHFloats BVHSimdFloor( BVHFloats a )
+{
+	// Truncate, then step down where that rounded a negative value up
+	BVHFloats t = _mm_cvtepi32_ps( _mm_cvttps_epi32( a ) );
+	return _mm_sub_ps( t, _mm_and_ps( _mm_cmpgt_ps( t, a ), _mm_set1_ps( 1.0f ) ) );
+}
+
+#else
+
+#define BVH_SIMD_WIDTH 1
+
+typedef float BVHFloats;
+
+inline unsigned int BVHSimdBits( float a ) { unsigned int bits; memcpy( &bits, &a, sizeof( bits ) ); return bits; }
+inline float BVHSimdFromBits( unsigned int bits ) { float a; memcpy( &a, &bits, sizeof( a ) ); return a; }
+
+inline BVHFloats BVHSimdSet( float value ) { return value; }
+inline BVHFloats BVHSimdLoad( const float * values ) { return *values; }
+inline void BVHSimdStore( float * values, BVHFloats v ) { *values = v; }
+inline BVHFloats BVHSimdAdd( BVHFloats a, BVHFloats b ) { return a + b; }
+inline BVHFloats BVHSimdSub( BVHFloats a, BVHFloats b ) { return a - b; }
+inline BVHFloats BVHSimdMul( BVHFloats a, BVHFloats b ) { return a * b; }
+inline BVHFloats BVHSimdNegate( BVHFloats a ) { return -a; }
+inline BVHFloats BVHSimdDiv( BVHFloats a, BVHFloats b ) { return a / b; }
+inline BVHFloats BVHSimdAnd( BVHFloats a, BVHFloats b ) { return BVHSimdFromBits( BVHSimdBits( a ) & BVHSimdBits( b ) ); }
+inline BVHFloats BVHSimdOr( BVHFloats a, BVHFloats b ) { return BVHSimdFromBits( BVHSimdBits( a ) | BVHSimdBits( b ) ); }
+inline BVHFloats BVHSimdXor( BVHFloats a, BVHFloats b ) { return BVHSimdFromBits( BVHSimdBits( a ) ^ BVHSimdBits( b ) ); }
+inline BVHFloats BVHSimdEqual( BVHFloats a, BVHFloats b ) { return BVHSimdFromBits( a == b ? 0xFFFFFFFFU : 0 ); }
+inline BVHFloats BVHSimdLess( BVHFloats a, BVHFloats b ) { return BVHSimdFromBits( a < b ? 0xFFFFFFFFU : 0 ); }
+inline BVHFloats BVHSimdSelect( BVHFloats mask, BVHFloats a, BVHFloats b ) { return BVHSimdBits( mask ) ? a : b; }
+inline BVHFloats BVHSimdRound( BVHFloats a ) { return floorf( a + 0.5f ); }
+inline BVHFloats BVHSimdFloor( BVHFloats a ) { return floorf( a ); }
+
+#endif
+
+#if BVH_SIMD_WIDTH > 1
+
+// The arithmetic on a single float too, so code templated on the type of
+// its values, like the Euler forms in BVHEuler.h, also composes one pose.
+// The single float build has these already.
+inline float BVHSimdAdd( float a, float b ) { return a + b; }
+inline float BVHSimdSub( float a, float b ) { return a - b; }
+inline float BVHSimdMul( float a, float b ) { return a * b; }
+inline float BVHSimdNegate( float a ) { return -a; }
+
+#endif
+
+/// <summary>
+/// Sine and cosine of every lane, accurate to a few float ulps for the
+/// angles found in motion data.
+/// </summary>
+/// <remarks>
+/// The angle is reduced to [-pi/4, pi/4] around the nearest multiple of
+/// pi/2 in three steps, so the reduction stays exact for large angles.
+/// Minimax polynomials then give the sine and cosine of the remainder, and
+/// the quadrant picks which of them, and which sign, each result takes.
+/// </remarks>
+inline void BVHSimdSinCos( BVHFloats angle, BVHFloats * sine, BVHFloats * cosine )
+{
+	BVHFloats quadrant = BVHSimdRound( BVHSimdMul( angle, BVHSimdSet( 0.636619772f ) ) );
+
+	BVHFloats x = BVHSimdSub( angle, BVHSimdMul( quadrant, BVHSimdSet( 1.5703125f ) ) );
+	x = BVHSimdSub( x, BVHSimdMul( quadrant, BVHSimdSet( 4.837512969970703125e-4f ) ) );
+	x = BVHSimdSub( x, BVHSimdMul( quadrant, BVHSimdSet( 7.54978995489188216e-8f ) ) );
+
+	BVHFloats x2 = BVHSimdMul( x, x );
+
+	BVHFloats s = BVHSimdAdd( BVHSimdMul( BVHSimdSet( -1.9515295891e-4f ), x2 ), BVHSimdSet( 8.3321608736e-3f ) );
+	s = BVHSimdAdd( BVHSimdMul( s, x2 ), BVHSimdSet( -1.6666654611e-1f ) );
+	s = BVHSimdAdd( BVHSimdMul( BVHSimdMul( s, x2 ), x ), x );
+
+	BVHFloats c = BVHSimdAdd( BVHSimdMul( BVHSimdSet( 2.443315711809948e-5f ), x2 ), BVHSimdSet( -1.388731625493765e-3f ) );
+	c = BVHSimdAdd( BVHSimdMul( c, x2 ), BVHSimdSet( 4.166664568298827e-2f ) );
+	c = BVHSimdAdd( BVHSimdMul( BVHSimdMul( c, x2 ), x2 ), BVHSimdSub( BVHSimdSet( 1.0f ), BVHSimdMul( x2, BVHSimdSet( 0.5f ) ) ) );
+
+	// quadrant mod 4: 0 ( s, c ), 1 ( c, -s ), 2 ( -s, -c ), 3 ( -c, s )
+	BVHFloats q = BVHSimdSub( quadrant, BVHSimdMul( BVHSimdFloor( BVHSimdMul( quadrant, BVHSimdSet( 0.25f ) ) ), BVHSimdSet( 4.0f ) ) );
+	BVHFloats q1 = BVHSimdEqual( q, BVHSimdSet( 1.0f ) );
+	BVHFloats q2 = BVHSimdEqual( q, BVHSimdSet( 2.0f ) );
+	BVHFloats q3 = BVHSimdEqual( q, BVHSimdSet( 3.0f ) );
+	BVHFloats swap = BVHSimdOr( q1, q3 );
+	BVHFloats signBit = BVHSimdSet( -0.0f );
+
+	*sine = BVHSimdXor( BVHSimdSelect( swap, c, s ), BVHSimdAnd( BVHSimdOr( q2, q3 ), signBit ) );
+	*cosine = BVHSimdXor( BVHSimdSelect( swap, s, c ), BVHSimdAnd( BVHSimdOr( q1, q2 ), signBit ) );
+}
@@ -0,0 +1,332 @@
+// BVHSkeleton.cpp
+//
+// Summary:
+//	The joint hierarchy of a BVH figure stored as flat arrays, and the
+//	forward kinematics that turns a frame of motion data into a pose.
+
+#include "BVHSkeleton.h"
+#include "BVHEuler.h"
+#include "BVHProfiler.h"
+
+// The axes, 0 to 2 for X to Z, of each RotationOrder in the order listed
+static const int g_rotationAxes[6][3] =
+{
+	{ 0, 1, 2 }, { 0, 2, 1 }, { 1, 0, 2 }, { 1, 2, 0 }, { 2, 0, 1 }, { 2, 1, 0 }
+};
+
+BVHSkeleton::BVHSkeleton(void)
+{
+	numEdges = 0;
+	generation = 0;
+}
+
+BVHSkeleton::~BVHSkeleton(void)
+{
+}
+
+/// <summary>
+/// Removes all joints and channels.
+/// </summary>
+void BVHSkeleton::Clear()
+{
+	names.clear();
+	parents.clear();
+	offsets.clear();
+	firstChannels.clear();
+	jointChannels.clear();
+	channels.clear();
+	rotationOrders.clear();
+	rotationChannels.clear();
+	positionChannels.clear();
+	numEdges = 0;
+	++generation;
+}
+
+/// <summary>
+/// Adds a joint after all existing joints.
+/// </summary>
+/// <param name='name'>Name of the joint, empty for an End Site.</param>
+/// <param name='parent'>Index of the parent joint, or -1 for a root.</param>
+/// <returns>Index of the new joint.</returns>
+int BVHSkeleton::AddJoint( const string & name, int parent )
+{
+	names.push_back( name );
+	parents.push_back( parent );
+	offsets.push_back( BVHVector3( 0, 0, 0 ) );
+	firstChannels.push_back( ( int )channels.size() );
+	jointChannels.push_back( 0 );
+	rotationOrders.push_back( RotationZXY );
+	rotationChannels.insert( rotationChannels.end(), 3, -1 );
+	positionChannels.insert( positionChannels.end(), 3, -1 );
+
+	if( parent >= 0 )
+		++numEdges;
+
+	++generation;
+	return ( int )parents.size() - 1;
+}
+
+void BVHSkeleton::SetOffset( int joint, BVHVector3 offset )
+{
+	offsets[joint] = offset;
+	++generation;
+}
+
+/// <summary>
+/// Adds the next sample of a frame to a joint. The samples of a joint
+/// must be added together, before the samples of any other joint.
+/// </summary>
+/// <remarks>
+/// Where each rotation and position sample is, and the order of the
+/// rotations, are worked out here once, so posing a joint reads its
+/// samples directly rather than testing each channel. A later channel of
+/// the same kind replaces an earlier one.
+/// </remarks>
+HRESULT BVHSkeleton::AddChannel( int joint, Channel channel )
+{
+	if( jointChannels[joint] == 0 )
+		firstChannels[joint] = ( int )channels.size();
+	else if( firstChannels[joint] + jointChannels[joint] != channels.size() )
+		return E_FAIL;
+
+	channels.push_back( channel );
+	++jointChannels[joint];
+	++generation;
+
+	int sample = ( int )channels.size() - 1;
+	switch( channel )
+	{
+	case Xrotation: rotationChannels[joint * 3] = sample; break;
+	case Yrotation: rotationChannels[joint * 3 + 1] = sample; break;
+	case Zrotation: rotationChannels[joint * 3 + 2] = sample; break;
+	case Xposition: positionChannels[joint * 3] = sample; break;
+	case Yposition: positionChannels[joint * 3 + 1] = sample; break;
+	case Zposition: positionChannels[joint * 3 + 2] = sample; break;
+	default: break;
+	}
+
+	// The first two rotation axes listed fix the order. A missing axis does
+	// not rotate, so it can go anywhere.
+	int first = -1, second = -1;
+	for( int c = firstChannels[joint]; c < firstChannels[joint] + jointChannels[joint]; ++c )
+	{
+		int axis = channels[c] == Xrotation ? 0 : channels[c] == Yrotation ? 1 : channels[c] == Zrotation ? 2 : -1;
+
+		if( axis < 0 || axis == first )
+			continue;
+
+		if( first < 0 )
+			first = axis;
+		else if( second < 0 )
+			second = axis;
+	}
+
+	if( first >= 0 )
+	{
+		if( second < 0 )
+			second = ( first + 1 ) % 3;
+
+		for( int order = 0; order < 6; ++order )
+		{
+			if( g_rotationAxes[order][0] == first && g_rotationAxes[order][1] == second )
+				rotationOrders[joint] = ( RotationOrder )order;
+		}
+	}
+
+	return S_OK;
+}
+
+/// <summary>
+/// Returns the axes, 0 to 2 for X to Z, of a rotation order in the order
+/// they are listed.
+/// </summary>
+const int * BVHSkeleton::GetRotationAxes( RotationOrder order )
+{
+	return g_rotationAxes[order];
+}
+
+/// <summary>
+/// Returns the bytes the joints and channels take up in memory.
+/// </summary>
+size_t BVHSkeleton::GetSize() const
+{
+	size_t size = names.capacity() * sizeof( string ) + parents.capacity() * sizeof( int ) +
+		offsets.capacity() * sizeof( BVHVector3 ) + firstChannels.capacity() * sizeof( int ) +
+		jointChannels.capacity() * sizeof( int ) + channels.capacity() * sizeof( Channel ) +
+		rotationOrders.capacity() * sizeof( RotationOrder ) + rotationChannels.capacity() * sizeof( int ) +
+		positionChannels.capacity() * sizeof( int );
+
+	for( int j = 0; j < names.size(); ++j )
+		size += names[j].capacity();
+
+	return size;
+}
+
+/// <summary>
+///	Gets the translation of a joint from its position samples.
+/// </summary>
+/// <param name='joint'>Index of the joint.</param>
+/// <param name='frame'>A frame of motion data.</param>
+BVHVector3 BVHSkeleton::GetTranslation( int joint, const float * frame ) const
+{
+	const int * position = &positionChannels[joint * 3];
+	return BVHVector3( position[0] >= 0 ? frame[position[0]] : 0.0f,
+		position[1] >= 0 ? frame[position[1]] : 0.0f,
+		position[2] >= 0 ? frame[position[2]] : 0.0f );
+}
+
+/// <summary>
+///	Creates the rotation matrix of a joint from its rotation samples,
+/// composed in the order the joint lists them.
+/// </summary>
+/// <remarks>
+/// Switches once on the joint's order into the closed form of BVHEuler.h
+/// that BVHPoseBatch uses, rather than multiplying a matrix per axis.
+/// </remarks>
+/// <param name='joint'>Index of the joint.</param>
+/// <param name='frame'>A frame of motion data.</param>
+BVHMatrix BVHSkeleton::GetRotation( int joint, const float * frame ) const
+{
+	const int * rotation = &rotationChannels[joint * 3];
+
+	// A missing axis has an angle of 0
+	float s[3], c[3];
+	for( int i = 0; i < 3; ++i )
+	{
+		float angle = rotation[i] >= 0 ? frame[rotation[i]] * ( BVH_PI / 180.0f ) : 0.0f;
+		s[i] = sinf( angle );
+		c[i] = cosf( angle );
+	}
+
+	float local[9];
+	BVHComposeMatrix( rotationOrders[joint], s, c, local );
+
+	BVHMatrix result;
+	for( int r = 0; r < 3; ++r )
+	{
+		for( int col = 0; col < 3; ++col )
+			result.m[r][col] = local[r * 3 + col];
+		result.m[r][3] = 0.0f;
+	}
+	result._41 = result._42 = result._43 = 0.0f;
+	result._44 = 1.0f;
+	return result;
+}
+
+/// <summary>
+///	Creates the rotation of a joint from its rotation samples as a quaternion,
+/// the same rotation as GetRotation.
+/// </summary>
+/// <param name='joint'>Index of the joint.</param>
+/// <param name='frame'>A frame of motion data.</param>
+BVHQuaternion BVHSkeleton::GetRotationQuaternion( int joint, const float * frame ) const
+{
+	const int * rotation = &rotationChannels[joint * 3];
+
+	float s[3], c[3];
+	for( int i = 0; i < 3; ++i )
+	{
+		float halfAngle = rotation[i] >= 0 ? frame[rotation[i]] * ( BVH_PI / 360.0f ) : 0.0f;
+		s[i] = sinf( halfAngle );
+		c[i] = cosf( halfAngle );
+	}
+
+	float q[4];
+	BVHComposeQuaternion( rotationOrders[joint], s, c, q );
+	return BVHQuaternion( q[0], q[1], q[2], q[3] );
+}
+
+/// <summary>
+/// Computes the world matrix of every joint for a frame of motion data.
+/// </summary>
+/// <remarks>
+/// A joint's local matrix is rotation * translation * offset. The last two
+/// are both translations, so they are summed into the bottom row of the
+/// rotation rather than multiplied. Parents come before their children, so
+/// the parent's world matrix is always ready when a joint is reached.
+/// </remarks>
+/// <param name='frame'>A frame of motion data, or NULL if the skeleton has no channels.</param>
+/// <param name='world'>World matrix of the roots' parent space.</param>
+/// <param name='worldMatrices'>Receives GetNumJoints() matrices.</param>
+void BVHSkeleton::EvaluatePose( const float * frame, const BVHMatrix & world, BVHMatrix * worldMatrices ) const
+{
+	for( int j = 0; j < parents.size(); ++j )
+	{
+		BVHMatrix local;
+
+		if( jointChannels[j] > 0 )
+		{
+			BVHVector3 translation = GetTranslation( j, frame );
+			local = GetRotation( j, frame );
+			local._41 = translation.x + offsets[j].x;
+			local._42 = translation.y + offsets[j].y;
+			local._43 = translation.z + offsets[j].z;
+		}
+		else
+		{
+			BVHMatrixTranslation( &local, offsets[j].x, offsets[j].y, offsets[j].z );
+		}
+
+		worldMatrices[j] = local * ( parents[j] >= 0 ? worldMatrices[parents[j]] : world );
+	}
+
+	BVH_PROFILE_COUNT( BVHCounterMatricesComposed, parents.size() );
+}
+
+/// <summary>
+/// Computes the world matrix of every joint between two frames of motion
+/// data. Translations are interpolated linearly and rotations as
+/// quaternions, so playback is smooth at any rate.
+/// </summary>
+/// <param name='frame'>A frame of motion data, or NULL if the skeleton has no channels.</param>
+/// <param name='nextFrame'>The frame to interpolate towards.</param>
+/// <param name='weight'>0 for frame, 1 for nextFrame.</param>
+/// <param name='world'>World matrix of the roots' parent space.</param>
+/// <param name='worldMatrices'>Receives GetNumJoints() matrices.</param>
+void BVHSkeleton::EvaluatePose( const float * frame, const float * nextFrame, float weight, const BVHMatrix & world, BVHMatrix * worldMatrices ) const
+{
+	for( int j = 0; j < parents.size(); ++j )
+	{
+		BVHMatrix local;
+
+		if( jointChannels[j] > 0 )
+		{
+			BVHQuaternion a = GetRotationQuaternion( j, frame );
+			BVHQuaternion b = GetRotationQuaternion( j, nextFrame );
+			BVHQuaternion rotation;
+			BVHMatrixRotationQuaternion( &local, BVHQuaternionNlerp( &rotation, &a, &b, weight ) );
+
+			BVHVector3 from = GetTranslation( j, frame );
+			BVHVector3 to = GetTranslation( j, nextFrame );
+			local._41 = from.x + ( to.x - from.x ) * weight + offsets[j].x;
+			local._42 = from.y + ( to.y - from.y ) * weight + offsets[j].y;
+			local._43 = from.z + ( to.z - from.z ) * weight + offsets[j].z;
+		}
+		else
+		{
+			BVHMatrixTranslation( &local, offsets[j].x, offsets[j].y, offsets[j].z );
+		}
+
+		worldMatrices[j] = local * ( parents[j] >= 0 ? worldMatrices[parents[j]] : world );
+	}
+
+	BVH_PROFILE_COUNT( BVHCounterMatricesComposed, parents.size() );
+}
+
+Channel parseChannel( const BVHToken & channelName )
+{
+	if(channelName.Equals("Xposition")) {
+		return Xposition;
+	} else if(channelName.Equals("Yposition")) {
+		return Yposition;
+	} else if(channelName.Equals("Zposition")) {
+		return Zposition;
+	} else if(channelName.Equals("Zrotation")) {
+		return Zrotation;
+	} else if(channelName.Equals("Xrotation")) {
+		return Xrotation;
+	} else if(channelName.Equals("Yrotation")) {
+		return Yrotation;
+	}
+	return None;
+}
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <vector>
+#include <string>
+
+#include "BVHFile.h"
+#include "BVHMath.h"
+
+using namespace std;
+
+enum Channel
+{
+	None = 0,
+	Xposition = 1,
+	Yposition = 2,
+	Zposition = 4,
+	Zrotation = 8,
+	Xrotation = 16,
+	Yrotation = 32
+};
+
+Channel parseChannel( const BVHToken & channelName );
+
+/// <summary>
+/// The order a joint's CHANNELS line lists its rotations in. For ZXY the
+/// joint's rotation is Ry * Rx * Rz with D3DX row vectors: the rotation
+/// listed last is applied to a point first.
+/// </summary>
+enum RotationOrder
+{
+	RotationXYZ,
+	RotationXZY,
+	RotationYXZ,
+	RotationYZX,
+	RotationZXY,
+	RotationZYX
+};
+
+/// <summary>
+/// The joints of a BVH figure, flattened into arrays. Joints are stored in
+/// the order the hierarchy lists them, so a parent always comes before its
+/// children and a pose is computed in one pass over the arrays.
+/// </summary>
+class BVHSkeleton
+{
+protected:
+	vector<string>				names;
+	vector<int>					parents;		// -1 for a root
+	vector<BVHVector3>			offsets;
+	vector<int>					firstChannels;	// Index of the joint's first sample in a frame
+	vector<int>					jointChannels;	// Number of samples of the joint in a frame
+	vector<Channel>				channels;		// Channel of each sample in a frame
+	vector<RotationOrder>		rotationOrders;	// Order of each joint's rotation channels
+	vector<int>					rotationChannels;	// Sample index of each joint's X, Y and Z rotation, -1 if none
+	vector<int>					positionChannels;	// Sample index of each joint's X, Y and Z position, -1 if none
+	int							numEdges;
+	unsigned int				generation;		// Bumped by every change, so a pose kept for the skeleton can tell it is stale
+public:
+	BVHSkeleton(void);
+	~BVHSkeleton(void);
+	void Clear();
+	int AddJoint( const string & name, int parent );
+	void SetOffset( int joint, BVHVector3 offset );
+	HRESULT AddChannel( int joint, Channel channel );
+	int GetNumJoints() const { return ( int )parents.size(); }
+	int GetNumChannels() const { return ( int )channels.size(); }
+	int GetNumEdges() const { return numEdges; }
+	unsigned int GetGeneration() const { return generation; }
+	const string & GetName( int joint ) const { return names[joint]; }
+	int GetParent( int joint ) const { return parents[joint]; }
+	const BVHVector3 & GetOffset( int joint ) const { return offsets[joint]; }
+	int GetFirstChannel( int joint ) const { return firstChannels[joint]; }
+	int GetNumJointChannels( int joint ) const { return jointChannels[joint]; }
+	Channel GetChannel( int channel ) const { return channels[channel]; }
+	RotationOrder GetRotationOrder( int joint ) const { return rotationOrders[joint]; }
+	const int * GetRotationChannels( int joint ) const { return &rotationChannels[joint * 3]; }
+	const int * GetPositionChannels( int joint ) const { return &positionChannels[joint * 3]; }
+	static const int * GetRotationAxes( RotationOrder order );
+	size_t GetSize() const;
+	BVHVector3 GetTranslation( int joint, const float * frame ) const;
+	BVHMatrix GetRotation( int joint, const float * frame ) const;
+	BVHQuaternion GetRotationQuaternion( int joint, const float * frame ) const;
+	void EvaluatePose( const float * frame, const BVHMatrix & world, BVHMatrix * worldMatrices ) const;
+	void EvaluatePose( const float * frame, const float * nextFrame, float weight, const BVHMatrix & world, BVHMatrix * worldMatrices ) const;
+};
@@ -1,376 +1,463 @@
-//--------------------------------------------------------------------------------------
-// File: BVHTester.cpp
-//
-// This application demonstrates animation using matrix transformations
-//
-// Copyright (c) Microsoft Corporation. All rights reserved.
-//--------------------------------------------------------------------------------------
-
-#include <vector>
-#include <windows.h>
-
-#include <d3d10.h>
-#include <d3dx10.h>
-
-#include "BVHNode.h"
-#include "BVHFigure.h"
-
-#include "resource.h"
-
-using namespace std;
-
-//--------------------------------------------------------------------------------------
-// Global Variables
-//--------------------------------------------------------------------------------------
-HINSTANCE                   g_hInst = NULL;
-HWND                        g_hWnd = NULL;
-D3D10_DRIVER_TYPE           g_driverType = D3D10_DRIVER_TYPE_NULL;
-ID3D10Device*               g_pd3dDevice = NULL;
-IDXGISwapChain*             g_pSwapChain = NULL;
-ID3D10RenderTargetView*     g_pRenderTargetView = NULL;
-ID3D10Texture2D*            g_pDepthStencil = NULL;
-ID3D10DepthStencilView*     g_pDepthStencilView = NULL;
-ID3D10Effect*               g_pEffect = NULL;
-ID3D10EffectTechnique*      g_pTechniqueRender = NULL;
-ID3D10InputLayout*          g_pVertexLayout = NULL;
-ID3D10EffectMatrixVariable* g_pViewVariable = NULL;
-ID3D10EffectMatrixVariable* g_pProjectionVariable = NULL;
-ID3D10EffectMatrixVariable* g_pWorldVariable = NULL;
-D3DXMATRIX                  g_Projection;
-
-BVHFigure*					g_figure;
-BVHFigure*					g_figure2;
-
-//--------------------------------------------------------------------------------------
-// Forward declarations
-//--------------------------------------------------------------------------------------
-HRESULT InitWindow( HINSTANCE hInstance, int nCmdShow );
-HRESULT InitDevice();
-void CleanupDevice();
-LRESULT CALLBACK    WndProc( HWND, UINT, WPARAM, LPARAM );
-void Render();
-
-//--------------------------------------------------------------------------------------
-// Entry point to the program. Initializes everything and goes into a message processing 
-// loop. Idle time is used to render the scene.
-//--------------------------------------------------------------------------------------
-int WINAPI wWinMain( HINSTANCE hInstance, HINSTANCE hPrevInstance, LPWSTR lpCmdLine, int nCmdShow )
-{
-    if( FAILED( InitWindow( hInstance, nCmdShow ) ) )
-        return E_FAIL;
-
-    if( FAILED( InitDevice() ) )
-    {
-        CleanupDevice();
-        return E_FAIL;
-    }
-
-	g_figure = new BVHFigure();
-	g_figure2 = new BVHFigure();
-	
-    if( FAILED( g_figure->ReadBVH("Jog.bvh") ) )
-		return E_FAIL;
-	
-    if( FAILED( g_figure2->ReadBVH("wave.bvh") ) )
-		return E_FAIL;
-
-    if( FAILED( g_figure->Initialize( g_pd3dDevice, g_pTechniqueRender, g_pWorldVariable ) ) )
-		return E_FAIL;
-
-    if( FAILED( g_figure2->Initialize( g_pd3dDevice, g_pTechniqueRender, g_pWorldVariable ) ) )
-		return E_FAIL;
-
-    // Main message loop
-    MSG msg = {0};
-    while( WM_QUIT != msg.message )
-    {
-        if( PeekMessage( &msg, NULL, 0, 0, PM_REMOVE ) )
-        {
-            TranslateMessage( &msg );
-            DispatchMessage( &msg );
-        }
-        else
-        {
-            Render();
-        }
-    }
-	
-	g_figure->Cleanup();
-	g_figure2->Cleanup();
-    CleanupDevice();
-
-	delete g_figure;
-	delete g_figure2;
-
-    return ( int )msg.wParam;
-}
-
-
-//--------------------------------------------------------------------------------------
-// Register class and create window
-//--------------------------------------------------------------------------------------
-HRESULT InitWindow( HINSTANCE hInstance, int nCmdShow )
-{
-    // Register class
-    WNDCLASSEX wcex;
-    wcex.cbSize = sizeof( WNDCLASSEX );
-    wcex.style = CS_HREDRAW | CS_VREDRAW;
-    wcex.lpfnWndProc = WndProc;
-    wcex.cbClsExtra = 0;
-    wcex.cbWndExtra = 0;
-    wcex.hInstance = hInstance;
-    wcex.hIcon = LoadIcon( hInstance, ( LPCTSTR )IDI_TUTORIAL1 );
-    wcex.hCursor = LoadCursor( NULL, IDC_ARROW );
-    wcex.hbrBackground = ( HBRUSH )( COLOR_WINDOW + 1 );
-    wcex.lpszMenuName = NULL;
-    wcex.lpszClassName = L"BVHTester";
-    wcex.hIconSm = LoadIcon( wcex.hInstance, ( LPCTSTR )IDI_TUTORIAL1 );
-    if( !RegisterClassEx( &wcex ) )
-        return E_FAIL;
-
-    // Create window
-    g_hInst = hInstance;
-    RECT rc = { 0, 0, 640, 480 };
-    AdjustWindowRect( &rc, WS_OVERLAPPEDWINDOW, FALSE );
-    g_hWnd = CreateWindow( L"BVHTester", L"BVHTester", WS_OVERLAPPEDWINDOW,
-                           CW_USEDEFAULT, CW_USEDEFAULT, rc.right - rc.left, rc.bottom - rc.top, NULL, NULL, hInstance,
-                           NULL );
-    if( !g_hWnd )
-        return E_FAIL;
-
-    ShowWindow( g_hWnd, nCmdShow );
-
-    return S_OK;
-}
-
-
-//--------------------------------------------------------------------------------------
-// Create Direct3D device and swap chain
-//--------------------------------------------------------------------------------------
-HRESULT InitDevice()
-{
-    HRESULT hr = S_OK;
-
-    RECT rc;
-    GetClientRect( g_hWnd, &rc );
-    UINT width = rc.right - rc.left;
-    UINT height = rc.bottom - rc.top;
-
-    UINT createDeviceFlags = 0;
-#ifdef _DEBUG
-    createDeviceFlags |= D3D10_CREATE_DEVICE_DEBUG;
-#endif
-
-    D3D10_DRIVER_TYPE driverTypes[] =
-    {
-        D3D10_DRIVER_TYPE_HARDWARE,
-        D3D10_DRIVER_TYPE_REFERENCE,
-    };
-    UINT numDriverTypes = sizeof( driverTypes ) / sizeof( driverTypes[0] );
-
-    DXGI_SWAP_CHAIN_DESC sd;
-    ZeroMemory( &sd, sizeof( sd ) );
-    sd.BufferCount = 1;
-    sd.BufferDesc.Width = width;
-    sd.BufferDesc.Height = height;
-    sd.BufferDesc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
-    sd.BufferDesc.RefreshRate.Numerator = 60;
-    sd.BufferDesc.RefreshRate.Denominator = 1;
-    sd.BufferUsage = DXGI_USAGE_RENDER_TARGET_OUTPUT;
-    sd.OutputWindow = g_hWnd;
-    sd.SampleDesc.Count = 1;
-    sd.SampleDesc.Quality = 0;
-    sd.Windowed = TRUE;
-
-    for( UINT driverTypeIndex = 0; driverTypeIndex < numDriverTypes; driverTypeIndex++ )
-    {
-        g_driverType = driverTypes[driverTypeIndex];
-        hr = D3D10CreateDeviceAndSwapChain( NULL, g_driverType, NULL, createDeviceFlags,
-                                            D3D10_SDK_VERSION, &sd, &g_pSwapChain, &g_pd3dDevice );
-        if( SUCCEEDED( hr ) )
-            break;
-    }
-    if( FAILED( hr ) )
-        return hr;
-
-    // Create a render target view
-    ID3D10Texture2D* pBuffer;
-    hr = g_pSwapChain->GetBuffer( 0, __uuidof( ID3D10Texture2D ), ( LPVOID* )&pBuffer );
-    if( FAILED( hr ) )
-        return hr;
-
-    hr = g_pd3dDevice->CreateRenderTargetView( pBuffer, NULL, &g_pRenderTargetView );
-    pBuffer->Release();
-    if( FAILED( hr ) )
-        return hr;
-
-    // Create depth stencil texture
-    D3D10_TEXTURE2D_DESC descDepth;
-    descDepth.Width = width;
-    descDepth.Height = height;
-    descDepth.MipLevels = 1;
-    descDepth.ArraySize = 1;
-    descDepth.Format = DXGI_FORMAT_D32_FLOAT;
-    descDepth.SampleDesc.Count = 1;
-    descDepth.SampleDesc.Quality = 0;
-    descDepth.Usage = D3D10_USAGE_DEFAULT;
-    descDepth.BindFlags = D3D10_BIND_DEPTH_STENCIL;
-    descDepth.CPUAccessFlags = 0;
-    descDepth.MiscFlags = 0;
-    hr = g_pd3dDevice->CreateTexture2D( &descDepth, NULL, &g_pDepthStencil );
-    if( FAILED( hr ) )
-        return hr;
-
-    // Create the depth stencil view
-    D3D10_DEPTH_STENCIL_VIEW_DESC descDSV;
-    descDSV.Format = descDepth.Format;
-    descDSV.ViewDimension = D3D10_DSV_DIMENSION_TEXTURE2D;
-    descDSV.Texture2D.MipSlice = 0;
-    hr = g_pd3dDevice->CreateDepthStencilView( g_pDepthStencil, &descDSV, &g_pDepthStencilView );
-    if( FAILED( hr ) )
-        return hr;
-
-    g_pd3dDevice->OMSetRenderTargets( 1, &g_pRenderTargetView, g_pDepthStencilView );
-
-    // Setup the viewport
-    D3D10_VIEWPORT vp;
-    vp.Width = width;
-    vp.Height = height;
-    vp.MinDepth = 0.0f;
-    vp.MaxDepth = 1.0f;
-    vp.TopLeftX = 0;
-    vp.TopLeftY = 0;
-    g_pd3dDevice->RSSetViewports( 1, &vp );
-
-    // Create the effect
-    DWORD dwShaderFlags = D3D10_SHADER_ENABLE_STRICTNESS;
-#if defined( DEBUG ) || defined( _DEBUG )
-    // Set the D3D10_SHADER_DEBUG flag to embed debug information in the shaders.
-    // Setting this flag improves the shader debugging experience, but still allows 
-    // the shaders to be optimized and to run exactly the way they will run in 
-    // the release configuration of this program.
-    dwShaderFlags |= D3D10_SHADER_DEBUG;
-    #endif
-    hr = D3DX10CreateEffectFromFile( L"BVHTester.fx", NULL, NULL, "fx_4_0", dwShaderFlags, 0, g_pd3dDevice, NULL,
-                                         NULL, &g_pEffect, NULL, NULL );
-    if( FAILED( hr ) )
-    {
-        MessageBox( NULL,
-                    L"The FX file cannot be located.  Please run this executable from the directory that contains the FX file.", L"Error", MB_OK );
-        return hr;
-    }
-
-    // Obtain the technique
-    g_pTechniqueRender = g_pEffect->GetTechniqueByName( "Render" );
-
-    // Obtain the variables
-    g_pWorldVariable = g_pEffect->GetVariableByName( "World" )->AsMatrix();
-    g_pViewVariable = g_pEffect->GetVariableByName( "View" )->AsMatrix();
-    g_pProjectionVariable = g_pEffect->GetVariableByName( "Projection" )->AsMatrix();
-
-    // Define the input layout
-    D3D10_INPUT_ELEMENT_DESC layout[] =
-    {
-        { "POSITION", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 0, D3D10_INPUT_PER_VERTEX_DATA, 0 },
-        { "COLOR", 0, DXGI_FORMAT_R32G32B32A32_FLOAT, 0, 12, D3D10_INPUT_PER_VERTEX_DATA, 0 },
-    };
-    UINT numElements = sizeof( layout ) / sizeof( layout[0] );
-
-    // Create the input layout
-    D3D10_PASS_DESC PassDesc;
-    g_pTechniqueRender->GetPassByIndex( 0 )->GetDesc( &PassDesc );
-    hr = g_pd3dDevice->CreateInputLayout( layout, numElements, PassDesc.pIAInputSignature,
-                                          PassDesc.IAInputSignatureSize, &g_pVertexLayout );
-    if( FAILED( hr ) )
-        return hr;
-
-	// Set the input layout
-	g_pd3dDevice->IASetInputLayout( g_pVertexLayout );
-
-    // Initialize the projection matrix
-    D3DXMatrixPerspectiveFovLH( &g_Projection, ( float )D3DX_PI * 0.25f, width / ( FLOAT )height, 0.1f, 1000.0f );
-    g_pProjectionVariable->SetMatrix( ( float* )&g_Projection );
-
-    return TRUE;
-}
-
-void CleanupDevice()
-{
-    if( g_pd3dDevice ) g_pd3dDevice->ClearState();
-
-    if( g_pVertexLayout ) g_pVertexLayout->Release();
-    if( g_pEffect ) g_pEffect->Release();
-    if( g_pRenderTargetView ) g_pRenderTargetView->Release();
-    if( g_pDepthStencil ) g_pDepthStencil->Release();
-    if( g_pDepthStencilView ) g_pDepthStencilView->Release();
-    if( g_pSwapChain ) g_pSwapChain->Release();
-    if( g_pd3dDevice ) g_pd3dDevice->Release();
-}
-
-//--------------------------------------------------------------------------------------
-// Called every time the application receives a message
-//--------------------------------------------------------------------------------------
-LRESULT CALLBACK WndProc( HWND hWnd, UINT message, WPARAM wParam, LPARAM lParam )
-{
-    PAINTSTRUCT ps;
-    HDC hdc;
-
-    switch( message )
-    {
-        case WM_PAINT:
-            hdc = BeginPaint( hWnd, &ps );
-            EndPaint( hWnd, &ps );
-            break;
-
-        case WM_DESTROY:
-            PostQuitMessage( 0 );
-            break;
-
-        default:
-            return DefWindowProc( hWnd, message, wParam, lParam );
-    }
-
-    return 0;
-}
-
-/// <summary>
-/// Render a frame.
-/// </summary>
-void Render()
-{
-    static float t = 0.0f;
-    static DWORD dwTimeStart = 0;
-    DWORD dwTimeCur = GetTickCount();
-    if( dwTimeStart == 0 )
-        dwTimeStart = dwTimeCur;
-
-    t = ( dwTimeCur - dwTimeStart ) / 1000.0f;
-
-	// Update figure
-	g_figure->Update(t);
-	g_figure2->Update(t);
-	D3DXVECTOR3 Eye( 500.0f, 10.0f, 500.0f );
-	D3DXVECTOR3 Up( 0.0f, 1.0f, 0.0f );
-	g_figure->LookAt( &Eye, &Up, g_pViewVariable);
-	g_figure2->LookAt( &Eye, &Up, g_pViewVariable);
-
-    //
-    // Clear the back buffer
-    //
-    float ClearColor[4] = { 0.0f, 0.125f, 0.3f, 1.0f }; //red, green, blue, alpha
-    g_pd3dDevice->ClearRenderTargetView( g_pRenderTargetView, ClearColor );
-
-    //
-    // Clear the depth buffer to 1.0 (max depth)
-    //
-    g_pd3dDevice->ClearDepthStencilView( g_pDepthStencilView, D3D10_CLEAR_DEPTH, 1.0f, 0 );
-
-	// Render figure
-	g_figure->Render();
-	g_figure2->Render();
-
-    //
-    // Present our back buffer to our front buffer
-    //
-    g_pSwapChain->Present( 0, 0 );
-}
+//--------------------------------------------------------------------------------------
+// File: BVHTester.cpp
+//
+// This application demonstrates animation using matrix transformations
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//--------------------------------------------------------------------------------------
+
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+#include <windows.h>
+
+#include <d3d10.h>
+#include <d3dx10.h>
+
+#include "BVHClipCache.h"
+#include "BVHCrowd.h"
+#include "BVHFigure.h"
+#include "BVHProfiler.h"
+#include "BVHRenderer.h"
+
+#include "resource.h"
+
+using namespace std;
+
+//--------------------------------------------------------------------------------------
+// Global Variables
+//--------------------------------------------------------------------------------------
+HINSTANCE                   g_hInst = NULL;
+HWND                        g_hWnd = NULL;
+D3D10_DRIVER_TYPE           g_driverType = D3D10_DRIVER_TYPE_NULL;
+ID3D10Device*               g_pd3dDevice = NULL;
+IDXGISwapChain*             g_pSwapChain = NULL;
+ID3D10RenderTargetView*     g_pRenderTargetView = NULL;
+ID3D10Texture2D*            g_pDepthStencil = NULL;
+ID3D10DepthStencilView*     g_pDepthStencilView = NULL;
+ID3D10Effect*               g_pEffect = NULL;
+ID3D10EffectTechnique*      g_pTechniqueRender = NULL;
+ID3D10EffectTechnique*      g_pTechniqueRenderInstanced = NULL;
+ID3D10EffectMatrixVariable* g_pViewVariable = NULL;
+ID3D10EffectMatrixVariable* g_pProjectionVariable = NULL;
+ID3D10EffectMatrixVariable* g_pWorldVariable = NULL;
+D3DXMATRIX                  g_Projection;
+
+// Clips the crowd plays, each loaded once and shared by its figures
+const char*					g_clipFiles[] = { "Jog.bvh", "wave.bvh" };
+const int					g_numClips = sizeof( g_clipFiles ) / sizeof( g_clipFiles[0] );
+BVHRenderer*				g_renderer = NULL;
+
+// Figures in the crowd, set by a number on the command line
+int							g_crowdSize = 64;
+
+// Written on exit when PROFILE is defined, open it in chrome://tracing
+const char*					g_traceFile = "BVHTester.trace.json";
+const float					g_crowdSpacing = 150.0f;
+BVHCrowd*					g_crowd = NULL;
+
+//--------------------------------------------------------------------------------------
+// Forward declarations
+//--------------------------------------------------------------------------------------
+HRESULT InitWindow( HINSTANCE hInstance, int nCmdShow );
+HRESULT InitDevice();
+HRESULT InitCrowd();
+int GetCrowdColumns();
+void CleanupDevice();
+void CleanupCrowd();
+LRESULT CALLBACK    WndProc( HWND, UINT, WPARAM, LPARAM );
+void Render();
+
+//--------------------------------------------------------------------------------------
+// Entry point to the program. Initializes everything and goes into a message processing 
+// loop. Idle time is used to render the scene.
+//--------------------------------------------------------------------------------------
+int WINAPI wWinMain( HINSTANCE hInstance, HINSTANCE hPrevInstance, LPWSTR lpCmdLine, int nCmdShow )
+{
+    if( FAILED( InitWindow( hInstance, nCmdShow ) ) )
+        return E_FAIL;
+
+    if( FAILED( InitDevice() ) )
+    {
+        CleanupDevice();
+        return E_FAIL;
+    }
+
+    if( _wtoi( lpCmdLine ) > 0 )
+        g_crowdSize = _wtoi( lpCmdLine );
+
+    BVH_PROFILE_THREAD( "Main" );
+
+    if( FAILED( InitCrowd() ) )
+    {
+        CleanupCrowd();
+        CleanupDevice();
+        return E_FAIL;
+    }
+
+    // Main message loop
+    MSG msg = {0};
+    while( WM_QUIT != msg.message )
+    {
+        if( PeekMessage( &msg, NULL, 0, 0, PM_REMOVE ) )
+        {
+            TranslateMessage( &msg );
+            DispatchMessage( &msg );
+        }
+        else
+        {
+            Render();
+        }
+    }
+
+#ifdef PROFILE
+    BVHProfiler::WriteChromeTrace( g_traceFile );
+#endif
+
+    CleanupCrowd();
+    CleanupDevice();
+
+    return ( int )msg.wParam;
+}
+
+
+//--------------------------------------------------------------------------------------
+// Register class and create window
+//--------------------------------------------------------------------------------------
+HRESULT InitWindow( HINSTANCE hInstance, int nCmdShow )
+{
+    // Register class
+    WNDCLASSEX wcex;
+    wcex.cbSize = sizeof( WNDCLASSEX );
+    wcex.style = CS_HREDRAW | CS_VREDRAW;
+    wcex.lpfnWndProc = WndProc;
+    wcex.cbClsExtra = 0;
+    wcex.cbWndExtra = 0;
+    wcex.hInstance = hInstance;
+    wcex.hIcon = LoadIcon( hInstance, ( LPCTSTR )IDI_TUTORIAL1 );
+    wcex.hCursor = LoadCursor( NULL, IDC_ARROW );
+    wcex.hbrBackground = ( HBRUSH )( COLOR_WINDOW + 1 );
+    wcex.lpszMenuName = NULL;
+    wcex.lpszClassName = L"BVHTester";
+    wcex.hIconSm = LoadIcon( wcex.hInstance, ( LPCTSTR )IDI_TUTORIAL1 );
+    if( !RegisterClassEx( &wcex ) )
+        return E_FAIL;
+
+    // Create window
+    g_hInst = hInstance;
+    RECT rc = { 0, 0, 640, 480 };
+    AdjustWindowRect( &rc, WS_OVERLAPPEDWINDOW, FALSE );
+    g_hWnd = CreateWindow( L"BVHTester", L"BVHTester", WS_OVERLAPPEDWINDOW,
+                           CW_USEDEFAULT, CW_USEDEFAULT, rc.right - rc.left, rc.bottom - rc.top, NULL, NULL, hInstance,
+                           NULL );
+    if( !g_hWnd )
+        return E_FAIL;
+
+    ShowWindow( g_hWnd, nCmdShow );
+
+    return S_OK;
+}
+
+
+//--------------------------------------------------------------------------------------
+// Create Direct3D device and swap chain
+//--------------------------------------------------------------------------------------
+HRESULT InitDevice()
+{
+    HRESULT hr = S_OK;
+
+    RECT rc;
+    GetClientRect( g_hWnd, &rc );
+    UINT width = rc.right - rc.left;
+    UINT height = rc.bottom - rc.top;
+
+    UINT createDeviceFlags = 0;
+#ifdef _DEBUG
+    createDeviceFlags |= D3D10_CREATE_DEVICE_DEBUG;
+#endif
+
+    D3D10_DRIVER_TYPE driverTypes[] =
+    {
+        D3D10_DRIVER_TYPE_HARDWARE,
+        D3D10_DRIVER_TYPE_REFERENCE,
+    };
+    UINT numDriverTypes = sizeof( driverTypes ) / sizeof( driverTypes[0] );
+
+    DXGI_SWAP_CHAIN_DESC sd;
+    ZeroMemory( &sd, sizeof( sd ) );
+    sd.BufferCount = 1;
+    sd.BufferDesc.Width = width;
+    sd.BufferDesc.Height = height;
+    sd.BufferDesc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
+    sd.BufferDesc.RefreshRate.Numerator = 60;
+    sd.BufferDesc.RefreshRate.Denominator = 1;
+    sd.BufferUsage = DXGI_USAGE_RENDER_TARGET_OUTPUT;
+    sd.OutputWindow = g_hWnd;
+    sd.SampleDesc.Count = 1;
+    sd.SampleDesc.Quality = 0;
+    sd.Windowed = TRUE;
+
+    for( UINT driverTypeIndex = 0; driverTypeIndex < numDriverTypes; driverTypeIndex++ )
+    {
+        g_driverType = driverTypes[driverTypeIndex];
+        hr = D3D10CreateDeviceAndSwapChain( NULL, g_driverType, NULL, createDeviceFlags,
+                                            D3D10_SDK_VERSION, &sd, &g_pSwapChain, &g_pd3dDevice );
+        if( SUCCEEDED( hr ) )
+            break;
+    }
+    if( FAILED( hr ) )
+        return hr;
+
+    // Create a render target view
+    ID3D10Texture2D* pBuffer;
+    hr = g_pSwapChain->GetBuffer( 0, __uuidof( ID3D10Texture2D ), ( LPVOID* )&pBuffer );
+    if( FAILED( hr ) )
+        return hr;
+
+    hr = g_pd3dDevice->CreateRenderTargetView( pBuffer, NULL, &g_pRenderTargetView );
+    pBuffer->Release();
+    if( FAILED( hr ) )
+        return hr;
+
+    // Create depth stencil texture
+    D3D10_TEXTURE2D_DESC descDepth;
+    descDepth.Width = width;
+    descDepth.Height = height;
+    descDepth.MipLevels = 1;
+    descDepth.ArraySize = 1;
+    descDepth.Format = DXGI_FORMAT_D32_FLOAT;
+    descDepth.SampleDesc.Count = 1;
+    descDepth.SampleDesc.Quality = 0;
+    descDepth.Usage = D3D10_USAGE_DEFAULT;
+    descDepth.BindFlags = D3D10_BIND_DEPTH_STENCIL;
+    descDepth.CPUAccessFlags = 0;
+    descDepth.MiscFlags = 0;
+    hr = g_pd3dDevice->CreateTexture2D( &descDepth, NULL, &g_pDepthStencil );
+    if( FAILED( hr ) )
+        return hr;
+
+    // Create the depth stencil view
+    D3D10_DEPTH_STENCIL_VIEW_DESC descDSV;
+    descDSV.Format = descDepth.Format;
+    descDSV.ViewDimension = D3D10_DSV_DIMENSION_TEXTURE2D;
+    descDSV.Texture2D.MipSlice = 0;
+    hr = g_pd3dDevice->CreateDepthStencilView( g_pDepthStencil, &descDSV, &g_pDepthStencilView );
+    if( FAILED( hr ) )
+        return hr;
+
+    g_pd3dDevice->OMSetRenderTargets( 1, &g_pRenderTargetView, g_pDepthStencilView );
+
+    // Setup the viewport
+    D3D10_VIEWPORT vp;
+    vp.Width = width;
+    vp.Height = height;
+    vp.MinDepth = 0.0f;
+    vp.MaxDepth = 1.0f;
+    vp.TopLeftX = 0;
+    vp.TopLeftY = 0;
+    g_pd3dDevice->RSSetViewports( 1, &vp );
+
+    // Create the effect
+    DWORD dwShaderFlags = D3D10_SHADER_ENABLE_STRICTNESS;
+#if defined( DEBUG ) || defined( _DEBUG )
+    // Set the D3D10_SHADER_DEBUG flag to embed debug information in the shaders.
+    // Setting this flag improves the shader debugging experience, but still allows 
+    // the shaders to be optimized and to run exactly the way they will run in 
+    // the release configuration of this program.
+    dwShaderFlags |= D3D10_SHADER_DEBUG;
+    #endif
+    hr = D3DX10CreateEffectFromFile( L"BVHTester.fx", NULL, NULL, "fx_4_0", dwShaderFlags, 0, g_pd3dDevice, NULL,
+                                         NULL, &g_pEffect, NULL, NULL );
+    if( FAILED( hr ) )
+    {
+        MessageBox( NULL,
+                    L"The FX file cannot be located.  Please run this executable from the directory that contains the FX file.", L"Error", MB_OK );
+        return hr;
+    }
+
+    // Obtain the techniques
+    g_pTechniqueRender = g_pEffect->GetTechniqueByName( "Render" );
+    g_pTechniqueRenderInstanced = g_pEffect->GetTechniqueByName( "RenderInstanced" );
+
+    // Obtain the variables
+    g_pWorldVariable = g_pEffect->GetVariableByName( "World" )->AsMatrix();
+    g_pViewVariable = g_pEffect->GetVariableByName( "View" )->AsMatrix();
+    g_pProjectionVariable = g_pEffect->GetVariableByName( "Projection" )->AsMatrix();
+
+    // Initialize the projection matrix
+    D3DXMatrixPerspectiveFovLH( &g_Projection, ( float )D3DX_PI * 0.25f, width / ( FLOAT )height, 0.1f, 10000.0f );
+    g_pProjectionVariable->SetMatrix( ( float* )&g_Projection );
+
+    return TRUE;
+}
+
+//--------------------------------------------------------------------------------------
+// Columns of the smallest square grid that holds the crowd
+//--------------------------------------------------------------------------------------
+int GetCrowdColumns()
+{
+    int columns = 1;
+    while( columns * columns < g_crowdSize )
+        ++columns;
+    return columns;
+}
+
+//--------------------------------------------------------------------------------------
+// Load the clips and lay out the crowd on a square grid
+//--------------------------------------------------------------------------------------
+HRESULT InitCrowd()
+{
+    g_renderer = new BVHRenderer();
+
+    if( FAILED( g_renderer->Initialize( g_pd3dDevice, g_pTechniqueRender, g_pTechniqueRenderInstanced, g_pWorldVariable ) ) )
+        return E_FAIL;
+
+    g_crowd = new BVHCrowd();
+
+    int columns = GetCrowdColumns();
+
+    for( int i = 0; i < g_crowdSize; ++i )
+    {
+        // Only the first figure of each clip loads it
+        BVHFigure figure;
+        if( FAILED( figure.ReadBVH( g_clipFiles[i % g_numClips] ) ) )
+            return E_FAIL;
+
+        // Spread the figures out in time and speed so they do not move in step
+        BVHMatrix root;
+        BVHMatrixTranslation( &root, ( i % columns ) * g_crowdSpacing, 0.0f, ( i / columns ) * g_crowdSpacing );
+        figure.SetWorld( root );
+        figure.SetTimeOffset( i * 0.37f );
+        figure.SetRate( 0.8f + 0.1f * ( i % 5 ) );
+
+        // The rates do not match the clips' frame times, so blend between frames
+        figure.SetInterpolate( true );
+
+        if( g_crowd->AddFigure( figure ) < 0 )
+            return E_FAIL;
+    }
+
+    return S_OK;
+}
+
+void CleanupCrowd()
+{
+    delete g_crowd;
+    g_crowd = NULL;
+
+    if( g_renderer ) g_renderer->Cleanup();
+    delete g_renderer;
+    g_renderer = NULL;
+}
+
+void CleanupDevice()
+{
+    if( g_pd3dDevice ) g_pd3dDevice->ClearState();
+
+    if( g_pEffect ) g_pEffect->Release();
+    if( g_pRenderTargetView ) g_pRenderTargetView->Release();
+    if( g_pDepthStencil ) g_pDepthStencil->Release();
+    if( g_pDepthStencilView ) g_pDepthStencilView->Release();
+    if( g_pSwapChain ) g_pSwapChain->Release();
+    if( g_pd3dDevice ) g_pd3dDevice->Release();
+}
+
+//--------------------------------------------------------------------------------------
+// Called every time the application receives a message
+//--------------------------------------------------------------------------------------
+LRESULT CALLBACK WndProc( HWND hWnd, UINT message, WPARAM wParam, LPARAM lParam )
+{
+    PAINTSTRUCT ps;
+    HDC hdc;
+
+    switch( message )
+    {
+        case WM_PAINT:
+            hdc = BeginPaint( hWnd, &ps );
+            EndPaint( hWnd, &ps );
+            break;
+
+        case WM_DESTROY:
+            PostQuitMessage( 0 );
+            break;
+
+        default:
+            return DefWindowProc( hWnd, message, wParam, lParam );
+    }
+
+    return 0;
+}
+
+/// <summary>
+/// Render a frame.
+/// </summary>
+void Render()
+{
+    BVH_PROFILE_SCOPE( "Frame" );
+
+    static float t = 0.0f;
+    static DWORD dwTimeStart = 0;
+    DWORD dwTimeCur = GetTickCount();
+    if( dwTimeStart == 0 )
+        dwTimeStart = dwTimeCur;
+
+    t = ( dwTimeCur - dwTimeStart ) / 1000.0f;
+
+	// Pose the crowd
+	{
+		BVH_PROFILE_SCOPE( "Update" );
+		g_crowd->Update( t );
+	}
+
+	// Look at the middle of the crowd
+	{
+		BVH_PROFILE_SCOPE( "LookAt" );
+		int columns = GetCrowdColumns();
+		float middle = ( columns - 1 ) * g_crowdSpacing * 0.5f;
+		D3DXVECTOR3 Eye( middle + 500.0f + columns * g_crowdSpacing * 0.5f, 300.0f, middle - 500.0f - columns * g_crowdSpacing * 0.5f );
+		D3DXVECTOR3 At( middle, 100.0f, middle );
+		D3DXVECTOR3 Up( 0.0f, 1.0f, 0.0f );
+		D3DXMATRIX View;
+		D3DXMatrixLookAtLH( &View, &Eye, &At, &Up );
+		g_pViewVariable->SetMatrix( ( float* )&View );
+	}
+
+	// Show the pose throughput about once a second
+	static DWORD dwTimeTitle = 0;
+	if( dwTimeCur - dwTimeTitle >= 1000 )
+	{
+		WCHAR title[128];
+		swprintf_s( title, L"BVHTester - %d figures sharing %d clips, %.1f figures/ms posing on %d threads",
+		            g_crowd->GetNumFigures(), BVHClipCache::GetShared()->GetNumClips(),
+		            g_crowd->GetFiguresPerMillisecond(), BVHThreadPool::GetShared()->GetNumThreads() );
+		SetWindowText( g_hWnd, title );
+		dwTimeTitle = dwTimeCur;
+	}
+
+    //
+    // Clear the back buffer
+    //
+    float ClearColor[4] = { 0.0f, 0.125f, 0.3f, 1.0f }; //red, green, blue, alpha
+    g_pd3dDevice->ClearRenderTargetView( g_pRenderTargetView, ClearColor );
+
+    //
+    // Clear the depth buffer to 1.0 (max depth)
+    //
+    g_pd3dDevice->ClearDepthStencilView( g_pDepthStencilView, D3D10_CLEAR_DEPTH, 1.0f, 0 );
+
+	// Render the crowd
+	{
+		BVH_PROFILE_SCOPE( "Render" );
+		g_renderer->Render( *g_crowd );
+	}
+
+    //
+    // Present our back buffer to our front buffer
+    //
+    {
+        BVH_PROFILE_SCOPE( "Present" );
+        g_pSwapChain->Present( 0, 0 );
+    }
+
+    BVH_PROFILE_FRAME();
+}
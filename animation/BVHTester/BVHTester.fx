@@ -1,63 +1,100 @@
-//--------------------------------------------------------------------------------------
-// File: BVHTester.fx
-//
-// Copyright (c) Microsoft Corporation. All rights reserved.
-//--------------------------------------------------------------------------------------
-
-//--------------------------------------------------------------------------------------
-// Constant Buffer Variables
-//--------------------------------------------------------------------------------------
-matrix World;
-matrix View;
-matrix Projection;
-
-//--------------------------------------------------------------------------------------
-struct VS_INPUT
-{
-    float4 Pos : POSITION;
-    float4 Color : COLOR;
-};
-
-struct PS_INPUT
-{
-    float4 Pos : SV_POSITION;
-    float4 Color : COLOR;
-};
-
-
-//--------------------------------------------------------------------------------------
-// Vertex Shader
-//--------------------------------------------------------------------------------------
-PS_INPUT VS( VS_INPUT input )
-{
-    PS_INPUT output = (PS_INPUT)0;
-    output.Pos = mul( input.Pos, World );
-    output.Pos = mul( output.Pos, View );
-    output.Pos = mul( output.Pos, Projection );
-    output.Color = input.Color;
-    
-    return output;
-}
-
-
-//--------------------------------------------------------------------------------------
-// Pixel Shader
-//--------------------------------------------------------------------------------------
-float4 PS( PS_INPUT input) : SV_Target
-{
-    return input.Color;
-}
-
-
-//--------------------------------------------------------------------------------------
-technique10 Render
-{
-    pass P0
-    {
-        SetVertexShader( CompileShader( vs_4_0, VS() ) );
-        SetGeometryShader( NULL );
-        SetPixelShader( CompileShader( ps_4_0, PS() ) );
-    }
-}
-
-
+//--------------------------------------------------------------------------------------
+// File: BVHTester.fx
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//--------------------------------------------------------------------------------------
+
+//--------------------------------------------------------------------------------------
+// Constant Buffer Variables
+//--------------------------------------------------------------------------------------
+matrix World;
+matrix View;
+matrix Projection;
+
+//--------------------------------------------------------------------------------------
+struct VS_INPUT
+{
+    float4 Pos : POSITION;
+    float4 Color : COLOR;
+};
+
+// A cube drawn once per joint, placed by the joint's world transform. The
+// transform is stored as its first three columns, one per float4.
+struct VS_INSTANCED_INPUT
+{
+    float4 Pos : POSITION;
+    float4 Color : COLOR;
+    float4 World0 : WORLD0;
+    float4 World1 : WORLD1;
+    float4 World2 : WORLD2;
+};
+
+struct PS_INPUT
+{
+    float4 Pos : SV_POSITION;
+    float4 Color : COLOR;
+};
+
+
+//--------------------------------------------------------------------------------------
+// Vertex Shader
+//--------------------------------------------------------------------------------------
+PS_INPUT VS( VS_INPUT input )
+{
+    PS_INPUT output = (PS_INPUT)0;
+    output.Pos = mul( input.Pos, World );
+    output.Pos = mul( output.Pos, View );
+    output.Pos = mul( output.Pos, Projection );
+    output.Color = input.Color;
+    
+    return output;
+}
+
+
+//--------------------------------------------------------------------------------------
+// Vertex Shader for instanced joints
+//--------------------------------------------------------------------------------------
+PS_INPUT VSInstanced( VS_INSTANCED_INPUT input )
+{
+    PS_INPUT output = (PS_INPUT)0;
+    output.Pos = float4( dot( input.Pos, input.World0 ), dot( input.Pos, input.World1 ), dot( input.Pos, input.World2 ), 1 );
+    output.Pos = mul( output.Pos, View );
+    output.Pos = mul( output.Pos, Projection );
+    output.Color = input.Color;
+    
+    return output;
+}
+
+
+//--------------------------------------------------------------------------------------
+// Pixel Shader
+//--------------------------------------------------------------------------------------
+float4 PS( PS_INPUT input) : SV_Target
+{
+    return input.Color;
+}
+
+
+//--------------------------------------------------------------------------------------
+technique10 Render
+{
+    pass P0
+    {
+        SetVertexShader( CompileShader( vs_4_0, VS() ) );
+        SetGeometryShader( NULL );
+        SetPixelShader( CompileShader( ps_4_0, PS() ) );
+    }
+}
+
+//--------------------------------------------------------------------------------------
+technique10 RenderInstanced
+{
+    pass P0
+    {
+        SetVertexShader( CompileShader( vs_4_0, VSInstanced() ) );
+        SetGeometryShader( NULL );
+        SetPixelShader( CompileShader( ps_4_0, PS() ) );
+    }
+}
+
+
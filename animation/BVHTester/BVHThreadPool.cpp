@@ -0,0 +1,229 @@
+// BVHThreadPool.cpp
+//
+// Summary:
+//	A fixed set of worker threads. ParallelFor hands out ranges of a loop
+//	to the workers and to the calling thread, and returns when the whole
+//	loop has run. Threads that run out of work steal ranges from the
+//	others.
+
+#include "BVHThreadPool.h"
+#include "BVHProfiler.h"
+
+/// <summary>
+/// Creates the worker threads.
+/// </summary>
+/// <param name='numThreads'>Threads to run loops on, including the calling thread. 0 uses one per processor.</param>
+BVHThreadPool::BVHThreadPool( int numThreads )
+{
+	if( numThreads <= 0 )
+		numThreads = GetNumProcessors();
+
+	BVHMutexInit( &lock );
+	BVHConditionInit( &workReady );
+	BVHConditionInit( &workDone );
+
+	shutdown = false;
+	busy = 0;
+	taskFunction = NULL;
+	taskContext = NULL;
+	taskGrain = 1;
+	numPending = 0;
+	generation = 0;
+	numStarted = 0;
+
+	// The thread that calls ParallelFor runs tasks too, so one less worker is needed
+	for( int i = 1; i < numThreads; ++i )
+	{
+		BVHThread thread;
+		if( BVHThreadCreate( &thread, WorkerMain, this ) )
+			threads.push_back( thread );
+	}
+
+	slices.resize( threads.size() + 1 );
+}
+
+/// <summary>
+/// Stops and joins the worker threads.
+/// </summary>
+BVHThreadPool::~BVHThreadPool( void )
+{
+	BVHMutexLock( &lock );
+	shutdown = true;
+	BVHConditionWakeAll( &workReady );
+	BVHMutexUnlock( &lock );
+
+	for( int i = 0; i < threads.size(); ++i )
+	{
+		BVHThreadJoin( threads[i] );
+	}
+
+	BVHConditionDestroy( &workReady );
+	BVHConditionDestroy( &workDone );
+	BVHMutexDestroy( &lock );
+}
+
+/// <summary>
+/// Returns the number of threads loops run on, including the calling thread.
+/// </summary>
+int BVHThreadPool::GetNumThreads()
+{
+	return ( int )threads.size() + 1;
+}
+
+/// <summary>
+/// Runs function over the indices [0, count) in ranges of at most grain
+/// indices, spread across the pool. Returns when every range has run.
+/// While the pool is running another loop, the whole of this one runs on
+/// the calling thread as thread 0.
+/// </summary>
+/// <param name='count'>Number of indices.</param>
+/// <param name='grain'>Largest range handed to one call of function.</param>
+/// <param name='function'>Function called for each range.</param>
+/// <param name='context'>Passed through to function.</param>
+void BVHThreadPool::ParallelFor( int count, int grain, BVHTaskFunction function, void * context )
+{
+	if( count <= 0 )
+		return;
+
+	if( grain < 1 )
+		grain = 1;
+
+	if( threads.empty() || count <= grain )
+	{
+		function( context, 0, 0, count );
+		return;
+	}
+
+	// The loop's state is shared by every worker, so only one loop can own
+	// it. Another caller, or a task of the running loop, runs its own.
+	if( BVHAtomicAdd( &busy, 1 ) != 0 )
+	{
+		BVHAtomicAdd( &busy, -1 );
+		function( context, 0, 0, count );
+		return;
+	}
+
+	BVHMutexLock( &lock );
+	taskFunction = function;
+	taskContext = context;
+	taskGrain = grain;
+	for( int t = 0; t < slices.size(); ++t )
+	{
+		slices[t].next = ( LONG )( ( long long )count * t / slices.size() );
+		slices[t].end = ( int )( ( long long )count * ( t + 1 ) / slices.size() );
+	}
+	numPending = ( int )threads.size();
+	++generation;
+	BVHConditionWakeAll( &workReady );
+	BVHMutexUnlock( &lock );
+
+	RunTasks( 0 );
+
+	// Every worker checks in once per loop, so none can miss the next one
+	BVHMutexLock( &lock );
+	while( numPending > 0 )
+		BVHConditionWait( &workDone, &lock );
+	taskFunction = NULL;
+	taskContext = NULL;
+	BVHMutexUnlock( &lock );
+
+	BVHAtomicAdd( &busy, -1 );
+}
+
+/// <summary>
+/// Runs the thread's own slice of the current loop, then steals ranges
+/// from the other slices until none are left.
+/// </summary>
+/// <param name='thread'>Index of the calling thread, 0 for the thread that called ParallelFor.</param>
+void BVHThreadPool::RunTasks( int thread )
+{
+	// A slice never refills, so one pass round the others is enough
+	for( int i = 0; i < slices.size(); ++i )
+	{
+		RunSlice( thread, &slices[( thread + i ) % slices.size()] );
+	}
+}
+
+/// <summary>
+/// Claims and runs ranges of a slice until it is empty.
+/// </summary>
+void BVHThreadPool::RunSlice( int thread, Slice * slice )
+{
+	for( ;; )
+	{
+		// The owner and thieves claim from the same counter, so no range runs twice
+		int begin = ( int )BVHAtomicAdd( &slice->next, taskGrain );
+		if( begin >= slice->end )
+			return;
+
+		int end = begin + taskGrain < slice->end ? begin + taskGrain : slice->end;
+		taskFunction( taskContext, thread, begin, end );
+	}
+}
+
+/// <summary>
+/// Worker thread loop, waits for a loop to run then helps run it.
+/// </summary>
+BVHThreadResult BVH_THREAD_CALL BVHThreadPool::WorkerMain( void * pool )
+{
+	BVHThreadPool * self = ( BVHThreadPool * )pool;
+	int thread = ( int )BVHAtomicAdd( &self->numStarted, 1 ) + 1;
+	int lastGeneration = 0;
+
+	BVH_PROFILE_THREAD( "BVHThreadPool worker" );
+
+	BVHMutexLock( &self->lock );
+	for( ;; )
+	{
+		while( !self->shutdown && self->generation == lastGeneration )
+			BVHConditionWait( &self->workReady, &self->lock );
+
+		if( self->shutdown )
+			break;
+
+		lastGeneration = self->generation;
+		BVHMutexUnlock( &self->lock );
+
+		self->RunTasks( thread );
+
+		BVHMutexLock( &self->lock );
+		if( --self->numPending == 0 )
+			BVHConditionWakeAll( &self->workDone );
+	}
+	BVHMutexUnlock( &self->lock );
+
+	return 0;
+}
+
+// Guards creation of the shared pool. It is initialized with the globals,
+// before main can start a thread, while the pool and its threads wait
+// for a program that uses them.
+static struct SharedPool
+{
+	BVHMutex					mutex;
+	BVHThreadPool *				pool;
+
+	SharedPool() { BVHMutexInit( &mutex ); pool = NULL; }
+} g_sharedPool;
+
+/// <summary>
+/// Returns a pool with one thread per processor, created on first use by
+/// whichever thread gets there first.
+/// </summary>
+BVHThreadPool * BVHThreadPool::GetShared()
+{
+	BVHMutexLock( &g_sharedPool.mutex );
+	if( g_sharedPool.pool == NULL )
+		g_sharedPool.pool = new BVHThreadPool();
+	BVHThreadPool * shared = g_sharedPool.pool;
+	BVHMutexUnlock( &g_sharedPool.mutex );
+	return shared;
+}
+
+/// <summary>
+/// Returns the number of logical processors.
+/// </summary>
+int BVHThreadPool::GetNumProcessors()
+{
+	return BVHGetNumProcessors();
+}
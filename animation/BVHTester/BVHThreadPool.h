@@ -0,0 +1,66 @@
+#pragma once
+
+#include <vector>
+
+#include "BVHPlatform.h"
+
+using namespace std;
+
+/// <summary>
+/// Called by BVHThreadPool::ParallelFor for each range of indices. thread
+/// is the index, below GetNumThreads(), of the thread running the range,
+/// so tasks can keep scratch data per thread.
+/// </summary>
+typedef void ( *BVHTaskFunction )( void * context, int thread, int begin, int end );
+
+/// <summary>
+/// A fixed set of worker threads that split loops between them.
+/// </summary>
+/// <remarks>
+/// Each loop is cut into one slice per thread. A thread runs its own slice
+/// first, then steals what is left of the others' slices, so uneven work
+/// still keeps every thread busy.
+///
+/// The pool runs one loop at a time. A loop started while another is
+/// running, from another thread or from a task of the running loop, runs
+/// serially on the thread that started it, so callers sharing the pool
+/// never wait on each other or deadlock.
+/// </remarks>
+class BVHThreadPool
+{
+protected:
+	// The indices of a loop that one thread starts on, padded to a cache line
+	struct Slice
+	{
+		volatile LONG			next;
+		int						end;
+		char					padding[56];
+	};
+
+	vector<BVHThread>			threads;
+	vector<Slice>				slices;
+	BVHMutex					lock;
+	BVHCondition				workReady;
+	BVHCondition				workDone;
+	bool						shutdown;
+	volatile LONG				busy;			// Non-zero while a loop is running on the pool
+
+	// The loop being run
+	BVHTaskFunction				taskFunction;
+	void *						taskContext;
+	int							taskGrain;
+	int							numPending;
+	int							generation;
+	volatile LONG				numStarted;
+
+	static BVHThreadResult BVH_THREAD_CALL WorkerMain( void * pool );
+	void RunTasks( int thread );
+	void RunSlice( int thread, Slice * slice );
+public:
+	BVHThreadPool( int numThreads = 0 );
+	~BVHThreadPool( void );
+	int GetNumThreads();
+	void ParallelFor( int count, int grain, BVHTaskFunction function, void * context );
+	static BVHThreadPool * GetShared();
+	static int GetNumProcessors();
+};
@@ -0,0 +1,76 @@
+// BVHTimeWarp.cpp
+//
+// Summary:
+//	A repeating piecewise linear curve from playback time to clip time.
+
+#include "BVHTimeWarp.h"
+
+#include <algorithm>
+#include <cmath>
+
+BVHTimeWarp::BVHTimeWarp( void )
+{
+}
+
+BVHTimeWarp::~BVHTimeWarp( void )
+{
+}
+
+/// <summary>
+/// Removes every key, which leaves clip time equal to playback time.
+/// </summary>
+void BVHTimeWarp::Clear()
+{
+	times.clear();
+	clipTimes.clear();
+}
+
+/// <summary>
+/// Adds a key after all existing keys.
+/// </summary>
+/// <param name='time'>Playback time of the key, later than the last key's.</param>
+/// <param name='clipTime'>Clip time shown at that playback time.</param>
+HRESULT BVHTimeWarp::AddKey( float time, float clipTime )
+{
+	if( !times.empty() && time <= times.back() )
+		return E_INVALIDARG;
+
+	times.push_back( time );
+	clipTimes.push_back( clipTime );
+
+	return S_OK;
+}
+
+/// <summary>
+/// Returns the clip time shown at a playback time.
+/// </summary>
+/// <remarks>
+/// With no keys the time is returned unchanged, and with one key it is
+/// shifted by that key. Otherwise the time is wrapped into the keys' cycle,
+/// interpolated between the two keys around it, and moved on by the clip
+/// time of each whole cycle before it.
+/// </remarks>
+float BVHTimeWarp::GetClipTime( float time ) const
+{
+	if( times.empty() )
+		return time;
+
+	if( times.size() == 1 )
+		return time - times[0] + clipTimes[0];
+
+	float period = times.back() - times.front();
+	float cycles = floorf( ( time - times.front() ) / period );
+	float local = time - cycles * period;
+
+	// The last key at or before the local time, which is inside the cycle
+	int k = ( int )( upper_bound( times.begin(), times.end(), local ) - times.begin() ) - 1;
+	if( k < 0 )
+		k = 0;
+	else if( k > ( int )times.size() - 2 )
+		k = ( int )times.size() - 2;
+
+	float t = ( local - times[k] ) / ( times[k + 1] - times[k] );
+	float clipTime = clipTimes[k] + ( clipTimes[k + 1] - clipTimes[k] ) * t;
+
+	return clipTime + cycles * ( clipTimes.back() - clipTimes.front() );
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <vector>
+
+#include "BVHPlatform.h"
+
+using namespace std;
+
+/// <summary>
+/// Maps playback time to clip time with a piecewise linear curve, so a clip
+/// can speed up, slow down or hold without being resampled. The keys cover
+/// one cycle, which repeats: each later cycle carries on from where the
+/// clip time of the previous one ended.
+/// </summary>
+/// <remarks>
+/// A warp holds no per figure state, so any number of figures can share one
+/// through BVHFigure::SetTimeWarp.
+/// </remarks>
+class BVHTimeWarp
+{
+protected:
+	vector<float>				times;			// Playback time of each key, increasing
+	vector<float>				clipTimes;		// Clip time of each key
+public:
+	BVHTimeWarp( void );
+	~BVHTimeWarp( void );
+	void Clear();
+	HRESULT AddKey( float time, float clipTime );
+	int GetNumKeys() const { return ( int )times.size(); }
+	float GetClipTime( float time ) const;
+};